@@ -490,6 +490,48 @@ trie_val_t* trie_get_try_wildcard(trie_t *tbl, const trie_key_t *key, uint32_t l
 	return trie_get_try(tbl, wild_key, wild_len);
 }
 
+/*! \brief Check that key[from, lkey->len) equals the tail of lkey. */
+static bool key_prefix_match(const trie_key_t *key, uint32_t len,
+                             const tkey_t *lkey, uint32_t from)
+{
+	return lkey->len <= len &&
+	       memcmp(key + from, lkey->chars + from, lkey->len - from) == 0;
+}
+
+/* The keys stored along the search path which are prefixes of the searched key
+ * can only be found in the NOBYTE twigs (always leaves) of the branches on the
+ * path. All keys below such a branch share the whole NOBYTE key as their prefix,
+ * so the candidates are verified incrementally from the last verified length
+ * and the descent stops at the first mismatching one. */
+trie_val_t* trie_get_lpm(trie_t *tbl, const trie_key_t *key, uint32_t len)
+{
+	assert(tbl);
+	if (!tbl->weight)
+		return NULL;
+	trie_val_t *best = NULL;
+	uint32_t verified = 0;
+	node_t *t = &tbl->root;
+	while (isbranch(t)) {
+		__builtin_prefetch(twigs(t));
+		if (hastwig(t, BMP_NOBYTE)) {
+			node_t *cand = twig(t, 0);
+			tkey_t *ckey = tkey(cand);
+			if (!key_prefix_match(key, len, ckey, verified))
+				return best;
+			best = tvalp(cand);
+			verified = ckey->len;
+		}
+		bitmap_t b = twigbit(t, key, len);
+		if (!hastwig(t, b))
+			return best;
+		t = twig(t, twigoff(t, b));
+	}
+	tkey_t *lkey = tkey(t);
+	if (key_prefix_match(key, len, lkey, verified))
+		return tvalp(t);
+	return best;
+}
+
 /*! \brief Delete leaf t with parent p; b is the bit for t under p.
  * Optionally return the deleted value via val.  The function can't fail. */
 static void del_found(trie_t *tbl, node_t *t, node_t *p, bitmap_t b, trie_val_t *val)
@@ -85,6 +85,18 @@ trie_val_t* trie_get_try(trie_t *tbl, const trie_key_t *key, uint32_t len);
  */
 trie_val_t* trie_get_try_wildcard(trie_t *tbl, const trie_key_t *key, uint32_t len);
 
+/*!
+ * \brief Search for the longest key which is a prefix of the searched key.
+ *
+ * The search is done in a single descent.
+ *
+ * \note For keys in knot_dname_lf() format, the result is the closest enclosing
+ *   name as long as the labels don't contain zero bytes.
+ *
+ * \return Value of the longest prefix key (incl. exact match) or NULL if none.
+ */
+trie_val_t* trie_get_lpm(trie_t *tbl, const trie_key_t *key, uint32_t len);
+
 /*! \brief Search the trie, inserting NULL trie_val_t on failure. */
 trie_val_t* trie_get_ins(trie_t *tbl, const trie_key_t *key, uint32_t len);
 
@@ -49,13 +49,12 @@ int sockaddr_len(const struct sockaddr_storage *ss)
 static int cmp_ipv4(const struct sockaddr_in *a, const struct sockaddr_in *b,
                     bool ignore_port)
 {
-	if (a->sin_addr.s_addr < b->sin_addr.s_addr) {
-		return -1;
-	} else if (a->sin_addr.s_addr > b->sin_addr.s_addr) {
-		return 1;
-	} else {
-		return ignore_port ? 0 : a->sin_port - b->sin_port;
+	int ret = memcmp(&a->sin_addr, &b->sin_addr, sizeof(struct in_addr));
+	if (ret == 0) {
+		ret = ignore_port ? 0 : a->sin_port - b->sin_port;
 	}
+
+	return ret;
 }
 
 static int cmp_ipv6(const struct sockaddr_in6 *a, const struct sockaddr_in6 *b,
@@ -0,0 +1,318 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef ENABLE_IO_URING
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "contrib/uring.h"
+#include "libknot/errcode.h"
+
+/*
+ * Single issuer (and thus Linux 6.0 or newer) is required, which also
+ * guarantees availability of multishot receive and provided buffer rings.
+ */
+#define URING_SETUP_FLAGS (IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | \
+                           IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER)
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags, void *arg, size_t arg_size)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+	               arg, arg_size);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int knot_uring_init(knot_uring_t *ring, unsigned entries)
+{
+	if (ring == NULL || entries == 0) {
+		return KNOT_EINVAL;
+	}
+
+	memset(ring, 0, sizeof(*ring));
+
+	struct io_uring_params p = {
+		.flags = URING_SETUP_FLAGS,
+		.cq_entries = 4 * entries,
+	};
+	ring->fd = uring_setup(entries, &p);
+	if (ring->fd < 0) {
+		ring->fd = -1;
+		return knot_map_errno();
+	}
+	ring->features = p.features;
+
+	if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+		close(ring->fd);
+		ring->fd = -1;
+		return KNOT_ENOTSUP;
+	}
+
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP);
+	if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+		ring->sq_ring_size = ring->cq_ring_size;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+	                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		ring->sq_ring = NULL;
+		goto failed;
+	}
+
+	if (single_mmap) {
+		ring->cq_ring_size = 0;
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+		                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED) {
+			ring->cq_ring = NULL;
+			goto failed;
+		}
+	}
+
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto failed;
+	}
+
+	uint8_t *sq = ring->sq_ring;
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sq_entries = p.sq_entries;
+	ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring->sqe_tail = *ring->sq_tail;
+
+	uint8_t *cq = ring->cq_ring;
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	/* Submission entries are always used in order. */
+	for (unsigned i = 0; i < ring->sq_entries; i++) {
+		ring->sq_array[i] = i;
+	}
+
+	return KNOT_EOK;
+failed:
+	knot_uring_deinit(ring);
+	return KNOT_ENOMEM;
+}
+
+void knot_uring_deinit(knot_uring_t *ring)
+{
+	if (ring == NULL || ring->fd < 0) {
+		return;
+	}
+
+	if (ring->sqes != NULL) {
+		munmap(ring->sqes, ring->sqes_size);
+	}
+	if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	}
+	if (ring->sq_ring != NULL) {
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	}
+	close(ring->fd);
+
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+struct io_uring_sqe *knot_uring_sqe(knot_uring_t *ring)
+{
+	unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (ring->sqe_tail - head >= ring->sq_entries) {
+		(void)knot_uring_submit(ring, 0, 0);
+		head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		if (ring->sqe_tail - head >= ring->sq_entries) {
+			return NULL;
+		}
+	}
+
+	struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+	ring->sqe_tail++;
+	memset(sqe, 0, sizeof(*sqe));
+
+	return sqe;
+}
+
+int knot_uring_submit(knot_uring_t *ring, unsigned wait_nr, int timeout_ms)
+{
+	if (*ring->sq_tail != ring->sqe_tail) {
+		__atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	}
+
+	unsigned to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (to_submit == 0 && wait_nr == 0) {
+		return 0;
+	}
+
+	unsigned flags = 0;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg = { 0 };
+	void *argp = NULL;
+	size_t arg_size = 0;
+	if (wait_nr > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeout_ms >= 0) {
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+			arg.ts = (uintptr_t)&ts;
+			argp = &arg;
+			arg_size = sizeof(arg);
+			flags |= IORING_ENTER_EXT_ARG;
+		}
+	}
+
+	int ret = uring_enter(ring->fd, to_submit, wait_nr, flags, argp, arg_size);
+	if (ret < 0) {
+		switch (errno) {
+		case ETIME:
+		case EINTR:
+		case EAGAIN:
+		case EBUSY:
+			return 0;
+		default:
+			return knot_map_errno();
+		}
+	}
+
+	return ret;
+}
+
+struct io_uring_cqe *knot_uring_cqe(knot_uring_t *ring)
+{
+	unsigned head = *ring->cq_head;
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+
+	return &ring->cqes[head & ring->cq_mask];
+}
+
+void knot_uring_cqe_seen(knot_uring_t *ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+bool knot_uring_cq_ready(knot_uring_t *ring)
+{
+	return *ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+}
+
+int knot_uring_bufs_init(knot_uring_t *ring, knot_uring_bufs_t *bufs,
+                         uint16_t group, uint16_t count, size_t buf_size)
+{
+	if (ring == NULL || bufs == NULL || count == 0 || (count & (count - 1)) != 0 ||
+	    buf_size == 0 || buf_size > UINT32_MAX) {
+		return KNOT_EINVAL;
+	}
+
+	memset(bufs, 0, sizeof(*bufs));
+	bufs->count = count;
+	bufs->group = group;
+	bufs->buf_size = buf_size;
+
+	/* The buffer ring must be page aligned. */
+	bufs->br_size = count * sizeof(struct io_uring_buf);
+	bufs->br = mmap(NULL, bufs->br_size, PROT_READ | PROT_WRITE,
+	                MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (bufs->br == MAP_FAILED) {
+		bufs->br = NULL;
+		return KNOT_ENOMEM;
+	}
+
+	bufs->mem = malloc(count * buf_size);
+	if (bufs->mem == NULL) {
+		munmap(bufs->br, bufs->br_size);
+		bufs->br = NULL;
+		return KNOT_ENOMEM;
+	}
+
+	struct io_uring_buf_reg reg = {
+		.ring_addr = (uintptr_t)bufs->br,
+		.ring_entries = count,
+		.bgid = group,
+	};
+	if (uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+		int ret = knot_map_errno();
+		free(bufs->mem);
+		munmap(bufs->br, bufs->br_size);
+		memset(bufs, 0, sizeof(*bufs));
+		return ret;
+	}
+
+	for (unsigned i = 0; i < count; i++) {
+		knot_uring_bufs_put(bufs, i);
+	}
+	knot_uring_bufs_commit(bufs);
+
+	return KNOT_EOK;
+}
+
+void knot_uring_bufs_deinit(knot_uring_t *ring, knot_uring_bufs_t *bufs)
+{
+	if (ring == NULL || bufs == NULL || bufs->br == NULL) {
+		return;
+	}
+
+	struct io_uring_buf_reg reg = { .bgid = bufs->group };
+	(void)uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+	free(bufs->mem);
+	munmap(bufs->br, bufs->br_size);
+	memset(bufs, 0, sizeof(*bufs));
+}
+
+void knot_uring_bufs_put(knot_uring_bufs_t *bufs, uint16_t bid)
+{
+	struct io_uring_buf *buf = &bufs->br->bufs[bufs->tail & (bufs->count - 1)];
+	buf->addr = (uintptr_t)knot_uring_buf(bufs, bid);
+	buf->len = bufs->buf_size;
+	buf->bid = bid;
+	bufs->tail++;
+}
+
+void knot_uring_bufs_commit(knot_uring_bufs_t *bufs)
+{
+	__atomic_store_n(&bufs->br->tail, bufs->tail, __ATOMIC_RELEASE);
+}
+
+#endif // ENABLE_IO_URING
@@ -0,0 +1,155 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Minimal io_uring wrapper over the raw kernel interface.
+ *
+ * The instance is meant to be owned and used by a single thread.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/*! \brief Submission and completion rings of one io_uring instance. */
+typedef struct {
+	int fd;                      /*!< Ring file descriptor. */
+	unsigned features;           /*!< IORING_FEAT_* flags supported by the kernel. */
+
+	unsigned *sq_head;           /*!< Kernel-consumed submission head. */
+	unsigned *sq_tail;           /*!< Published submission tail. */
+	unsigned *sq_array;          /*!< Submission index array. */
+	unsigned sq_mask;            /*!< Submission ring mask. */
+	unsigned sq_entries;         /*!< Submission ring size. */
+	unsigned sqe_tail;           /*!< Tail of prepared but unpublished entries. */
+	struct io_uring_sqe *sqes;   /*!< Submission entries. */
+
+	unsigned *cq_head;           /*!< Completion head. */
+	unsigned *cq_tail;           /*!< Completion tail. */
+	unsigned cq_mask;            /*!< Completion ring mask. */
+	struct io_uring_cqe *cqes;   /*!< Completion entries. */
+
+	void *sq_ring;               /*!< Mapping of the submission ring. */
+	size_t sq_ring_size;         /*!< Size of the submission ring mapping. */
+	void *cq_ring;               /*!< Mapping of the completion ring (if separate). */
+	size_t cq_ring_size;         /*!< Size of the completion ring mapping. */
+	size_t sqes_size;            /*!< Size of the submission entries mapping. */
+} knot_uring_t;
+
+/*! \brief Ring of buffers provided to the kernel for buffer selection. */
+typedef struct {
+	struct io_uring_buf_ring *br; /*!< Shared buffer ring. */
+	uint8_t *mem;                 /*!< Buffer memory. */
+	size_t br_size;               /*!< Size of the buffer ring mapping. */
+	size_t buf_size;              /*!< Size of one buffer. */
+	uint16_t count;               /*!< Number of buffers (power of two). */
+	uint16_t tail;                /*!< Local tail of returned buffers. */
+	uint16_t group;               /*!< Buffer group identifier. */
+} knot_uring_bufs_t;
+
+/*!
+ * \brief Create an io_uring instance.
+ *
+ * \param ring     Ring to initialize.
+ * \param entries  Submission queue size, the completion queue is four times bigger.
+ *
+ * \return KNOT_E*
+ */
+int knot_uring_init(knot_uring_t *ring, unsigned entries);
+
+/*!
+ * \brief Destroy the io_uring instance, pending operations are cancelled.
+ */
+void knot_uring_deinit(knot_uring_t *ring);
+
+/*!
+ * \brief Get a cleared submission entry.
+ *
+ * If the submission queue is full, the prepared entries are submitted first.
+ *
+ * \return Submission entry or NULL if not available.
+ */
+struct io_uring_sqe *knot_uring_sqe(knot_uring_t *ring);
+
+/*!
+ * \brief Submit prepared entries and optionally wait for completions.
+ *
+ * \param ring        Ring.
+ * \param wait_nr     Number of completions to wait for (0 to not wait).
+ * \param timeout_ms  Maximum waiting time (negative for no limit).
+ *
+ * \return Number of submitted entries or KNOT_E*.
+ */
+int knot_uring_submit(knot_uring_t *ring, unsigned wait_nr, int timeout_ms);
+
+/*!
+ * \brief Get the oldest unprocessed completion entry.
+ *
+ * \return Completion entry or NULL if none.
+ */
+struct io_uring_cqe *knot_uring_cqe(knot_uring_t *ring);
+
+/*!
+ * \brief Mark the oldest completion entry as processed.
+ */
+void knot_uring_cqe_seen(knot_uring_t *ring);
+
+/*!
+ * \brief Check if there are completion entries to be processed.
+ */
+bool knot_uring_cq_ready(knot_uring_t *ring);
+
+/*!
+ * \brief Create and register a ring of provided buffers.
+ *
+ * All buffers are handed over to the kernel.
+ *
+ * \param ring      Ring to register the buffers with.
+ * \param bufs      Buffers to initialize.
+ * \param group     Buffer group identifier.
+ * \param count     Number of buffers (power of two).
+ * \param buf_size  Size of one buffer.
+ *
+ * \return KNOT_E*
+ */
+int knot_uring_bufs_init(knot_uring_t *ring, knot_uring_bufs_t *bufs,
+                         uint16_t group, uint16_t count, size_t buf_size);
+
+/*!
+ * \brief Unregister and free the provided buffers.
+ */
+void knot_uring_bufs_deinit(knot_uring_t *ring, knot_uring_bufs_t *bufs);
+
+/*!
+ * \brief Get the memory of a provided buffer.
+ */
+inline static uint8_t *knot_uring_buf(const knot_uring_bufs_t *bufs, uint16_t bid)
+{
+	return bufs->mem + (size_t)bid * bufs->buf_size;
+}
+
+/*!
+ * \brief Return a buffer to the kernel, visible after knot_uring_bufs_commit().
+ */
+void knot_uring_bufs_put(knot_uring_bufs_t *bufs, uint16_t bid);
+
+/*!
+ * \brief Publish returned buffers to the kernel.
+ */
+void knot_uring_bufs_commit(knot_uring_bufs_t *bufs);
@@ -14,49 +14,189 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <sys/time.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 
+#include "contrib/macros.h"
 #include "libknot/libknot.h"
 #include "knot/server/dthreads.h"
 #include "knot/common/evsched.h"
 
-/*! \brief Some implementations of timercmp >= are broken, this is for compat.*/
-static inline int timercmp_ge(struct timeval *a, struct timeval *b) {
-	return !timercmp(a, b, <);
+#define L0_SIZE		(1 << EVSCHED_L0_BITS)
+#define L0_MASK		(L0_SIZE - 1)
+#define LN_SIZE		(1 << EVSCHED_LN_BITS)
+#define LN_MASK		(LN_SIZE - 1)
+
+/*! \brief Bit shift of the slot index in the given level (> 0). */
+#define LEVEL_SHIFT(level)	(EVSCHED_L0_BITS + ((level) - 1) * EVSCHED_LN_BITS)
+
+/*! \brief Slot index of the given level (> 0) and index within the level. */
+#define LEVEL_SLOT(level, idx)	(L0_SIZE + ((level) - 1) * LN_SIZE + (idx))
+
+/*! \brief Clock of the wheel, the wall clock only if waiting on another isn't possible. */
+#if defined(_POSIX_CLOCK_SELECTION) && _POSIX_CLOCK_SELECTION >= 0
+#define EVSCHED_CLOCK	CLOCK_MONOTONIC
+#else
+#define EVSCHED_CLOCK	CLOCK_REALTIME
+#endif
+
+/*!
+ * \brief Get current time in milliseconds.
+ */
+static uint64_t time_ms(void)
+{
+	struct timespec ts = { 0 };
+	clock_gettime(EVSCHED_CLOCK, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-static int compare_event_heap_nodes(void *e1, void *e2)
+/*!
+ * \brief Insert the event into the slot corresponding to its expiration.
+ */
+static void wheel_insert(evsched_t *sched, event_t *ev)
 {
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, <)) return -1;
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, >)) return 1;
-	return 0;
+	uint64_t delta = (ev->expire > sched->now) ? ev->expire - sched->now : 0;
+
+	if (delta < L0_SIZE) {
+		/* Also overdue events fire at the next tick. */
+		uint64_t tick = (delta > 0) ? ev->expire : sched->now;
+		ev->slot = tick & L0_MASK;
+		sched->count_l0++;
+	} else {
+		unsigned level = 1;
+		while (level < EVSCHED_LEVELS - 1 &&
+		       delta >= ((uint64_t)1 << LEVEL_SHIFT(level + 1))) {
+			level++;
+		}
+		/* Out of range events (stale wheel time) are cascaded again later. */
+		uint64_t expire = ev->expire;
+		uint64_t max_delta = ((uint64_t)1 << LEVEL_SHIFT(level + 1)) - 1;
+		if (delta > max_delta) {
+			expire = sched->now + max_delta;
+		}
+		ev->slot = LEVEL_SLOT(level, (expire >> LEVEL_SHIFT(level)) & LN_MASK);
+	}
+
+	add_tail(&sched->slots[ev->slot], &ev->n);
+	sched->count++;
+}
+
+static bool wheel_linked(event_t *ev)
+{
+	return ev->n.prev != NULL;
+}
+
+static void wheel_remove(evsched_t *sched, event_t *ev)
+{
+	if (ev->slot < L0_SIZE) {
+		sched->count_l0--;
+	}
+
+	rem_node(&ev->n);
+	sched->count--;
 }
 
 /*!
- * \brief Get time T (now) + dt milliseconds.
+ * \brief Move events of higher level slots, which start now, to lower levels.
  */
-static struct timeval timeval_in(uint32_t dt)
+static void wheel_cascade(evsched_t *sched)
 {
-	struct timeval tv = { 0 };
-	gettimeofday(&tv, NULL);
+	for (unsigned level = 1; level < EVSCHED_LEVELS; level++) {
+		unsigned idx = (sched->now >> LEVEL_SHIFT(level)) & LN_MASK;
+		list_t *slot = &sched->slots[LEVEL_SLOT(level, idx)];
+		while (!EMPTY_LIST(*slot)) {
+			event_t *ev = HEAD(*slot);
+			rem_node(&ev->n);
+			sched->count--;
+			wheel_insert(sched, ev);
+		}
+		if (idx != 0) {
+			break;
+		}
+	}
+}
 
-	/* Add number of seconds. */
-	tv.tv_sec += dt / 1000;
+/*!
+ * \brief Fire all events due till the given time.
+ *
+ * \note Callbacks are run with the scheduler locked.
+ */
+static void wheel_run(evsched_t *sched, uint64_t till)
+{
+	while (sched->now <= till) {
+		if (sched->count == 0) {
+			sched->now = till + 1;
+			break;
+		}
 
-	/* Add the number of microseconds. */
-	tv.tv_usec += (dt % 1000) * 1000;
+		if ((sched->now & L0_MASK) == 0) {
+			wheel_cascade(sched);
+		}
 
-	/* Check for overflow. */
-	while (tv.tv_usec > 999999) {
-		tv.tv_sec += 1;
-		tv.tv_usec -= 1 * 1000 * 1000;
+		list_t *slot = &sched->slots[sched->now & L0_MASK];
+		while (!EMPTY_LIST(*slot)) {
+			event_t *ev = HEAD(*slot);
+			rem_node(&ev->n);
+			sched->count--;
+			sched->count_l0--;
+			ev->cb(ev);
+		}
+
+		sched->now++;
+
+		/* Skip to the next cascade if nothing can fire meanwhile. */
+		if (sched->count_l0 == 0) {
+			uint64_t next = (sched->now + L0_MASK) & ~(uint64_t)L0_MASK;
+			sched->now = MIN(next, till + 1);
+		}
+	}
+}
+
+/*!
+ * \brief Get time of the earliest non-empty slot.
+ *
+ * The result can be earlier than the real expiration of the events
+ * in a higher level slot, which are cascaded at that time.
+ *
+ * \return Time in ms or UINT64_MAX if no event is scheduled.
+ */
+static uint64_t wheel_next(evsched_t *sched)
+{
+	if (sched->count == 0) {
+		return UINT64_MAX;
+	}
+
+	uint64_t next = UINT64_MAX;
+	for (uint64_t tick = sched->now; sched->count_l0 > 0; tick++) {
+		if (!EMPTY_LIST(sched->slots[tick & L0_MASK])) {
+			next = tick;
+			break;
+		}
+	}
+
+	/* A higher level slot can start before the first level event. */
+	for (unsigned level = 1; level < EVSCHED_LEVELS; level++) {
+		unsigned shift = LEVEL_SHIFT(level);
+		/* The current slot is still to be cascaded if exactly at its start. */
+		uint64_t first = (sched->now & (((uint64_t)1 << shift) - 1)) == 0 ? 0 : 1;
+		for (uint64_t i = first; i <= LN_SIZE; i++) {
+			uint64_t start = ((sched->now >> shift) + i) << shift;
+			if (start >= next) {
+				break;
+			}
+			if (!EMPTY_LIST(sched->slots[LEVEL_SLOT(level, (start >> shift) & LN_MASK)])) {
+				next = start;
+				break;
+			}
+		}
 	}
 
-	return tv;
+	return next;
 }
 
 /*! \brief Event scheduler loop. */
@@ -68,33 +208,31 @@ static int evsched_run(dthread_t *thread)
 	}
 
 	/* Run event loop. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	while (!dt_is_cancelled(thread)) {
-		if (!!EMPTY_HEAP(&sched->heap) || sched->paused) {
-			pthread_cond_wait(&sched->notify, &sched->heap_lock);
+		if (sched->paused) {
+			pthread_cond_wait(&sched->notify, &sched->lock);
 			continue;
 		}
 
-		/* Get current time. */
-		struct timeval dt;
-		gettimeofday(&dt, 0);
-
-		/* Get next event. */
-		event_t *ev = *((event_t**)HHEAD(&sched->heap));
-		assert(ev != NULL);
+		/* Fire all due events at once. */
+		wheel_run(sched, time_ms());
 
-		if (timercmp_ge(&dt, &ev->tv)) {
-			heap_delmin(&sched->heap);
-			ev->cb(ev);
+		/* Wait for next event or interrupt. Unlock calendar. */
+		uint64_t next = wheel_next(sched);
+		sched->wakeup = next;
+		if (next == UINT64_MAX) {
+			pthread_cond_wait(&sched->notify, &sched->lock);
 		} else {
-			/* Wait for next event or interrupt. Unlock calendar. */
-			struct timespec ts;
-			ts.tv_sec = ev->tv.tv_sec;
-			ts.tv_nsec = ev->tv.tv_usec * 1000L;
-			pthread_cond_timedwait(&sched->notify, &sched->heap_lock, &ts);
+			struct timespec ts = {
+				.tv_sec = next / 1000,
+				.tv_nsec = (next % 1000) * 1000000L
+			};
+			pthread_cond_timedwait(&sched->notify, &sched->lock, &ts);
 		}
+		sched->wakeup = 0;
 	}
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -105,9 +243,18 @@ int evsched_init(evsched_t *sched, void *ctx)
 	sched->ctx = ctx;
 
 	/* Initialize event calendar. */
-	pthread_mutex_init(&sched->heap_lock, 0);
-	pthread_cond_init(&sched->notify, 0);
-	heap_init(&sched->heap, compare_event_heap_nodes, 0);
+	pthread_mutex_init(&sched->lock, 0);
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+#if defined(_POSIX_CLOCK_SELECTION) && _POSIX_CLOCK_SELECTION >= 0
+	pthread_condattr_setclock(&attr, EVSCHED_CLOCK);
+#endif
+	pthread_cond_init(&sched->notify, &attr);
+	pthread_condattr_destroy(&attr);
+	for (unsigned i = 0; i < EVSCHED_SLOTS; i++) {
+		init_list(&sched->slots[i]);
+	}
+	sched->now = time_ms();
 
 	sched->thread = dt_create(1, evsched_run, NULL, sched);
 
@@ -126,17 +273,18 @@ void evsched_deinit(evsched_t *sched)
 	}
 
 	/* Deinitialize event calendar. */
-	pthread_mutex_destroy(&sched->heap_lock);
+	pthread_mutex_destroy(&sched->lock);
 	pthread_cond_destroy(&sched->notify);
 
-	while (!EMPTY_HEAP(&sched->heap)) {
-		event_t *e = (event_t *)*HHEAD(&sched->heap);
-		heap_delmin(&sched->heap);
-		evsched_event_free(e);
+	for (unsigned i = 0; i < EVSCHED_SLOTS && sched->count > 0; i++) {
+		while (!EMPTY_LIST(sched->slots[i])) {
+			event_t *e = HEAD(sched->slots[i]);
+			rem_node(&e->n);
+			sched->count--;
+			evsched_event_free(e);
+		}
 	}
 
-	heap_deinit(&sched->heap);
-
 	if (sched->thread != NULL) {
 		dt_delete(&sched->thread);
 	}
@@ -163,7 +311,6 @@ event_t *evsched_event_create(evsched_t *sched, event_cb_t cb, void *data)
 	e->sched = sched;
 	e->cb = cb;
 	e->data = data;
-	e->hpos.pos = 0;
 
 	return e;
 }
@@ -183,27 +330,33 @@ int evsched_schedule(event_t *ev, uint32_t dt)
 		return KNOT_EINVAL;
 	}
 
-	struct timeval new_time = timeval_in(dt);
+	uint64_t new_time = time_ms() + dt;
 
 	evsched_t *sched = ev->sched;
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
-
-	ev->tv = new_time;
+	pthread_mutex_lock(&sched->lock);
 
 	/* Make sure it's not already enqueued. */
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		/* "Replacing" with itself -- just repositioning it. */
-		heap_replace(&sched->heap, found, (heap_val_t *)ev);
-	} else {
-		heap_insert(&sched->heap, (heap_val_t *)ev);
+	if (wheel_linked(ev)) {
+		wheel_remove(sched, ev);
+	}
+
+	/* The wheel time can be moved forward freely if empty. */
+	if (sched->count == 0 && sched->now < new_time - dt) {
+		sched->now = new_time - dt;
+	}
+
+	ev->expire = new_time;
+	wheel_insert(sched, ev);
+
+	/* Wake up the scheduler only if it sleeps longer. */
+	if (new_time < sched->wakeup) {
+		pthread_cond_signal(&sched->notify);
 	}
 
 	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -217,19 +370,17 @@ int evsched_cancel(event_t *ev)
 	evsched_t *sched = ev->sched;
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_delete(&sched->heap, found);
-		pthread_cond_signal(&sched->notify);
+	if (wheel_linked(ev)) {
+		wheel_remove(sched, ev);
 	}
 
 	/* Unlock calendar. */
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	/* Reset event timer. */
-	memset(&ev->tv, 0, sizeof(struct timeval));
+	ev->expire = 0;
 
 	return KNOT_EOK;
 }
@@ -241,10 +392,10 @@ void evsched_start(evsched_t *sched)
 
 void evsched_stop(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	dt_stop(sched->thread);
 	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
 
 void evsched_join(evsched_t *sched)
@@ -254,15 +405,15 @@ void evsched_join(evsched_t *sched)
 
 void evsched_pause(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	sched->paused = true;
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
 
 void evsched_resume(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	sched->paused = false;
 	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
@@ -16,6 +16,12 @@
 
 /*!
  * \brief Event scheduler.
+ *
+ * Events are kept in a hierarchical timing wheel with millisecond ticks.
+ * The first level has a slot per tick, each other level has slots covering
+ * the whole span of the previous level. Events in higher levels are moved
+ * (cascaded) to lower levels as the time passes and they fire from the
+ * first level. Scheduling and cancelling are O(1).
  */
 
 #pragma once
@@ -26,7 +32,13 @@
 #include <sys/time.h>
 
 #include "knot/server/dthreads.h"
-#include "contrib/ucw/heap.h"
+#include "contrib/ucw/lists.h"
+
+#define EVSCHED_L0_BITS		8	/*!< First level: 256 slots of 1 ms. */
+#define EVSCHED_LN_BITS		6	/*!< Other levels: 64 slots each. */
+#define EVSCHED_LEVELS		5	/*!< Levels covering the whole uint32_t range of ms. */
+#define EVSCHED_SLOTS		((1 << EVSCHED_L0_BITS) + \
+				 (EVSCHED_LEVELS - 1) * (1 << EVSCHED_LN_BITS))
 
 /* Forward decls. */
 struct evsched;
@@ -51,8 +63,9 @@ typedef void (*event_cb_t)(struct event *);
  * \brief Event structure.
  */
 typedef struct event {
-	struct heap_val hpos;
-	struct timeval tv; /*!< Event scheduled time. */
+	node_t n;          /*!< Timing wheel slot node. */
+	uint64_t expire;   /*!< Event scheduled time (ms since the Epoch), 0 if unscheduled. */
+	unsigned slot;     /*!< Timing wheel slot index. */
 	void *data;        /*!< Usable data ptr. */
 	event_cb_t cb;     /*!< Event callback. */
 	struct evsched *sched; /*!< Scheduler for this event. */
@@ -63,9 +76,13 @@ typedef struct event {
  */
 typedef struct evsched {
 	volatile bool paused;      /*!< Temporarily stop processing events. */
-	pthread_mutex_t heap_lock; /*!< Event heap locking. */
-	pthread_cond_t notify;     /*!< Event heap notification. */
-	struct heap heap;          /*!< Event heap. */
+	pthread_mutex_t lock;      /*!< Timing wheel locking. */
+	pthread_cond_t notify;     /*!< Timing wheel notification. */
+	uint64_t now;              /*!< Next tick to be processed (ms since the Epoch). */
+	uint64_t wakeup;           /*!< Time the scheduler thread sleeps till, 0 if awake. */
+	size_t count;              /*!< Number of scheduled events. */
+	size_t count_l0;           /*!< Number of events in the first level. */
+	list_t slots[EVSCHED_SLOTS]; /*!< Timing wheel slots of all levels. */
 	void *ctx;                 /*!< Scheduler context. */
 	dt_unit_t *thread;
 } evsched_t;
@@ -114,6 +131,9 @@ void evsched_event_free(event_t *ev);
  *       then it replaces this timer with the newer value.
  *       Running events are not canceled or waited for.
  *
+ * \note The scheduler thread is only woken up if the event is due before
+ *       its planned wakeup.
+ *
  * \param ev Prepared event.
  * \param dt Time difference in milliseconds from now (dt is relative).
  *
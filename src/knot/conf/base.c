@@ -23,6 +23,7 @@
 #include "knot/conf/tools.h"
 #include "knot/common/log.h"
 #include "knot/nameserver/query_module.h"
+#include "knot/updates/acl.h"
 #include "libknot/libknot.h"
 #include "libknot/yparser/ypformat.h"
 #include "libknot/yparser/yptrafo.h"
@@ -125,6 +126,8 @@ static void init_cache(
 	static bool   first_init = true;
 	static bool   running_tcp_reuseport;
 	static bool   running_socket_affinity;
+	static bool   running_udp_gso;
+	static bool   running_io_uring;
 	static bool   running_xdp_udp;
 	static bool   running_xdp_tcp;
 	static uint16_t running_xdp_quic;
@@ -140,6 +143,8 @@ static void init_cache(
 	if (first_init || reinit_cache) {
 		running_tcp_reuseport = conf_get_bool(conf, C_SRV, C_TCP_REUSEPORT);
 		running_socket_affinity = conf_get_bool(conf, C_SRV, C_SOCKET_AFFINITY);
+		running_udp_gso = conf_get_bool(conf, C_SRV, C_UDP_GSO);
+		running_io_uring = conf_get_bool(conf, C_SRV, C_IO_URING);
 		running_xdp_udp = conf_get_bool(conf, C_XDP, C_UDP);
 		running_xdp_tcp = conf_get_bool(conf, C_XDP, C_TCP);
 		running_xdp_quic = 0;
@@ -192,6 +197,10 @@ static void init_cache(
 
 	conf->cache.srv_socket_affinity = running_socket_affinity;
 
+	conf->cache.srv_udp_gso = running_udp_gso;
+
+	conf->cache.srv_io_uring = running_io_uring;
+
 	val = conf_get(conf, C_SRV, C_DBUS_EVENT);
 	while (val.code == KNOT_EOK) {
 		conf->cache.srv_dbus_event |= conf_opt(&val);
@@ -226,6 +235,9 @@ static void init_cache(
 	val = conf_get(conf, C_XDP, C_TCP_RESEND);
 	conf->cache.xdp_tcp_idle_resend = conf_int(&val);
 
+	val = conf_get(conf, C_XDP, C_TCP_SYN_COOKIES);
+	conf->cache.xdp_tcp_syn_cookies = conf_bool(&val);
+
 	conf->cache.xdp_udp = running_xdp_udp;
 
 	conf->cache.xdp_tcp = running_xdp_tcp;
@@ -485,6 +497,11 @@ conf_t *conf_update(
 			conf->query_modules = s_conf->query_modules;
 			conf->query_plan = s_conf->query_plan;
 		}
+
+		// Compile the ACLs, the fallback is the confdb walk if failed.
+		if (conf->acl_index == NULL) {
+			conf->acl_index = acl_index_new(conf);
+		}
 	}
 
 	conf_t **current_conf = &s_conf;
@@ -538,6 +555,8 @@ void conf_free(
 	free(conf->query_modules);
 	conf_mod_unload_shared(conf);
 
+	acl_index_free(conf->acl_index);
+
 	if (!conf->is_clone) {
 		if (conf->api != NULL) {
 			conf->api->deinit(conf->db);
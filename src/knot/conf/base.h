@@ -138,6 +138,8 @@ typedef struct {
 		bool srv_tcp_reuseport;
 		bool srv_tcp_fastopen;
 		bool srv_socket_affinity;
+		bool srv_udp_gso;
+		bool srv_io_uring;
 		unsigned srv_dbus_event;
 		size_t srv_udp_threads;
 		size_t srv_tcp_threads;
@@ -150,6 +152,7 @@ typedef struct {
 		uint32_t xdp_tcp_idle_close;
 		uint32_t xdp_tcp_idle_reset;
 		uint32_t xdp_tcp_idle_resend;
+		bool xdp_tcp_syn_cookies;
 		size_t srv_quic_max_clients;
 		size_t srv_quic_obuf_max_size;
 		uint32_t srv_quic_idle_close;
@@ -179,6 +182,8 @@ typedef struct {
 	struct query_plan *query_plan;
 	/*! Zone catalog database. */
 	struct catalog *catalog;
+	/*! Compiled ACL matcher (master configuration only). */
+	struct acl_index *acl_index;
 } conf_t;
 
 /*!
@@ -602,6 +602,51 @@ void conf_mix_iter_next(
 	}
 }
 
+int conf_ids_copy(
+	conf_val_t *val,
+	conf_ids_t *out)
+{
+	assert(val != NULL && val->item != NULL && out != NULL);
+
+	memset(out, 0, sizeof(*out));
+
+	size_t count = conf_val_count(val);
+	if (count == 0) {
+		return KNOT_EOK;
+	}
+
+	out->ids = calloc(count, sizeof(*out->ids));
+	if (out->ids == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	while (val->code == KNOT_EOK) {
+		out->ids[out->count] = strdup(conf_str(val));
+		if (out->ids[out->count] == NULL) {
+			conf_ids_deinit(out);
+			return KNOT_ENOMEM;
+		}
+		out->count++;
+		conf_val_next(val);
+	}
+
+	return KNOT_EOK;
+}
+
+void conf_ids_deinit(
+	conf_ids_t *ids)
+{
+	if (ids == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < ids->count; i++) {
+		free(ids->ids[i]);
+	}
+	free(ids->ids);
+	memset(ids, 0, sizeof(*ids));
+}
+
 int64_t conf_int(
 	conf_val_t *val)
 {
@@ -62,6 +62,14 @@ typedef struct {
 	bool nested;
 } conf_mix_iter_t;
 
+/*! Owned copy of a multivalued reference (e.g. zone ACL or remote list). */
+typedef struct {
+	/*! Referenced string identifiers. */
+	char **ids;
+	/*! Number of identifiers. */
+	size_t count;
+} conf_ids_t;
+
 /*! Configuration module getter output. */
 typedef struct {
 	/*! Module name. */
@@ -445,6 +453,28 @@ void conf_mix_iter_next(
 	conf_mix_iter_t *iter
 );
 
+/*!
+ * Copies string identifiers of a multivalued reference item.
+ *
+ * \param[in] val   Multivalued item value.
+ * \param[out] out  Output identifiers.
+ *
+ * \return Error code, KNOT_EOK if success.
+ */
+int conf_ids_copy(
+	conf_val_t *val,
+	conf_ids_t *out
+);
+
+/*!
+ * Frees the copied identifiers.
+ *
+ * \param[in] ids  Identifiers.
+ */
+void conf_ids_deinit(
+	conf_ids_t *ids
+);
+
 /*!
  * Gets the numeric value of the item.
  *
@@ -155,6 +155,12 @@ static const knot_lookup_t journal_content[] = {
 	{ 0, NULL }
 };
 
+static const knot_lookup_t journal_compression[] = {
+	{ JOURNAL_COMPRESSION_NONE, "none" },
+	{ JOURNAL_COMPRESSION_ZSTD, "zstd" },
+	{ 0, NULL }
+};
+
 static const knot_lookup_t zonefile_load[] = {
 	{ ZONEFILE_LOAD_NONE,  "none" },
 	{ ZONEFILE_LOAD_DIFF,  "difference" },
@@ -227,6 +233,8 @@ static const yp_item_t desc_server[] = {
 	{ C_RMT_POOL_TIMEOUT,     YP_TINT,  YP_VINT = { 1, INT32_MAX, 5, YP_STIME } },
 	{ C_RMT_RETRY_DELAY,      YP_TINT,  YP_VINT = { 0, INT32_MAX, 0 } },
 	{ C_SOCKET_AFFINITY,      YP_TBOOL, YP_VNONE },
+	{ C_UDP_GSO,              YP_TBOOL, YP_VNONE },
+	{ C_IO_URING,             YP_TBOOL, YP_VNONE },
 	{ C_UDP_MAX_PAYLOAD,      YP_TINT,  YP_VINT = { KNOT_EDNS_MIN_DNSSEC_PAYLOAD,
 	                                                KNOT_EDNS_MAX_UDP_PAYLOAD,
 	                                                1232, YP_SSIZE } },
@@ -246,6 +254,7 @@ static const yp_item_t desc_server[] = {
 	{ C_DBUS_INIT_DELAY,      YP_TINT,  YP_VINT = { 0, INT32_MAX, 1, YP_STIME } },
 	{ C_LISTEN,               YP_TADDR, YP_VADDR = { 53 }, YP_FMULTI, { check_listen } },
 	{ C_LISTEN_QUIC,          YP_TADDR, YP_VADDR = { 853 }, YP_FMULTI, { check_listen } },
+	{ C_LISTEN_TLS,           YP_TADDR, YP_VADDR = { 853 }, YP_FMULTI, { check_listen } },
 	{ C_COMMENT,              YP_TSTR,  YP_VNONE },
 	// Legacy items.
 	{ C_LISTEN_XDP,           YP_TADDR, YP_VADDR = { 0 },                        YP_FMULTI, { legacy_item } },
@@ -271,6 +280,7 @@ static const yp_item_t desc_xdp[] = {
 	{ C_TCP_IDLE_CLOSE,       YP_TINT,  YP_VINT = { 1, INT32_MAX, 10, YP_STIME } },
 	{ C_TCP_IDLE_RESET,       YP_TINT,  YP_VINT = { 1, INT32_MAX, 20, YP_STIME } },
 	{ C_TCP_RESEND,           YP_TINT,  YP_VINT = { 1, INT32_MAX, 5, YP_STIME } },
+	{ C_TCP_SYN_COOKIES,      YP_TBOOL, YP_VNONE },
 	{ C_ROUTE_CHECK,          YP_TBOOL, YP_VNONE },
 	{ C_COMMENT,              YP_TSTR,  YP_VNONE },
 	{ NULL }
@@ -305,6 +315,7 @@ static const yp_item_t desc_database[] = {
 	{ C_STORAGE,             YP_TSTR,  YP_VSTR = { STORAGE_DIR } },
 	{ C_JOURNAL_DB,          YP_TSTR,  YP_VSTR = { "journal" } },
 	{ C_JOURNAL_DB_MODE,     YP_TOPT,  YP_VOPT = { journal_modes, JOURNAL_MODE_ROBUST } },
+	{ C_JOURNAL_DB_GROUP_COMMIT, YP_TINT, YP_VINT = { 0, 1000, 10 } },
 	{ C_JOURNAL_DB_MAX_SIZE, YP_TINT,  YP_VINT = { MEGA(1), VIRT_MEM_LIMIT(TERA(100)),
 	                                               VIRT_MEM_LIMIT(GIGA(20)), YP_SSIZE } },
 	{ C_KASP_DB,             YP_TSTR,  YP_VSTR = { "keys" } },
@@ -453,11 +464,18 @@ static const yp_item_t desc_policy[] = {
 	{ C_SEM_CHECKS,          YP_TOPT,  YP_VOPT = { semantic_checks, SEMCHECKS_OFF }, FLAGS }, \
 	{ C_ZONEFILE_SYNC,       YP_TINT,  YP_VINT = { -1, INT32_MAX, 0, YP_STIME } }, \
 	{ C_ZONEFILE_LOAD,       YP_TOPT,  YP_VOPT = { zonefile_load, ZONEFILE_LOAD_WHOLE } }, \
+	{ C_ZONEFILE_SNAP,       YP_TBOOL, YP_VNONE }, \
 	{ C_JOURNAL_CONTENT,     YP_TOPT,  YP_VOPT = { journal_content, JOURNAL_CONTENT_CHANGES }, FLAGS }, \
 	{ C_JOURNAL_MAX_USAGE,   YP_TINT,  YP_VINT = { KILO(40), SSIZE_MAX, MEGA(100), YP_SSIZE } }, \
 	{ C_JOURNAL_MAX_DEPTH,   YP_TINT,  YP_VINT = { 2, SSIZE_MAX, 20 } }, \
+	{ C_JOURNAL_COMPRESSION, YP_TOPT,  YP_VOPT = { journal_compression, JOURNAL_COMPRESSION_NONE }, \
+	                                   YP_FNONE, { check_journal_compression } }, \
 	{ C_ZONE_MAX_SIZE,       YP_TINT,  YP_VINT = { 0, SSIZE_MAX, SSIZE_MAX, YP_SSIZE }, FLAGS }, \
+	{ C_IXFR_BUFFER_SIZE,    YP_TINT,  YP_VINT = { 0, SSIZE_MAX, MEGA(64), YP_SSIZE } }, \
+	{ C_IXFR_LOCK_TIMEOUT,   YP_TINT,  YP_VINT = { 1, INT32_MAX, 60, YP_STIME } }, \
+	{ C_AXFR_SNAP_MAX_SIZE,  YP_TINT,  YP_VINT = { 0, SSIZE_MAX, MEGA(64), YP_SSIZE } }, \
 	{ C_ADJUST_THR,          YP_TINT,  YP_VINT = { 1, UINT16_MAX, 1 } }, \
+	{ C_ANS_CACHE,           YP_TINT,  YP_VINT = { 0, INT32_MAX, 0 } }, \
 	{ C_DNSSEC_SIGNING,      YP_TBOOL, YP_VNONE, FLAGS }, \
 	{ C_DNSSEC_VALIDATION,   YP_TBOOL, YP_VNONE, FLAGS }, \
 	{ C_DNSSEC_POLICY,       YP_TREF,  YP_VREF = { C_POLICY }, FLAGS, { check_ref_dflt } }, \
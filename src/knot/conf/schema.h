@@ -24,11 +24,13 @@
 #define C_ADDR			"\x07""address"
 #define C_ADJUST_THR		"\x0E""adjust-threads"
 #define C_ALG			"\x09""algorithm"
+#define C_ANS_CACHE		"\x0C""answer-cache"
 #define C_ANS_ROTATION		"\x0F""answer-rotation"
 #define C_ANY			"\x03""any"
 #define C_APPEND		"\x06""append"
 #define C_ASYNC_START		"\x0B""async-start"
 #define C_AUTO_ACL		"\x0D""automatic-acl"
+#define C_AXFR_SNAP_MAX_SIZE	"\x16""axfr-snapshot-max-size"
 #define C_BACKEND		"\x07""backend"
 #define C_BG_WORKERS		"\x12""background-workers"
 #define C_BLOCK_NOTIFY_XFR	"\x1B""block-notify-after-transfer"
@@ -66,8 +68,13 @@
 #define C_ID			"\x02""id"
 #define C_IDENT			"\x08""identity"
 #define C_INCL			"\x07""include"
+#define C_IO_URING		"\x08""io-uring"
+#define C_IXFR_BUFFER_SIZE	"\x10""ixfr-buffer-size"
+#define C_IXFR_LOCK_TIMEOUT	"\x11""ixfr-lock-timeout"
+#define C_JOURNAL_COMPRESSION	"\x13""journal-compression"
 #define C_JOURNAL_CONTENT	"\x0F""journal-content"
 #define C_JOURNAL_DB		"\x0A""journal-db"
+#define C_JOURNAL_DB_GROUP_COMMIT	"\x17""journal-db-group-commit"
 #define C_JOURNAL_DB_MAX_SIZE	"\x13""journal-db-max-size"
 #define C_JOURNAL_DB_MODE	"\x0F""journal-db-mode"
 #define C_JOURNAL_MAX_DEPTH	"\x11""journal-max-depth"
@@ -85,6 +92,7 @@
 #define C_KSK_SIZE		"\x08""ksk-size"
 #define C_LISTEN		"\x06""listen"
 #define C_LISTEN_QUIC		"\x0B""listen-quic"
+#define C_LISTEN_TLS		"\x0A""listen-tls"
 #define C_LOG			"\x03""log"
 #define C_MANUAL		"\x06""manual"
 #define C_MASTER		"\x06""master"
@@ -150,6 +158,7 @@
 #define C_TCP_OUTBUF_MAX_SIZE	"\x13""tcp-outbuf-max-size"
 #define C_TCP_RESEND		"\x12""tcp-resend-timeout"
 #define C_TCP_REUSEPORT		"\x0D""tcp-reuseport"
+#define C_TCP_SYN_COOKIES	"\x0F""tcp-syn-cookies"
 #define C_TCP_RMT_IO_TIMEOUT	"\x15""tcp-remote-io-timeout"
 #define C_TCP_WORKERS		"\x0B""tcp-workers"
 #define C_TIMEOUT		"\x07""timeout"
@@ -158,6 +167,7 @@
 #define C_TIMER_DB_MAX_SIZE	"\x11""timer-db-max-size"
 #define C_TPL			"\x08""template"
 #define C_UDP			"\x03""udp"
+#define C_UDP_GSO		"\x07""udp-gso"
 #define C_UDP_MAX_PAYLOAD	"\x0F""udp-max-payload"
 #define C_UDP_MAX_PAYLOAD_IPV4	"\x14""udp-max-payload-ipv4"
 #define C_UDP_MAX_PAYLOAD_IPV6	"\x14""udp-max-payload-ipv6"
@@ -173,6 +183,7 @@
 #define C_XDP			"\x03""xdp"
 #define C_ZONE			"\x04""zone"
 #define C_ZONEFILE_LOAD		"\x0D""zonefile-load"
+#define C_ZONEFILE_SNAP		"\x11""zonefile-snapshot"
 #define C_ZONEFILE_SYNC		"\x0D""zonefile-sync"
 #define C_ZONEMD_GENERATE	"\x0F""zonemd-generate"
 #define C_ZONEMD_VERIFY		"\x0D""zonemd-verify"
@@ -250,6 +261,11 @@ enum {
 	JOURNAL_CONTENT_ALL     = 2,
 };
 
+enum {
+	JOURNAL_COMPRESSION_NONE = 0,
+	JOURNAL_COMPRESSION_ZSTD = 1,
+};
+
 enum {
 	JOURNAL_MODE_ROBUST = 0, // Robust journal DB disk synchronization.
 	JOURNAL_MODE_ASYNC  = 1, // Asynchronous journal DB disk synchronization.
@@ -336,6 +336,19 @@ int check_cert_pin(
 	return KNOT_EOK;
 }
 
+int check_journal_compression(
+	knotd_conf_check_args_t *args)
+{
+#ifndef HAVE_ZSTD
+	if (yp_opt(args->data) == JOURNAL_COMPRESSION_ZSTD) {
+		args->err_str = "zstd compression is not available";
+		return KNOT_ENOTSUP;
+	}
+#endif
+
+	return KNOT_EOK;
+}
+
 static int dir_exists(const char *dir)
 {
 	struct stat st;
@@ -592,6 +605,37 @@ int check_server(
 #endif // ENABLE_QUIC
 	}
 
+	conf_val_t listls_val = conf_get_txn(args->extra->conf, args->extra->txn,
+	                                     C_SRV, C_LISTEN_TLS);
+	size_t listls_count = conf_val_count(&listls_val);
+	if (listls_count > 0) {
+#ifdef ENABLE_QUIC
+		conf_val_t listen_val = conf_get_txn(args->extra->conf, args->extra->txn,
+		                                     C_SRV, C_LISTEN);
+		size_t listen_count = conf_val_count(&listen_val);
+
+		for (size_t i = 0; listen_count > 0 && i < listls_count; i++) {
+			struct sockaddr_storage listls_addr = conf_addr(&listls_val, NULL);
+
+			for (size_t j = 0; j < listen_count; j++) {
+				struct sockaddr_storage listen_addr = conf_addr(&listen_val, NULL);
+				if (listen_hit(&listls_addr, &listen_addr)) {
+					args->err_str = "TLS listen address/port overlaps "
+					                "with TCP listen address/port";
+					return KNOT_EINVAL;
+				}
+				conf_val_next(&listen_val);
+			}
+
+			conf_val(&listen_val);
+			conf_val_next(&listls_val);
+		}
+#else
+		args->err_str = "TLS processing not available";
+		return KNOT_EINVAL;
+#endif // ENABLE_QUIC
+	}
+
 	return KNOT_EOK;
 }
 
@@ -82,6 +82,10 @@ int check_cert_pin(
 	knotd_conf_check_args_t *args
 );
 
+int check_journal_compression(
+	knotd_conf_check_args_t *args
+);
+
 int check_database(
 	knotd_conf_check_args_t *args
 );
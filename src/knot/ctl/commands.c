@@ -14,7 +14,9 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/time.h>
 #include <urcu.h>
@@ -61,14 +63,29 @@ typedef struct {
 	char rdata[2 * 65536];
 } send_ctx_t;
 
-static struct {
+struct ctl_buffers {
 	send_ctx_t send_ctx;
 	zs_scanner_t scanner;
 	char txt_rr[sizeof(((send_ctx_t *)0)->owner) +
 	            sizeof(((send_ctx_t *)0)->ttl) +
 	            sizeof(((send_ctx_t *)0)->type) +
 	            sizeof(((send_ctx_t *)0)->rdata)];
-} ctl_globals;
+};
+
+/*! Returns the session buffers, allocated on first use. */
+static struct ctl_buffers *get_buffers(ctl_args_t *args)
+{
+	if (args->buffers == NULL) {
+		args->buffers = malloc(sizeof(*args->buffers));
+	}
+
+	return args->buffers;
+}
+
+static bool cancelled(ctl_args_t *args)
+{
+	return args->cancel != NULL && atomic_load(args->cancel);
+}
 
 /*!
  * Evaluates a filter pair and checks for conflicting filters.
@@ -161,6 +178,19 @@ static int get_zone(ctl_args_t *args, zone_t **zone)
 	return KNOT_EOK;
 }
 
+static int zone_apply(zone_t *zone, ctl_args_t *args, int (*fcn)(zone_t *, ctl_args_t *))
+{
+	if (args->lock != CTL_LOCK_ZONE) {
+		return fcn(zone, args);
+	}
+
+	pthread_mutex_lock(&zone->control_lock);
+	int ret = fcn(zone, args);
+	pthread_mutex_unlock(&zone->control_lock);
+
+	return ret;
+}
+
 static int zones_apply(ctl_args_t *args, int (*fcn)(zone_t *, ctl_args_t *))
 {
 	int ret;
@@ -169,9 +199,9 @@ static int zones_apply(ctl_args_t *args, int (*fcn)(zone_t *, ctl_args_t *))
 	if (args->data[KNOT_CTL_IDX_ZONE] == NULL) {
 		bool failed = false;
 		knot_zonedb_iter_t *it = knot_zonedb_iter_begin(args->server->zone_db);
-		while (!knot_zonedb_iter_finished(it)) {
+		while (!knot_zonedb_iter_finished(it) && !cancelled(args)) {
 			args->suppress = false;
-			ret = fcn((zone_t *)knot_zonedb_iter_val(it), args);
+			ret = zone_apply((zone_t *)knot_zonedb_iter_val(it), args, fcn);
 			if (ret != KNOT_EOK && !args->suppress) {
 				failed = true;
 			}
@@ -192,7 +222,7 @@ static int zones_apply(ctl_args_t *args, int (*fcn)(zone_t *, ctl_args_t *))
 		zone_t *zone;
 		ret = get_zone(args, &zone);
 		if (ret == KNOT_EOK) {
-			ret = fcn(zone, args);
+			ret = zone_apply(zone, args, fcn);
 		}
 		if (ret != KNOT_EOK) {
 			log_ctl_zone_str_error(args->data[KNOT_CTL_IDX_ZONE],
@@ -200,6 +230,10 @@ static int zones_apply(ctl_args_t *args, int (*fcn)(zone_t *, ctl_args_t *))
 			send_error(args, knot_strerror(ret));
 		}
 
+		if (cancelled(args)) {
+			return KNOT_ECONNABORTED;
+		}
+
 		// Get next zone name.
 		ret = knot_ctl_receive(args->ctl, &args->type, &args->data);
 		if (ret != KNOT_EOK || args->type != KNOT_CTL_TYPE_DATA) {
@@ -910,6 +944,10 @@ static int send_rrset(knot_rrset_t *rrset, send_ctx_t *ctx)
 static int send_node(zone_node_t *node, void *ctx_void)
 {
 	send_ctx_t *ctx = ctx_void;
+	if (cancelled(ctx->args)) {
+		return KNOT_ECONNABORTED;
+	}
+
 	if (knot_dname_to_str(ctx->owner, node->owner, sizeof(ctx->owner)) == NULL) {
 		return KNOT_EINVAL;
 	}
@@ -975,7 +1013,12 @@ static int get_owner(uint8_t *out, size_t out_len, knot_dname_t *origin,
 
 static int zone_read(zone_t *zone, ctl_args_t *args)
 {
-	send_ctx_t *ctx = &ctl_globals.send_ctx;
+	struct ctl_buffers *buffers = get_buffers(args);
+	if (buffers == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	send_ctx_t *ctx = &buffers->send_ctx;
 	int ret = init_send_ctx(ctx, zone->name, args);
 	if (ret != KNOT_EOK) {
 		return ret;
@@ -1012,7 +1055,12 @@ static int zone_flag_txn_get(zone_t *zone, ctl_args_t *args, const char *flag)
 		return KNOT_TXN_ENOTEXISTS;
 	}
 
-	send_ctx_t *ctx = &ctl_globals.send_ctx;
+	struct ctl_buffers *buffers = get_buffers(args);
+	if (buffers == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	send_ctx_t *ctx = &buffers->send_ctx;
 	int ret = init_send_ctx(ctx, zone->name, args);
 	if (ret != KNOT_EOK) {
 		return ret;
@@ -1126,7 +1174,12 @@ static int zone_txn_diff(zone_t *zone, ctl_args_t *args)
 		return zone_flag_txn_get(zone, args, CTL_FLAG_DIFF_ADD);
 	}
 
-	send_ctx_t *ctx = &ctl_globals.send_ctx;
+	struct ctl_buffers *buffers = get_buffers(args);
+	if (buffers == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	send_ctx_t *ctx = &buffers->send_ctx;
 	int ret = init_send_ctx(ctx, zone->name, args);
 	if (ret != KNOT_EOK) {
 		return ret;
@@ -1177,9 +1230,14 @@ static int create_rrset(knot_rrset_t **rrset, zone_t *zone, ctl_args_t *args,
 	const char *data  = args->data[KNOT_CTL_IDX_DATA];
 	const char *ttl   = need_ttl ? args->data[KNOT_CTL_IDX_TTL] : NULL;
 
+	struct ctl_buffers *buffers = get_buffers(args);
+	if (buffers == NULL) {
+		return KNOT_ENOMEM;
+	}
+
 	// Prepare a buffer for a reconstructed record.
-	const size_t buff_len = sizeof(ctl_globals.txt_rr);
-	char *buff = ctl_globals.txt_rr;
+	const size_t buff_len = sizeof(buffers->txt_rr);
+	char *buff = buffers->txt_rr;
 
 	uint32_t default_ttl = 0;
 	if (ttl == NULL) {
@@ -1201,7 +1259,7 @@ static int create_rrset(knot_rrset_t **rrset, zone_t *zone, ctl_args_t *args,
 	size_t rdata_len = ret;
 
 	// Parse the record.
-	zs_scanner_t *scanner = &ctl_globals.scanner;
+	zs_scanner_t *scanner = &buffers->scanner;
 	if (zs_init(scanner, origin, KNOT_CLASS_IN, default_ttl) != 0 ||
 	    zs_set_input_string(scanner, buff, rdata_len) != 0 ||
 	    zs_parse_record(scanner) != 0 ||
@@ -1806,7 +1864,7 @@ static int server_status(ctl_args_t *args)
 		ret = snprintf(buff, sizeof(buff), "Version: %s", PACKAGE_VERSION);
 	} else if (strcasecmp(type, "workers") == 0) {
 		int running_bkg_wrk, wrk_queue;
-		worker_pool_status(args->server->workers, false, &running_bkg_wrk, &wrk_queue);
+		worker_pool_status(args->server->workers, &running_bkg_wrk, &wrk_queue);
 		ret = snprintf(buff, sizeof(buff), "UDP workers: %zu, TCP workers: %zu, "
 		               "XDP workers: %zu, background workers: %zu (running: %d, pending: %d)",
 		               conf()->cache.srv_udp_threads, conf()->cache.srv_tcp_threads,
@@ -2237,53 +2295,54 @@ static int ctl_conf_modify(ctl_args_t *args, ctl_cmd_t cmd)
 typedef struct {
 	const char *name;
 	int (*fcn)(ctl_args_t *, ctl_cmd_t);
+	ctl_lock_t lock;
 } desc_t;
 
 static const desc_t cmd_table[] = {
 	[CTL_NONE]            = { "" },
 
-	[CTL_STATUS]          = { "status",          ctl_server },
-	[CTL_STOP]            = { "stop",            ctl_server },
-	[CTL_RELOAD]          = { "reload",          ctl_server },
-	[CTL_STATS]           = { "stats",           ctl_stats },
-
-	[CTL_ZONE_STATUS]     = { "zone-status",        ctl_zone },
-	[CTL_ZONE_RELOAD]     = { "zone-reload",        ctl_zone },
-	[CTL_ZONE_REFRESH]    = { "zone-refresh",       ctl_zone },
-	[CTL_ZONE_RETRANSFER] = { "zone-retransfer",    ctl_zone },
-	[CTL_ZONE_NOTIFY]     = { "zone-notify",        ctl_zone },
-	[CTL_ZONE_FLUSH]      = { "zone-flush",         ctl_zone },
-	[CTL_ZONE_BACKUP]     = { "zone-backup",        ctl_zone },
-	[CTL_ZONE_RESTORE]    = { "zone-restore",       ctl_zone },
-	[CTL_ZONE_SIGN]       = { "zone-sign",          ctl_zone },
-	[CTL_ZONE_KEYS_LOAD]  = { "zone-keys-load",     ctl_zone },
-	[CTL_ZONE_KEY_ROLL]   = { "zone-key-rollover",  ctl_zone },
-	[CTL_ZONE_KSK_SBM]    = { "zone-ksk-submitted", ctl_zone },
-	[CTL_ZONE_FREEZE]     = { "zone-freeze",        ctl_zone },
-	[CTL_ZONE_THAW]       = { "zone-thaw",          ctl_zone },
-	[CTL_ZONE_XFR_FREEZE] = { "zone-xfr-freeze",    ctl_zone },
-	[CTL_ZONE_XFR_THAW]   = { "zone-xfr-thaw",      ctl_zone },
-
-	[CTL_ZONE_READ]       = { "zone-read",       ctl_zone },
-	[CTL_ZONE_BEGIN]      = { "zone-begin",      ctl_zone },
-	[CTL_ZONE_COMMIT]     = { "zone-commit",     ctl_zone },
-	[CTL_ZONE_ABORT]      = { "zone-abort",      ctl_zone },
-	[CTL_ZONE_DIFF]       = { "zone-diff",       ctl_zone },
-	[CTL_ZONE_GET]        = { "zone-get",        ctl_zone },
-	[CTL_ZONE_SET]        = { "zone-set",        ctl_zone },
-	[CTL_ZONE_UNSET]      = { "zone-unset",      ctl_zone },
-	[CTL_ZONE_PURGE]      = { "zone-purge",      ctl_zone },
-	[CTL_ZONE_STATS]      = { "zone-stats",	     ctl_zone },
-
-	[CTL_CONF_LIST]       = { "conf-list",       ctl_conf_list },
-	[CTL_CONF_READ]       = { "conf-read",       ctl_conf_read },
-	[CTL_CONF_BEGIN]      = { "conf-begin",      ctl_conf_txn },
-	[CTL_CONF_COMMIT]     = { "conf-commit",     ctl_conf_txn },
-	[CTL_CONF_ABORT]      = { "conf-abort",      ctl_conf_txn },
-	[CTL_CONF_DIFF]       = { "conf-diff",       ctl_conf_read },
-	[CTL_CONF_GET]        = { "conf-get",        ctl_conf_read },
-	[CTL_CONF_SET]        = { "conf-set",        ctl_conf_modify },
-	[CTL_CONF_UNSET]      = { "conf-unset",      ctl_conf_modify },
+	[CTL_STATUS]          = { "status",             ctl_server,      CTL_LOCK_SHARED },
+	[CTL_STOP]            = { "stop",               ctl_server,      CTL_LOCK_EXCLUSIVE },
+	[CTL_RELOAD]          = { "reload",             ctl_server,      CTL_LOCK_EXCLUSIVE },
+	[CTL_STATS]           = { "stats",              ctl_stats,       CTL_LOCK_SHARED },
+
+	[CTL_ZONE_STATUS]     = { "zone-status",        ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_RELOAD]     = { "zone-reload",        ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_REFRESH]    = { "zone-refresh",       ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_RETRANSFER] = { "zone-retransfer",    ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_NOTIFY]     = { "zone-notify",        ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_FLUSH]      = { "zone-flush",         ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_BACKUP]     = { "zone-backup",        ctl_zone,        CTL_LOCK_EXCLUSIVE },
+	[CTL_ZONE_RESTORE]    = { "zone-restore",       ctl_zone,        CTL_LOCK_EXCLUSIVE },
+	[CTL_ZONE_SIGN]       = { "zone-sign",          ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_KEYS_LOAD]  = { "zone-keys-load",     ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_KEY_ROLL]   = { "zone-key-rollover",  ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_KSK_SBM]    = { "zone-ksk-submitted", ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_FREEZE]     = { "zone-freeze",        ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_THAW]       = { "zone-thaw",          ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_XFR_FREEZE] = { "zone-xfr-freeze",    ctl_zone,        CTL_LOCK_SHARED },
+	[CTL_ZONE_XFR_THAW]   = { "zone-xfr-thaw",      ctl_zone,        CTL_LOCK_SHARED },
+
+	[CTL_ZONE_READ]       = { "zone-read",          ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_BEGIN]      = { "zone-begin",         ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_COMMIT]     = { "zone-commit",        ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_ABORT]      = { "zone-abort",         ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_DIFF]       = { "zone-diff",          ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_GET]        = { "zone-get",           ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_SET]        = { "zone-set",           ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_UNSET]      = { "zone-unset",         ctl_zone,        CTL_LOCK_ZONE },
+	[CTL_ZONE_PURGE]      = { "zone-purge",         ctl_zone,        CTL_LOCK_EXCLUSIVE },
+	[CTL_ZONE_STATS]      = { "zone-stats",         ctl_zone,        CTL_LOCK_SHARED },
+
+	[CTL_CONF_LIST]       = { "conf-list",          ctl_conf_list,   CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_READ]       = { "conf-read",          ctl_conf_read,   CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_BEGIN]      = { "conf-begin",         ctl_conf_txn,    CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_COMMIT]     = { "conf-commit",        ctl_conf_txn,    CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_ABORT]      = { "conf-abort",         ctl_conf_txn,    CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_DIFF]       = { "conf-diff",          ctl_conf_read,   CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_GET]        = { "conf-get",           ctl_conf_read,   CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_SET]        = { "conf-set",           ctl_conf_modify, CTL_LOCK_EXCLUSIVE },
+	[CTL_CONF_UNSET]      = { "conf-unset",         ctl_conf_modify, CTL_LOCK_EXCLUSIVE },
 };
 
 #define MAX_CTL_CODE (sizeof(cmd_table) / sizeof(desc_t) - 1)
@@ -2312,12 +2371,91 @@ ctl_cmd_t ctl_str_to_cmd(const char *cmd_str)
 	return CTL_NONE;
 }
 
+ctl_lock_t ctl_cmd_lock(ctl_cmd_t cmd)
+{
+	if (cmd <= CTL_NONE || cmd > MAX_CTL_CODE) {
+		return CTL_LOCK_EXCLUSIVE;
+	}
+
+	return cmd_table[cmd].lock;
+}
+
+static bool ctl_locked(server_t *server, ctl_lock_t lock)
+{
+	if (lock == CTL_LOCK_EXCLUSIVE) {
+		return server->ctl_lock.exclusive || server->ctl_lock.shared > 0;
+	} else {
+		return server->ctl_lock.exclusive || server->ctl_lock.waiting > 0;
+	}
+}
+
+int ctl_lock(server_t *server, ctl_lock_t lock, unsigned timeout_ms)
+{
+	if (server == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&server->ctl_lock.mutex);
+	if (lock == CTL_LOCK_EXCLUSIVE) {
+		server->ctl_lock.waiting++;
+	}
+	while (ctl_locked(server, lock)) {
+		if (pthread_cond_timedwait(&server->ctl_lock.cond, &server->ctl_lock.mutex,
+		                           &deadline) == ETIMEDOUT) {
+			break;
+		}
+	}
+	int ret = ctl_locked(server, lock) ? KNOT_ETIMEOUT : KNOT_EOK;
+	if (lock == CTL_LOCK_EXCLUSIVE) {
+		server->ctl_lock.waiting--;
+		if (ret == KNOT_EOK) {
+			server->ctl_lock.exclusive = true;
+		} else {
+			// Let in the shared holders blocked by this attempt.
+			pthread_cond_broadcast(&server->ctl_lock.cond);
+		}
+	} else if (ret == KNOT_EOK) {
+		server->ctl_lock.shared++;
+	}
+	pthread_mutex_unlock(&server->ctl_lock.mutex);
+
+	return ret;
+}
+
+void ctl_unlock(server_t *server)
+{
+	if (server == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&server->ctl_lock.mutex);
+	if (server->ctl_lock.exclusive) {
+		server->ctl_lock.exclusive = false;
+	} else {
+		assert(server->ctl_lock.shared > 0);
+		server->ctl_lock.shared--;
+	}
+	pthread_cond_broadcast(&server->ctl_lock.cond);
+	pthread_mutex_unlock(&server->ctl_lock.mutex);
+}
+
 int ctl_exec(ctl_cmd_t cmd, ctl_args_t *args)
 {
 	if (args == NULL) {
 		return KNOT_EINVAL;
 	}
 
+	args->lock = cmd_table[cmd].lock;
+
 	return cmd_table[cmd].fcn(args, cmd);
 }
 
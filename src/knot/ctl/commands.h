@@ -112,6 +112,15 @@ typedef enum {
 	CTL_CONF_UNSET,
 } ctl_cmd_t;
 
+/*! Concurrency of control commands processed in parallel sessions. */
+typedef enum {
+	CTL_LOCK_SHARED,    /*!< Runs in parallel with other non-exclusive commands. */
+	CTL_LOCK_ZONE,      /*!< Like shared, but serialized per zone. */
+	CTL_LOCK_EXCLUSIVE, /*!< Runs alone, e.g. a server reload. */
+} ctl_lock_t;
+
+struct ctl_buffers;
+
 /*! Control command parameters. */
 typedef struct {
 	knot_ctl_t *ctl;
@@ -119,6 +128,9 @@ typedef struct {
 	knot_ctl_data_t data;
 	server_t *server;
 	bool suppress;	// Suppress error reporting in the "all zones" ctl commands.
+	ctl_lock_t lock;	// Concurrency of the command being executed.
+	atomic_bool *cancel;	// Session cancellation request (optional).
+	struct ctl_buffers *buffers;	// Lazily allocated, to be freed by the caller.
 } ctl_args_t;
 
 /*!
@@ -139,9 +151,43 @@ const char *ctl_cmd_to_str(ctl_cmd_t cmd);
  */
 ctl_cmd_t ctl_str_to_cmd(const char *cmd_str);
 
+/*!
+ * Returns the concurrency of the command.
+ *
+ * \param[in] cmd  Command.
+ *
+ * \return Command concurrency.
+ */
+ctl_lock_t ctl_cmd_lock(ctl_cmd_t cmd);
+
+/*!
+ * Locks the server control lock according to the command concurrency.
+ *
+ * Exclusive locking takes precedence, new shared holders wait while
+ * an exclusive one is waiting.
+ *
+ * \param[in] server      Server instance.
+ * \param[in] lock        Concurrency of the command to be executed.
+ * \param[in] timeout_ms  Maximum time to wait for the lock.
+ *
+ * \retval KNOT_ETIMEOUT  if not locked in time.
+ * \return Error code, KNOT_EOK if successful.
+ */
+int ctl_lock(server_t *server, ctl_lock_t lock, unsigned timeout_ms);
+
+/*!
+ * Unlocks the server control lock locked by ctl_lock().
+ *
+ * \param[in] server  Server instance.
+ */
+void ctl_unlock(server_t *server);
+
 /*!
  * Executes a control command.
  *
+ * \note The caller must hold the server control lock according to the
+ *       command concurrency (see ctl_lock()).
+ *
  * \param[in] cmd   Control command.
  * \param[in] args  Command arguments.
  *
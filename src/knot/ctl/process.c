@@ -14,30 +14,124 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
 #include "knot/common/log.h"
 #include "knot/ctl/commands.h"
 #include "knot/ctl/process.h"
+#include "knot/worker/pool.h"
 #include "libknot/error.h"
 #include "contrib/string.h"
 
-int ctl_process(knot_ctl_t *ctl, server_t *server)
+/*! Exclusive command handed over to the pool creator thread. */
+typedef struct {
+	ctl_cmd_t cmd;
+	ctl_args_t *args;
+	int ret;
+	bool taken;
+	bool done;
+} handover_t;
+
+struct ctl_pool {
+	worker_pool_t *workers;
+	server_t *server;
+	pthread_t owner;        // thread executing exclusive commands
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	handover_t *handover;   // pending exclusive command, guarded by lock
+	unsigned sessions;      // queued or running sessions, guarded by lock
+
+	atomic_bool cancel;     // stop processing of all sessions
+};
+
+typedef struct {
+	worker_task_t task;
+	ctl_pool_t *pool;
+	knot_ctl_t *ctl;
+} session_t;
+
+static int handover_wait(ctl_pool_t *pool, handover_t *h)
 {
-	if (ctl == NULL || server == NULL) {
-		return KNOT_EINVAL;
+	pthread_mutex_lock(&pool->lock);
+	while (pool->handover != NULL && !atomic_load(&pool->cancel)) {
+		pthread_cond_wait(&pool->cond, &pool->lock);
 	}
+	if (atomic_load(&pool->cancel)) {
+		pthread_mutex_unlock(&pool->lock);
+		return KNOT_ECONNABORTED;
+	}
+	pool->handover = h;
 
-	ctl_args_t args = {
-		.ctl = ctl,
-		.type = KNOT_CTL_TYPE_END,
-		.server = server
-	};
+	// The wake-up signal may come before the owner starts waiting, so repeat it.
+	while (!h->done) {
+		if (!h->taken) {
+			if (atomic_load(&pool->cancel)) {
+				h->ret = KNOT_ECONNABORTED;
+				break;
+			}
+			pthread_kill(pool->owner, SIGALRM);
+		}
+
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += CTL_LOCK_WAIT_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&pool->cond, &pool->lock, &deadline);
+	}
+
+	pool->handover = NULL;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return h->ret;
+}
+
+static int exec(ctl_pool_t *pool, ctl_cmd_t cmd, ctl_args_t *args)
+{
+	ctl_lock_t lock = ctl_cmd_lock(cmd);
+	if (lock == CTL_LOCK_EXCLUSIVE && !pthread_equal(pthread_self(), pool->owner)) {
+		handover_t h = {
+			.cmd = cmd,
+			.args = args
+		};
 
+		return handover_wait(pool, &h);
+	}
+
+	// Wait in intervals so that a stop request isn't blocked by an exclusive command.
+	int ret;
+	while ((ret = ctl_lock(pool->server, lock, CTL_LOCK_WAIT_MS)) == KNOT_ETIMEOUT) {
+		if (atomic_load(&pool->cancel)) {
+			return KNOT_ECONNABORTED;
+		}
+	}
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = ctl_exec(cmd, args);
+
+	ctl_unlock(pool->server);
+
+	return ret;
+}
+
+static int process(ctl_pool_t *pool, ctl_args_t *args)
+{
 	// Strip redundant/unprocessed data units in the current block.
 	bool strip = false;
 
-	while (true) {
+	while (!atomic_load(&pool->cancel)) {
 		// Receive data unit.
-		int ret = knot_ctl_receive(args.ctl, &args.type, &args.data);
+		int ret = knot_ctl_receive(args->ctl, &args->type, &args->data);
 		if (ret != KNOT_EOK) {
 			log_ctl_debug("control, failed to receive (%s)",
 			              knot_strerror(ret));
@@ -45,7 +139,7 @@ int ctl_process(knot_ctl_t *ctl, server_t *server)
 		}
 
 		// Decide what to do.
-		switch (args.type) {
+		switch (args->type) {
 		case KNOT_CTL_TYPE_DATA:
 			// Leading data unit with a command name.
 			if (!strip) {
@@ -67,10 +161,10 @@ int ctl_process(knot_ctl_t *ctl, server_t *server)
 			assert(0);
 		}
 
-		strtolower((char *)args.data[KNOT_CTL_IDX_ZONE]);
+		strtolower((char *)args->data[KNOT_CTL_IDX_ZONE]);
 
-		const char *cmd_name = args.data[KNOT_CTL_IDX_CMD];
-		const char *zone_name = args.data[KNOT_CTL_IDX_ZONE];
+		const char *cmd_name = args->data[KNOT_CTL_IDX_CMD];
+		const char *zone_name = args->data[KNOT_CTL_IDX_ZONE];
 
 		ctl_cmd_t cmd = ctl_str_to_cmd(cmd_name);
 		if (cmd == CTL_CONF_LIST) {
@@ -91,7 +185,11 @@ int ctl_process(knot_ctl_t *ctl, server_t *server)
 		}
 
 		// Execute the command.
-		int cmd_ret = ctl_exec(cmd, &args);
+		int cmd_ret = exec(pool, cmd, args);
+		if (cmd_ret == KNOT_ECONNABORTED) {
+			// Not executed, the session is closed without a reply.
+			return cmd_ret;
+		}
 		switch (cmd_ret) {
 		case KNOT_EOK:
 			strip = false;
@@ -107,7 +205,7 @@ int ctl_process(knot_ctl_t *ctl, server_t *server)
 		}
 
 		// Finalize the answer block.
-		ret = knot_ctl_send(ctl, KNOT_CTL_TYPE_BLOCK, NULL);
+		ret = knot_ctl_send(args->ctl, KNOT_CTL_TYPE_BLOCK, NULL);
 		if (ret != KNOT_EOK) {
 			log_ctl_debug("control, failed to reply (%s)",
 			              knot_strerror(ret));
@@ -116,7 +214,7 @@ int ctl_process(knot_ctl_t *ctl, server_t *server)
 		// Stop if required.
 		if (cmd_ret == KNOT_CTL_ESTOP) {
 			// Finalize the answer message.
-			ret = knot_ctl_send(ctl, KNOT_CTL_TYPE_END, NULL);
+			ret = knot_ctl_send(args->ctl, KNOT_CTL_TYPE_END, NULL);
 			if (ret != KNOT_EOK) {
 				log_ctl_debug("control, failed to reply (%s)",
 				              knot_strerror(ret));
@@ -125,4 +223,171 @@ int ctl_process(knot_ctl_t *ctl, server_t *server)
 			return cmd_ret;
 		}
 	}
+	return KNOT_ECONNABORTED;
+}
+
+static void session_run(worker_task_t *task)
+{
+	session_t *session = task->ctx;
+	ctl_pool_t *pool = session->pool;
+
+	ctl_args_t args = {
+		.ctl = session->ctl,
+		.type = KNOT_CTL_TYPE_END,
+		.server = pool->server,
+		.cancel = &pool->cancel
+	};
+
+	(void)process(pool, &args);
+
+	free(args.buffers);
+	knot_ctl_free(session->ctl);
+	free(session);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->sessions--;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+ctl_pool_t *ctl_pool_create(server_t *server, unsigned threads)
+{
+	if (server == NULL) {
+		return NULL;
+	}
+
+	ctl_pool_t *pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->workers = worker_pool_create(threads);
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pool->server = server;
+	pool->owner = pthread_self();
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+	atomic_init(&pool->cancel, false);
+
+	worker_pool_start(pool->workers);
+
+	return pool;
+}
+
+static void reject(knot_ctl_t *ctl, int code)
+{
+	// The request isn't read, the client gets the error as the reply to its first command.
+	knot_ctl_data_t data = {
+		[KNOT_CTL_IDX_ERROR] = knot_strerror(code)
+	};
+	int ret = knot_ctl_send(ctl, KNOT_CTL_TYPE_DATA, &data);
+	if (ret == KNOT_EOK) {
+		ret = knot_ctl_send(ctl, KNOT_CTL_TYPE_BLOCK, NULL);
+	}
+	if (ret != KNOT_EOK) {
+		log_ctl_debug("control, failed to reply (%s)", knot_strerror(ret));
+	}
+
+	knot_ctl_close(ctl);
+}
+
+int ctl_pool_assign(ctl_pool_t *pool, knot_ctl_t *ctl)
+{
+	if (pool == NULL || ctl == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->sessions >= CTL_MAX_SESSIONS) {
+		pthread_mutex_unlock(&pool->lock);
+		reject(ctl, KNOT_EBUSY);
+		return KNOT_EBUSY;
+	}
+	pool->sessions++;
+	pthread_mutex_unlock(&pool->lock);
+
+	session_t *session = malloc(sizeof(*session));
+	knot_ctl_t *conn = knot_ctl_detach(ctl);
+	if (session == NULL || conn == NULL) {
+		free(session);
+		knot_ctl_free(conn);
+		reject(ctl, KNOT_ENOMEM);
+		pthread_mutex_lock(&pool->lock);
+		pool->sessions--;
+		pthread_mutex_unlock(&pool->lock);
+		return KNOT_ENOMEM;
+	}
+
+	session->task.ctx = session;
+	session->task.run = session_run;
+	session->task.flags = 0;
+	session->pool = pool;
+	session->ctl = conn;
+
+	worker_pool_assign(pool->workers, &session->task);
+
+	return KNOT_EOK;
+}
+
+int ctl_pool_exec(ctl_pool_t *pool)
+{
+	if (pool == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	handover_t *h = pool->handover;
+	if (h == NULL || h->taken) {
+		pthread_mutex_unlock(&pool->lock);
+		return KNOT_EOK;
+	}
+	h->taken = true;
+	pthread_mutex_unlock(&pool->lock);
+
+	// Don't block the caller behind long running shared commands, retry later.
+	int ret = ctl_lock(pool->server, CTL_LOCK_EXCLUSIVE, CTL_LOCK_WAIT_MS);
+	if (ret != KNOT_EOK) {
+		pthread_mutex_lock(&pool->lock);
+		h->taken = false;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+		return KNOT_EAGAIN;
+	}
+
+	ret = ctl_exec(h->cmd, h->args);
+
+	ctl_unlock(pool->server);
+
+	pthread_mutex_lock(&pool->lock);
+	h->ret = ret;
+	h->done = true;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return ret;
+}
+
+void ctl_pool_destroy(ctl_pool_t *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	// Queued sessions are closed unprocessed, running ones stop at the next check.
+	pthread_mutex_lock(&pool->lock);
+	atomic_store(&pool->cancel, true);
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	worker_pool_wait(pool->workers);
+	worker_pool_stop(pool->workers);
+	worker_pool_join(pool->workers);
+	worker_pool_destroy(pool->workers);
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
 }
@@ -19,12 +19,68 @@
 #include "libknot/libknot.h"
 #include "knot/server/server.h"
 
+/*! Number of threads processing control sessions. */
+#define CTL_THREADS		4
+
+/*! Maximum number of queued or running control sessions. */
+#define CTL_MAX_SESSIONS	64
+
+/*! Interval of stop checks while waiting for the control lock or a handover. */
+#define CTL_LOCK_WAIT_MS	500
+
+/*!
+ * Control sessions processed in parallel.
+ *
+ * Each accepted connection is processed by a pool thread. Commands run
+ * in parallel according to their concurrency (see ctl_lock_t), exclusive
+ * commands are handed over to the thread which created the pool, so that
+ * e.g. a configuration transaction is always processed by the same thread.
+ */
+typedef struct ctl_pool ctl_pool_t;
+
 /*!
- * Processes incoming control commands.
+ * Creates and starts the control pool.
+ *
+ * \note The calling thread must have SIGALRM unblocked and call
+ *       ctl_pool_exec() upon its delivery.
+ *
+ * \param[in] server   Server instance.
+ * \param[in] threads  Number of pool threads.
  *
- * \param[in] ctl     Control context.
- * \param[in] server  Server instance.
+ * \return Control pool or NULL if error.
+ */
+ctl_pool_t *ctl_pool_create(server_t *server, unsigned threads);
+
+/*!
+ * Takes over the accepted connection and queues it for processing.
  *
+ * \param[in] pool  Control pool.
+ * \param[in] ctl   Control context with an accepted connection.
+ *
+ * \retval KNOT_EBUSY  if too many sessions are pending, the connection is closed
+ *                     after an error reply.
  * \return Error code, KNOT_EOK if successful.
  */
-int ctl_process(knot_ctl_t *ctl, server_t *server);
+int ctl_pool_assign(ctl_pool_t *pool, knot_ctl_t *ctl);
+
+/*!
+ * Executes an exclusive command handed over by a pool thread, if any.
+ *
+ * If the control lock isn't available within CTL_LOCK_WAIT_MS, the command
+ * is left for a later call, so that the caller isn't blocked by long
+ * running shared commands.
+ *
+ * \param[in] pool  Control pool.
+ *
+ * \retval KNOT_CTL_ESTOP  if the server stop was requested.
+ * \retval KNOT_EAGAIN     if the command was postponed.
+ * \return Error code, KNOT_EOK if successful or no command is pending.
+ */
+int ctl_pool_exec(ctl_pool_t *pool);
+
+/*!
+ * Cancels pending sessions, waits for the running ones, and frees the pool.
+ *
+ * \param[in] pool  Control pool.
+ */
+void ctl_pool_destroy(ctl_pool_t *pool);
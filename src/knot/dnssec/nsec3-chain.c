@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 
 #include "libknot/dname.h"
 #include "knot/dnssec/nsec-chain.h"
@@ -24,8 +25,15 @@
 #include "knot/zone/adjust.h"
 #include "knot/zone/zone-diff.h"
 #include "contrib/base32hex.h"
+#include "contrib/macros.h"
 #include "contrib/wire_ctx.h"
 
+/*! \brief Minimal number of names hashed by one thread. */
+#define NSEC3_HASH_BATCH_MIN	64
+
+/*! \brief Maximal number of names hashed at once when creating the chain. */
+#define NSEC3_HASH_WINDOW	65536
+
 static bool nsec3_empty(const zone_node_t *node, const dnssec_nsec3_params_t *params)
 {
 	bool opt_out = (params->flags & KNOT_NSEC3_FLAG_OPT_OUT);
@@ -224,29 +232,25 @@ static zone_node_t *create_nsec3_node(const knot_dname_t *owner,
 /*!
  * \brief Create new NSEC3 node for given regular node.
  *
- * \param node       Node for which the NSEC3 node is created.
- * \param apex       Zone apex node.
- * \param params     NSEC3 hash function parameters.
- * \param ttl        TTL of the new NSEC3 node.
+ * \param node         Node for which the NSEC3 node is created.
+ * \param nsec3_owner  Hashed owner of the node.
+ * \param apex         Zone apex node.
+ * \param params       NSEC3 hash function parameters.
+ * \param ttl          TTL of the new NSEC3 node.
  *
  * \return Error code, KNOT_EOK if successful.
  */
 static zone_node_t *create_nsec3_node_for_node(const zone_node_t *node,
+                                               const knot_dname_t *nsec3_owner,
                                                zone_node_t *apex,
                                                const dnssec_nsec3_params_t *params,
                                                uint32_t ttl)
 {
 	assert(node);
+	assert(nsec3_owner);
 	assert(apex);
 	assert(params);
 
-	knot_dname_storage_t nsec3_owner;
-	int ret = knot_create_nsec3_owner(nsec3_owner, sizeof(nsec3_owner),
-	                                  node->owner, apex->owner, params);
-	if (ret != KNOT_EOK) {
-		return NULL;
-	}
-
 	dnssec_nsec_bitmap_t *rr_types = dnssec_nsec_bitmap_new();
 	if (!rr_types) {
 		return NULL;
@@ -267,6 +271,105 @@ static zone_node_t *create_nsec3_node_for_node(const zone_node_t *node,
 	return nsec3_node;
 }
 
+/* - NSEC3 owners hashing --------------------------------------------------- */
+
+typedef struct {
+	const zone_node_t **nodes;
+	uint8_t *hashed;
+	size_t hashed_size;
+	const knot_dname_t *apex;
+	const dnssec_nsec3_params_t *params;
+	size_t begin;
+	size_t end;
+	int errcode;
+	int thread_init_errcode;
+	pthread_t thread;
+} nsec3_hash_args_t;
+
+static void *nsec3_hash_thread(void *_arg)
+{
+	nsec3_hash_args_t *arg = _arg;
+	for (size_t i = arg->begin; i < arg->end && arg->errcode == KNOT_EOK; i++) {
+		arg->errcode = knot_create_nsec3_owner(arg->hashed + i * arg->hashed_size,
+		                                       arg->hashed_size, arg->nodes[i]->owner,
+		                                       arg->apex, arg->params);
+	}
+	return NULL;
+}
+
+/*! \brief Size of one hashed owner in the array filled by nsec3_hash_nodes(). */
+static size_t nsec3_hashed_size(const knot_dname_t *apex,
+                                const dnssec_nsec3_params_t *params)
+{
+	return 1 + ((dnssec_nsec3_hash_length(params->algorithm) + 4) / 5) * 8 +
+	       knot_dname_size(apex);
+}
+
+/*!
+ * \brief Compute NSEC3 owners of given nodes in parallel batches.
+ *
+ * The iterated hashing is the most expensive part of the NSEC3 chain
+ * maintenance, so each thread hashes a continuous batch of the nodes.
+ *
+ * \param nodes        Nodes whose owners are hashed.
+ * \param count        Number of the nodes.
+ * \param apex         Zone apex name.
+ * \param params       NSEC3 params.
+ * \param threads      Maximal number of threads to be used.
+ * \param hashed       Out: array of hashed owners, for count items of the size
+ *                     given by nsec3_hashed_size().
+ *
+ * \return KNOT_E*
+ */
+static int nsec3_hash_nodes(const zone_node_t **nodes, size_t count,
+                            const knot_dname_t *apex,
+                            const dnssec_nsec3_params_t *params,
+                            size_t threads, uint8_t *hashed)
+{
+	threads = MIN(threads, count / NSEC3_HASH_BATCH_MIN);
+	threads = MAX(threads, 1);
+	nsec3_hash_args_t args[threads];
+	memset(args, 0, sizeof(args));
+
+	for (size_t i = 0; i < threads; i++) {
+		args[i].nodes = nodes;
+		args[i].hashed = hashed;
+		args[i].hashed_size = nsec3_hashed_size(apex, params);
+		args[i].apex = apex;
+		args[i].params = params;
+		args[i].begin = count * i / threads;
+		args[i].end = count * (i + 1) / threads;
+		args[i].errcode = KNOT_EOK;
+		args[i].thread_init_errcode = -1;
+	}
+
+	if (threads == 1) {
+		args[0].thread_init_errcode = 0;
+		nsec3_hash_thread(&args[0]);
+	} else {
+		for (size_t i = 0; i < threads; i++) {
+			args[i].thread_init_errcode =
+				pthread_create(&args[i].thread, NULL, nsec3_hash_thread, &args[i]);
+		}
+		for (size_t i = 0; i < threads; i++) {
+			if (args[i].thread_init_errcode == 0) {
+				args[i].thread_init_errcode = pthread_join(args[i].thread, NULL);
+			}
+		}
+	}
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < threads && ret == KNOT_EOK; i++) {
+		if (args[i].thread_init_errcode != 0) {
+			ret = knot_map_errno_code(args[i].thread_init_errcode);
+		} else {
+			ret = args[i].errcode;
+		}
+	}
+
+	return ret;
+}
+
 /* - NSEC3 chain creation --------------------------------------------------- */
 
 // see connect_nsec3_nodes() for what this function does
@@ -398,13 +501,53 @@ static int reconnect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
 	return ret;
 }
 
+/*!
+ * \brief Create NSEC3 nodes for a window of regular nodes.
+ *
+ * \param nodes        Regular nodes.
+ * \param count        Number of the nodes.
+ * \param hashed       Buffer for the hashed owners of the nodes.
+ * \param zone         Zone.
+ * \param params       NSEC3 params.
+ * \param ttl          TTL for the created NSEC records.
+ * \param threads      Number of threads for hashing the owners.
+ * \param nsec3_nodes  Tree whereto new NSEC3 nodes will be added.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+static int create_nsec3_window(const zone_node_t **nodes, size_t count, uint8_t *hashed,
+                               const zone_contents_t *zone,
+                               const dnssec_nsec3_params_t *params,
+                               uint32_t ttl, size_t threads, zone_tree_t *nsec3_nodes)
+{
+	size_t hashed_size = nsec3_hashed_size(zone->apex->owner, params);
+	int result = nsec3_hash_nodes(nodes, count, zone->apex->owner, params,
+	                              threads, hashed);
+
+	for (size_t i = 0; i < count && result == KNOT_EOK; i++) {
+		zone_node_t *nsec3_node;
+		nsec3_node = create_nsec3_node_for_node(nodes[i], hashed + i * hashed_size,
+		                                        zone->apex, params, ttl);
+		if (!nsec3_node) {
+			return KNOT_ENOMEM;
+		}
+
+		result = zone_tree_insert(nsec3_nodes, &nsec3_node);
+	}
+
+	return result;
+}
+
 /*!
  * \brief Create NSEC3 node for each regular node in the zone.
  *
+ * The owners are hashed in windows of NSEC3_HASH_WINDOW nodes, so that
+ * the memory needed doesn't grow with the zone size.
+ *
  * \param zone         Zone.
  * \param params       NSEC3 params.
  * \param ttl          TTL for the created NSEC records.
- * \param cds_in_apex  Hint to guess apex node type bitmap: false=just DNSKEY, true=DNSKEY,CDS,CDNSKEY.
+ * \param threads      Number of threads for hashing the owners.
  * \param nsec3_nodes  Tree whereto new NSEC3 nodes will be added.
  * \param update       Zone update for possible NSEC removals
  *
@@ -413,6 +556,7 @@ static int reconnect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
 static int create_nsec3_nodes(const zone_contents_t *zone,
                               const dnssec_nsec3_params_t *params,
                               uint32_t ttl,
+                              size_t threads,
                               zone_tree_t *nsec3_nodes,
                               zone_update_t *update)
 {
@@ -420,6 +564,17 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 	assert(nsec3_nodes);
 	assert(update);
 
+	size_t window = MIN(zone_tree_count(zone->nodes), NSEC3_HASH_WINDOW);
+	window = MAX(window, 1);
+	const zone_node_t **nodes = malloc(window * sizeof(*nodes));
+	uint8_t *hashed = malloc(window * nsec3_hashed_size(zone->apex->owner, params));
+	if (nodes == NULL || hashed == NULL) {
+		free(nodes);
+		free(hashed);
+		return KNOT_ENOMEM;
+	}
+	size_t count = 0;
+
 	zone_tree_delsafe_it_t it = { 0 };
 	int result = zone_tree_delsafe_it_begin(zone->nodes, &it, false); // delsafe - removing nodes that contain only NSEC+RRSIG
 
@@ -434,22 +589,17 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 		if (result != KNOT_EOK) {
 			break;
 		}
-		if (node->flags & NODE_FLAGS_NONAUTH || nsec3_empty(node, params) || node->flags & NODE_FLAGS_DELETED) {
-			zone_tree_delsafe_it_next(&it);
-			continue;
-		}
-
-		zone_node_t *nsec3_node;
-		nsec3_node = create_nsec3_node_for_node(node, zone->apex,
-							params, ttl);
-		if (!nsec3_node) {
-			result = KNOT_ENOMEM;
-			break;
+		if (!(node->flags & NODE_FLAGS_NONAUTH) && !nsec3_empty(node, params) &&
+		    !(node->flags & NODE_FLAGS_DELETED)) {
+			nodes[count++] = node;
 		}
-
-		result = zone_tree_insert(nsec3_nodes, &nsec3_node);
-		if (result != KNOT_EOK) {
-			break;
+		if (count == window) {
+			result = create_nsec3_window(nodes, count, hashed, zone, params,
+			                             ttl, threads, nsec3_nodes);
+			if (result != KNOT_EOK) {
+				break;
+			}
+			count = 0;
 		}
 
 		zone_tree_delsafe_it_next(&it);
@@ -457,40 +607,55 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 
 	zone_tree_delsafe_it_free(&it);
 
+	if (result == KNOT_EOK) {
+		result = create_nsec3_window(nodes, count, hashed, zone, params,
+		                             ttl, threads, nsec3_nodes);
+	}
+
+	free(hashed);
+	free(nodes);
+
 	return result;
 }
 
 /*!
- * \brief For given dname, check if anything changed in zone_update, and recreate (possibly unconnected) NSEC3 nodes appropriately.
+ * \brief For given dname, check if anything changed in zone_update so that its NSEC3 needs to be recreated.
+ */
+static bool nsec3_fix_needed(zone_update_t *update, const dnssec_nsec3_params_t *params,
+                             const knot_dname_t *for_node)
+{
+	const zone_node_t *old_n = zone_contents_find_node(update->zone->contents, for_node);
+	const zone_node_t *new_n = zone_contents_find_node(update->new_cont, for_node);
+
+	bool had_no_nsec = (old_n == NULL || old_n->nsec3_node == NULL || !(old_n->flags & NODE_FLAGS_NSEC3_NODE));
+	bool shall_no_nsec = (new_n == NULL || new_n->flags & NODE_FLAGS_NONAUTH || nsec3_empty(new_n, params) || new_n->flags & NODE_FLAGS_DELETED);
+
+	return had_no_nsec != shall_no_nsec || !node_bitmap_equal(old_n, new_n);
+}
+
+/*!
+ * \brief For given dname, recreate (possibly unconnected) NSEC3 nodes appropriately to changes in zone_update.
  *
- * \param update    Zone update structure holding zone contents changes.
- * \param params    NSEC3 params.
- * \param ttl       TTL for newly created NSEC3 records.
- * \param for_node  Domain name of the node in question.
+ * \param update           Zone update structure holding zone contents changes.
+ * \param params           NSEC3 params.
+ * \param ttl              TTL for newly created NSEC3 records.
+ * \param for_node         Domain name of the node in question.
+ * \param for_node_hashed  NSEC3 owner corresponding to the node in question.
  *
  * \retval KNOT_ENORECORD if the NSEC3 chain shall be rather recreated completely.
  * \return KNOT_EOK, KNOT_E* if any error.
  */
 static int fix_nsec3_for_node(zone_update_t *update, const dnssec_nsec3_params_t *params,
-                              uint32_t ttl, const knot_dname_t *for_node)
+                              uint32_t ttl, const knot_dname_t *for_node,
+                              const knot_dname_t *for_node_hashed)
 {
-	// check if we need to do something
 	const zone_node_t *old_n = zone_contents_find_node(update->zone->contents, for_node);
 	const zone_node_t *new_n = zone_contents_find_node(update->new_cont, for_node);
 
 	bool had_no_nsec = (old_n == NULL || old_n->nsec3_node == NULL || !(old_n->flags & NODE_FLAGS_NSEC3_NODE));
 	bool shall_no_nsec = (new_n == NULL || new_n->flags & NODE_FLAGS_NONAUTH || nsec3_empty(new_n, params) || new_n->flags & NODE_FLAGS_DELETED);
 
-	if (had_no_nsec == shall_no_nsec && node_bitmap_equal(old_n, new_n)) {
-		return KNOT_EOK;
-	}
-
-	knot_dname_storage_t for_node_hashed;
-	int ret = knot_create_nsec3_owner(for_node_hashed, sizeof(for_node_hashed),
-	                                  for_node, update->new_cont->apex->owner, params);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
+	int ret = KNOT_EOK;
 
 	// saved hash of next node
 	uint8_t *next_hash = NULL;
@@ -515,7 +680,8 @@ static int fix_nsec3_for_node(zone_update_t *update, const dnssec_nsec3_params_t
 
 	// add NSEC3 with correct bitmap
 	if (!shall_no_nsec && ret == KNOT_EOK) {
-		zone_node_t *new_nsec3_n = create_nsec3_node_for_node(new_n, update->new_cont->apex, params, ttl);
+		zone_node_t *new_nsec3_n = create_nsec3_node_for_node(new_n, for_node_hashed,
+		                                                      update->new_cont->apex, params, ttl);
 		if (new_nsec3_n == NULL) {
 			return KNOT_ENOMEM;
 		}
@@ -545,20 +711,46 @@ static int fix_nsec3_for_node(zone_update_t *update, const dnssec_nsec3_params_t
 }
 
 static int fix_nsec3_nodes(zone_update_t *update, const dnssec_nsec3_params_t *params,
-                           uint32_t ttl)
+                           uint32_t ttl, size_t threads)
 {
 	assert(update);
 
+	const zone_node_t **nodes = malloc(MAX(zone_tree_count(update->a_ctx->node_ptrs), 1) * sizeof(*nodes));
+	if (nodes == NULL) {
+		return KNOT_ENOMEM;
+	}
+	size_t count = 0;
+
 	zone_tree_it_t it = { 0 };
 	int ret = zone_tree_it_begin(update->a_ctx->node_ptrs, &it);
 
 	while (!zone_tree_it_finished(&it) && ret == KNOT_EOK) {
 		zone_node_t *n = zone_tree_it_val(&it);
-		ret = fix_nsec3_for_node(update, params, ttl, n->owner);
+		if (nsec3_fix_needed(update, params, n->owner)) {
+			nodes[count++] = n;
+		}
 		zone_tree_it_next(&it);
 	}
 	zone_tree_it_free(&it);
 
+	const knot_dname_t *apex = update->new_cont->apex->owner;
+	size_t hashed_size = nsec3_hashed_size(apex, params);
+	uint8_t *hashed = malloc(MAX(count, 1) * hashed_size);
+	if (hashed == NULL) {
+		ret = KNOT_ENOMEM;
+	}
+	if (ret == KNOT_EOK) {
+		ret = nsec3_hash_nodes(nodes, count, apex, params, threads, hashed);
+	}
+
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		ret = fix_nsec3_for_node(update, params, ttl, nodes[i]->owner,
+		                         hashed + i * hashed_size);
+	}
+
+	free(hashed);
+	free(nodes);
+
 	return ret;
 }
 
@@ -625,6 +817,7 @@ int delete_nsec3_chain(zone_update_t *up)
 int knot_nsec3_create_chain(const zone_contents_t *zone,
                             const dnssec_nsec3_params_t *params,
                             uint32_t ttl,
+                            size_t threads,
                             zone_update_t *update)
 {
 	assert(zone);
@@ -635,7 +828,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 		return KNOT_ENOMEM;
 	}
 
-	int result = create_nsec3_nodes(zone, params, ttl, nsec3_nodes, update);
+	int result = create_nsec3_nodes(zone, params, ttl, threads, nsec3_nodes, update);
 	if (result != KNOT_EOK) {
 		free_nsec3_tree(nsec3_nodes);
 		return result;
@@ -657,7 +850,8 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 
 int knot_nsec3_fix_chain(zone_update_t *update,
                          const dnssec_nsec3_params_t *params,
-                         uint32_t ttl)
+                         uint32_t ttl,
+                         size_t threads)
 {
 	assert(update);
 	assert(params);
@@ -668,15 +862,18 @@ int knot_nsec3_fix_chain(zone_update_t *update,
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
-		return knot_nsec3_create_chain(update->new_cont, params, ttl, update);
+		return knot_nsec3_create_chain(update->new_cont, params, ttl, threads, update);
 	}
 
-	int ret = fix_nsec3_nodes(update, params, ttl);
+	int ret = fix_nsec3_nodes(update, params, ttl, threads);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
 
-	ret = zone_adjust_contents(update->new_cont, NULL, adjust_cb_void, false, true, 1, update->a_ctx->nsec3_ptrs);
+	// fix prev pointers only around the added and removed NSEC3 nodes
+	ret = zone_adjust_prevs_incremental(update->new_cont->nsec3_nodes,
+	                                    update->a_ctx->nsec3_ptrs,
+	                                    update->a_ctx->nsec3_ptrs);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -33,6 +33,7 @@ int delete_nsec3_chain(zone_update_t *up);
  * \param zone       Zone to be checked.
  * \param params     NSEC3 parameters.
  * \param ttl        TTL for new records.
+ * \param threads    Number of threads for hashing the owners.
  * \param update     Zone update to stare immediate changes into.
  *
  * \return KNOT_E*
@@ -40,6 +41,7 @@ int delete_nsec3_chain(zone_update_t *up);
 int knot_nsec3_create_chain(const zone_contents_t *zone,
                             const dnssec_nsec3_params_t *params,
                             uint32_t ttl,
+                            size_t threads,
                             zone_update_t *update);
 
 /*!
@@ -48,13 +50,15 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
  * \param update     Zone Update structure holding the zone and its update. Also modified!
  * \param params     NSEC3 parameters.
  * \param ttl        TTL for new records.
+ * \param threads    Number of threads for hashing the owners.
  *
  * \retval KNOT_ENORECORD if the chain must be recreated from scratch.
  * \return KNOT_E*
  */
 int knot_nsec3_fix_chain(zone_update_t *update,
                          const dnssec_nsec3_params_t *params,
-                         uint32_t ttl);
+                         uint32_t ttl,
+                         size_t threads);
 
 /*!
  * \brief Validate NSEC3 chain in new_cont as whole.
@@ -31,6 +31,14 @@
 #include "libknot/dynarray.h"
 #include "contrib/wire_ctx.h"
 
+#ifdef HAVE_ATOMIC
+#define ATOMIC_SET(dst, val) __atomic_store_n(&(dst), (val), __ATOMIC_RELAXED)
+#define ATOMIC_GET(src)      __atomic_load_n(&(src), __ATOMIC_RELAXED)
+#else
+#define ATOMIC_SET(dst, val) ((dst) = (val))
+#define ATOMIC_GET(src)      (src)
+#endif
+
 typedef struct {
 	node_t n;
 	uint16_t type;
@@ -509,7 +517,8 @@ typedef struct {
 	zone_sign_ctx_t *sign_ctx;
 	changeset_t changeset;
 	knot_time_t expires_at;
-	dnssec_validation_hint_t *hint;
+	dnssec_validation_hint_t hint;
+	bool *failed;
 	size_t num_threads;
 	size_t thread_index;
 	size_t rrset_index;
@@ -539,9 +548,14 @@ static int sign_node(zone_node_t *node, void *data)
 		return KNOT_EOK;
 	}
 
+	// Another thread already failed, the result would be dropped anyway.
+	if (ATOMIC_GET(*args->failed)) {
+		return KNOT_EOF;
+	}
+
 	int result = sign_node_rrsets(node, args->sign_ctx,
 	                              &args->changeset, &args->expires_at,
-	                              args->hint);
+	                              &args->hint);
 
 	return result;
 }
@@ -550,6 +564,11 @@ static void *tree_sign_thread(void *_arg)
 {
 	node_sign_args_t *arg = _arg;
 	arg->errcode = zone_tree_apply(arg->tree, sign_node, _arg);
+	if (arg->errcode == KNOT_EOF) {
+		arg->errcode = KNOT_EOK; // Stopped due to a failure of another thread.
+	} else if (arg->errcode != KNOT_EOK) {
+		ATOMIC_SET(*arg->failed, true);
+	}
 	return NULL;
 }
 
@@ -583,6 +602,7 @@ static int zone_tree_sign(zone_tree_t *tree,
 	assert(update || dnssec_ctx->validation_mode);
 
 	int ret = KNOT_EOK;
+	bool failed = false;
 	node_sign_args_t args[num_threads];
 	memset(args, 0, sizeof(args));
 	*expires_at = knot_time_plus(dnssec_ctx->now, dnssec_ctx->policy->rrsig_lifetime);
@@ -602,7 +622,7 @@ static int zone_tree_sign(zone_tree_t *tree,
 			break;
 		}
 		args[i].expires_at = 0;
-		args[i].hint = &update->validation_hint;
+		args[i].failed = &failed;
 		args[i].num_threads = num_threads;
 		args[i].thread_index = i;
 		args[i].rrset_index = 0;
@@ -642,6 +662,10 @@ static int zone_tree_sign(zone_tree_t *tree,
 				ret = knot_map_errno_code(args[i].thread_init_errcode);
 			} else {
 				ret = args[i].errcode;
+				if (ret != KNOT_EOK && update != NULL && args[i].hint.node != NULL) {
+					update->validation_hint.node = args[i].hint.node;
+					update->validation_hint.rrtype = args[i].hint.rrtype;
+				}
 				if (ret == KNOT_EOK && !dnssec_ctx->validation_mode) {
 					ret = zone_update_apply_changeset(update, &args[i].changeset); // _fix not needed
 					*expires_at = knot_time_min(*expires_at, args[i].expires_at);
@@ -86,6 +86,30 @@ bool ufreeze_applies(zone_event_type_t type)
 	}
 }
 
+/*!
+ * \brief Get worker pool scheduling flags of an event.
+ *
+ * User-triggered, awaited, and expiration events are prioritized. Signing
+ * and loading are CPU-heavy, the others are mostly waiting for I/O.
+ */
+static unsigned event_task_flags(zone_events_t *events, zone_event_type_t type)
+{
+	if (!valid_event(type)) {
+		return 0;
+	}
+
+	unsigned flags = 0;
+	if (events->forced[type] || events->blocking[type] != NULL ||
+	    type == ZONE_EVENT_EXPIRE) {
+		flags |= WORKER_TASK_PRIO;
+	}
+	if (type == ZONE_EVENT_LOAD || type == ZONE_EVENT_DNSSEC) {
+		flags |= WORKER_TASK_CPU;
+	}
+
+	return flags;
+}
+
 /*! \brief Return remaining time to planned event (seconds). */
 static time_t time_until(time_t planned)
 {
@@ -271,6 +295,7 @@ static void event_dispatch(event_t *event)
 	pthread_mutex_lock(&events->mx);
 	if (!events->running && !events->frozen) {
 		events->running = true;
+		events->task.flags = event_task_flags(events, get_next_event(events));
 		worker_pool_assign(events->pool, &events->task);
 	}
 	pthread_mutex_unlock(&events->mx);
@@ -438,6 +463,7 @@ void zone_events_enqueue(zone_t *zone, zone_event_type_t type)
 		events->running = true;
 		events->type = type;
 		event_set_time(events, type, ZONE_EVENT_IMMEDIATE);
+		events->task.flags = event_task_flags(events, type);
 		worker_pool_assign(events->pool, &events->task);
 		pthread_mutex_unlock(&events->mx);
 		return;
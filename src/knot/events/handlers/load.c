@@ -94,17 +94,7 @@ int event_load(conf_t *conf, zone_t *zone)
 		char *filename = conf_zonefile(conf, zone->name);
 		ret = zonefile_exists(filename, &mtime);
 		if (ret == KNOT_EOK) {
-			conf_val_t semchecks = conf_zone_get(conf, C_SEM_CHECKS, zone->name);
-			semcheck_optional_t mode = conf_opt(&semchecks);
-			if (mode == SEMCHECK_DNSSEC_AUTO) {
-				conf_val_t validation = conf_zone_get(conf, C_DNSSEC_VALIDATION, zone->name);
-				if (conf_bool(&validation)) {
-					/* Disable duplicate DNSSEC checks, which are the
-					   same as DNSSEC validation in zone update commit. */
-					mode = SEMCHECK_DNSSEC_OFF;
-				}
-			}
-
+			semcheck_optional_t mode = zone_load_semcheck_mode(conf, zone->name);
 			ret = zone_load_contents(conf, zone->name, &zf_conts, mode, false);
 		}
 		if (ret != KNOT_EOK) {
@@ -205,6 +195,8 @@ int event_load(conf_t *conf, zone_t *zone)
 	val = conf_zone_get(conf, C_ZONEMD_GENERATE, zone->name);
 	unsigned digest_alg = conf_opt(&val);
 	bool update_zonemd = (digest_alg != ZONE_DIGEST_NONE);
+	val = conf_zone_get(conf, C_ADJUST_THR, zone->name);
+	unsigned digest_threads = conf_int(&val);
 
 	// Create zone_update structure according to current state.
 	if (old_contents_exist) {
@@ -328,7 +320,9 @@ load_end:
 		/* Don't update ZONEMD if no change and ZONEMD is up-to-date.
 		 * If ZONEFILE_LOAD_DIFSE, the change is non-empty and ZONEMD
 		 * is directly updated without its verification. */
-		if (!zone_update_no_change(&up) || !zone_contents_digest_exists(up.new_cont, digest_alg, false)) {
+		if (!zone_update_no_change(&up) ||
+		    !zone_contents_digest_exists(up.new_cont, digest_alg, false,
+		                                 digest_threads, &zone->digest_cache)) {
 			if (zone_update_to(&up) == NULL || middle_serial == zone->zonefile.serial) {
 				ret = zone_update_increment_soa(&up, conf);
 			}
@@ -357,7 +351,9 @@ load_end:
 		}
 
 		// If the original ZONEMD is outdated, use the reverted changeset again.
-		if (update_zonemd && !zone_contents_digest_exists(up.new_cont, digest_alg, false)) {
+		if (update_zonemd &&
+		    !zone_contents_digest_exists(up.new_cont, digest_alg, false,
+		                                 digest_threads, &zone->digest_cache)) {
 			ret = zone_update_apply_changeset(&up, cpy);
 			changeset_free(cpy);
 			if (ret != KNOT_EOK) {
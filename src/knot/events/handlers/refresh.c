@@ -18,6 +18,7 @@
 #include <stdint.h>
 
 #include "contrib/mempattern.h"
+#include "contrib/sockaddr.h"
 #include "libdnssec/random.h"
 #include "knot/common/log.h"
 #include "knot/conf/conf.h"
@@ -28,7 +29,10 @@
 #include "knot/query/layer.h"
 #include "knot/query/query.h"
 #include "knot/query/requestor.h"
+#include "knot/query/soa_probe.h"
+#include "knot/server/server.h"
 #include "knot/updates/changesets.h"
+#include "knot/updates/zone-update.h"
 #include "knot/zone/adjust.h"
 #include "knot/zone/digest.h"
 #include "knot/zone/serial.h"
@@ -64,6 +68,11 @@
  *        +----------------------------+
  *
  * \endverbatim
+ *
+ * If the zone has contents, the SOA query is first sent over UDP by the server
+ * SOA query engine and the event finishes without waiting. Once the response
+ * arrives, the event is planned again and the received serial is processed
+ * instead of the SOA query. Any failure falls back to the SOA query over TCP.
  */
 
 #define REFRESH_LOG(priority, data, direction, msg...) \
@@ -95,6 +104,7 @@ enum xfr_type {
 
 struct refresh_data {
 	knot_layer_t *layer;              //!< Used for reading requestor flags.
+	knot_request_t *request;          //!< Used for limiting the transfer duration.
 
 	// transfer configuration, initialize appropriately:
 
@@ -107,6 +117,7 @@ struct refresh_data {
 	query_edns_data_t edns;           //!< EDNS data to be used in queries.
 	zone_master_fallback_t *fallback; //!< Flags allowing zone_master_try() fallbacks.
 	bool fallback_axfr;               //!< Flag allowing fallback to AXFR,
+	const soa_probe_result_t *probe;  //!< Asynchronous SOA query result (or NULL).
 	uint32_t expire_timer;            //!< Result: expire timer from answer EDNS.
 
 	// internal state, initialize with zeroes:
@@ -126,7 +137,18 @@ struct refresh_data {
 	struct {
 		struct ixfr_proc *proc;   //!< IXFR processing context.
 		knot_rrset_t *final_soa;  //!< SOA denoting end of transfer.
-		list_t changesets;        //!< IXFR result, zone updates.
+		list_t changesets;        //!< Received changes not applied yet.
+		size_t buffered;          //!< Size of the buffered changes.
+		size_t buffer_size;       //!< Limit of the buffered changes.
+		uint32_t lock_timeout;    //!< Limit of receiving into the open update (s).
+		zone_update_t update;     //!< IXFR result, open once the buffer is full.
+		size_t count;             //!< Number of received changesets.
+		uint32_t serial_from;     //!< Remote serial of the current changeset start.
+		uint32_t serial_to;       //!< Remote serial of the current changeset end.
+		bool dnssec;              //!< Signing of unsigned remote enabled.
+		unsigned serial_policy;   //!< Serial policy for signed serials.
+		uint32_t master_serial;   //!< Last processed remote serial (signing).
+		uint32_t local_serial;    //!< Last assigned signed serial (signing).
 	} ixfr;
 
 	bool updated;  // TODO: Can we fid a better way to check if zone was updated?
@@ -180,24 +202,40 @@ static void limit_timer(conf_t *conf, const knot_dname_t *zone, uint32_t *timer,
  * \brief Modify the expire timer wrt the received EDNS EXPIRE (RFC 7314, section 4)
  *
  * \param data             The refresh data.
- * \param pkt              A received packet to parse.
+ * \param edns_expire      Received EDNS EXPIRE value (NULL if none).
  * \param strictly_follow  Strictly use EDNS EXPIRE as the expire timer value.
  *                         (false == RFC 7314, section 4, second paragraph,
  *                           true ==                      third paragraph)
  */
-static void consume_edns_expire(struct refresh_data *data, knot_pkt_t *pkt, bool strictly_follow)
+static void consume_expire(struct refresh_data *data, const uint32_t *edns_expire,
+                           bool strictly_follow)
 {
 	if (data->zone->is_catalog_flag) {
 		data->expire_timer = EXPIRE_TIMER_INVALID;
 		return;
 	}
 
+	if (edns_expire != NULL) {
+		data->expire_timer = strictly_follow ? *edns_expire :
+				     MAX(*edns_expire, data->zone->timers.next_expire - time(NULL));
+	}
+}
+
+static const uint32_t *pkt_edns_expire(knot_pkt_t *pkt, uint32_t *edns_expire)
+{
 	uint8_t *expire_opt = knot_pkt_edns_option(pkt, KNOT_EDNS_OPTION_EXPIRE);
 	if (expire_opt != NULL && knot_edns_opt_get_length(expire_opt) == sizeof(uint32_t)) {
-		uint32_t edns_expire = knot_wire_read_u32(knot_edns_opt_get_data(expire_opt));
-		data->expire_timer = strictly_follow ? edns_expire :
-				     MAX(edns_expire, data->zone->timers.next_expire - time(NULL));
+		*edns_expire = knot_wire_read_u32(knot_edns_opt_get_data(expire_opt));
+		return edns_expire;
 	}
+
+	return NULL;
+}
+
+static void consume_edns_expire(struct refresh_data *data, knot_pkt_t *pkt, bool strictly_follow)
+{
+	uint32_t edns_expire;
+	consume_expire(data, pkt_edns_expire(pkt, &edns_expire), strictly_follow);
 }
 
 static void finalize_timers(struct refresh_data *data)
@@ -489,6 +527,31 @@ static int axfr_consume(knot_pkt_t *pkt, struct refresh_data *data, bool reuse_s
 	return next;
 }
 
+/*! \brief Reads the serials needed to adjust SOAs from an unsigned remote. */
+static int ixfr_slave_sign_init(struct refresh_data *data)
+{
+	uint32_t local_serial = zone_contents_serial(data->zone->contents), lastsigned;
+
+	if (zone_get_lastsigned_serial(data->zone, &lastsigned) != KNOT_EOK ||
+	    lastsigned != local_serial) {
+		// this is kind of assert
+		return KNOT_ERROR;
+	}
+
+	conf_val_t val = conf_zone_get(data->conf, C_SERIAL_POLICY, data->zone->name);
+	data->ixfr.serial_policy = conf_opt(&val);
+	data->ixfr.local_serial = local_serial;
+
+	int ret = zone_get_master_serial(data->zone, &data->ixfr.master_serial);
+	if (ret != KNOT_EOK) {
+		log_zone_error(data->zone->name, "failed to read master serial"
+		                                 "from KASP DB (%s)", knot_strerror(ret));
+		return ret;
+	}
+
+	return KNOT_EOK;
+}
+
 /*! \brief Initialize IXFR-in processing context. */
 static int ixfr_init(struct refresh_data *data)
 {
@@ -501,8 +564,25 @@ static int ixfr_init(struct refresh_data *data)
 	proc->state = IXFR_START;
 	proc->mm = data->mm;
 
+	conf_val_t val = conf_zone_get(data->conf, C_DNSSEC_SIGNING, data->zone->name);
+	data->ixfr.dnssec = conf_bool(&val);
+	if (data->ixfr.dnssec) {
+		int ret = ixfr_slave_sign_init(data);
+		if (ret != KNOT_EOK) {
+			mm_free(data->mm, proc);
+			return ret;
+		}
+	}
+
+	val = conf_zone_get(data->conf, C_IXFR_BUFFER_SIZE, data->zone->name);
+	data->ixfr.buffer_size = conf_int(&val);
+	val = conf_zone_get(data->conf, C_IXFR_LOCK_TIMEOUT, data->zone->name);
+	data->ixfr.lock_timeout = conf_int(&val);
+
 	data->ixfr.proc = proc;
 	data->ixfr.final_soa = NULL;
+	data->ixfr.buffered = 0;
+	data->ixfr.count = 0;
 
 	init_list(&data->ixfr.changesets);
 
@@ -522,131 +602,129 @@ static void ixfr_cleanup(struct refresh_data *data)
 	data->ixfr.proc = NULL;
 
 	changesets_free(&data->ixfr.changesets);
+
+	// Roll back the changes applied so far (no-op if committed).
+	zone_update_clear(&data->ixfr.update);
+	if (data->request != NULL) {
+		data->request->deadline = (struct timespec){ 0 };
+	}
 }
 
-static bool ixfr_serial_once(changeset_t *ch, int policy, uint32_t *master_serial, uint32_t *local_serial)
+static bool ixfr_serial_once(struct refresh_data *data, knot_rrset_t *soa_to)
 {
-	uint32_t ch_from = changeset_from(ch), ch_to = changeset_to(ch);
+	uint32_t ch_from = data->ixfr.serial_from, ch_to = data->ixfr.serial_to;
 
-	if (ch_from != *master_serial || (serial_compare(ch_from, ch_to) & SERIAL_MASK_GEQ)) {
+	if (ch_from != data->ixfr.master_serial ||
+	    (serial_compare(ch_from, ch_to) & SERIAL_MASK_GEQ)) {
 		return false;
 	}
 
-	uint32_t new_from = *local_serial;
-	uint32_t new_to = serial_next(new_from, policy, 1);
-	knot_soa_serial_set(ch->soa_from->rrs.rdata, new_from);
-	knot_soa_serial_set(ch->soa_to->rrs.rdata, new_to);
+	uint32_t new_to = serial_next(data->ixfr.local_serial, data->ixfr.serial_policy, 1);
+	knot_soa_serial_set(soa_to->rrs.rdata, new_to);
 
-	*master_serial = ch_to;
-	*local_serial = new_to;
+	data->ixfr.master_serial = ch_to;
+	data->ixfr.local_serial = new_to;
 
 	return true;
 }
 
-static int ixfr_slave_sign_serial(list_t *changesets, zone_t *zone,
-                                  conf_t *conf, uint32_t *master_serial)
+/*!
+ * \brief Opens the incremental zone update and applies the buffered changes.
+ *
+ * The update holds the zone copy-on-write lock, which blocks the other zone
+ * updates (DDNS, control zone transactions, signing). So the received changes
+ * are buffered and the update is opened when the transfer is complete. If the
+ * buffer fills up sooner, the update is opened while receiving, the rest of
+ * the changes is applied on the fly, and the transfer must be finished within
+ * the lock timeout, otherwise it's aborted and falls back to AXFR.
+ *
+ * \param data       Refresh data.
+ * \param receiving  The transfer hasn't been received completely.
+ */
+static int ixfr_update_open(struct refresh_data *data, bool receiving)
 {
-	uint32_t local_serial = zone_contents_serial(zone->contents), lastsigned;
-
-	if (zone_get_lastsigned_serial(zone, &lastsigned) != KNOT_EOK || lastsigned != local_serial) {
-		// this is kind of assert
-		return KNOT_ERROR;
+	if (data->ixfr.update.zone != NULL) {
+		return KNOT_EOK;
 	}
 
-	conf_val_t val = conf_zone_get(conf, C_SERIAL_POLICY, zone->name);
-	unsigned serial_policy = conf_opt(&val);
-
-	int ret = zone_get_master_serial(zone, master_serial);
+	int ret = zone_update_init(&data->ixfr.update, data->zone,
+	                           UPDATE_INCREMENTAL | UPDATE_STRICT | UPDATE_NO_CHSET);
 	if (ret != KNOT_EOK) {
-		log_zone_error(zone->name, "failed to read master serial"
-		                           "from KASP DB (%s)", knot_strerror(ret));
 		return ret;
 	}
-	changeset_t *chs;
-	WALK_LIST(chs, *changesets) {
-		if (!ixfr_serial_once(chs, serial_policy, master_serial, &local_serial)) {
-			return KNOT_EINVAL;
-		}
-	}
 
-	return KNOT_EOK;
-}
-
-static int ixfr_finalize(struct refresh_data *data)
-{
-	conf_val_t val = conf_zone_get(data->conf, C_DNSSEC_SIGNING, data->zone->name);
-	bool dnssec_enable = conf_bool(&val);
-	uint32_t master_serial = 0, old_serial = zone_contents_serial(data->zone->contents);
+	if (receiving && data->request != NULL) {
+		struct timespec deadline = time_now();
+		deadline.tv_sec += data->ixfr.lock_timeout;
+		data->request->deadline = deadline;
+	}
 
-	if (dnssec_enable) {
-		int ret = ixfr_slave_sign_serial(&data->ixfr.changesets, data->zone, data->conf, &master_serial);
+	changeset_t *set;
+	WALK_LIST(set, data->ixfr.changesets) {
+		ret = zone_update_apply_changeset(&data->ixfr.update, set);
 		if (ret != KNOT_EOK) {
 			IXFRIN_LOG(LOG_WARNING, data,
-			           "failed to adjust SOA serials from unsigned remote (%s)",
+			           "failed to apply buffered changes to zone (%s)",
 			           knot_strerror(ret));
-			data->fallback_axfr = false;
-			data->fallback->remote = false;
 			return ret;
 		}
 	}
+	changesets_free(&data->ixfr.changesets);
+	data->ixfr.buffered = 0;
 
-	zone_update_t up = { 0 };
-	int ret = zone_update_init(&up, data->zone, UPDATE_INCREMENTAL | UPDATE_STRICT | UPDATE_NO_CHSET);
+	return KNOT_EOK;
+}
+
+static int ixfr_finalize(struct refresh_data *data)
+{
+	zone_update_t *up = &data->ixfr.update;
+	bool dnssec_enable = data->ixfr.dnssec;
+	uint32_t master_serial = data->ixfr.master_serial;
+	uint32_t old_serial = zone_contents_serial(data->zone->contents);
+
+	int ret = ixfr_update_open(data, false);
 	if (ret != KNOT_EOK) {
+		zone_update_clear(up);
 		data->fallback_axfr = false;
 		data->fallback->remote = false;
 		return ret;
 	}
 
-	changeset_t *set;
-	WALK_LIST(set, data->ixfr.changesets) {
-		ret = zone_update_apply_changeset(&up, set);
-		if (ret != KNOT_EOK) {
-			uint32_t serial_from = knot_soa_serial(set->soa_from->rrs.rdata);
-			uint32_t serial_to = knot_soa_serial(set->soa_to->rrs.rdata);
-			zone_update_clear(&up);
-			IXFRIN_LOG(LOG_WARNING, data,
-			           "serial %u -> %u, failed to apply changes to zone (%s)",
-			           serial_from, serial_to, knot_strerror(ret));
-			return ret;
-		}
-	}
-
-	ret = zone_update_semcheck(data->conf, &up);
+	ret = zone_update_semcheck(data->conf, up);
 	if (ret == KNOT_EOK) {
-		ret = zone_update_verify_digest(data->conf, &up);
+		ret = zone_update_verify_digest(data->conf, up);
 	}
 	if (ret != KNOT_EOK) {
-		zone_update_clear(&up);
+		zone_update_clear(up);
 		data->fallback_axfr = false;
 		return ret;
 	}
 
-	val = conf_zone_get(data->conf, C_ZONEMD_GENERATE, data->zone->name);
+	conf_val_t val = conf_zone_get(data->conf, C_ZONEMD_GENERATE, data->zone->name);
 	unsigned digest_alg = conf_opt(&val);
 
 	if (dnssec_enable) {
-		ret = knot_dnssec_sign_update(&up, data->conf);
+		ret = knot_dnssec_sign_update(up, data->conf);
 	} else if (digest_alg != ZONE_DIGEST_NONE) {
-		assert(zone_update_to(&up) != NULL);
-		ret = zone_update_add_digest(&up, digest_alg, false);
+		assert(zone_update_to(up) != NULL);
+		ret = zone_update_add_digest(up, digest_alg, false);
 	}
 	if (ret != KNOT_EOK) {
-		zone_update_clear(&up);
+		zone_update_clear(up);
 		data->fallback_axfr = false;
 		data->fallback->remote = false;
 		return ret;
 	}
 
-	ret = zone_update_commit(data->conf, &up);
+	ret = zone_update_commit(data->conf, up);
 	if (ret != KNOT_EOK) {
-		zone_update_clear(&up);
+		zone_update_clear(up);
 		IXFRIN_LOG(LOG_WARNING, data,
 		           "failed to store changes (%s)", knot_strerror(ret));
 		return ret;
 	}
 
-	if (dnssec_enable && !EMPTY_LIST(data->ixfr.changesets)) {
+	if (dnssec_enable && data->ixfr.count > 0) {
 		ret = zone_set_master_serial(data->zone, master_serial);
 		if (ret != KNOT_EOK) {
 			log_zone_warning(data->zone->name,
@@ -661,7 +739,34 @@ static int ixfr_finalize(struct refresh_data *data)
 	return KNOT_EOK;
 }
 
-/*! \brief Stores starting SOA into changesets structure. */
+/*! \brief Buffers single RR or applies it to the zone update if open. */
+static int ixfr_apply_rr(const knot_rrset_t *rr, struct refresh_data *data, bool add)
+{
+	int ret;
+	if (data->ixfr.update.zone == NULL) {
+		changeset_t *change = TAIL(data->ixfr.changesets);
+		ret = add ? changeset_add_addition(change, rr, 0) :
+		            changeset_add_removal(change, rr, 0);
+		data->ixfr.buffered += knot_rrset_size(rr);
+	} else {
+		ret = add ? zone_update_add(&data->ixfr.update, rr) :
+		            zone_update_remove(&data->ixfr.update, rr);
+	}
+	if (ret != KNOT_EOK && !add) {
+		IXFRIN_LOG(LOG_WARNING, data,
+		           "serial %u, failed to apply changes to zone (%s)",
+		           data->ixfr.serial_from, knot_strerror(ret));
+	} else if (ret != KNOT_EOK) {
+		IXFRIN_LOG(LOG_WARNING, data,
+		           "serial %u -> %u, failed to apply changes to zone (%s)",
+		           data->ixfr.serial_from, data->ixfr.serial_to,
+		           knot_strerror(ret));
+	}
+
+	return ret;
+}
+
+/*! \brief Stores terminal SOA. */
 static int ixfr_solve_start(const knot_rrset_t *rr, struct refresh_data *data)
 {
 	assert(data->ixfr.final_soa == NULL);
@@ -675,9 +780,6 @@ static int ixfr_solve_start(const knot_rrset_t *rr, struct refresh_data *data)
 		return KNOT_ENOMEM;
 	}
 
-	// Initialize list for changes
-	init_list(&data->ixfr.changesets);
-
 	return KNOT_EOK;
 }
 
@@ -688,50 +790,52 @@ static int ixfr_solve_soa_del(const knot_rrset_t *rr, struct refresh_data *data)
 		return KNOT_EMALF;
 	}
 
-	// Create new changeset.
-	changeset_t *change = changeset_new(data->zone->name);
-	if (change == NULL) {
-		return KNOT_ENOMEM;
-	}
+	// Start of a new changeset, its ending serial is not known yet.
+	data->ixfr.serial_from = knot_soa_serial(rr->rrs.rdata);
 
-	// Store SOA into changeset.
-	change->soa_from = knot_rrset_copy(rr, NULL);
-	if (change->soa_from == NULL) {
-		changeset_free(change);
-		return KNOT_ENOMEM;
+	// The starting SOA is replaced by the ending one, no need to store it.
+	if (data->ixfr.update.zone == NULL) {
+		changeset_t *change = changeset_new(data->zone->name);
+		if (change == NULL) {
+			return KNOT_ENOMEM;
+		}
+		add_tail(&data->ixfr.changesets, &change->n);
 	}
 
-	// Add changeset.
-	add_tail(&data->ixfr.changesets, &change->n);
-
 	return KNOT_EOK;
 }
 
-/*! \brief Stores ending SOA into changeset. */
-static int ixfr_solve_soa_add(const knot_rrset_t *rr, changeset_t *change, knot_mm_t *mm)
+/*! \brief Applies ending SOA, adjusted if signing an unsigned remote. */
+static int ixfr_solve_soa_add(const knot_rrset_t *rr, struct refresh_data *data)
 {
 	if (rr->type != KNOT_RRTYPE_SOA) {
 		return KNOT_EMALF;
 	}
 
-	change->soa_to = knot_rrset_copy(rr, NULL);
-	if (change->soa_to == NULL) {
+	data->ixfr.serial_to = knot_soa_serial(rr->rrs.rdata);
+
+	knot_rrset_t *soa_to = knot_rrset_copy(rr, NULL);
+	if (soa_to == NULL) {
 		return KNOT_ENOMEM;
 	}
 
-	return KNOT_EOK;
-}
+	if (data->ixfr.dnssec && !ixfr_serial_once(data, soa_to)) {
+		knot_rrset_free(soa_to, NULL);
+		IXFRIN_LOG(LOG_WARNING, data,
+		           "failed to adjust SOA serials from unsigned remote (%s)",
+		           knot_strerror(KNOT_EINVAL));
+		data->fallback_axfr = false;
+		data->fallback->remote = false;
+		return KNOT_EINVAL;
+	}
 
-/*! \brief Adds single RR into remove section of changeset. */
-static int ixfr_solve_del(const knot_rrset_t *rr, changeset_t *change, knot_mm_t *mm)
-{
-	return changeset_add_removal(change, rr, 0);
-}
+	int ret = ixfr_apply_rr(soa_to, data, true);
+	knot_rrset_free(soa_to, NULL);
+	if (ret == KNOT_EOK) {
+		data->ixfr.count++;
+	}
 
-/*! \brief Adds single RR into add section of changeset. */
-static int ixfr_solve_add(const knot_rrset_t *rr, changeset_t *change, knot_mm_t *mm)
-{
-	return changeset_add_addition(change, rr, 0);
+	return ret;
 }
 
 /*! \brief Decides what the next IXFR-in state should be. */
@@ -770,7 +874,8 @@ static int ixfr_next_state(struct refresh_data *data, const knot_rrset_t *rr)
 /*!
  * \brief Processes single RR according to current IXFR-in state. The states
  *        correspond with IXFR-in message structure, in the order they are
- *        mentioned in the code.
+ *        mentioned in the code. The changes are buffered until the zone
+ *        update is opened, then they are applied to it immediately.
  *
  * \param rr    RR to process.
  * \param proc  Processing context.
@@ -780,7 +885,6 @@ static int ixfr_next_state(struct refresh_data *data, const knot_rrset_t *rr)
 static int ixfr_step(const knot_rrset_t *rr, struct refresh_data *data)
 {
 	data->ixfr.proc->state = ixfr_next_state(data, rr);
-	changeset_t *change = TAIL(data->ixfr.changesets);
 
 	switch (data->ixfr.proc->state) {
 	case IXFR_START:
@@ -788,11 +892,11 @@ static int ixfr_step(const knot_rrset_t *rr, struct refresh_data *data)
 	case IXFR_SOA_DEL:
 		return ixfr_solve_soa_del(rr, data);
 	case IXFR_DEL:
-		return ixfr_solve_del(rr, change, data->mm);
+		return ixfr_apply_rr(rr, data, false);
 	case IXFR_SOA_ADD:
-		return ixfr_solve_soa_add(rr, change, data->mm);
+		return ixfr_solve_soa_add(rr, data);
 	case IXFR_ADD:
-		return ixfr_solve_add(rr, change, data->mm);
+		return ixfr_apply_rr(rr, data, true);
 	case IXFR_DONE:
 		return KNOT_EOK;
 	default:
@@ -825,11 +929,23 @@ static int ixfr_consume_rr(const knot_rrset_t *rr, struct refresh_data *data)
 		return KNOT_STATE_DONE;
 	}
 
+	// Stop buffering, continue with the changes applied on the fly.
+	if (data->ixfr.buffered > data->ixfr.buffer_size) {
+		IXFRIN_LOG(LOG_DEBUG, data,
+		           "buffer size exceeded, updating zone while receiving");
+		data->ret = ixfr_update_open(data, true);
+		if (data->ret != KNOT_EOK) {
+			IXFRIN_LOG(LOG_WARNING, data,
+			           "failed (%s)", knot_strerror(data->ret));
+			return KNOT_STATE_FAIL;
+		}
+	}
+
 	return KNOT_STATE_CONSUME;
 }
 
 /*!
- * \brief Processes IXFR reply packet and fills in the changesets structure.
+ * \brief Processes IXFR reply packet and fills in the changes.
  *
  * \param pkt    Packet containing the IXFR reply in wire format.
  * \param adata  Answer data, including processing context.
@@ -991,6 +1107,50 @@ static int ixfr_consume(knot_pkt_t *pkt, struct refresh_data *data)
 	return next;
 }
 
+/*!
+ * \brief Decides on the refresh according to the remote SOA serial.
+ *
+ * \param data           The refresh data.
+ * \param remote_serial  Received remote serial.
+ * \param edns_expire    Received EDNS EXPIRE value (NULL if none).
+ *
+ * \return KNOT_STATE_RESET to continue with transfer, KNOT_STATE_DONE
+ *         if up-to-date, KNOT_STATE_FAIL otherwise.
+ */
+static int soa_serial_consume(struct refresh_data *data, uint32_t remote_serial,
+                              const uint32_t *edns_expire)
+{
+	uint32_t local_serial;
+	data->ret = slave_zone_serial(data->zone, data->conf, &local_serial);
+	if (data->ret != KNOT_EOK) {
+		xfr_log_read_ms(data->zone->name, data->ret);
+		data->fallback->remote = false;
+		return KNOT_STATE_FAIL;
+	}
+	bool current = serial_is_current(local_serial, remote_serial);
+	bool master_uptodate = serial_is_current(remote_serial, local_serial);
+
+	if (!current) {
+		REFRESH_LOG(LOG_INFO, data, LOG_DIRECTION_NONE,
+		            "remote serial %u, zone is outdated", remote_serial);
+		data->state = STATE_TRANSFER;
+		return KNOT_STATE_RESET; // continue with transfer
+	} else if (master_uptodate) {
+		consume_expire(data, edns_expire, false);
+		finalize_timers(data);
+		char expires_in[32] = "";
+		fill_expires_in(expires_in, sizeof(expires_in), data);
+		REFRESH_LOG(LOG_INFO, data, LOG_DIRECTION_NONE,
+		            "remote serial %u, zone is up-to-date%s",
+		            remote_serial, expires_in);
+		return KNOT_STATE_DONE;
+	} else {
+		REFRESH_LOG(LOG_INFO, data, LOG_DIRECTION_NONE,
+		            "remote serial %u, remote is outdated", remote_serial);
+		return KNOT_STATE_FAIL;
+	}
+}
+
 static int soa_query_produce(knot_layer_t *layer, knot_pkt_t *pkt)
 {
 	struct refresh_data *data = layer->data;
@@ -1041,38 +1201,10 @@ static int soa_query_consume(knot_layer_t *layer, knot_pkt_t *pkt)
 		}
 	}
 
-	uint32_t local_serial;
-	data->ret = slave_zone_serial(data->zone, data->conf, &local_serial);
-	if (data->ret != KNOT_EOK) {
-		xfr_log_read_ms(data->zone->name, data->ret);
-		data->fallback->remote = false;
-		return KNOT_STATE_FAIL;
-	}
-	uint32_t remote_serial = knot_soa_serial(rr->rrs.rdata);
-	bool current = serial_is_current(local_serial, remote_serial);
-	bool master_uptodate = serial_is_current(remote_serial, local_serial);
-
-	if (!current) {
-		REFRESH_LOG(LOG_INFO, data, LOG_DIRECTION_NONE,
-		            "remote serial %u, zone is outdated", remote_serial);
-		data->state = STATE_TRANSFER;
-		return KNOT_STATE_RESET; // continue with transfer
-	} else if (master_uptodate) {
-		consume_edns_expire(data, pkt, false);
-		finalize_timers(data);
-		char expires_in[32] = "";
-		fill_expires_in(expires_in, sizeof(expires_in), data);
-		REFRESH_LOG(LOG_INFO, data, LOG_DIRECTION_NONE,
-		            "remote serial %u, zone is up-to-date%s",
-		            remote_serial, expires_in);
-		return KNOT_STATE_DONE;
-	} else {
-		REFRESH_LOG(LOG_INFO, data, LOG_DIRECTION_NONE,
-		            "remote serial %u, remote is outdated", remote_serial);
-		return KNOT_STATE_FAIL;
-	}
+	uint32_t edns_expire;
+	return soa_serial_consume(data, knot_soa_serial(rr->rrs.rdata),
+	                          pkt_edns_expire(pkt, &edns_expire));
 }
-
 static int transfer_produce(knot_layer_t *layer, knot_pkt_t *pkt)
 {
 	struct refresh_data *data = layer->data;
@@ -1192,6 +1324,14 @@ static int refresh_begin(knot_layer_t *layer, void *_data)
 
 	data->started = time_now();
 
+	// The SOA query was already answered asynchronously.
+	if (data->soa && data->probe != NULL) {
+		const soa_probe_result_t *probe = data->probe;
+		int next = soa_serial_consume(data, probe->serial,
+		                              probe->has_expire ? &probe->expire : NULL);
+		return next == KNOT_STATE_RESET ? KNOT_STATE_PRODUCE : next;
+	}
+
 	return KNOT_STATE_PRODUCE;
 }
 
@@ -1257,6 +1397,7 @@ static size_t max_zone_size(conf_t *conf, const knot_dname_t *zone)
 typedef struct {
 	bool force_axfr;
 	bool send_notify;
+	const soa_probe_result_t *probe;
 } try_refresh_ctx_t;
 
 static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
@@ -1290,6 +1431,13 @@ static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
 		.fallback_axfr = false, // will be set upon IXFR consume
 	};
 
+	// Use the asynchronous SOA query result once, if from this master.
+	if (trctx->probe != NULL &&
+	    sockaddr_cmp(&trctx->probe->remote, &master->addr, false) == 0) {
+		data.probe = trctx->probe;
+		trctx->probe = NULL;
+	}
+
 	knot_requestor_t requestor;
 	knot_requestor_init(&requestor, &REFRESH_API, &data, NULL);
 
@@ -1308,6 +1456,7 @@ static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
 		knot_requestor_clear(&requestor);
 		return KNOT_ENOMEM;
 	}
+	data.request = req;
 
 	int timeout = conf->cache.srv_tcp_remote_io_timeout;
 
@@ -1337,6 +1486,61 @@ static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
 	return ret;
 }
 
+static int probe_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
+                         void *ctx, zone_master_fallback_t *fallback)
+{
+	query_edns_data_t edns = query_edns_data_init(conf, master->addr.ss_family,
+	                                              QUERY_EDNS_OPT_EXPIRE);
+	int ret = soa_probe_submit(zone->server->soa_probe, zone->name, master,
+	                           master->no_edns ? NULL : &edns,
+	                           conf->cache.srv_tcp_remote_io_timeout);
+	if (ret == KNOT_ENOMEM) {
+		fallback->remote = false;
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Submits or consumes the asynchronous SOA query of the refresh.
+ *
+ * \retval KNOT_EOK     if the query is outstanding, the event is finished.
+ * \retval KNOT_EAGAIN  if the refresh is to continue, possibly with the result.
+ */
+static int refresh_probe(conf_t *conf, zone_t *zone, soa_probe_result_t *result,
+                         try_refresh_ctx_t *trctx)
+{
+	if (trctx->force_axfr || zone->contents == NULL ||
+	    zone->server == NULL || zone->server->soa_probe == NULL) {
+		return KNOT_EAGAIN;
+	}
+
+	switch (zone_refresh_probe_take(zone, result)) {
+	case ZONE_PROBE_NONE:
+		if (zone_master_try(conf, zone, probe_refresh, NULL, "refresh") == KNOT_EOK) {
+			return KNOT_EOK;
+		}
+		zone_refresh_probe_cancel(zone);
+		return KNOT_EAGAIN;
+	case ZONE_PROBE_PENDING:
+		return KNOT_EOK;
+	case ZONE_PROBE_DONE:
+		// On failure, fall back to the SOA query over TCP.
+		if (result->ret == KNOT_EOK) {
+			trctx->probe = result;
+		} else {
+			char addr_str[SOCKADDR_STRLEN] = { 0 };
+			sockaddr_tostr(addr_str, sizeof(addr_str), &result->remote);
+			log_zone_debug(zone->name, "refresh, remote %s, UDP SOA query failed (%s)",
+			               addr_str, knot_strerror(result->ret));
+		}
+		return KNOT_EAGAIN;
+	default:
+		assert(0);
+		return KNOT_EAGAIN;
+	}
+}
+
 int event_refresh(conf_t *conf, zone_t *zone)
 {
 	assert(zone);
@@ -1353,6 +1557,12 @@ int event_refresh(conf_t *conf, zone_t *zone)
 		zone->zonefile.retransfer = true;
 	}
 
+	/* Wait for the SOA query outside of the worker if possible. */
+	soa_probe_result_t probe;
+	if (refresh_probe(conf, zone, &probe, &trctx) == KNOT_EOK) {
+		return KNOT_EOK;
+	}
+
 	int ret = zone_master_try(conf, zone, try_refresh, &trctx, "refresh");
 	zone_clear_preferred_master(zone);
 	if (ret != KNOT_EOK) {
@@ -147,10 +147,8 @@ static int process_normal(conf_t *conf, zone_t *zone, list_t *requests)
 	}
 
 	// Sign update.
-	conf_val_t val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	bool dnssec_enable = conf_bool(&val);
-	val = conf_zone_get(conf, C_ZONEMD_GENERATE, zone->name);
-	unsigned digest_alg = conf_opt(&val);
+	bool dnssec_enable = zone_conf_dnssec_signing(conf, &zone->settings, zone->name);
+	unsigned digest_alg = zone_conf_zonemd_generate(conf, &zone->settings, zone->name);
 	if (dnssec_enable) {
 		ret = knot_dnssec_sign_update(&up, conf);
 	} else if (digest_alg != ZONE_DIGEST_NONE) {
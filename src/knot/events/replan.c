@@ -86,8 +86,7 @@ static void replan_dnssec(conf_t *conf, zone_t *zone)
 	assert(conf);
 	assert(zone);
 
-	conf_val_t val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	if (conf_bool(&val)) {
+	if (zone_conf_dnssec_signing(conf, &zone->settings, zone->name)) {
 		zone_events_schedule_now(zone, ZONE_EVENT_DNSSEC);
 	}
 }
@@ -120,8 +119,8 @@ void replan_from_timers(conf_t *conf, zone_t *zone)
 
 	time_t flush = TIME_IGNORE;
 	if (!zone_is_slave(conf, zone) || zone->contents != NULL) {
-		conf_val_t val = conf_zone_get(conf, C_ZONEFILE_SYNC, zone->name);
-		int64_t sync_timeout = conf_int(&val);
+		int64_t sync_timeout = zone_conf_zonefile_sync(conf, &zone->settings,
+		                                               zone->name);
 		if (sync_timeout > 0) {
 			flush = zone->timers.last_flush + sync_timeout;
 		}
@@ -130,11 +129,10 @@ void replan_from_timers(conf_t *conf, zone_t *zone)
 	time_t resalt = TIME_IGNORE;
 	time_t ds_check = TIME_CANCEL;
 	time_t ds_push = TIME_CANCEL;
-	conf_val_t val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	if (conf_bool(&val)) {
+	if (zone_conf_dnssec_signing(conf, &zone->settings, zone->name)) {
 		conf_val_t policy = conf_zone_get(conf, C_DNSSEC_POLICY, zone->name);
 		conf_id_fix_default(&policy);
-		val = conf_id_get(conf, C_POLICY, C_NSEC3, &policy);
+		conf_val_t val = conf_id_get(conf, C_POLICY, C_NSEC3, &policy);
 		if (conf_bool(&val)) {
 			knot_time_t last_resalt = 0;
 			if (knot_lmdb_open(zone_kaspdb(zone)) == KNOT_EOK) {
@@ -398,6 +398,7 @@ typedef enum {
 /*! Query processing specific flags. */
 typedef enum {
 	KNOTD_QUERY_FLAG_COOKIE  = 1 << 0, /*!< Valid DNS Cookie indication. */
+	KNOTD_QUERY_FLAG_PROXIED = 1 << 1, /*!< Remote address from a PROXY header. */
 } knotd_query_flag_t;
 
 /*! Query processing data context parameters. */
@@ -432,6 +433,8 @@ typedef struct {
 	knotd_qdata_params_t *params; /*!< Low-level processing parameters. */
 
 	struct knotd_qdata_extra *extra; /*!< Private items (process_query.h). */
+
+	uint32_t rand;                  /*!< Per-query random value (0 if not drawn yet). */
 } knotd_qdata_t;
 
 /*!
@@ -467,6 +470,19 @@ inline static const struct sockaddr_storage *knotd_qdata_remote_addr(knotd_qdata
  */
 uint32_t knotd_qdata_rtt(knotd_qdata_t *qdata);
 
+/*!
+ * Gets a random value drawn once per query.
+ *
+ * The value is the same for all the processing stages and response messages
+ * of the query, so it can be used for consistent per-query decisions
+ * (e.g. sampling of both the query and the response).
+ *
+ * \param[in] qdata  Query data.
+ *
+ * \return Non-zero random value.
+ */
+uint32_t knotd_qdata_rand(knotd_qdata_t *qdata);
+
 /*!
  * Gets the current zone name.
  *
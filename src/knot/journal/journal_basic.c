@@ -49,11 +49,14 @@ void journal_del_zone(knot_lmdb_txn_t *txn, const knot_dname_t *zone)
 	free(prefix.mv_data);
 }
 
-void journal_make_header(void *chunk, uint32_t ch_serial_to)
+void journal_make_header(void *chunk, uint32_t ch_serial_to, unsigned compression,
+                         uint32_t raw_size)
 {
-	knot_lmdb_make_key_part(chunk, JOURNAL_HEADER_SIZE, "IILLL", ch_serial_to,
+	knot_lmdb_make_key_part(chunk, JOURNAL_HEADER_SIZE, "IIIILL", ch_serial_to,
 	                        (uint32_t)0 /* we no longer care for # of chunks */,
-	                        (uint64_t)0, (uint64_t)0, (uint64_t)0);
+	                        (uint32_t)compression,
+	                        compression == JOURNAL_COMPRESSION_NONE ? (uint32_t)0 : raw_size,
+	                        (uint64_t)0, (uint64_t)0);
 }
 
 uint32_t journal_next_serial(const MDB_val *chunk)
@@ -61,6 +64,19 @@ uint32_t journal_next_serial(const MDB_val *chunk)
 	return knot_wire_read_u32(chunk->mv_data);
 }
 
+unsigned journal_chunk_compression(const MDB_val *chunk)
+{
+	return knot_wire_read_u32(chunk->mv_data + 2 * sizeof(uint32_t));
+}
+
+size_t journal_chunk_raw_size(const MDB_val *chunk)
+{
+	if (journal_chunk_compression(chunk) == JOURNAL_COMPRESSION_NONE) {
+		return chunk->mv_size - JOURNAL_HEADER_SIZE;
+	}
+	return knot_wire_read_u32(chunk->mv_data + 3 * sizeof(uint32_t));
+}
+
 bool journal_serial_to(knot_lmdb_txn_t *txn, bool zij, uint32_t serial,
                        const knot_dname_t *zone, uint32_t *serial_to)
 {
@@ -75,18 +91,20 @@ bool journal_serial_to(knot_lmdb_txn_t *txn, bool zij, uint32_t serial,
 
 bool journal_allow_flush(zone_journal_t j)
 {
-	conf_val_t val = conf_zone_get(j.conf, C_ZONEFILE_SYNC, j.zone);
-	return conf_int(&val) >= 0;
+	return zone_conf_zonefile_sync(j.conf, j.zconf, j.zone) >= 0;
 }
 
 size_t journal_conf_max_usage(zone_journal_t j)
 {
-	conf_val_t val = conf_zone_get(j.conf, C_JOURNAL_MAX_USAGE, j.zone);
-	return conf_int(&val);
+	return zone_conf_journal_max_usage(j.conf, j.zconf, j.zone);
 }
 
 size_t journal_conf_max_changesets(zone_journal_t j)
 {
-	conf_val_t val = conf_zone_get(j.conf, C_JOURNAL_MAX_DEPTH, j.zone);
-	return conf_int(&val);
+	return zone_conf_journal_max_depth(j.conf, j.zconf, j.zone);
+}
+
+unsigned journal_conf_compression(zone_journal_t j)
+{
+	return zone_conf_journal_compression(j.conf, j.zconf, j.zone);
 }
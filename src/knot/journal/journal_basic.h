@@ -19,17 +19,20 @@
 #include "knot/conf/conf.h"
 #include "knot/journal/knot_lmdb.h"
 #include "knot/updates/changesets.h"
+#include "knot/zone/zone-conf.h"
 #include "libknot/dname.h"
 
 typedef struct {
 	knot_lmdb_db_t *db;
 	const knot_dname_t *zone;
 	void *conf; // needed only for journal write operations
+	zone_conf_t *const *zconf; // pre-resolved zone configuration location (optional)
 } zone_journal_t;
 
 #define JOURNAL_CHUNK_MAX (70 * 1024) // must be at least 64k + 6B
 #define JOURNAL_CHUNK_THRESH (15 * 1024)
 #define JOURNAL_HEADER_SIZE (32)
+#define JOURNAL_ZSTD_LEVEL (1)
 
 /*! \brief Convert journal_mode to LMDB environment flags. */
 inline static unsigned journal_env_flags(int journal_mode, bool readonly)
@@ -74,10 +77,17 @@ void journal_del_zone(knot_lmdb_txn_t *txn, const knot_dname_t *zone);
 /*!
  * \brief Initialise chunk header.
  *
- * \param chunk   Pointer to the changeset chunk. It must be at least JOURNAL_HEADER_SIZE, perhaps more.
- * \param ch      Serial-to of the changeset being serialized.
+ * The header consists of serial-to, unused chunk count, compression algorithm,
+ * uncompressed size of the chunk data, and reserved space. The zero fields of
+ * older journals denote an uncompressed chunk.
+ *
+ * \param chunk         Pointer to the changeset chunk. It must be at least JOURNAL_HEADER_SIZE, perhaps more.
+ * \param ch            Serial-to of the changeset being serialized.
+ * \param compression   Compression of the chunk data (JOURNAL_COMPRESSION_*).
+ * \param raw_size      Uncompressed size of the chunk data (without header).
  */
-void journal_make_header(void *chunk, uint32_t ch_serial_to);
+void journal_make_header(void *chunk, uint32_t ch_serial_to, unsigned compression,
+                         uint32_t raw_size);
 
 /*!
  * \brief Obtain serial-to of the serialized changeset.
@@ -88,6 +98,12 @@ void journal_make_header(void *chunk, uint32_t ch_serial_to);
  */
 uint32_t journal_next_serial(const MDB_val *chunk);
 
+/*! \brief Obtain the compression algorithm of the chunk data. */
+unsigned journal_chunk_compression(const MDB_val *chunk);
+
+/*! \brief Obtain the uncompressed size of the chunk data (without header). */
+size_t journal_chunk_raw_size(const MDB_val *chunk);
+
 /*!
  * \brief Obtain serial-to of a changeset stored in journal.
  *
@@ -116,3 +132,6 @@ size_t journal_conf_max_usage(zone_journal_t j);
 
 /*! \brief Return configured maximal depth of journal. */
 size_t journal_conf_max_changesets(zone_journal_t j);
+
+/*! \brief Return configured compression of newly written chunks. */
+unsigned journal_conf_compression(zone_journal_t j);
@@ -25,6 +25,9 @@
 #include "libknot/error.h"
 
 #include <stdlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 struct journal_read {
 	knot_lmdb_txn_t txn;
@@ -32,6 +35,10 @@ struct journal_read {
 	const knot_dname_t *zone;
 	wire_ctx_t wire;
 	uint32_t next;
+#ifdef HAVE_ZSTD
+	ZSTD_DCtx *dctx;
+	uint8_t *raw;       // decompressed chunk data
+#endif
 };
 
 int journal_read_get_error(const journal_read_t *ctx, int another_error)
@@ -39,10 +46,58 @@ int journal_read_get_error(const journal_read_t *ctx, int another_error)
 	return (ctx == NULL || ctx->txn.ret == KNOT_EOK ? another_error : ctx->txn.ret);
 }
 
-static void update_ctx_wire(journal_read_t *ctx)
+#ifdef HAVE_ZSTD
+static bool decompress_chunk(journal_read_t *ctx, const MDB_val *chunk)
 {
-	ctx->wire = wire_ctx_init_const(ctx->txn.cur_val.mv_data, ctx->txn.cur_val.mv_size);
-	wire_ctx_skip(&ctx->wire, JOURNAL_HEADER_SIZE);
+	size_t raw_size = journal_chunk_raw_size(chunk);
+	if (raw_size == 0 || raw_size > JOURNAL_CHUNK_MAX) {
+		ctx->txn.ret = KNOT_EMALF;
+		return false;
+	}
+
+	if (ctx->dctx == NULL) {
+		ctx->dctx = ZSTD_createDCtx();
+		ctx->raw = malloc(JOURNAL_CHUNK_MAX);
+		if (ctx->dctx == NULL || ctx->raw == NULL) {
+			ctx->txn.ret = KNOT_ENOMEM;
+			return false;
+		}
+	}
+
+	size_t res = ZSTD_decompressDCtx(ctx->dctx, ctx->raw, raw_size,
+	                                 chunk->mv_data + JOURNAL_HEADER_SIZE,
+	                                 chunk->mv_size - JOURNAL_HEADER_SIZE);
+	if (ZSTD_isError(res) || res != raw_size) {
+		ctx->txn.ret = KNOT_EMALF;
+		return false;
+	}
+
+	ctx->wire = wire_ctx_init_const(ctx->raw, raw_size);
+	return true;
+}
+#endif
+
+static bool update_ctx_wire(journal_read_t *ctx)
+{
+	const MDB_val *chunk = &ctx->txn.cur_val;
+	if (chunk->mv_size < JOURNAL_HEADER_SIZE) {
+		ctx->txn.ret = KNOT_EMALF;
+		return false;
+	}
+
+	switch (journal_chunk_compression(chunk)) {
+	case JOURNAL_COMPRESSION_NONE:
+		ctx->wire = wire_ctx_init_const(chunk->mv_data, chunk->mv_size);
+		wire_ctx_skip(&ctx->wire, JOURNAL_HEADER_SIZE);
+		return true;
+#ifdef HAVE_ZSTD
+	case JOURNAL_COMPRESSION_ZSTD:
+		return decompress_chunk(ctx, chunk);
+#endif
+	default:
+		ctx->txn.ret = KNOT_ENOTSUP;
+		return false;
+	}
 }
 
 static bool go_next_changeset(journal_read_t *ctx, bool go_zone, const knot_dname_t *zone)
@@ -57,8 +112,7 @@ static bool go_next_changeset(journal_read_t *ctx, bool go_zone, const knot_dnam
 		return false;
 	}
 	ctx->next = journal_next_serial(&ctx->txn.cur_val);
-	update_ctx_wire(ctx);
-	return true;
+	return update_ctx_wire(ctx);
 }
 
 int journal_read_begin(zone_journal_t j, bool read_zone, uint32_t serial_from, journal_read_t **ctx)
@@ -82,8 +136,9 @@ int journal_read_begin(zone_journal_t j, bool read_zone, uint32_t serial_from, j
 		*ctx = newctx;
 		return KNOT_EOK;
 	} else {
+		int ret = (newctx->txn.ret == KNOT_EOK ? KNOT_ENOENT : newctx->txn.ret);
 		journal_read_end(newctx);
-		return KNOT_ENOENT;
+		return ret;
 	}
 }
 
@@ -92,6 +147,10 @@ void journal_read_end(journal_read_t *ctx)
 	if (ctx != NULL) {
 		free(ctx->key_prefix.mv_data);
 		knot_lmdb_abort(&ctx->txn);
+#ifdef HAVE_ZSTD
+		ZSTD_freeDCtx(ctx->dctx);
+		free(ctx->raw);
+#endif
 		free(ctx);
 	}
 }
@@ -110,7 +169,7 @@ static bool make_data_available(journal_read_t *ctx)
 			ctx->txn.ret = KNOT_EMALF;
 			return false;
 		}
-		update_ctx_wire(ctx);
+		return update_ctx_wire(ctx);
 	}
 	return true;
 }
@@ -434,3 +493,51 @@ int journal_sem_check(zone_journal_t j)
 	}
 	return KNOT_EOK;
 }
+
+static void add_chunk_sizes(knot_lmdb_txn_t *txn, bool zij, uint32_t serial,
+                            const knot_dname_t *zone, uint64_t *stored, uint64_t *raw)
+{
+	MDB_val prefix = journal_changeset_id_to_key(zij, serial, zone);
+	knot_lmdb_foreach(txn, &prefix) {
+		if (txn->cur_val.mv_size >= JOURNAL_HEADER_SIZE) {
+			*stored += txn->cur_val.mv_size;
+			*raw += JOURNAL_HEADER_SIZE + journal_chunk_raw_size(&txn->cur_val);
+		}
+	}
+	free(prefix.mv_data);
+}
+
+int journal_chunk_sizes(zone_journal_t j, uint64_t *stored, uint64_t *raw)
+{
+	*stored = 0;
+	*raw = 0;
+
+	if (!journal_is_existing(j)) {
+		return KNOT_EOK;
+	}
+
+	knot_lmdb_txn_t txn = { 0 };
+	journal_metadata_t md = { 0 };
+	knot_lmdb_begin(j.db, &txn, false);
+	journal_load_metadata(&txn, j.zone, &md);
+
+	if (journal_contains(&txn, true, 0, j.zone)) {
+		add_chunk_sizes(&txn, true, 0, j.zone, stored, raw);
+	}
+	if ((md.flags & JOURNAL_MERGED_SERIAL_VALID)) {
+		add_chunk_sizes(&txn, false, md.merged_serial, j.zone, stored, raw);
+	}
+
+	uint32_t serial = md.first_serial, next;
+	for (size_t i = 0; i < md.changeset_count && txn.ret == KNOT_EOK &&
+	     (md.flags & JOURNAL_SERIAL_TO_VALID) && serial != md.serial_to; i++) {
+		if (!journal_serial_to(&txn, false, serial, j.zone, &next)) {
+			break;
+		}
+		add_chunk_sizes(&txn, false, serial, j.zone, stored, raw);
+		serial = next;
+	}
+
+	knot_lmdb_abort(&txn);
+	return txn.ret;
+}
@@ -156,3 +156,14 @@ int journal_walk(zone_journal_t j, journal_walk_cb_t cb, void *ctx);
  * \return KNOT_EOK of all ok.
  */
 int journal_sem_check(zone_journal_t j);
+
+/*!
+ * \brief Compute the stored and the uncompressed size of the zone changesets.
+ *
+ * \param j        Zone journal.
+ * \param stored   Output: size of the stored chunks.
+ * \param raw      Output: size of the chunks if stored uncompressed.
+ *
+ * \return KNOT_E*
+ */
+int journal_chunk_sizes(zone_journal_t j, uint64_t *stored, uint64_t *raw);
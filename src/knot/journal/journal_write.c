@@ -14,6 +14,13 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "knot/journal/journal_write.h"
 
 #include "contrib/macros.h"
@@ -22,24 +29,273 @@
 #include "knot/journal/serialization.h"
 #include "libknot/error.h"
 
+static void chunk_raw_write(knot_lmdb_txn_t *txn, serialize_ctx_t *ser, MDB_val *key,
+                            size_t raw_size, uint32_t ch_to)
+{
+	MDB_val chunk = { .mv_size = JOURNAL_HEADER_SIZE + raw_size, .mv_data = NULL };
+	if (knot_lmdb_insert(txn, key, &chunk)) {
+		journal_make_header(chunk.mv_data, ch_to, JOURNAL_COMPRESSION_NONE, 0);
+		serialize_chunk(ser, chunk.mv_data + JOURNAL_HEADER_SIZE, raw_size);
+	}
+}
+
+/*! Limit of the stored size of the chunks prepared in advance. */
+#define JOURNAL_CHUNKS_PREPARED_MAX (1024 * 1024)
+
+/*! Changeset chunks prepared in advance, including the headers. */
+typedef struct {
+	MDB_val *chunks;
+	size_t count;
+	size_t size;     //!< Total stored size of the chunks.
+	bool complete;   //!< All the chunks are prepared, not only their size.
+} journal_chunks_t;
+
+static void journal_chunks_drop(journal_chunks_t *chunks)
+{
+	for (size_t i = 0; i < chunks->count; i++) {
+		free(chunks->chunks[i].mv_data);
+	}
+	free(chunks->chunks);
+	chunks->chunks = NULL;
+	chunks->count = 0;
+	chunks->complete = false;
+}
+
+static void journal_chunks_free(journal_chunks_t *chunks)
+{
+	journal_chunks_drop(chunks);
+	memset(chunks, 0, sizeof(*chunks));
+}
+
+#ifdef HAVE_ZSTD
+/*! Compression context and buffers, reused by each thread. */
+typedef struct {
+	ZSTD_CCtx *cctx;
+	uint8_t raw[JOURNAL_CHUNK_MAX];
+	size_t out_size;
+	uint8_t out[];
+} chunk_zstd_t;
+
+static pthread_key_t zstd_key;
+static pthread_once_t zstd_once = PTHREAD_ONCE_INIT;
+
+static void chunk_zstd_free(void *ptr)
+{
+	chunk_zstd_t *z = ptr;
+	if (z != NULL) {
+		ZSTD_freeCCtx(z->cctx);
+		free(z);
+	}
+}
+
+static void chunk_zstd_key_init(void)
+{
+	(void)pthread_key_create(&zstd_key, chunk_zstd_free);
+}
+
+static chunk_zstd_t *chunk_zstd_get(void)
+{
+	(void)pthread_once(&zstd_once, chunk_zstd_key_init);
+
+	chunk_zstd_t *z = pthread_getspecific(zstd_key);
+	if (z == NULL) {
+		size_t out_size = ZSTD_compressBound(JOURNAL_CHUNK_MAX);
+		z = malloc(sizeof(*z) + out_size);
+		if (z == NULL) {
+			return NULL;
+		}
+		z->out_size = out_size;
+		z->cctx = ZSTD_createCCtx();
+		if (z->cctx == NULL || pthread_setspecific(zstd_key, z) != 0) {
+			chunk_zstd_free(z);
+			return NULL;
+		}
+	}
+
+	return z;
+}
+
+/*!
+ * \brief Serializes and compresses the next chunk into the thread buffers.
+ *
+ * The compressed data is used only if it's smaller than the raw chunk data.
+ *
+ * \return Size of the chunk data to be stored (without the header), 0 if finished.
+ */
+static size_t chunk_zstd_next(chunk_zstd_t *z, serialize_ctx_t *ser, size_t *raw_size,
+                              const uint8_t **data, unsigned *compression)
+{
+	serialize_prepare(ser, JOURNAL_CHUNK_THRESH - JOURNAL_HEADER_SIZE,
+	                  JOURNAL_CHUNK_MAX - JOURNAL_HEADER_SIZE, raw_size);
+	if (*raw_size == 0) {
+		return 0; // beware! If this is omitted, it creates empty chunk => EMALF when reading.
+	}
+	serialize_chunk(ser, z->raw, *raw_size);
+
+	size_t comp_size = ZSTD_compressCCtx(z->cctx, z->out, z->out_size,
+	                                     z->raw, *raw_size, JOURNAL_ZSTD_LEVEL);
+	if (!ZSTD_isError(comp_size) && comp_size < *raw_size) {
+		*data = z->out;
+		*compression = JOURNAL_COMPRESSION_ZSTD;
+		return comp_size;
+	}
+	*data = z->raw;
+	*compression = JOURNAL_COMPRESSION_NONE;
+	return *raw_size;
+}
+
+/*!
+ * \brief Serializes and compresses the chunks in advance, so that their stored
+ *        size is known before the occupation check.
+ *
+ * The chunks are kept only up to JOURNAL_CHUNKS_PREPARED_MAX of the stored
+ * size. Beyond that, just the size is counted and the chunks have to be
+ * compressed again while writing. The serialization context is freed in any case.
+ */
+static int chunks_prepare(serialize_ctx_t *ser, uint32_t ch_to, journal_chunks_t *out)
+{
+	memset(out, 0, sizeof(*out));
+	if (ser == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	chunk_zstd_t *z = chunk_zstd_get();
+	if (z == NULL) {
+		(void)serialize_deinit(ser);
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	size_t raw_size, capacity = 0;
+	const uint8_t *data;
+	unsigned compression;
+	out->complete = true;
+	while (serialize_unfinished(ser)) {
+		size_t data_size = chunk_zstd_next(z, ser, &raw_size, &data, &compression);
+		if (data_size == 0) {
+			break;
+		}
+		out->size += JOURNAL_HEADER_SIZE + data_size;
+		if (!out->complete || out->size > JOURNAL_CHUNKS_PREPARED_MAX) {
+			journal_chunks_drop(out);
+			continue;
+		}
+
+		if (out->count == capacity) {
+			capacity = MAX(2 * capacity, 8);
+			MDB_val *chunks = realloc(out->chunks, capacity * sizeof(*chunks));
+			if (chunks == NULL) {
+				ret = KNOT_ENOMEM;
+				break;
+			}
+			out->chunks = chunks;
+		}
+		MDB_val *chunk = &out->chunks[out->count];
+		chunk->mv_size = JOURNAL_HEADER_SIZE + data_size;
+		chunk->mv_data = malloc(chunk->mv_size);
+		if (chunk->mv_data == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+		journal_make_header(chunk->mv_data, ch_to, compression, raw_size);
+		memcpy(chunk->mv_data + JOURNAL_HEADER_SIZE, data, data_size);
+		out->count++;
+	}
+
+	int ser_ret = serialize_deinit(ser);
+	if (ret == KNOT_EOK) {
+		ret = ser_ret;
+	}
+	if (ret != KNOT_EOK) {
+		journal_chunks_free(out);
+	}
+	return ret;
+}
+
+static void journal_write_zstd(knot_lmdb_txn_t *txn, serialize_ctx_t *ser,
+                               const knot_dname_t *apex, bool zij, uint32_t ch_from,
+                               uint32_t ch_to)
+{
+	chunk_zstd_t *z = chunk_zstd_get();
+	if (z == NULL && txn->ret == KNOT_EOK) {
+		txn->ret = KNOT_ENOMEM;
+	}
+
+	size_t raw_size;
+	const uint8_t *data;
+	unsigned compression;
+	uint32_t i = 0;
+	while (serialize_unfinished(ser) && txn->ret == KNOT_EOK) {
+		size_t data_size = chunk_zstd_next(z, ser, &raw_size, &data, &compression);
+		if (data_size == 0) {
+			break;
+		}
+		MDB_val key = journal_make_chunk_key(apex, ch_from, zij, i);
+		MDB_val chunk = { .mv_size = JOURNAL_HEADER_SIZE + data_size, .mv_data = NULL };
+		if (knot_lmdb_insert(txn, &key, &chunk)) {
+			journal_make_header(chunk.mv_data, ch_to, compression, raw_size);
+			memcpy(chunk.mv_data + JOURNAL_HEADER_SIZE, data, data_size);
+		}
+		free(key.mv_data);
+		i++;
+	}
+	int ret = serialize_deinit(ser);
+	if (txn->ret == KNOT_EOK) {
+		txn->ret = ret;
+	}
+}
+#else
+static int chunks_prepare(serialize_ctx_t *ser, _unused_ uint32_t ch_to,
+                          journal_chunks_t *out)
+{
+	memset(out, 0, sizeof(*out));
+	(void)serialize_deinit(ser);
+	return KNOT_ENOTSUP;
+}
+
+static void journal_write_zstd(knot_lmdb_txn_t *txn, serialize_ctx_t *ser,
+                               _unused_ const knot_dname_t *apex, _unused_ bool zij,
+                               _unused_ uint32_t ch_from, _unused_ uint32_t ch_to)
+{
+	(void)serialize_deinit(ser);
+	if (txn->ret == KNOT_EOK) {
+		txn->ret = KNOT_ENOTSUP;
+	}
+}
+#endif
+
+static void journal_write_chunks(knot_lmdb_txn_t *txn, const journal_chunks_t *chunks,
+                                 const knot_dname_t *apex, bool zij, uint32_t ch_from)
+{
+	for (uint32_t i = 0; i < chunks->count && txn->ret == KNOT_EOK; i++) {
+		MDB_val key = journal_make_chunk_key(apex, ch_from, zij, i);
+		MDB_val chunk = { .mv_size = chunks->chunks[i].mv_size, .mv_data = NULL };
+		if (knot_lmdb_insert(txn, &key, &chunk)) {
+			memcpy(chunk.mv_data, chunks->chunks[i].mv_data, chunk.mv_size);
+		}
+		free(key.mv_data);
+	}
+}
+
 static void journal_write_serialize(knot_lmdb_txn_t *txn, serialize_ctx_t *ser,
-                                    const knot_dname_t *apex, bool zij, uint32_t ch_from, uint32_t ch_to)
+                                    const knot_dname_t *apex, bool zij, uint32_t ch_from,
+                                    uint32_t ch_to, unsigned compression)
 {
-	MDB_val chunk;
+	if (compression == JOURNAL_COMPRESSION_ZSTD) {
+		journal_write_zstd(txn, ser, apex, zij, ch_from, ch_to);
+		return;
+	}
+
+	size_t raw_size;
 	uint32_t i = 0;
 	while (serialize_unfinished(ser) && txn->ret == KNOT_EOK) {
 		serialize_prepare(ser, JOURNAL_CHUNK_THRESH - JOURNAL_HEADER_SIZE,
-		                  JOURNAL_CHUNK_MAX - JOURNAL_HEADER_SIZE, &chunk.mv_size);
-		if (chunk.mv_size == 0) {
+		                  JOURNAL_CHUNK_MAX - JOURNAL_HEADER_SIZE, &raw_size);
+		if (raw_size == 0) {
 			break; // beware! If this is omitted, it creates empty chunk => EMALF when reading.
 		}
-		chunk.mv_size += JOURNAL_HEADER_SIZE;
-		chunk.mv_data = NULL;
 		MDB_val key = journal_make_chunk_key(apex, ch_from, zij, i);
-		if (knot_lmdb_insert(txn, &key, &chunk)) {
-			journal_make_header(chunk.mv_data, ch_to);
-			serialize_chunk(ser, chunk.mv_data + JOURNAL_HEADER_SIZE, chunk.mv_size - JOURNAL_HEADER_SIZE);
-		}
+		chunk_raw_write(txn, ser, &key, raw_size, ch_to);
 		free(key.mv_data);
 		i++;
 	}
@@ -49,7 +305,7 @@ static void journal_write_serialize(knot_lmdb_txn_t *txn, serialize_ctx_t *ser,
 	}
 }
 
-void journal_write_changeset(knot_lmdb_txn_t *txn, const changeset_t *ch)
+void journal_write_changeset(knot_lmdb_txn_t *txn, const changeset_t *ch, unsigned compression)
 {
 	serialize_ctx_t *ser = serialize_init(ch);
 	if (ser == NULL) {
@@ -57,30 +313,34 @@ void journal_write_changeset(knot_lmdb_txn_t *txn, const changeset_t *ch)
 		return;
 	}
 	if (ch->remove == NULL) {
-		journal_write_serialize(txn, ser, ch->soa_to->owner, true, 0, changeset_to(ch));
+		journal_write_serialize(txn, ser, ch->soa_to->owner, true, 0, changeset_to(ch),
+		                        compression);
 	} else {
-		journal_write_serialize(txn, ser, ch->soa_to->owner, false, changeset_from(ch), changeset_to(ch));
+		journal_write_serialize(txn, ser, ch->soa_to->owner, false, changeset_from(ch),
+		                        changeset_to(ch), compression);
 	}
 }
 
-void journal_write_zone(knot_lmdb_txn_t *txn, const zone_contents_t *z)
+void journal_write_zone(knot_lmdb_txn_t *txn, const zone_contents_t *z, unsigned compression)
 {
 	serialize_ctx_t *ser = serialize_zone_init(z);
 	if (ser == NULL) {
 		txn->ret = KNOT_ENOMEM;
 		return;
 	}
-	journal_write_serialize(txn, ser, z->apex->owner, true, 0, zone_contents_serial(z));
+	journal_write_serialize(txn, ser, z->apex->owner, true, 0, zone_contents_serial(z),
+	                        compression);
 }
 
-void journal_write_zone_diff(knot_lmdb_txn_t *txn, const zone_diff_t *z)
+void journal_write_zone_diff(knot_lmdb_txn_t *txn, const zone_diff_t *z, unsigned compression)
 {
 	serialize_ctx_t *ser = serialize_zone_diff_init(z);
 	if (ser == NULL) {
 		txn->ret = KNOT_ENOMEM;
 		return;
 	}
-	journal_write_serialize(txn, ser, z->apex->owner, false, zone_diff_from(z), zone_diff_to(z));
+	journal_write_serialize(txn, ser, z->apex->owner, false, zone_diff_from(z), zone_diff_to(z),
+	                        compression);
 }
 
 static bool delete_one(knot_lmdb_txn_t *txn, bool del_zij, uint32_t del_serial,
@@ -127,7 +387,7 @@ void journal_merge(zone_journal_t j, knot_lmdb_txn_t *txn, bool merge_zij,
 	delete_one(txn, merge_zij, merge_serial, j.zone, &del_freed, &del_next_serial);
 	assert(del_freed > 0 && del_next_serial == *original_serial_to);
 
-	journal_write_changeset(txn, &merge);
+	journal_write_changeset(txn, &merge, journal_conf_compression(j));
 	journal_read_clear_changeset(&merge);
 }
 
@@ -226,108 +486,193 @@ void journal_fix_occupation(zone_journal_t j, knot_lmdb_txn_t *txn, journal_meta
 	}
 }
 
-int journal_insert_zone(zone_journal_t j, const zone_contents_t *z)
+typedef struct {
+	zone_journal_t j;
+	const zone_contents_t *z;
+	const changeset_t *ch;
+	const changeset_t *extra;
+	const zone_diff_t *zdiff;
+	journal_chunks_t chunks;
+	journal_chunks_t extra_chunks;
+	unsigned compression;
+	size_t ch_size;
+	size_t extra_size;
+	size_t max_usage;
+	size_t max_changesets;
+} insert_ctx_t;
+
+static void insert_zone_txn(knot_lmdb_txn_t *txn, void *ctx)
 {
-	changeset_t fake_ch = { .add = (zone_contents_t *)z };
-	size_t ch_size = changeset_serialized_size(&fake_ch);
-	size_t max_usage = journal_conf_max_usage(j);
-	if (ch_size >= max_usage) {
-		return KNOT_ESPACE;
-	}
-	int ret = knot_lmdb_open(j.db);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-	knot_lmdb_txn_t txn = { 0 };
-	knot_lmdb_begin(j.db, &txn, true);
+	insert_ctx_t *c = ctx;
+	zone_journal_t j = c->j;
 
-	update_last_inserter(&txn, j.zone);
-	journal_del_zone_txn(&txn, j.zone);
+	update_last_inserter(txn, j.zone);
+	journal_del_zone_txn(txn, j.zone);
 
-	journal_write_zone(&txn, z);
+	if (c->chunks.complete) {
+		journal_write_chunks(txn, &c->chunks, j.zone, true, 0);
+	} else {
+		journal_write_zone(txn, c->z, c->compression);
+	}
 
 	journal_metadata_t md = { 0 };
 	md.flags = JOURNAL_SERIAL_TO_VALID;
-	md.serial_to = zone_contents_serial(z);
+	md.serial_to = zone_contents_serial(c->z);
 	md.first_serial = md.serial_to;
-	journal_store_metadata(&txn, j.zone, &md);
-
-	knot_lmdb_commit(&txn);
-	return txn.ret;
+	journal_store_metadata(txn, j.zone, &md);
 }
 
-int journal_insert(zone_journal_t j, const changeset_t *ch, const changeset_t *extra,
-                   const zone_diff_t *zdiff)
+int journal_insert_zone(zone_journal_t j, const zone_contents_t *z)
 {
-	assert(zdiff == NULL || (ch == NULL && extra == NULL));
-
-	size_t ch_size = zdiff == NULL ? changeset_serialized_size(ch) :
-	                                 zone_diff_serialized_size(*zdiff);
-	size_t max_usage = journal_conf_max_usage(j);
-	if (ch_size >= max_usage) {
-		return KNOT_ESPACE;
+	insert_ctx_t ctx = {
+		.j = j,
+		.z = z,
+		.compression = journal_conf_compression(j),
+		.max_usage = journal_conf_max_usage(j),
+	};
+	if (ctx.compression == JOURNAL_COMPRESSION_ZSTD) {
+		// The stored size is known only after the compression.
+		int ret = chunks_prepare(serialize_zone_init(z), zone_contents_serial(z), &ctx.chunks);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		ctx.ch_size = ctx.chunks.size;
+	} else {
+		changeset_t fake_ch = { .add = (zone_contents_t *)z };
+		ctx.ch_size = changeset_serialized_size(&fake_ch);
+	}
+	int ret = KNOT_ESPACE;
+	if (ctx.ch_size < ctx.max_usage) {
+		ret = knot_lmdb_open(j.db);
+	}
+	if (ret == KNOT_EOK) {
+		ret = knot_lmdb_group_run(j.db, insert_zone_txn, &ctx);
 	}
+	journal_chunks_free(&ctx.chunks);
+	return ret;
+}
 
+static void insert_txn(knot_lmdb_txn_t *txn, void *ctx)
+{
+	insert_ctx_t *c = ctx;
+	zone_journal_t j = c->j;
+	const changeset_t *ch = c->ch, *extra = c->extra;
+	const zone_diff_t *zdiff = c->zdiff;
 	uint32_t ch_from = zdiff == NULL ? changeset_from(ch) : zone_diff_from(zdiff);
 	uint32_t ch_to = zdiff == NULL ? changeset_to(ch) : zone_diff_to(zdiff);
-	if (extra != NULL && (changeset_to(extra) != ch_to ||
-	     changeset_from(extra) == ch_from)) {
-		return KNOT_EINVAL;
-	}
-	int ret = knot_lmdb_open(j.db);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-	knot_lmdb_txn_t txn = { 0 };
+	size_t ch_size = c->ch_size;
+
 	journal_metadata_t md = { 0 };
-	knot_lmdb_begin(j.db, &txn, true);
-	journal_load_metadata(&txn, j.zone, &md);
+	journal_load_metadata(txn, j.zone, &md);
 
-	update_last_inserter(&txn, j.zone);
+	update_last_inserter(txn, j.zone);
 
 	if (extra != NULL) {
-		if (journal_contains(&txn, true, 0, j.zone)) {
-			txn.ret = KNOT_ESEMCHECK;
+		if (journal_contains(txn, true, 0, j.zone)) {
+			txn->ret = KNOT_ESEMCHECK;
 		}
 		uint64_t merged_freed = 0;
-		delete_merged(&txn, j.zone, &md, &merged_freed);
-		ch_size += changeset_serialized_size(extra);
+		delete_merged(txn, j.zone, &md, &merged_freed);
+		ch_size += c->extra_size;
 		ch_size -= merged_freed;
 		md.flushed_upto = md.serial_to; // set temporarily
 		md.flags |= JOURNAL_LAST_FLUSHED_VALID;
 	}
 
-	size_t chs_limit = journal_conf_max_changesets(j);
-	journal_fix_occupation(j, &txn, &md, max_usage - ch_size, chs_limit - 1);
+	journal_fix_occupation(j, txn, &md, c->max_usage - ch_size, c->max_changesets - 1);
 
 	// avoid discontinuity
 	if ((md.flags & JOURNAL_SERIAL_TO_VALID) && md.serial_to != ch_from) {
-		if (journal_contains(&txn, true, 0, j.zone)) {
-			txn.ret = KNOT_ESEMCHECK;
+		if (journal_contains(txn, true, 0, j.zone)) {
+			txn->ret = KNOT_ESEMCHECK;
 		} else {
-			journal_del_zone_txn(&txn, j.zone);
+			journal_del_zone_txn(txn, j.zone);
 			memset(&md, 0, sizeof(md));
 		}
 	}
 
 	// avoid cycle
-	if (journal_contains(&txn, false, ch_to, j.zone)) {
-		journal_fix_occupation(j, &txn, &md, INT64_MAX, 1);
+	if (journal_contains(txn, false, ch_to, j.zone)) {
+		journal_fix_occupation(j, txn, &md, INT64_MAX, 1);
 	}
 
-	if (zdiff == NULL) {
-		journal_write_changeset(&txn, ch);
+	if (c->chunks.complete) {
+		bool zij = (zdiff == NULL && ch->remove == NULL);
+		journal_write_chunks(txn, &c->chunks, j.zone, zij, zij ? 0 : ch_from);
+	} else if (zdiff == NULL) {
+		journal_write_changeset(txn, ch, c->compression);
 	} else {
-		journal_write_zone_diff(&txn, zdiff);
+		journal_write_zone_diff(txn, zdiff, c->compression);
 	}
 	journal_metadata_after_insert(&md, ch_from, ch_to);
 
 	if (extra != NULL) {
-		journal_write_changeset(&txn, extra);
+		if (c->extra_chunks.complete) {
+			bool zij = (extra->remove == NULL);
+			journal_write_chunks(txn, &c->extra_chunks, j.zone, zij,
+			                     zij ? 0 : changeset_from(extra));
+		} else {
+			journal_write_changeset(txn, extra, c->compression);
+		}
 		journal_metadata_after_extra(&md, changeset_from(extra), changeset_to(extra));
 	}
 
-	journal_store_metadata(&txn, j.zone, &md);
-	knot_lmdb_commit(&txn);
-	return txn.ret;
+	journal_store_metadata(txn, j.zone, &md);
+}
+
+int journal_insert(zone_journal_t j, const changeset_t *ch, const changeset_t *extra,
+                   const zone_diff_t *zdiff)
+{
+	assert(zdiff == NULL || (ch == NULL && extra == NULL));
+
+	uint32_t ch_from = zdiff == NULL ? changeset_from(ch) : zone_diff_from(zdiff);
+	uint32_t ch_to = zdiff == NULL ? changeset_to(ch) : zone_diff_to(zdiff);
+	if (extra != NULL && (changeset_to(extra) != ch_to ||
+	     changeset_from(extra) == ch_from)) {
+		return KNOT_EINVAL;
+	}
+
+	insert_ctx_t ctx = {
+		.j = j,
+		.ch = ch,
+		.extra = extra,
+		.zdiff = zdiff,
+		.compression = journal_conf_compression(j),
+		.max_usage = journal_conf_max_usage(j),
+		.max_changesets = journal_conf_max_changesets(j),
+	};
+	int ret;
+	if (ctx.compression == JOURNAL_COMPRESSION_ZSTD) {
+		// The stored sizes are known only after the compression.
+		ret = chunks_prepare(zdiff == NULL ? serialize_init(ch) :
+		                                     serialize_zone_diff_init(zdiff),
+		                     ch_to, &ctx.chunks);
+		if (ret == KNOT_EOK && extra != NULL) {
+			ret = chunks_prepare(serialize_init(extra), changeset_to(extra),
+			                     &ctx.extra_chunks);
+		}
+		if (ret != KNOT_EOK) {
+			goto done;
+		}
+		ctx.ch_size = ctx.chunks.size;
+		ctx.extra_size = ctx.extra_chunks.size;
+	} else {
+		ctx.ch_size = zdiff == NULL ? changeset_serialized_size(ch) :
+		                              zone_diff_serialized_size(*zdiff);
+		ctx.extra_size = changeset_serialized_size(extra);
+	}
+
+	if (ctx.ch_size >= ctx.max_usage) {
+		ret = KNOT_ESPACE;
+		goto done;
+	}
+
+	ret = knot_lmdb_open(j.db);
+	if (ret == KNOT_EOK) {
+		ret = knot_lmdb_group_run(j.db, insert_txn, &ctx);
+	}
+done:
+	journal_chunks_free(&ctx.chunks);
+	journal_chunks_free(&ctx.extra_chunks);
+	return ret;
 }
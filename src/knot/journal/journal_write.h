@@ -23,18 +23,20 @@
 /*!
  * \brief Serialize a changeset into chunks and write it into DB with no checks and metadata update.
  *
- * \param txn   Journal DB transaction.
- * \param ch    Changeset to be written.
+ * \param txn           Journal DB transaction.
+ * \param ch            Changeset to be written.
+ * \param compression   Compression of the chunks (JOURNAL_COMPRESSION_*).
  */
-void journal_write_changeset(knot_lmdb_txn_t *txn, const changeset_t *ch);
+void journal_write_changeset(knot_lmdb_txn_t *txn, const changeset_t *ch, unsigned compression);
 
 /*!
  * \brief Serialize zone contents aka "bootstrap" changeset into journal, no checks.
  *
- * \param txn   Journal DB transaction.
- * \param z     Zone contents to be written.
+ * \param txn           Journal DB transaction.
+ * \param z             Zone contents to be written.
+ * \param compression   Compression of the chunks (JOURNAL_COMPRESSION_*).
  */
-void journal_write_zone(knot_lmdb_txn_t *txn, const zone_contents_t *z);
+void journal_write_zone(knot_lmdb_txn_t *txn, const zone_contents_t *z, unsigned compression);
 
 /*!
  * \brief Merge all following changeset into one of journal changeset.
@@ -14,16 +14,19 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h> // snprintf
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "knot/journal/knot_lmdb.h"
 
 #include "knot/conf/conf.h"
 #include "contrib/files.h"
+#include "contrib/time.h"
 #include "contrib/wire_ctx.h"
 #include "libknot/dname.h"
 #include "libknot/endian.h"
@@ -81,6 +84,11 @@ void knot_lmdb_init(knot_lmdb_db_t *db, const char *path, size_t mapsize, unsign
 	pthread_mutex_init(&db->opening_mutex, NULL);
 	db->maxdbs = 2;
 	db->maxreaders = conf_lmdb_readers(conf());
+	db->group_commit_ms = 0;
+	pthread_mutex_init(&db->group_mutex, NULL);
+	pthread_cond_init(&db->group_cond, NULL);
+	db->group_queue = NULL;
+	db->group_leader = false;
 }
 
 static int lmdb_stat(const char *lmdb_path, struct stat *st)
@@ -274,12 +282,14 @@ void knot_lmdb_deinit(knot_lmdb_db_t *db)
 {
 	knot_lmdb_close(db);
 	pthread_mutex_destroy(&db->opening_mutex);
+	pthread_mutex_destroy(&db->group_mutex);
+	pthread_cond_destroy(&db->group_cond);
 	free(db->path);
 }
 
-void knot_lmdb_begin(knot_lmdb_db_t *db, knot_lmdb_txn_t *txn, bool rw)
+static void txn_begin(knot_lmdb_db_t *db, MDB_txn *parent, knot_lmdb_txn_t *txn, bool rw)
 {
-	txn->ret = mdb_txn_begin(db->env, NULL, rw ? 0 : MDB_RDONLY, &txn->txn);
+	txn->ret = mdb_txn_begin(db->env, parent, rw ? 0 : MDB_RDONLY, &txn->txn);
 	err_to_knot(&txn->ret);
 	if (txn->ret == KNOT_EOK) {
 		txn->opened = true;
@@ -288,6 +298,11 @@ void knot_lmdb_begin(knot_lmdb_db_t *db, knot_lmdb_txn_t *txn, bool rw)
 	}
 }
 
+void knot_lmdb_begin(knot_lmdb_db_t *db, knot_lmdb_txn_t *txn, bool rw)
+{
+	txn_begin(db, NULL, txn, rw);
+}
+
 void knot_lmdb_abort(knot_lmdb_txn_t *txn)
 {
 	if (txn->opened) {
@@ -326,6 +341,124 @@ void knot_lmdb_commit(knot_lmdb_txn_t *txn)
 	txn->opened = false;
 }
 
+/*! \brief Write transaction waiting to be run in a group. */
+typedef struct knot_lmdb_group_req {
+	knot_lmdb_group_cb_t cb;
+	void *ctx;
+	struct knot_lmdb_group_req *next;
+	int ret;
+	bool done;
+} knot_lmdb_group_req_t;
+
+/*! \brief Run the transaction body and finish the transaction unless done by the body. */
+static int txn_run(knot_lmdb_txn_t *txn, knot_lmdb_group_cb_t cb, void *ctx)
+{
+	if (txn->opened) {
+		cb(txn, ctx);
+	}
+	if (txn->opened) {
+		knot_lmdb_commit(txn);
+	}
+	return txn->ret;
+}
+
+/*! \brief Take the queued requests in the order of arrival. */
+static knot_lmdb_group_req_t *group_take(knot_lmdb_db_t *db)
+{
+	knot_lmdb_group_req_t *reqs = NULL;
+	while (db->group_queue != NULL) {
+		knot_lmdb_group_req_t *req = db->group_queue;
+		db->group_queue = req->next;
+		req->next = reqs;
+		reqs = req;
+	}
+	return reqs;
+}
+
+/*!
+ * \brief Run the queued requests in one group transaction and commit it.
+ *
+ * \note Called and returns with group_mutex locked, unlocked meanwhile.
+ */
+static void group_lead(knot_lmdb_db_t *db)
+{
+	knot_lmdb_group_req_t *reqs = group_take(db), *done = NULL;
+	pthread_mutex_unlock(&db->group_mutex);
+
+	// waiting for the LMDB writer lock, possibly held by a standalone writer
+	MDB_txn *group_txn = NULL;
+	int ret = mdb_txn_begin(db->env, NULL, 0, &group_txn);
+	err_to_knot(&ret);
+
+	// run the requests arriving meanwhile until the deadline, a lone one isn't delayed
+	struct timespec begin = time_now();
+	while (reqs != NULL) {
+		while (reqs != NULL) {
+			knot_lmdb_group_req_t *req = reqs;
+			reqs = req->next;
+			if (ret == KNOT_EOK) {
+				knot_lmdb_txn_t txn = { 0 };
+				txn_begin(db, group_txn, &txn, true);
+				req->ret = txn_run(&txn, req->cb, req->ctx);
+			} else {
+				req->ret = ret;
+			}
+			req->next = done;
+			done = req;
+		}
+
+		struct timespec now = time_now();
+		if (ret == KNOT_EOK && time_diff_ms(&begin, &now) < db->group_commit_ms) {
+			pthread_mutex_lock(&db->group_mutex);
+			reqs = group_take(db);
+			pthread_mutex_unlock(&db->group_mutex);
+		}
+	}
+
+	if (ret == KNOT_EOK) {
+		ret = mdb_txn_commit(group_txn);
+		err_to_knot(&ret);
+	}
+
+	pthread_mutex_lock(&db->group_mutex);
+	for (knot_lmdb_group_req_t *req = done; req != NULL; req = req->next) {
+		if (ret != KNOT_EOK) { // nothing stored
+			req->ret = ret;
+		}
+		req->done = true;
+	}
+	db->group_leader = false;
+	pthread_cond_broadcast(&db->group_cond);
+}
+
+int knot_lmdb_group_run(knot_lmdb_db_t *db, knot_lmdb_group_cb_t cb, void *ctx)
+{
+	// nested transactions not possible with MDB_WRITEMAP, no sync to share with MDB_NOSYNC
+	if (db->group_commit_ms == 0 ||
+	    (db->env_flags & (MDB_WRITEMAP | MDB_NOSYNC | MDB_RDONLY))) {
+		knot_lmdb_txn_t txn = { 0 };
+		knot_lmdb_begin(db, &txn, true);
+		return txn_run(&txn, cb, ctx);
+	}
+
+	knot_lmdb_group_req_t req = { .cb = cb, .ctx = ctx };
+
+	pthread_mutex_lock(&db->group_mutex);
+	req.next = db->group_queue;
+	db->group_queue = &req;
+	while (!req.done) {
+		if (!db->group_leader) {
+			db->group_leader = true;
+			group_lead(db);
+		} else {
+			pthread_cond_wait(&db->group_cond, &db->group_mutex);
+		}
+	}
+	pthread_mutex_unlock(&db->group_mutex);
+
+	return req.ret;
+}
+
 // save the programmer's frequent checking for ENOMEM when creating search keys
 static bool txn_enomem(knot_lmdb_txn_t *txn, const MDB_val *tocheck)
 {
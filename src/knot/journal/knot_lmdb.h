@@ -23,6 +23,8 @@
 #include <stdlib.h>
 #include <pthread.h>
 
+struct knot_lmdb_group_req;
+
 typedef struct knot_lmdb_db {
 	MDB_dbi dbi;
 	MDB_env *env;
@@ -31,6 +33,13 @@ typedef struct knot_lmdb_db {
 	// those are static options. Set them after knot_lmdb_init().
 	unsigned maxdbs;
 	unsigned maxreaders;
+	unsigned group_commit_ms; // see knot_lmdb_group_run(), 0 disables grouping
+
+	// group commit state, guarded by group_mutex
+	pthread_mutex_t group_mutex;
+	pthread_cond_t group_cond;
+	struct knot_lmdb_group_req *group_queue; // transactions waiting to be run
+	bool group_leader;                       // a thread is running a group
 
 	// those are internal options. Please don't touch them directly.
 	size_t mapsize;
@@ -51,6 +60,9 @@ typedef struct {
 	knot_lmdb_db_t *db;
 } knot_lmdb_txn_t;
 
+/*! \brief Body of a read-write transaction, see knot_lmdb_group_run(). */
+typedef void (*knot_lmdb_group_cb_t)(knot_lmdb_txn_t *txn, void *ctx);
+
 typedef enum {
 	KNOT_LMDB_EXACT = 3,   /*! \brief Search for exactly matching key. */
 	KNOT_LMDB_LEQ = 1,     /*! \brief Search lexicographically lower or equal key. */
@@ -172,6 +184,35 @@ inline static bool knot_lmdb_is_open(knot_lmdb_db_t *db) { return db != NULL &&
  */
 void knot_lmdb_begin(knot_lmdb_db_t *db, knot_lmdb_txn_t *txn, bool rw);
 
+/*!
+ * \brief Run a read-write DB transaction committed together with concurrent ones.
+ *
+ * The transaction bodies of threads writing to the same DB at the same time
+ * are run by one of these threads, the group leader, each in a transaction
+ * nested in one group transaction. After the bodies queued so far, the leader
+ * runs those queued meanwhile, but no longer than db->group_commit_ms, and
+ * commits the group transaction to disk at once. The function returns once
+ * the group is committed, so the changes are as durable as with
+ * knot_lmdb_begin(). Failure of one body doesn't affect the others.
+ *
+ * All the LMDB calls of a group are made by the leader thread, as an LMDB
+ * write transaction may only be used by the thread which started it.
+ *
+ * The body gets an opened transaction. It may commit or abort it, otherwise
+ * the transaction is committed (aborted if txn->ret is set) after the body.
+ *
+ * \note The body runs in a standalone transaction if grouping is disabled or
+ *       not supported by the DB flags (MDB_WRITEMAP, MDB_NOSYNC).
+ * \note The body must not start another transaction on the same DB.
+ *
+ * \param db    The database.
+ * \param cb    Transaction body.
+ * \param ctx   Context passed to the body.
+ *
+ * \return KNOT_E* (txn->ret set by the body or an error of the group commit)
+ */
+int knot_lmdb_group_run(knot_lmdb_db_t *db, knot_lmdb_group_cb_t cb, void *ctx);
+
 /*!
  * \brief Abort a transaction.
  *
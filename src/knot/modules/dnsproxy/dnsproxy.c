@@ -17,6 +17,7 @@
 #include "contrib/net.h"
 #include "knot/include/module.h"
 #include "knot/conf/schema.h"
+#include "knot/modules/dnsproxy/inflight.h"
 #include "knot/query/capture.h" // Forces static module!
 #include "knot/query/requestor.h" // Forces static module!
 
@@ -26,6 +27,7 @@
 #define MOD_TIMEOUT		"\x07""timeout"
 #define MOD_FALLBACK		"\x08""fallback"
 #define MOD_CATCH_NXDOMAIN	"\x0E""catch-nxdomain"
+#define MOD_ASYNC		"\x05""async"
 
 const yp_item_t dnsproxy_conf[] = {
 	{ MOD_REMOTE,         YP_TREF,  YP_VREF = { C_RMT }, YP_FNONE,
@@ -35,6 +37,7 @@ const yp_item_t dnsproxy_conf[] = {
 	{ MOD_FALLBACK,       YP_TBOOL, YP_VBOOL = { true } },
 	{ MOD_TCP_FASTOPEN,   YP_TBOOL, YP_VNONE },
 	{ MOD_CATCH_NXDOMAIN, YP_TBOOL, YP_VNONE },
+	{ MOD_ASYNC,          YP_TBOOL, YP_VNONE },
 	{ NULL }
 };
 
@@ -57,8 +60,19 @@ typedef struct {
 	bool tfo;
 	bool catch_nxdomain;
 	int timeout;
+	inflight_t *inflight;
 } dnsproxy_t;
 
+/*! \brief Checks if the query can be answered by the completion thread. */
+static bool forward_async(dnsproxy_t *proxy, knotd_qdata_t *qdata)
+{
+	const knotd_qdata_params_t *params = qdata->params;
+	return proxy->inflight != NULL &&
+	       params->proto == KNOTD_QUERY_PROTO_UDP &&
+	       params->xdp_msg == NULL &&
+	       !(params->flags & KNOTD_QUERY_FLAG_PROXIED);
+}
+
 static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
                                   knotd_qdata_t *qdata, knotd_mod_t *mod)
 {
@@ -66,6 +80,11 @@ static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
 
 	dnsproxy_t *proxy = knotd_mod_ctx(mod);
 
+	/* Don't forward queries whose answer has been dropped (e.g. by RRL). */
+	if (state == KNOTD_STATE_NOOP) {
+		return state;
+	}
+
 	/* Forward only queries ending with REFUSED (no zone) or NXDOMAIN (if configured) */
 	if (proxy->fallback && !(qdata->rcode == KNOT_RCODE_REFUSED ||
 	     (qdata->rcode == KNOT_RCODE_NXDOMAIN && proxy->catch_nxdomain))) {
@@ -86,6 +105,14 @@ static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
 		                 qdata->query->max_size, qdata->query->tsig_rr);
 	}
 
+	/* Forward asynchronously, the response is sent by the completion thread. */
+	if (forward_async(proxy, qdata) &&
+	    inflight_submit(proxy->inflight, qdata->params->thread_id, qdata->query,
+	                    qdata->params->socket, qdata->params->remote,
+	                    qdata->params->local) == KNOT_EOK) {
+		return KNOTD_STATE_NOOP;
+	}
+
 	/* Capture layer context. */
 	const knot_layer_api_t *capture = query_capture_api();
 	struct capture_param capture_param = {
@@ -169,6 +196,17 @@ int dnsproxy_load(knotd_mod_t *mod)
 	conf = knotd_conf_mod(mod, MOD_CATCH_NXDOMAIN);
 	proxy->catch_nxdomain = conf.single.boolean;
 
+	conf = knotd_conf_mod(mod, MOD_ASYNC);
+	if (conf.single.boolean) {
+		proxy->inflight = inflight_new(&proxy->remote, &proxy->via,
+		                               knotd_mod_threads(mod), proxy->timeout);
+		if (proxy->inflight == NULL) {
+			knotd_conf_free(&proxy->addr);
+			free(proxy);
+			return KNOT_ENOMEM;
+		}
+	}
+
 	knotd_mod_ctx_set(mod, proxy);
 
 	if (proxy->fallback) {
@@ -182,6 +220,7 @@ void dnsproxy_unload(knotd_mod_t *mod)
 {
 	dnsproxy_t *ctx = knotd_mod_ctx(mod);
 	if (ctx != NULL) {
+		inflight_free(ctx->inflight);
 		knotd_conf_free(&ctx->addr);
 	}
 	free(ctx);
@@ -0,0 +1,486 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "knot/modules/dnsproxy/inflight.h"
+#include "libdnssec/random.h"
+#include "libknot/errcode.h"
+#include "libknot/packet/wire.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "contrib/time.h"
+
+/*! Number of in-flight queries per worker thread (power of two). */
+#define FLIGHT_SLOTS		1024
+#define FLIGHT_SLOT_MASK	(FLIGHT_SLOTS - 1)
+
+/*! Upstream sockets (source ports) per worker thread. */
+#define FLIGHT_SOCKETS		8
+
+/*! Number of queries sent from one socket before it's replaced. */
+#define FLIGHT_SOCKET_USES	4096
+
+/*! Maximum period of the timeout checks and socket replacements. */
+#define FLIGHT_SWEEP_MS		50
+
+typedef struct {
+	struct sockaddr_storage client;
+	struct sockaddr_storage local;  //!< AF_UNSPEC if unknown.
+	uint64_t deadline;              //!< Query timeout (ms).
+	int fd;                         //!< Client socket.
+	bool active;
+	uint8_t sock;                   //!< Upstream socket index.
+	uint16_t id;                    //!< Upstream message ID.
+	uint16_t client_id;             //!< Original message ID.
+	uint8_t flags1;                 //!< Original OPCODE and RD.
+	uint16_t qsize;
+	uint8_t question[KNOT_DNAME_MAXLEN + 2 * sizeof(uint16_t)];
+} flight_t;
+
+typedef struct {
+	int fd;                         //!< Connected upstream socket or -1.
+	unsigned sent;                  //!< Queries sent since the socket was opened.
+	unsigned pending;               //!< In-flight queries sent from the socket.
+} flight_sock_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	flight_sock_t socks[FLIGHT_SOCKETS];
+	unsigned next;                  //!< Free slot search hint.
+	uint16_t ids[UINT16_MAX + 1];   //!< Message ID to slot index + 1 (0 if unused).
+	flight_t slots[FLIGHT_SLOTS];
+} flight_table_t;
+
+struct inflight {
+	struct sockaddr_storage remote;
+	struct sockaddr_storage via;    //!< AF_UNSPEC if any.
+	int timeout;
+	int notify[2];                  //!< Completion thread wakeup pipe.
+	bool running;
+	pthread_t thread;
+	unsigned tables_count;
+	flight_table_t *tables;
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+};
+
+/*! \brief Monotonic time in milliseconds. */
+static uint64_t time_ms(void)
+{
+	struct timespec now = time_now();
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*! \brief Sends a message to the client from the local address of the query. */
+static void send_client(const flight_t *f, const uint8_t *wire, size_t len)
+{
+	struct iovec iov = { .iov_base = (void *)wire, .iov_len = len };
+	struct msghdr msg = {
+		.msg_name = (void *)&f->client,
+		.msg_namelen = sockaddr_len(&f->client),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+
+	union {
+		struct cmsghdr cmsg;
+		uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+	} cmsg = { 0 };
+
+#if defined(IP_PKTINFO)
+	if (f->local.ss_family == AF_INET && f->client.ss_family == AF_INET) {
+		msg.msg_control = cmsg.buf;
+		msg.msg_controllen = CMSG_SPACE(sizeof(struct in_pktinfo));
+		struct cmsghdr *hdr = CMSG_FIRSTHDR(&msg);
+		hdr->cmsg_level = IPPROTO_IP;
+		hdr->cmsg_type = IP_PKTINFO;
+		hdr->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+		struct in_pktinfo *info = (struct in_pktinfo *)CMSG_DATA(hdr);
+		info->ipi_spec_dst = ((const struct sockaddr_in *)&f->local)->sin_addr;
+	}
+#endif
+	if (f->local.ss_family == AF_INET6 && f->client.ss_family == AF_INET6) {
+		msg.msg_control = cmsg.buf;
+		msg.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
+		struct cmsghdr *hdr = CMSG_FIRSTHDR(&msg);
+		hdr->cmsg_level = IPPROTO_IPV6;
+		hdr->cmsg_type = IPV6_PKTINFO;
+		hdr->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+		struct in6_pktinfo *info = (struct in6_pktinfo *)CMSG_DATA(hdr);
+		info->ipi6_addr = ((const struct sockaddr_in6 *)&f->local)->sin6_addr;
+	}
+
+	(void)sendmsg(f->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/*! \brief Answers SERVFAIL with the original question. */
+static void send_servfail(const flight_t *f)
+{
+	uint8_t wire[KNOT_WIRE_HEADER_SIZE + sizeof(f->question)] = { 0 };
+
+	knot_wire_set_id(wire, f->client_id);
+	knot_wire_set_flags1(wire, f->flags1);
+	knot_wire_set_qr(wire);
+	knot_wire_set_rcode(wire, KNOT_RCODE_SERVFAIL);
+	knot_wire_set_qdcount(wire, 1);
+	memcpy(wire + KNOT_WIRE_HEADER_SIZE, f->question, f->qsize);
+
+	send_client(f, wire, KNOT_WIRE_HEADER_SIZE + f->qsize);
+}
+
+/*! \brief Checks that the response question matches the forwarded one. */
+static bool question_match(const flight_t *f, const uint8_t *wire, size_t len)
+{
+	if (len < KNOT_WIRE_HEADER_SIZE + f->qsize || knot_wire_get_qdcount(wire) != 1) {
+		return false;
+	}
+
+	const uint8_t *question = wire + KNOT_WIRE_HEADER_SIZE;
+	size_t qname_size = f->qsize - 2 * sizeof(uint16_t);
+	if (knot_dname_size(question) != qname_size ||
+	    !knot_dname_is_equal(question, f->question)) {
+		return false;
+	}
+
+	return memcmp(question + qname_size, f->question + qname_size,
+	              2 * sizeof(uint16_t)) == 0;
+}
+
+/*! \brief Releases an in-flight slot, the table must be locked. */
+static void slot_release(flight_table_t *table, flight_t *slot)
+{
+	assert(slot->active);
+	slot->active = false;
+	table->ids[slot->id] = 0;
+	table->socks[slot->sock].pending--;
+}
+
+static void table_recv(inflight_t *ctx, flight_table_t *table, unsigned sock)
+{
+	// Only the completion thread replaces the sockets.
+	int fd = table->socks[sock].fd;
+
+	ssize_t len;
+	while ((len = recv(fd, ctx->buf, sizeof(ctx->buf), MSG_DONTWAIT)) > 0) {
+		if (len < KNOT_WIRE_HEADER_SIZE || !knot_wire_get_qr(ctx->buf)) {
+			continue;
+		}
+
+		uint16_t id = knot_wire_get_id(ctx->buf);
+		flight_t f;
+
+		pthread_mutex_lock(&table->lock);
+		unsigned idx = table->ids[id];
+		flight_t *slot = (idx > 0) ? &table->slots[idx - 1] : NULL;
+		bool match = slot != NULL && slot->active && slot->id == id &&
+		             slot->sock == sock && question_match(slot, ctx->buf, len);
+		if (match) {
+			f = *slot;
+			slot_release(table, slot);
+		}
+		pthread_mutex_unlock(&table->lock);
+
+		if (match) {
+			knot_wire_set_id(ctx->buf, f.client_id);
+			send_client(&f, ctx->buf, len);
+		}
+	}
+}
+
+static void table_expire(flight_table_t *table, uint64_t now)
+{
+	pthread_mutex_lock(&table->lock);
+	for (unsigned i = 0; i < FLIGHT_SLOTS; i++) {
+		flight_t *slot = &table->slots[i];
+		if (slot->active && slot->deadline <= now) {
+			slot_release(table, slot);
+			send_servfail(slot);
+		}
+	}
+	pthread_mutex_unlock(&table->lock);
+}
+
+static int sock_open(const inflight_t *ctx)
+{
+	// Each socket gets a random ephemeral source port.
+	return net_connected_socket(SOCK_DGRAM, &ctx->remote,
+	                            ctx->via.ss_family == AF_UNSPEC ? NULL : &ctx->via,
+	                            false);
+}
+
+/*!
+ * \brief Replaces the used up sockets with new ones (new source ports).
+ *
+ * A socket is replaced only after its in-flight queries are completed.
+ */
+static void table_rotate(const inflight_t *ctx, flight_table_t *table,
+                         struct pollfd *fds)
+{
+	pthread_mutex_lock(&table->lock);
+	for (unsigned i = 0; i < FLIGHT_SOCKETS; i++) {
+		flight_sock_t *sock = &table->socks[i];
+		if (sock->pending > 0 || (sock->fd >= 0 && sock->sent < FLIGHT_SOCKET_USES)) {
+			continue;
+		}
+		if (sock->fd >= 0) {
+			close(sock->fd);
+		}
+		sock->fd = sock_open(ctx); // Retried in the next sweep if failed.
+		sock->sent = 0;
+		fds[i].fd = sock->fd;
+	}
+	pthread_mutex_unlock(&table->lock);
+}
+
+static void *inflight_run(void *arg)
+{
+	inflight_t *ctx = arg;
+
+	const unsigned nfds = 1 + ctx->tables_count * FLIGHT_SOCKETS;
+	struct pollfd *fds = calloc(nfds, sizeof(*fds));
+	if (fds == NULL) {
+		return NULL;
+	}
+	fds[0].fd = ctx->notify[0];
+	fds[0].events = POLLIN;
+	for (unsigned i = 0; i < ctx->tables_count; i++) {
+		for (unsigned j = 0; j < FLIGHT_SOCKETS; j++) {
+			struct pollfd *pfd = &fds[1 + i * FLIGHT_SOCKETS + j];
+			pfd->fd = ctx->tables[i].socks[j].fd;
+			pfd->events = POLLIN;
+		}
+	}
+
+	uint64_t next_sweep = time_ms() + FLIGHT_SWEEP_MS;
+	while (true) {
+		uint64_t now = time_ms();
+		int timeout = next_sweep > now ? next_sweep - now : 0;
+		if (poll(fds, nfds, timeout) < 0 && errno != EINTR) {
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			break;
+		}
+
+		for (unsigned i = 1; i < nfds; i++) {
+			// Receiving also clears the pending errors (e.g. ICMP unreachable).
+			if (fds[i].revents & (POLLIN | POLLERR)) {
+				table_recv(ctx, &ctx->tables[(i - 1) / FLIGHT_SOCKETS],
+				           (i - 1) % FLIGHT_SOCKETS);
+			}
+		}
+
+		now = time_ms();
+		if (now >= next_sweep) {
+			for (unsigned i = 0; i < ctx->tables_count; i++) {
+				table_expire(&ctx->tables[i], now);
+				table_rotate(ctx, &ctx->tables[i],
+				             &fds[1 + i * FLIGHT_SOCKETS]);
+			}
+			next_sweep = now + FLIGHT_SWEEP_MS;
+		}
+	}
+
+	free(fds);
+	return NULL;
+}
+
+inflight_t *inflight_new(const struct sockaddr_storage *remote,
+                         const struct sockaddr_storage *via,
+                         unsigned threads, int timeout_ms)
+{
+	if (remote == NULL || threads == 0) {
+		return NULL;
+	}
+
+	inflight_t *ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return NULL;
+	}
+	memcpy(&ctx->remote, remote, sizeof(ctx->remote));
+	if (via != NULL) {
+		memcpy(&ctx->via, via, sizeof(ctx->via));
+	} else {
+		ctx->via.ss_family = AF_UNSPEC;
+	}
+	ctx->timeout = timeout_ms;
+	ctx->notify[0] = ctx->notify[1] = -1;
+
+	ctx->tables = calloc(threads, sizeof(*ctx->tables));
+	if (ctx->tables == NULL) {
+		inflight_free(ctx);
+		return NULL;
+	}
+	for (unsigned i = 0; i < threads; i++) {
+		flight_table_t *table = &ctx->tables[i];
+		pthread_mutex_init(&table->lock, NULL);
+		ctx->tables_count++;
+		for (unsigned j = 0; j < FLIGHT_SOCKETS; j++) {
+			table->socks[j].fd = sock_open(ctx);
+			if (table->socks[j].fd < 0) {
+				inflight_free(ctx);
+				return NULL;
+			}
+		}
+	}
+
+	if (pipe(ctx->notify) != 0 ||
+	    pthread_create(&ctx->thread, NULL, inflight_run, ctx) != 0) {
+		inflight_free(ctx);
+		return NULL;
+	}
+	ctx->running = true;
+
+	return ctx;
+}
+
+void inflight_free(inflight_t *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	if (ctx->running) {
+		uint8_t byte = 0;
+		ssize_t ret = write(ctx->notify[1], &byte, sizeof(byte));
+		(void)ret;
+		pthread_join(ctx->thread, NULL);
+	}
+	if (ctx->notify[0] >= 0) {
+		close(ctx->notify[0]);
+		close(ctx->notify[1]);
+	}
+
+	for (unsigned i = 0; i < ctx->tables_count; i++) {
+		flight_table_t *table = &ctx->tables[i];
+		for (unsigned j = 0; j < FLIGHT_SOCKETS; j++) {
+			if (table->socks[j].fd >= 0) {
+				close(table->socks[j].fd);
+			}
+		}
+		pthread_mutex_destroy(&table->lock);
+	}
+	free(ctx->tables);
+	free(ctx);
+}
+
+/*! \brief Picks a random usable socket, returns -1 if none. */
+static int sock_pick(flight_table_t *table)
+{
+	unsigned start = dnssec_random_uint16_t();
+	for (unsigned i = 0; i < FLIGHT_SOCKETS; i++) {
+		unsigned idx = (start + i) % FLIGHT_SOCKETS;
+		flight_sock_t *sock = &table->socks[idx];
+		if (sock->fd >= 0 && sock->sent < FLIGHT_SOCKET_USES) {
+			return idx;
+		}
+	}
+
+	return -1;
+}
+
+/*!
+ * \brief Finds a free slot with an unused random message ID.
+ *
+ * \return Slot or NULL if the table is full.
+ */
+static flight_t *slot_alloc(flight_table_t *table)
+{
+	for (unsigned i = 0; i < FLIGHT_SLOTS; i++) {
+		unsigned idx = (table->next + i) & FLIGHT_SLOT_MASK;
+		if (!table->slots[idx].active) {
+			table->next = idx + 1;
+			flight_t *slot = &table->slots[idx];
+			// At most FLIGHT_SLOTS of 65536 IDs are used, a free one is found soon.
+			do {
+				slot->id = dnssec_random_uint16_t();
+			} while (table->ids[slot->id] != 0);
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+int inflight_submit(inflight_t *ctx, unsigned thread_id, knot_pkt_t *query,
+                    int fd, const struct sockaddr_storage *client,
+                    const struct sockaddr_storage *local)
+{
+	if (ctx == NULL || query == NULL || client == NULL) {
+		return KNOT_EINVAL;
+	}
+	if (thread_id >= ctx->tables_count) {
+		return KNOT_ERANGE;
+	}
+
+	uint16_t qsize = knot_pkt_question_size(query);
+	if (qsize == 0 || qsize > sizeof(((flight_t *)NULL)->question)) {
+		return KNOT_EMALF;
+	}
+
+	flight_table_t *table = &ctx->tables[thread_id];
+	pthread_mutex_lock(&table->lock);
+
+	int sock = sock_pick(table);
+	flight_t *slot = (sock >= 0) ? slot_alloc(table) : NULL;
+	if (slot == NULL) {
+		pthread_mutex_unlock(&table->lock);
+		return KNOT_ESPACE;
+	}
+	slot->sock = sock;
+
+	memcpy(&slot->client, client, sockaddr_len(client));
+	if (local != NULL) {
+		memcpy(&slot->local, local, sockaddr_len(local));
+	} else {
+		slot->local.ss_family = AF_UNSPEC;
+	}
+	slot->fd = fd;
+	slot->client_id = knot_wire_get_id(query->wire);
+	slot->flags1 = knot_wire_get_flags1(query->wire) & (KNOT_WIRE_OPCODE_MASK |
+	                                                    KNOT_WIRE_RD_MASK);
+	slot->qsize = qsize;
+	memcpy(slot->question, query->wire + KNOT_WIRE_HEADER_SIZE, qsize);
+	slot->deadline = time_ms() + ctx->timeout;
+
+	// Forward with the slot message ID, keep the query unchanged.
+	knot_wire_set_id(query->wire, slot->id);
+	ssize_t ret = send(table->socks[sock].fd, query->wire, query->size,
+	                   MSG_DONTWAIT | MSG_NOSIGNAL);
+	knot_wire_set_id(query->wire, slot->client_id);
+
+	table->socks[sock].sent++;
+	if (ret != query->size) {
+		pthread_mutex_unlock(&table->lock);
+		return (ret < 0) ? knot_map_errno() : KNOT_ECONN;
+	}
+	slot->active = true;
+	table->ids[slot->id] = slot - table->slots + 1;
+	table->socks[sock].pending++;
+
+	pthread_mutex_unlock(&table->lock);
+
+	return KNOT_EOK;
+}
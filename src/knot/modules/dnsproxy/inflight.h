@@ -0,0 +1,72 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Asynchronous forwarding of UDP queries.
+ *
+ * Each worker thread has its own table of in-flight queries and its own
+ * set of UDP sockets connected to the upstream, each query is sent from
+ * a randomly chosen one with a random message ID. A single completion thread
+ * receives the upstream responses and relays them directly to the clients,
+ * or answers SERVFAIL if the upstream doesn't respond in time. It also
+ * replaces the sockets after a number of queries, so that the source ports
+ * change over time.
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include "libknot/packet/pkt.h"
+
+typedef struct inflight inflight_t;
+
+/*!
+ * \brief Creates the in-flight tables and starts the completion thread.
+ *
+ * \param remote      Upstream address.
+ * \param via         Source address for the upstream (AF_UNSPEC if any).
+ * \param threads     Number of worker threads.
+ * \param timeout_ms  Upstream timeout.
+ *
+ * \return In-flight context or NULL if error.
+ */
+inflight_t *inflight_new(const struct sockaddr_storage *remote,
+                         const struct sockaddr_storage *via,
+                         unsigned threads, int timeout_ms);
+
+/*!
+ * \brief Stops the completion thread and drops all in-flight queries.
+ */
+void inflight_free(inflight_t *ctx);
+
+/*!
+ * \brief Forwards a query and registers it for asynchronous completion.
+ *
+ * \param ctx        In-flight context.
+ * \param thread_id  Worker thread id.
+ * \param query      Parsed query to forward (its wire is left unchanged).
+ * \param fd         Socket the query was received on.
+ * \param client     Client address.
+ * \param local      Local address the query was received on (can be NULL).
+ *
+ * \retval KNOT_EOK if the response will be sent by the completion thread.
+ * \retval KNOT_ESPACE if the table is full.
+ * \return KNOT_E* if the query can't be forwarded asynchronously.
+ */
+int inflight_submit(inflight_t *ctx, unsigned thread_id, knot_pkt_t *query,
+                    int fd, const struct sockaddr_storage *client,
+                    const struct sockaddr_storage *local);
@@ -0,0 +1,356 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fstrm.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "knot/modules/dnstap/capture.h"
+#include "contrib/macros.h"
+
+#ifdef HAVE_ATOMIC
+#define ATOMIC_STORE(dst, val) __atomic_store_n(&(dst), (val), __ATOMIC_RELEASE)
+#define ATOMIC_LOAD(src)       __atomic_load_n(&(src), __ATOMIC_ACQUIRE)
+#define ATOMIC_FENCE()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define ATOMIC_STORE(dst, val) do { __sync_synchronize(); (dst) = (val); } while (0)
+#define ATOMIC_LOAD(src)       __sync_fetch_and_add(&(src), 0)
+#define ATOMIC_FENCE()         __sync_synchronize()
+#endif
+
+/*! Clock of the writer thread wait, the wall clock only if waiting on another isn't possible. */
+#if defined(_POSIX_CLOCK_SELECTION) && _POSIX_CLOCK_SELECTION >= 0
+#define CAPTURE_CLOCK		CLOCK_MONOTONIC
+#else
+#define CAPTURE_CLOCK		CLOCK_REALTIME
+#endif
+
+/*! Maximum number of frames written at once. */
+#define CAPTURE_BATCH		128
+
+/*! Period of reopening the sink after a failure. */
+#define CAPTURE_REOPEN_MS	1000
+
+/*! Record header value for skipping the rest of the ring. */
+#define RECORD_WRAP		UINT32_MAX
+
+/*! Records are length-prefixed and aligned. */
+#define RECORD_ALIGN		8
+#define RECORD_SIZE(len)	(((len) + sizeof(uint32_t) + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1))
+
+typedef struct {
+	uint64_t head;     //!< Published end of the frames (producer).
+	uint64_t tail;     //!< End of the written frames (consumer).
+	uint64_t reserved; //!< End of the reserved frame (producer only).
+	uint8_t *buf;
+	uint8_t padding[64 - 3 * sizeof(uint64_t) - sizeof(uint8_t *)];
+} capture_ring_t;
+
+struct dt_capture {
+	struct fstrm_writer *writer;
+	bool opened;
+	uint64_t reopen;         //!< Time of the next reopen attempt (ms).
+	size_t ring_size;        //!< Power of two.
+	unsigned rings_count;
+	capture_ring_t *rings;
+	uint64_t *tails;         //!< New ring tails of the current batch.
+	unsigned first_ring;     //!< Rotated for fairness between the rings.
+	bool stop;
+	bool sleeping;           //!< The writer thread waits for a wakeup.
+	pthread_mutex_t lock;    //!< Protects the wakeup.
+	pthread_cond_t wakeup;
+	pthread_t thread;
+	bool running;
+};
+
+/*! \brief Time of the writer thread clock in milliseconds. */
+static uint64_t time_ms(void)
+{
+	struct timespec now = { 0 };
+	clock_gettime(CAPTURE_CLOCK, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void capture_wakeup(dt_capture_t *cap)
+{
+	pthread_mutex_lock(&cap->lock);
+	pthread_cond_signal(&cap->wakeup);
+	pthread_mutex_unlock(&cap->lock);
+}
+
+uint8_t *dt_capture_reserve(dt_capture_t *cap, unsigned thread_id, size_t len)
+{
+	if (cap == NULL || thread_id >= cap->rings_count) {
+		return NULL;
+	}
+
+	capture_ring_t *ring = &cap->rings[thread_id];
+	size_t need = RECORD_SIZE(len);
+	uint64_t head = ring->head;
+	size_t pos = head & (cap->ring_size - 1);
+
+	// The frame must be contiguous, skip the end of the ring if needed.
+	size_t skip = (pos + need > cap->ring_size) ? cap->ring_size - pos : 0;
+	if (head + skip + need - ATOMIC_LOAD(ring->tail) > cap->ring_size) {
+		return NULL;
+	}
+
+	if (skip > 0) {
+		*(uint32_t *)(ring->buf + pos) = RECORD_WRAP;
+		pos = 0;
+	}
+
+	*(uint32_t *)(ring->buf + pos) = len;
+	ring->reserved = head + skip + need;
+
+	return ring->buf + pos + sizeof(uint32_t);
+}
+
+void dt_capture_commit(dt_capture_t *cap, unsigned thread_id)
+{
+	if (cap == NULL || thread_id >= cap->rings_count) {
+		return;
+	}
+
+	capture_ring_t *ring = &cap->rings[thread_id];
+	ATOMIC_STORE(ring->head, ring->reserved);
+
+	// Pairs with the fence in capture_wait(), either the writer thread sees
+	// the new frame or this thread sees it sleeping.
+	ATOMIC_FENCE();
+	if (ATOMIC_LOAD(cap->sleeping)) {
+		capture_wakeup(cap);
+	}
+}
+
+/*! \brief Collects published frames from the ring, returns the new ring tail. */
+static uint64_t ring_collect(dt_capture_t *cap, capture_ring_t *ring,
+                             struct iovec *iov, int *iov_count)
+{
+	uint64_t head = ATOMIC_LOAD(ring->head);
+	uint64_t off = ring->tail;
+
+	while (off < head && *iov_count < CAPTURE_BATCH) {
+		size_t pos = off & (cap->ring_size - 1);
+		uint32_t len = *(uint32_t *)(ring->buf + pos);
+		if (len == RECORD_WRAP) {
+			off += cap->ring_size - pos;
+			continue;
+		}
+
+		iov[*iov_count].iov_base = ring->buf + pos + sizeof(uint32_t);
+		iov[*iov_count].iov_len = len;
+		(*iov_count)++;
+		off += RECORD_SIZE(len);
+	}
+
+	return off;
+}
+
+static bool writer_ready(dt_capture_t *cap)
+{
+	if (!cap->opened) {
+		uint64_t now = time_ms();
+		if (now < cap->reopen) {
+			return false;
+		}
+		cap->opened = (fstrm_writer_open(cap->writer) == fstrm_res_success);
+		if (!cap->opened) {
+			cap->reopen = now + CAPTURE_REOPEN_MS;
+		}
+	}
+
+	return cap->opened;
+}
+
+/*! \brief Writes one batch of frames from all the rings, returns the number of frames. */
+static int capture_flush(dt_capture_t *cap)
+{
+	struct iovec iov[CAPTURE_BATCH];
+	uint64_t *tails = cap->tails;
+	int iov_count = 0;
+
+	// If the sink isn't available, the frames are kept until the rings are full.
+	if (!writer_ready(cap)) {
+		return 0;
+	}
+
+	for (unsigned i = 0; i < cap->rings_count; i++) {
+		unsigned idx = (cap->first_ring + i) % cap->rings_count;
+		tails[idx] = ring_collect(cap, &cap->rings[idx], iov, &iov_count);
+	}
+	cap->first_ring = (cap->first_ring + 1) % cap->rings_count;
+	if (iov_count == 0) {
+		return 0;
+	}
+
+	if (fstrm_writer_writev(cap->writer, iov, iov_count) != fstrm_res_success) {
+		// The frames of the failed write are discarded.
+		(void)fstrm_writer_close(cap->writer);
+		cap->opened = false;
+		cap->reopen = time_ms() + CAPTURE_REOPEN_MS;
+	}
+
+	for (unsigned i = 0; i < cap->rings_count; i++) {
+		ATOMIC_STORE(cap->rings[i].tail, tails[i]);
+	}
+
+	return iov_count;
+}
+
+static bool rings_empty(dt_capture_t *cap)
+{
+	for (unsigned i = 0; i < cap->rings_count; i++) {
+		capture_ring_t *ring = &cap->rings[i];
+		if (ATOMIC_LOAD(ring->head) != ring->tail) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*!
+ * \brief Blocks until a new frame is committed or the sink can be reopened.
+ *
+ * If the sink isn't available, the workers aren't woken up for each frame,
+ * the thread just waits for the next reopen attempt.
+ */
+static void capture_wait(dt_capture_t *cap)
+{
+	pthread_mutex_lock(&cap->lock);
+
+	uint64_t until = cap->opened ? time_ms() + CAPTURE_REOPEN_MS : cap->reopen;
+	struct timespec ts = {
+		.tv_sec = until / 1000,
+		.tv_nsec = (until % 1000) * 1000000L
+	};
+
+	if (cap->opened) {
+		ATOMIC_STORE(cap->sleeping, true);
+		ATOMIC_FENCE();
+		if (rings_empty(cap) && !ATOMIC_LOAD(cap->stop)) {
+			pthread_cond_timedwait(&cap->wakeup, &cap->lock, &ts);
+		}
+		ATOMIC_STORE(cap->sleeping, false);
+	} else if (!ATOMIC_LOAD(cap->stop)) {
+		pthread_cond_timedwait(&cap->wakeup, &cap->lock, &ts);
+	}
+
+	pthread_mutex_unlock(&cap->lock);
+}
+
+static void *capture_run(void *arg)
+{
+	dt_capture_t *cap = arg;
+
+	while (!ATOMIC_LOAD(cap->stop)) {
+		if (capture_flush(cap) < CAPTURE_BATCH) {
+			capture_wait(cap);
+		}
+	}
+
+	// Write the remaining frames.
+	while (capture_flush(cap) > 0);
+
+	return NULL;
+}
+
+dt_capture_t *dt_capture_new(struct fstrm_writer **writer, unsigned threads,
+                             size_t ring_size)
+{
+	if (writer == NULL || *writer == NULL || threads == 0 ||
+	    ring_size < RECORD_ALIGN) {
+		return NULL;
+	}
+
+	dt_capture_t *cap = calloc(1, sizeof(*cap));
+	if (cap == NULL) {
+		return NULL;
+	}
+
+	// Round the ring size up to a power of two.
+	cap->ring_size = RECORD_ALIGN;
+	while (cap->ring_size < ring_size) {
+		cap->ring_size <<= 1;
+	}
+
+	pthread_mutex_init(&cap->lock, NULL);
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+#if defined(_POSIX_CLOCK_SELECTION) && _POSIX_CLOCK_SELECTION >= 0
+	pthread_condattr_setclock(&attr, CAPTURE_CLOCK);
+#endif
+	pthread_cond_init(&cap->wakeup, &attr);
+	pthread_condattr_destroy(&attr);
+
+	cap->rings = calloc(threads, sizeof(*cap->rings));
+	cap->tails = calloc(threads, sizeof(*cap->tails));
+	if (cap->rings == NULL || cap->tails == NULL) {
+		dt_capture_free(cap);
+		return NULL;
+	}
+	for (unsigned i = 0; i < threads; i++) {
+		cap->rings[i].buf = malloc(cap->ring_size);
+		if (cap->rings[i].buf == NULL) {
+			dt_capture_free(cap);
+			return NULL;
+		}
+		cap->rings_count++;
+	}
+
+	cap->writer = *writer;
+	*writer = NULL;
+
+	if (pthread_create(&cap->thread, NULL, capture_run, cap) != 0) {
+		dt_capture_free(cap);
+		return NULL;
+	}
+	cap->running = true;
+
+	return cap;
+}
+
+void dt_capture_free(dt_capture_t *cap)
+{
+	if (cap == NULL) {
+		return;
+	}
+
+	if (cap->running) {
+		ATOMIC_STORE(cap->stop, true);
+		capture_wakeup(cap);
+		pthread_join(cap->thread, NULL);
+	}
+
+	if (cap->writer != NULL) {
+		fstrm_writer_destroy(&cap->writer);
+	}
+
+	for (unsigned i = 0; i < cap->rings_count; i++) {
+		free(cap->rings[i].buf);
+	}
+	free(cap->rings);
+	free(cap->tails);
+	pthread_cond_destroy(&cap->wakeup);
+	pthread_mutex_destroy(&cap->lock);
+	free(cap);
+}
@@ -0,0 +1,67 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Batched dnstap frame capture.
+ *
+ * Each worker thread encodes its frames directly into its own preallocated
+ * ring buffer (single producer, single consumer, no locking). A writer thread
+ * collects the frames from all the rings and writes them to the sink in
+ * batches of many frames per write. If a ring is full, the frame is dropped
+ * and the caller is expected to account for it.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct fstrm_writer;
+
+typedef struct dt_capture dt_capture_t;
+
+/*!
+ * \brief Creates the capture rings and starts the writer thread.
+ *
+ * \param writer     Sink writer, the capture takes ownership of it.
+ * \param threads    Number of worker threads.
+ * \param ring_size  Ring buffer size per worker thread.
+ *
+ * \return Capture context or NULL if error.
+ */
+dt_capture_t *dt_capture_new(struct fstrm_writer **writer, unsigned threads,
+                             size_t ring_size);
+
+/*!
+ * \brief Writes the pending frames, stops the writer thread, and frees the context.
+ */
+void dt_capture_free(dt_capture_t *cap);
+
+/*!
+ * \brief Reserves space for a frame in the worker thread ring.
+ *
+ * \param cap        Capture context.
+ * \param thread_id  Worker thread id.
+ * \param len        Exact frame length.
+ *
+ * \return Frame buffer or NULL if the ring is full.
+ */
+uint8_t *dt_capture_reserve(dt_capture_t *cap, unsigned thread_id, size_t len);
+
+/*!
+ * \brief Publishes the last reserved frame to the writer thread.
+ */
+void dt_capture_commit(dt_capture_t *cap, unsigned thread_id);
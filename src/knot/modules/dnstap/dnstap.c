@@ -23,6 +23,7 @@
 #include "contrib/dnstap/writer.h"
 #include "contrib/time.h"
 #include "knot/include/module.h"
+#include "knot/modules/dnstap/capture.h"
 
 #define MOD_SINK		"\x04""sink"
 #define MOD_IDENTITY		"\x08""identity"
@@ -30,6 +31,8 @@
 #define MOD_QUERIES		"\x0B""log-queries"
 #define MOD_RESPONSES		"\x0D""log-responses"
 #define MOD_WITH_QUERIES	"\x16""responses-with-queries"
+#define MOD_SAMPLE_RATE		"\x0B""sample-rate"
+#define MOD_BUFFER_SIZE		"\x0B""buffer-size"
 
 const yp_item_t dnstap_conf[] = {
 	{ MOD_SINK,         YP_TSTR,  YP_VNONE },
@@ -38,6 +41,8 @@ const yp_item_t dnstap_conf[] = {
 	{ MOD_QUERIES,      YP_TBOOL, YP_VBOOL = { true } },
 	{ MOD_RESPONSES,    YP_TBOOL, YP_VBOOL = { true } },
 	{ MOD_WITH_QUERIES, YP_TBOOL, YP_VBOOL = { false } },
+	{ MOD_SAMPLE_RATE,  YP_TINT,  YP_VINT = { 1, UINT16_MAX, 1 } },
+	{ MOD_BUFFER_SIZE,  YP_TINT,  YP_VINT = { 64 * 1024, UINT32_MAX, 1024 * 1024, YP_SSIZE } },
 	{ NULL }
 };
 
@@ -53,7 +58,8 @@ int dnstap_conf_check(knotd_conf_check_args_t *args)
 }
 
 typedef struct {
-	struct fstrm_iothr *iothread;
+	dt_capture_t *capture;
+	unsigned sample_rate;
 	char *identity;
 	size_t identity_len;
 	char *version;
@@ -73,8 +79,10 @@ static knotd_state_t log_message(knotd_state_t state, const knot_pkt_t *pkt,
 
 	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
 
-	struct fstrm_iothr_queue *ioq =
-		fstrm_iothr_get_input_queue_idx(ctx->iothread, qdata->params->thread_id);
+	/* Sample once per query to log both the query and the response. */
+	if (ctx->sample_rate > 1 && knotd_qdata_rand(qdata) % ctx->sample_rate != 0) {
+		return state;
+	}
 
 	/* Unless we want to measure the time it takes to process each query,
 	 * we can treat Q/R times the same. */
@@ -134,21 +142,16 @@ static knotd_state_t log_message(knotd_state_t state, const knot_pkt_t *pkt,
 		msg.has_query_time_nsec = msg.has_response_time_nsec;
 	}
 
-	/* Pack the message. */
-	uint8_t *frame = NULL;
-	size_t size = 0;
-	dt_pack(&dnstap, &frame, &size);
+	/* Pack the message directly into the capture ring. */
+	unsigned thread_id = qdata->params->thread_id;
+	size_t size = dnstap__dnstap__get_packed_size(&dnstap);
+	uint8_t *frame = dt_capture_reserve(ctx->capture, thread_id, size);
 	if (frame == NULL) {
+		knotd_mod_stats_incr(mod, thread_id, 0, 0, 1);
 		return state;
 	}
-
-	/* Submit a request. */
-	fstrm_res res = fstrm_iothr_submit(ctx->iothread, ioq, frame, size,
-	                                   fstrm_free_wrapper, NULL);
-	if (res != fstrm_res_success) {
-		free(frame);
-		return state;
-	}
+	(void)dnstap__dnstap__pack(&dnstap, frame);
+	dt_capture_commit(ctx->capture, thread_id);
 
 	return state;
 }
@@ -271,6 +274,10 @@ int dnstap_load(knotd_mod_t *mod)
 	conf = knotd_conf_mod(mod, MOD_WITH_QUERIES);
 	ctx->with_queries = conf.single.boolean;
 
+	/* Set sampling. */
+	conf = knotd_conf_mod(mod, MOD_SAMPLE_RATE);
+	ctx->sample_rate = conf.single.integer;
+
 	/* Set sink. */
 	conf = knotd_conf_mod(mod, MOD_SINK);
 	const char *sink = conf.single.string;
@@ -289,21 +296,21 @@ int dnstap_load(knotd_mod_t *mod)
 		goto fail;
 	}
 
-	struct fstrm_iothr_options *opt = fstrm_iothr_options_init();
-	if (opt == NULL) {
+	/* Create the capture rings and the writer thread. */
+	conf = knotd_conf_mod(mod, MOD_BUFFER_SIZE);
+	ctx->capture = dt_capture_new(&writer, knotd_mod_threads(mod), conf.single.integer);
+	if (ctx->capture == NULL) {
 		fstrm_writer_destroy(&writer);
 		goto fail;
 	}
 
-	/* Initialize queues. */
-	fstrm_iothr_options_set_num_input_queues(opt, knotd_mod_threads(mod));
-
-	/* Create the I/O thread. */
-	ctx->iothread = fstrm_iothr_init(opt, &writer);
-	fstrm_iothr_options_destroy(&opt);
-	if (ctx->iothread == NULL) {
-		fstrm_writer_destroy(&writer);
-		goto fail;
+	int ret = knotd_mod_stats_add(mod, "dropped", 1, NULL);
+	if (ret != KNOT_EOK) {
+		dt_capture_free(ctx->capture);
+		free(ctx->identity);
+		free(ctx->version);
+		free(ctx);
+		return ret;
 	}
 
 	knotd_mod_ctx_set(mod, ctx);
@@ -331,7 +338,7 @@ void dnstap_unload(knotd_mod_t *mod)
 {
 	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
 
-	fstrm_iothr_destroy(&ctx->iothread);
+	dt_capture_free(ctx->capture);
 	free(ctx->identity);
 	free(ctx->version);
 	free(ctx);
@@ -14,10 +14,10 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <assert.h>
 #include <time.h>
 
 #include "knot/modules/rrl/functions.h"
+#include "contrib/macros.h"
 #include "contrib/musl/inet_ntop.h"
 #include "contrib/openbsd/strlcat.h"
 #include "contrib/sockaddr.h"
@@ -25,8 +25,25 @@
 #include "libdnssec/error.h"
 #include "libdnssec/random.h"
 
-/* Hopscotch defines. */
-#define HOP_LEN (sizeof(unsigned)*8)
+#ifdef HAVE_ATOMIC
+#define ATOMIC_GET(src)           __atomic_load_n(&(src), __ATOMIC_RELAXED)
+#define ATOMIC_CAS(dst, old, val) __atomic_compare_exchange_n(&(dst), &(old), (val), \
+                                  false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#elif defined(HAVE_SYNC_ATOMIC)
+#define ATOMIC_GET(src)           __sync_fetch_and_add(&(src), 0)
+#define ATOMIC_CAS(dst, old, val) __sync_bool_compare_and_swap(&(dst), (old), (val))
+#else
+#define ATOMIC_GET(src)           (src)
+#define ATOMIC_CAS(dst, old, val) ((dst) = (val), true)
+#endif
+
+/* Number of buckets searched for a match (two cache lines). */
+#define RRL_WINDOW 8
+/* Bucket state word layout (from the least significant bit). */
+#define RRL_TIME_BITS  32
+#define RRL_NTOK_BITS  16
+#define RRL_FLAG_BITS  2
+#define RRL_CHECK_BITS 14
 /* Limits (class, ipv6 remote, dname) */
 #define RRL_CLSBLK_MAXLEN (1 + 8 + 255)
 /* CIDR block prefix lengths for v4/v6 */
@@ -36,7 +53,9 @@
 #define RRL_SSTART 2 /* 1/Nth of the rate for slow start */
 #define RRL_PSIZE_LARGE 1024
 #define RRL_CAPACITY 4 /* Window size in seconds */
-#define RRL_LOCK_GRANULARITY 32 /* Last digit granularity */
+
+typedef char static_assert_rate_fits_tokens
+	[(RRL_CAPACITY * RRL_RATE_MAX < (1 << RRL_NTOK_BITS)) ? 1 : -1];
 
 /* Classification */
 enum {
@@ -88,6 +107,59 @@ enum {
 	RRL_BF_ELIMIT = 1 << 1  /* Bucket is rate-limited. */
 };
 
+/* Bucket state changes to be logged. */
+enum {
+	RRL_LOG_LEAVE = 1 << 0, /* Bucket left rate limiting. */
+	RRL_LOG_ENTER = 1 << 1  /* Bucket entered rate limiting. */
+};
+
+/* Unpacked bucket state. */
+typedef struct {
+	uint16_t check; /* Owner check bits, must match the tag owner. */
+	uint8_t flags;  /* Flags. */
+	uint16_t ntok;  /* Tokens available. */
+	uint32_t time;  /* Timestamp (monotonic seconds). */
+} rrl_bucket_t;
+
+static rrl_bucket_t bucket_unpack(uint64_t state)
+{
+	rrl_bucket_t b = {
+		.time  = state,
+		.ntok  = state >> RRL_TIME_BITS,
+		.flags = (state >> (RRL_TIME_BITS + RRL_NTOK_BITS)) &
+		         ((1 << RRL_FLAG_BITS) - 1),
+		.check = state >> (RRL_TIME_BITS + RRL_NTOK_BITS + RRL_FLAG_BITS)
+	};
+	return b;
+}
+
+static uint64_t bucket_pack(const rrl_bucket_t *b)
+{
+	return (uint64_t)b->time |
+	       (uint64_t)b->ntok << RRL_TIME_BITS |
+	       (uint64_t)b->flags << (RRL_TIME_BITS + RRL_NTOK_BITS) |
+	       (uint64_t)b->check << (RRL_TIME_BITS + RRL_NTOK_BITS + RRL_FLAG_BITS);
+}
+
+static uint64_t hash_tag(uint64_t hash)
+{
+	/* Whole hash, non-zero for a used bucket. */
+	return hash | 1;
+}
+
+static uint16_t hash_check(uint64_t hash)
+{
+	/* Upper bits, the lower ones determine the bucket position. */
+	return (hash >> (64 - RRL_CHECK_BITS)) | 1;
+}
+
+/*! \brief Wrap-safe age of a timestamp, never negative. */
+static uint32_t bucket_age(const rrl_bucket_t *b, uint32_t now)
+{
+	int32_t age = now - b->time;
+	return (age > 0) ? age : 0;
+}
+
 static uint8_t rrl_clsid(rrl_req_t *p)
 {
 	/* Check error code */
@@ -188,79 +260,96 @@ static int rrl_classify(uint8_t *dst, size_t maxlen, const struct sockaddr_stora
 	return blklen;
 }
 
-static int bucket_free(rrl_item_t *bucket, uint32_t now)
+static bool bucket_free(const rrl_bucket_t *b, uint32_t now)
 {
-	return bucket->cls == CLS_NULL || (bucket->time + 1 < now);
+	return b->check == 0 || bucket_age(b, now) > 1;
 }
 
-static int bucket_match(rrl_item_t *bucket, rrl_item_t *match)
+/*! \brief Find a bucket for the hash, a free one, or the home one if none. */
+static rrl_item_t *rrl_bucket(rrl_table_t *tbl, uint64_t hash, uint32_t now)
 {
-	return bucket->cls    == match->cls &&
-	       bucket->netblk == match->netblk &&
-	       bucket->qname  == match->qname;
-}
-
-static int find_free(rrl_table_t *tbl, unsigned id, uint32_t now)
-{
-	for (int i = id; i < tbl->size; i++) {
-		if (bucket_free(&tbl->arr[i], now)) {
-			return i - id;
+	uint64_t tag = hash_tag(hash);
+	size_t id = hash % tbl->size;
+	rrl_item_t *free_bucket = NULL;
+
+	for (size_t i = 0; i < RRL_WINDOW; i++) {
+		rrl_item_t *bucket = &tbl->arr[(id + i) % tbl->size];
+		if (ATOMIC_GET(bucket->tag) == tag) {
+			return bucket;
 		}
-	}
-	for (int i = 0; i < id; i++) {
-		if (bucket_free(&tbl->arr[i], now)) {
-			return i + (tbl->size - id);
+		rrl_bucket_t b = bucket_unpack(ATOMIC_GET(bucket->state));
+		if (free_bucket == NULL && bucket_free(&b, now)) {
+			free_bucket = bucket;
 		}
 	}
 
-	/* this happens if table is full... force vacate current elm */
-	return id;
+	/* If the window is full, force vacate the home bucket. */
+	return (free_bucket != NULL) ? free_bucket : &tbl->arr[id];
 }
 
-static inline unsigned find_match(rrl_table_t *tbl, uint32_t id, rrl_item_t *m)
+/*! \brief Compute new bucket state after a visit. */
+static uint64_t bucket_visit(const rrl_table_t *tbl, uint64_t state,
+                             uint16_t check, uint32_t now, uint8_t *log, int *ret)
 {
-	unsigned new_id = 0;
-	unsigned hop = 0;
-	unsigned match_bitmap = tbl->arr[id].hop;
-	while (match_bitmap != 0) {
-		hop = __builtin_ctz(match_bitmap); /* offset of next potential match */
-		new_id = (id + hop) % tbl->size;
-		if (bucket_match(&tbl->arr[new_id], m)) {
-			return hop;
-		} else {
-			match_bitmap &= ~(1 << hop); /* clear potential match */
+	const uint32_t ntok_max = RRL_CAPACITY * tbl->rate;
+
+	rrl_bucket_t b = bucket_unpack(state);
+	if (b.check != check) {
+		if (bucket_free(&b, now)) {
+			b = (rrl_bucket_t) {
+				.check = check,
+				.ntok = ntok_max,
+				.time = now
+			};
+		} else if (!(b.flags & RRL_BF_SSTART)) {
+			/* Collision, reset the bucket and start slowly. */
+			b = (rrl_bucket_t) {
+				.check = check,
+				.flags = RRL_BF_SSTART,
+				.ntok = tbl->rate + tbl->rate / RRL_SSTART,
+				.time = now
+			};
 		}
 	}
 
-	return HOP_LEN + 1;
-}
+	/* Calculate rate for dT, a concurrent visit may have been later. */
+	uint32_t dt = bucket_age(&b, now);
+	if (dt > RRL_CAPACITY) {
+		dt = RRL_CAPACITY;
+	}
+	/* Visit bucket. */
+	if (dt > 0) {
+		b.time = now;
+	}
+	*log = 0;
+	if (dt > 0) { /* Window moved. */
 
-static inline unsigned reduce_dist(rrl_table_t *tbl, unsigned id, unsigned dist, unsigned *free_id)
-{
-	unsigned rd = HOP_LEN - 1;
-	while (rd > 0) {
-		unsigned vacate_id = (tbl->size + *free_id - rd) % tbl->size; /* bucket to be vacated */
-		if (tbl->arr[vacate_id].hop != 0) {
-			unsigned hop = __builtin_ctz(tbl->arr[vacate_id].hop);  /* offset of first valid bucket */
-			if (hop < rd) { /* only offsets in <vacate_id, free_id> are interesting */
-				unsigned new_id = (vacate_id + hop) % tbl->size; /* this item will be displaced to [free_id] */
-				unsigned keep_hop = tbl->arr[*free_id].hop; /* unpredictable padding */
-				memcpy(tbl->arr + *free_id, tbl->arr + new_id, sizeof(rrl_item_t));
-				tbl->arr[*free_id].hop = keep_hop;
-				tbl->arr[new_id].cls = CLS_NULL;
-				tbl->arr[vacate_id].hop &= ~(1 << hop);
-				tbl->arr[vacate_id].hop |= 1 << rd;
-				*free_id = new_id;
-				return dist - (rd - hop);
-			}
+		/* Check state change. */
+		if ((b.ntok > 0 || dt > 1) && (b.flags & RRL_BF_ELIMIT)) {
+			b.flags &= ~RRL_BF_ELIMIT;
+			*log |= RRL_LOG_LEAVE;
 		}
-		--rd;
+
+		/* Add new tokens. */
+		b.flags &= ~RRL_BF_SSTART;
+		b.ntok = MIN(b.ntok + tbl->rate * dt, ntok_max);
+	}
+
+	/* Last item taken. */
+	if (b.ntok == 1 && !(b.flags & RRL_BF_ELIMIT)) {
+		b.flags |= RRL_BF_ELIMIT;
+		*log |= RRL_LOG_ENTER;
+	}
+
+	/* Decay current bucket. */
+	if (b.ntok > 0) {
+		--b.ntok;
+		*ret = KNOT_EOK;
+	} else {
+		*ret = KNOT_ELIMIT;
 	}
 
-	assert(rd == 0); /* this happens with p=1/fact(HOP_LEN) */
-	*free_id = id;
-	dist = 0; /* force vacate initial element */
-	return dist;
+	return bucket_pack(&b);
 }
 
 static void subnet_tostr(char *dst, size_t maxlen, const struct sockaddr_storage *ss)
@@ -308,58 +397,9 @@ static void rrl_log_state(knotd_mod_t *mod, const struct sockaddr_storage *ss,
 	              addr_str, rrl_clsstr(cls), qname_str, what);
 }
 
-static void rrl_lock(rrl_table_t *tbl, int lk_id)
-{
-	assert(lk_id > -1);
-	pthread_mutex_lock(tbl->lk + lk_id);
-}
-
-static void rrl_unlock(rrl_table_t *tbl, int lk_id)
-{
-	assert(lk_id > -1);
-	pthread_mutex_unlock(tbl->lk + lk_id);
-}
-
-static int rrl_setlocks(rrl_table_t *tbl, uint32_t granularity)
-{
-	assert(!tbl->lk); /* Cannot change while locks are used. */
-	assert(granularity <= tbl->size / 10); /* Due to int. division err. */
-
-	if (pthread_mutex_init(&tbl->ll, NULL) < 0) {
-		return KNOT_ENOMEM;
-	}
-
-	/* Alloc new locks. */
-	tbl->lk = malloc(granularity * sizeof(pthread_mutex_t));
-	if (!tbl->lk) {
-		return KNOT_ENOMEM;
-	}
-	memset(tbl->lk, 0, granularity * sizeof(pthread_mutex_t));
-
-	/* Initialize. */
-	for (size_t i = 0; i < granularity; ++i) {
-		if (pthread_mutex_init(tbl->lk + i, NULL) < 0) {
-			break;
-		}
-		++tbl->lk_count;
-	}
-
-	/* Incomplete initialization */
-	if (tbl->lk_count != granularity) {
-		for (size_t i = 0; i < tbl->lk_count; ++i) {
-			pthread_mutex_destroy(tbl->lk + i);
-		}
-		free(tbl->lk);
-		tbl->lk_count = 0;
-		return KNOT_ERROR;
-	}
-
-	return KNOT_EOK;
-}
-
 rrl_table_t *rrl_create(size_t size, uint32_t rate)
 {
-	if (size == 0) {
+	if (size == 0 || rate > RRL_RATE_MAX) {
 		return NULL;
 	}
 
@@ -376,88 +416,9 @@ rrl_table_t *rrl_create(size_t size, uint32_t rate)
 		return NULL;
 	}
 
-	if (rrl_setlocks(tbl, RRL_LOCK_GRANULARITY) != KNOT_EOK) {
-		free(tbl);
-		return NULL;
-	}
-
 	return tbl;
 }
 
-static knot_dname_t *buf_qname(uint8_t *buf)
-{
-	return buf + sizeof(uint8_t) + sizeof(uint64_t);
-}
-
-/*! \brief Get bucket for current combination of parameters. */
-static rrl_item_t *rrl_hash(rrl_table_t *tbl, const struct sockaddr_storage *remote,
-                            rrl_req_t *req, const knot_dname_t *zone, uint32_t stamp,
-                            int *lock, uint8_t *buf, size_t buf_len)
-{
-	int len = rrl_classify(buf, buf_len, remote, req, zone);
-	if (len < 0) {
-		return NULL;
-	}
-
-	uint32_t id = SipHash24(&tbl->key, buf, len) % tbl->size;
-
-	/* Lock for lookup. */
-	pthread_mutex_lock(&tbl->ll);
-
-	/* Find an exact match in <id, id + HOP_LEN). */
-	knot_dname_t *qname = buf_qname(buf);
-	uint64_t netblk;
-	memcpy(&netblk, buf + sizeof(uint8_t), sizeof(netblk));
-	rrl_item_t match = {
-		.hop = 0,
-		.netblk = netblk,
-		.ntok = tbl->rate * RRL_CAPACITY,
-		.cls = buf[0],
-		.flags = RRL_BF_NULL,
-		.qname = SipHash24(&tbl->key, qname, knot_dname_size(qname)),
-		.time = stamp
-	};
-
-	unsigned dist = find_match(tbl, id, &match);
-	if (dist > HOP_LEN) { /* not an exact match, find free element [f] */
-		dist = find_free(tbl, id, stamp);
-	}
-
-	/* Reduce distance to fit <id, id + HOP_LEN) */
-	unsigned free_id = (id + dist) % tbl->size;
-	while (dist >= HOP_LEN) {
-		dist = reduce_dist(tbl, id, dist, &free_id);
-	}
-
-	/* Assign granular lock and unlock lookup. */
-	*lock = free_id % tbl->lk_count;
-	rrl_lock(tbl, *lock);
-	pthread_mutex_unlock(&tbl->ll);
-
-	/* found free bucket which is in <id, id + HOP_LEN) */
-	tbl->arr[id].hop |= (1 << dist);
-	rrl_item_t *bucket = &tbl->arr[free_id];
-	assert(free_id == (id + dist) % tbl->size);
-
-	/* Inspect bucket state. */
-	unsigned hop = bucket->hop;
-	if (bucket->cls == CLS_NULL) {
-		memcpy(bucket, &match, sizeof(rrl_item_t));
-		bucket->hop = hop;
-	}
-	/* Check for collisions. */
-	if (!bucket_match(bucket, &match)) {
-		if (!(bucket->flags & RRL_BF_SSTART)) {
-			memcpy(bucket, &match, sizeof(rrl_item_t));
-			bucket->hop = hop;
-			bucket->ntok = tbl->rate + tbl->rate / RRL_SSTART;
-			bucket->flags |= RRL_BF_SSTART;
-		}
-	}
-
-	return bucket;
-}
-
 int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *remote,
               rrl_req_t *req, const knot_dname_t *zone, knotd_mod_t *mod)
 {
@@ -466,63 +427,41 @@ int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *remote,
 	}
 
 	uint8_t buf[RRL_CLSBLK_MAXLEN];
-
-	/* Calculate hash and fetch */
-	int ret = KNOT_EOK;
-	int lock = -1;
-	uint32_t now = time_now().tv_sec;
-	rrl_item_t *bucket = rrl_hash(rrl, remote, req, zone, now, &lock, buf, sizeof(buf));
-	if (!bucket) {
-		if (lock > -1) {
-			rrl_unlock(rrl, lock);
-		}
+	int len = rrl_classify(buf, sizeof(buf), remote, req, zone);
+	if (len < 0) {
 		return KNOT_ERROR;
 	}
 
-	/* Calculate rate for dT */
-	uint32_t dt = now - bucket->time;
-	if (dt > RRL_CAPACITY) {
-		dt = RRL_CAPACITY;
-	}
-	/* Visit bucket. */
-	bucket->time = now;
-	if (dt > 0) { /* Window moved. */
+	uint64_t hash = SipHash24(&rrl->key, buf, len);
+	uint64_t tag = hash_tag(hash);
+	uint16_t check = hash_check(hash);
+	uint32_t now = time_now().tv_sec;
 
-		/* Check state change. */
-		if ((bucket->ntok > 0 || dt > 1) && (bucket->flags & RRL_BF_ELIMIT)) {
-			bucket->flags &= ~RRL_BF_ELIMIT;
-			rrl_log_state(mod, remote, bucket->flags, bucket->cls,
-			              knot_pkt_qname(req->query));
-		}
+	/* Lookup and update the bucket, retry if it was changed meanwhile. */
+	int ret;
+	uint8_t log;
+	rrl_item_t *bucket;
+	uint64_t old, new;
+	do {
+		bucket = rrl_bucket(rrl, hash, now);
+		old = ATOMIC_GET(bucket->state);
+		new = bucket_visit(rrl, old, check, now, &log, &ret);
+	} while (!ATOMIC_CAS(bucket->state, old, new));
 
-		/* Add new tokens. */
-		uint32_t dn = rrl->rate * dt;
-		if (bucket->flags & RRL_BF_SSTART) { /* Bucket in slow-start. */
-			bucket->flags &= ~RRL_BF_SSTART;
-		}
-		bucket->ntok += dn;
-		if (bucket->ntok > RRL_CAPACITY * rrl->rate) {
-			bucket->ntok = RRL_CAPACITY * rrl->rate;
-		}
+	/* Publish the tag of a taken over bucket for subsequent lookups. */
+	uint64_t old_tag = ATOMIC_GET(bucket->tag);
+	if (old_tag != tag && bucket_unpack(new).check == check) {
+		(void)ATOMIC_CAS(bucket->tag, old_tag, tag);
 	}
 
-	/* Last item taken. */
-	if (bucket->ntok == 1 && !(bucket->flags & RRL_BF_ELIMIT)) {
-		bucket->flags |= RRL_BF_ELIMIT;
-		rrl_log_state(mod, remote, bucket->flags, bucket->cls,
-		              knot_pkt_qname(req->query));
+	uint8_t cls = buf[0];
+	if (log & RRL_LOG_LEAVE) {
+		rrl_log_state(mod, remote, RRL_BF_NULL, cls, knot_pkt_qname(req->query));
 	}
-
-	/* Decay current bucket. */
-	if (bucket->ntok > 0) {
-		--bucket->ntok;
-	} else if (bucket->ntok == 0) {
-		ret = KNOT_ELIMIT;
+	if (log & RRL_LOG_ENTER) {
+		rrl_log_state(mod, remote, RRL_BF_ELIMIT, cls, knot_pkt_qname(req->query));
 	}
 
-	if (lock > -1) {
-		rrl_unlock(rrl, lock);
-	}
 	return ret;
 }
 
@@ -540,15 +479,5 @@ bool rrl_slip_roll(int n_slip)
 
 void rrl_destroy(rrl_table_t *rrl)
 {
-	if (rrl) {
-		if (rrl->lk_count > 0) {
-			pthread_mutex_destroy(&rrl->ll);
-		}
-		for (size_t i = 0; i < rrl->lk_count; ++i) {
-			pthread_mutex_destroy(rrl->lk + i);
-		}
-		free(rrl->lk);
-	}
-
 	free(rrl);
 }
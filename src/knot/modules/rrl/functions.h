@@ -17,24 +17,31 @@
 #pragma once
 
 #include <stdint.h>
-#include <pthread.h>
 #include <sys/socket.h>
 
 #include "libknot/libknot.h"
 #include "knot/include/module.h"
 #include "contrib/openbsd/siphash.h"
 
+/*!
+ * \brief Maximum rate limit.
+ *
+ * A bucket holds up to RRL_CAPACITY seconds of tokens in a 16-bit counter.
+ */
+#define RRL_RATE_MAX 16383
+
 /*!
  * \brief RRL hash bucket.
+ *
+ * The tag (full 64-bit name hash) is used for lookups. The state (owner check
+ * bits, flags, tokens, and 32-bit timestamp) is packed into a single 64-bit
+ * word, so it can be updated with compare-and-swap. The check bits bind
+ * the state to the owner, so a bucket is never charged to a flow which
+ * took it over meanwhile.
  */
 typedef struct {
-	unsigned hop;        /* Hop bitmap. */
-	uint64_t netblk;     /* Prefix associated. */
-	uint16_t ntok;       /* Tokens available. */
-	uint8_t  cls;        /* Bucket class. */
-	uint8_t  flags;      /* Flags. */
-	uint32_t qname;      /* imputed(QNAME) hash. */
-	uint32_t time;       /* Timestamp. */
+	uint64_t tag;
+	uint64_t state;
 } rrl_item_t;
 
 /*!
@@ -45,16 +52,13 @@ typedef struct {
  * When a bucket is in a slow-start mode, it cannot reset again for the time
  * period.
  *
- * To avoid lock contention, N locks are created and distributed amongst buckets.
- * As of now lock K for bucket N is calculated as K = N % (num_buckets).
+ * The table is lock-free. A bucket for a hash is searched within a short
+ * window of neighbouring buckets and all bucket updates are atomic, so
+ * concurrent workers only interfere when they update the very same bucket.
  */
-
 typedef struct {
 	SIPHASH_KEY key;     /* Siphash key. */
 	uint32_t rate;       /* Configured RRL limit. */
-	pthread_mutex_t ll;
-	pthread_mutex_t *lk; /* Table locks. */
-	unsigned lk_count;   /* Table lock count (granularity). */
 	size_t size;         /* Number of buckets. */
 	rrl_item_t arr[];    /* Buckets. */
 } rrl_table_t;
@@ -78,7 +82,7 @@ typedef struct {
 /*!
  * \brief Create a RRL table.
  * \param size Fixed hashtable size (reasonable large prime is recommended).
- * \param rate Rate (in pkts/sec).
+ * \param rate Rate (in pkts/sec), at most RRL_RATE_MAX.
  * \return created table or NULL.
  */
 rrl_table_t *rrl_create(size_t size, uint32_t rate);
@@ -24,7 +24,7 @@
 #define MOD_WHITELIST		"\x09""whitelist"
 
 const yp_item_t rrl_conf[] = {
-	{ MOD_RATE_LIMIT, YP_TINT, YP_VINT = { 1, INT32_MAX } },
+	{ MOD_RATE_LIMIT, YP_TINT, YP_VINT = { 1, RRL_RATE_MAX } },
 	{ MOD_SLIP,       YP_TINT, YP_VINT = { 0, 100, 1 } },
 	{ MOD_TBL_SIZE,   YP_TINT, YP_VINT = { 1, INT32_MAX, 393241 } },
 	{ MOD_WHITELIST,  YP_TNET, YP_VNONE, YP_FMULTI },
@@ -193,6 +193,10 @@ int rrl_load(knotd_mod_t *mod)
 
 	knotd_mod_ctx_set(mod, ctx);
 
+#if !defined(HAVE_ATOMIC) && !defined(HAVE_SYNC_ATOMIC)
+	knotd_mod_log(mod, LOG_WARNING, "the module might work slightly wrong on this platform");
+#endif
+
 	return knotd_mod_hook(mod, KNOTD_STAGE_END, ratelimit_apply);
 }
 
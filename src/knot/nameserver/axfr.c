@@ -16,12 +16,14 @@
 
 #include <urcu.h>
 
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/sockaddr.h"
 #include "knot/nameserver/axfr.h"
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/log.h"
 #include "knot/nameserver/xfr.h"
+#include "knot/zone/zone-conf.h"
 #include "libknot/libknot.h"
 
 #define ZONE_NAME(qdata) knot_pkt_qname((qdata)->query)
@@ -31,14 +33,273 @@
 	ns_log(priority, ZONE_NAME(qdata), LOG_OPERATION_AXFR, \
 	       LOG_DIRECTION_OUT, REMOTE(qdata), false, fmt)
 
+/*! \brief Answer section of one pre-encoded AXFR message. */
+typedef struct {
+	size_t offset;     //!< Offset of the answer section in the snapshot data.
+	uint16_t size;     //!< Size of the answer section.
+	uint16_t ancount;  //!< Number of records in the answer section.
+	const zone_tree_t *tree;  //!< Tree to continue in after the message (or NULL).
+	const zone_node_t *node;  //!< Node to continue at after the message.
+	unsigned cur_rrset;       //!< RRSet of the node to continue at.
+} axfr_msg_t;
+
+/*!
+ * \brief Pre-encoded AXFR message stream of one zone contents version.
+ *
+ * The answer sections are stored including compression pointers, which
+ * are valid only with the same question, so the question is stored too.
+ * Message header, EDNS and TSIG are added for each transfer separately.
+ *
+ * The snapshot is set in the zone as soon as its recording starts. Other
+ * transfers replay the messages recorded so far and if they catch up with
+ * the recording, they continue by encoding the zone from the position
+ * after the last replayed message.
+ *
+ * The snapshot is referenced only by the transfers using it, the zone
+ * just points to it. So it's freed when the last transfer finishes.
+ * The snapshot data is protected by the zone's snapshot lock.
+ */
+struct axfr_snapshot {
+	unsigned refs;
+	zone_t *zone;
+	const zone_contents_t *contents;  //!< Zone contents the snapshot belongs to.
+	uint8_t question[KNOT_DNAME_MAXLEN + 2 * sizeof(uint16_t)];
+	uint16_t question_size;
+	size_t room;                      //!< Message space of the recording transfer.
+	bool complete;                    //!< All the messages have been recorded.
+	axfr_msg_t *msgs;
+	size_t msg_count;
+	size_t msg_max;
+	uint8_t *data;
+	size_t data_size;
+	size_t data_max;
+	size_t data_limit;                //!< Configured limit of the data size.
+};
+
 /* AXFR context. @note aliasing the generic xfr_proc */
 struct axfr_proc {
 	struct xfr_proc proc;
 	trie_it_t *i;
 	zone_tree_it_t it;
 	unsigned cur_rrset;
+	axfr_snapshot_t *snapshot;  //!< Snapshot being replayed or recorded.
+	bool replay;
+	size_t cur_msg;
 };
 
+void axfr_snapshot_release(axfr_snapshot_t *snapshot)
+{
+	if (snapshot == NULL) {
+		return;
+	}
+
+	zone_t *zone = snapshot->zone;
+	pthread_mutex_lock(&zone->axfr_snapshot_lock);
+	bool last = (--snapshot->refs == 0);
+	if (last && zone->axfr_snapshot == snapshot) {
+		zone->axfr_snapshot = NULL;
+	}
+	pthread_mutex_unlock(&zone->axfr_snapshot_lock);
+	if (!last) {
+		return;
+	}
+
+	free(snapshot->msgs);
+	free(snapshot->data);
+	free(snapshot);
+}
+
+void axfr_snapshot_drop(zone_t *zone)
+{
+	// Freed by the transfers still using it.
+	pthread_mutex_lock(&zone->axfr_snapshot_lock);
+	zone->axfr_snapshot = NULL;
+	pthread_mutex_unlock(&zone->axfr_snapshot_lock);
+}
+
+static axfr_snapshot_t *snapshot_new(zone_t *zone, const zone_contents_t *contents,
+                                     const uint8_t *question, uint16_t question_size,
+                                     size_t room, size_t data_limit)
+{
+	axfr_snapshot_t *snap = calloc(1, sizeof(*snap));
+	if (snap == NULL) {
+		return NULL;
+	}
+
+	snap->refs = 1;
+	snap->zone = zone;
+	snap->contents = contents;
+	assert(question_size <= sizeof(snap->question));
+	memcpy(snap->question, question, question_size);
+	snap->question_size = question_size;
+	snap->room = room;
+	snap->data_limit = data_limit;
+
+	return snap;
+}
+
+static int snapshot_record(axfr_snapshot_t *snap, const knot_pkt_t *pkt, size_t answer_pos,
+                           struct axfr_proc *axfr, bool last)
+{
+	size_t size = pkt->size - answer_pos;
+	if (snap->data_size + size > snap->data_limit) {
+		return KNOT_ELIMIT;
+	}
+
+	if (snap->msg_count == snap->msg_max) {
+		size_t msg_max = MAX(2 * snap->msg_max, 16);
+		axfr_msg_t *msgs = realloc(snap->msgs, msg_max * sizeof(*msgs));
+		if (msgs == NULL) {
+			return KNOT_ENOMEM;
+		}
+		snap->msgs = msgs;
+		snap->msg_max = msg_max;
+	}
+	if (snap->data_size + size > snap->data_max) {
+		size_t data_max = MAX(2 * snap->data_max, snap->data_size + size);
+		uint8_t *data = realloc(snap->data, data_max);
+		if (data == NULL) {
+			return KNOT_ENOMEM;
+		}
+		snap->data = data;
+		snap->data_max = data_max;
+	}
+
+	memcpy(snap->data + snap->data_size, pkt->wire + answer_pos, size);
+	axfr_msg_t *msg = &snap->msgs[snap->msg_count++];
+	*msg = (axfr_msg_t) {
+		.offset = snap->data_size,
+		.size = size,
+		.ancount = knot_wire_get_ancount(pkt->wire),
+	};
+	if (!EMPTY_LIST(axfr->proc.nodes)) {
+		msg->tree = ((ptrnode_t *)HEAD(axfr->proc.nodes))->d;
+		msg->node = zone_tree_it_val(&axfr->it);
+		msg->cur_rrset = axfr->cur_rrset;
+	}
+	snap->data_size += size;
+	snap->complete = last;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Decide whether to replay an existing snapshot or to record a new one. */
+static void axfr_snapshot_begin(struct axfr_proc *axfr, knot_pkt_t *pkt,
+                                knotd_qdata_t *qdata)
+{
+	const uint8_t *question = pkt->wire + KNOT_WIRE_HEADER_SIZE;
+	uint16_t question_size = knot_pkt_question_size(pkt);
+	if (pkt->size != KNOT_WIRE_HEADER_SIZE + question_size ||
+	    knot_wire_get_ancount(pkt->wire) != 0) {
+		return;
+	}
+
+	zone_t *zone = qdata->extra->zone;
+	size_t limit = zone_conf_axfr_snapshot_max_size(conf(), &zone->settings, zone->name);
+	if (limit == 0) {
+		return;
+	}
+	size_t room = pkt->max_size - pkt->reserved;
+
+	pthread_mutex_lock(&zone->axfr_snapshot_lock);
+	axfr_snapshot_t *snap = zone->axfr_snapshot;
+	if (snap != NULL && snap->contents == qdata->extra->contents) {
+		if (snap->question_size == question_size &&
+		    memcmp(snap->question, question, question_size) == 0 &&
+		    room >= snap->room) {
+			snap->refs++;
+			axfr->snapshot = snap;
+			axfr->replay = true;
+		}
+	} else {
+		// No snapshot or one of outdated contents, which is left to its users.
+		snap = snapshot_new(zone, qdata->extra->contents, question,
+		                    question_size, room, limit);
+		zone->axfr_snapshot = snap;
+		axfr->snapshot = snap;
+	}
+	pthread_mutex_unlock(&zone->axfr_snapshot_lock);
+}
+
+/*! \brief Stop recording the snapshot, the transfer continues without it. */
+static void axfr_snapshot_abort(struct axfr_proc *axfr)
+{
+	axfr_snapshot_release(axfr->snapshot);
+	axfr->snapshot = NULL;
+	axfr->replay = false;
+}
+
+/*! \brief Continue the transfer after the given message by encoding the zone. */
+static int axfr_resume(struct axfr_proc *axfr, const axfr_msg_t *msg, knot_mm_t *mm)
+{
+	while (!EMPTY_LIST(axfr->proc.nodes)) {
+		ptrnode_t *head = HEAD(axfr->proc.nodes);
+		if (head->d == msg->tree) {
+			break;
+		}
+		rem_node((node_t *)head);
+		mm_free(mm, head);
+	}
+	if (msg->tree == NULL) {
+		return KNOT_EOK; // Just the final SOA left.
+	} else if (EMPTY_LIST(axfr->proc.nodes)) {
+		return KNOT_ERROR;
+	}
+
+	int ret = zone_tree_it_leq_begin((zone_tree_t *)msg->tree, msg->node->owner,
+	                                 &axfr->it);
+	if (ret <= 0) {
+		return (ret == 0) ? KNOT_ERROR : ret;
+	}
+	axfr->cur_rrset = msg->cur_rrset;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Replay the next message of the snapshot.
+ *
+ * \retval KNOT_EAGAIN if the message is to be encoded from the zone.
+ */
+static int axfr_snapshot_replay(knot_pkt_t *pkt, struct axfr_proc *axfr, knot_mm_t *mm)
+{
+	axfr_snapshot_t *snap = axfr->snapshot;
+	pthread_mutex_t *lock = &snap->zone->axfr_snapshot_lock;
+
+	pthread_mutex_lock(lock);
+	if (axfr->cur_msg < snap->msg_count) {
+		const axfr_msg_t *msg = &snap->msgs[axfr->cur_msg];
+		if (pkt->size + msg->size > pkt->max_size - pkt->reserved) {
+			pthread_mutex_unlock(lock);
+			return KNOT_ERANGE;
+		}
+		memcpy(pkt->wire + pkt->size, snap->data + msg->offset, msg->size);
+		pkt->size += msg->size;
+		knot_wire_set_ancount(pkt->wire, msg->ancount);
+
+		bool more = (++axfr->cur_msg < snap->msg_count || !snap->complete);
+		pthread_mutex_unlock(lock);
+		return more ? KNOT_ESPACE : KNOT_EOK;
+	}
+
+	// Caught up with the unfinished recording.
+	axfr_msg_t last = { 0 };
+	if (axfr->cur_msg > 0) {
+		last = snap->msgs[axfr->cur_msg - 1];
+	}
+	pthread_mutex_unlock(lock);
+
+	axfr_snapshot_abort(axfr);
+	if (axfr->cur_msg > 0) {
+		int ret = axfr_resume(axfr, &last, mm);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EAGAIN;
+}
+
 static int axfr_put_rrsets(knot_pkt_t *pkt, zone_node_t *node,
                            struct axfr_proc *state)
 {
@@ -100,6 +361,7 @@ static void axfr_query_cleanup(knotd_qdata_t *qdata)
 	struct axfr_proc *axfr = (struct axfr_proc *)qdata->extra->ext;
 
 	zone_tree_it_free(&axfr->it);
+	axfr_snapshot_release(axfr->snapshot);
 	ptrlist_free(&axfr->proc.nodes, qdata->mm);
 	mm_free(qdata->mm, axfr);
 
@@ -208,8 +470,39 @@ int axfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 		return KNOT_STATE_FAIL;
 	}
 
+	/* Replay or record pre-encoded messages shared by the transfers. */
+	if (axfr->proc.stats.messages == 0) {
+		axfr_snapshot_begin(axfr, pkt, qdata);
+	}
+
 	/* Answer current packet (or continue). */
-	ret = xfr_process_list(pkt, &axfr_process_node_tree, qdata);
+	ret = KNOT_EAGAIN;
+	if (axfr->replay) {
+		if (qdata->extra->contents == NULL) {
+			ret = KNOT_ENOZONE;
+		} else {
+			ret = axfr_snapshot_replay(pkt, axfr, qdata->mm);
+		}
+		if (ret == KNOT_EOK || ret == KNOT_ESPACE) {
+			xfr_stats_add(&axfr->proc.stats, pkt->size + knot_rrset_size(&qdata->opt_rr));
+		}
+	}
+	if (ret == KNOT_EAGAIN) {
+		size_t answer_pos = pkt->size;
+		ret = xfr_process_list(pkt, &axfr_process_node_tree, qdata);
+		axfr_snapshot_t *snap = axfr->snapshot;
+		if (snap != NULL) {
+			int rec_ret = ret;
+			if (ret == KNOT_EOK || ret == KNOT_ESPACE) {
+				pthread_mutex_lock(&snap->zone->axfr_snapshot_lock);
+				rec_ret = snapshot_record(snap, pkt, answer_pos, axfr, ret == KNOT_EOK);
+				pthread_mutex_unlock(&snap->zone->axfr_snapshot_lock);
+			}
+			if (rec_ret != KNOT_EOK || ret == KNOT_EOK) {
+				axfr_snapshot_abort(axfr);
+			}
+		}
+	}
 	switch (ret) {
 	case KNOT_ESPACE: /* Couldn't write more, send packet and continue. */
 		return KNOT_STATE_PRODUCE; /* Check for more. */
@@ -19,6 +19,24 @@
 #include "knot/nameserver/process_query.h"
 #include "libknot/packet/pkt.h"
 
+/*!
+ * \brief Pre-encoded AXFR messages shared by transfers of the same zone version.
+ */
+typedef struct axfr_snapshot axfr_snapshot_t;
+
+/*!
+ * \brief Release a reference to the AXFR snapshot, free it if unused.
+ *
+ * The snapshot is referenced only by the transfers, so it's freed (and
+ * unset in the zone) when the last transfer using it finishes.
+ */
+void axfr_snapshot_release(axfr_snapshot_t *snapshot);
+
+/*!
+ * \brief Unset the AXFR snapshot of the zone (e.g. when the contents change).
+ */
+void axfr_snapshot_drop(zone_t *zone);
+
 /*!
  * \brief Process an AXFR query message.
  *
@@ -120,6 +120,23 @@ static bool have_dnssec(knotd_qdata_t *qdata)
 	       qdata->extra->contents->dnssec;
 }
 
+/*!
+ * \brief Check if the answer may be served from or stored to the answer cache.
+ *
+ * Query modules and answer rotation make answers differ between queries,
+ * ECS and TSIG are specific to the client.
+ */
+static bool answer_cache_usable(knotd_qdata_t *qdata)
+{
+	return qdata->extra->contents->answer_cache != NULL &&
+	       qdata->extra->zone->query_plan == NULL &&
+	       !qdata->extra->zone->is_catalog_flag &&
+	       conf()->query_plan == NULL &&
+	       !conf()->cache.srv_ans_rotate &&
+	       qdata->ecs == NULL &&
+	       !knot_pkt_has_tsig(qdata->query);
+}
+
 /*! \brief This is a wildcard-covered or any other terminal node for QNAME.
  *         e.g. positive answer.
  */
@@ -695,6 +712,13 @@ static int answer_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	/* Write resulting RCODE. */
 	knot_wire_set_rcode(pkt->wire, qdata->rcode);
 
+	/* Store the complete answer for subsequent queries. */
+	if (qdata->rcode_ede == KNOT_EDNS_EDE_NONE && answer_cache_usable(qdata)) {
+		answer_cache_put(qdata->extra->contents->answer_cache, pkt,
+		                 with_dnssec, qdata->params->proto == KNOTD_QUERY_PROTO_UDP,
+		                 qdata->rcode);
+	}
+
 	return KNOT_STATE_DONE;
 }
 
@@ -724,5 +748,13 @@ int internet_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	/* Get answer to QNAME. */
 	qdata->name = knot_pkt_qname(qdata->query);
 
+	/* Reuse a pre-rendered answer if available. */
+	if (answer_cache_usable(qdata) &&
+	    answer_cache_get(qdata->extra->contents->answer_cache, pkt,
+	                     have_dnssec(qdata), qdata->params->proto == KNOTD_QUERY_PROTO_UDP,
+	                     &qdata->rcode)) {
+		return KNOT_STATE_DONE;
+	}
+
 	return answer_query(pkt, qdata);
 }
@@ -179,9 +179,8 @@ static int ixfr_answer_init(knotd_qdata_t *qdata, uint32_t *serial_from)
 		return KNOT_EAGAIN;
 	}
 
-	conf_val_t provide = conf_zone_get(conf(), C_PROVIDE_IXFR,
-	                                   qdata->extra->zone->name);
-	if (!conf_bool(&provide)) {
+	const zone_t *zone = qdata->extra->zone;
+	if (!zone_conf_provide_ixfr(conf(), &zone->settings, zone->name)) {
 		return KNOT_ENOTSUP;
 	}
 
@@ -702,21 +702,42 @@ bool process_query_acl_check(conf_t *conf, acl_action_t action,
 	bool automatic = false;
 	bool allowed = false;
 
+	/* Use the pre-resolved zone ACLs and remotes if possible. */
+	rcu_read_lock();
+	const zone_conf_t *zconf = rcu_dereference(qdata->extra->zone->settings);
+	if (zconf != NULL && !acl_index_usable(conf, query_source)) {
+		zconf = NULL;
+	}
+
 	if (action != ACL_ACTION_UPDATE) {
 		// ACL_ACTION_QUERY is used for SOA/refresh query.
 		assert(action == ACL_ACTION_QUERY || action == ACL_ACTION_NOTIFY ||
 		       action == ACL_ACTION_TRANSFER);
-		const yp_name_t *item = (action == ACL_ACTION_NOTIFY) ? C_MASTER : C_NOTIFY;
-		conf_val_t rmts = conf_zone_get(conf, item, zone_name);
-		allowed = rmt_allowed(conf, &rmts, query_source, &tsig,
-		                      qdata->params->quic_conn);
+		if (zconf != NULL) {
+			const conf_ids_t *rmts = (action == ACL_ACTION_NOTIFY) ?
+			                         &zconf->master : &zconf->notify;
+			allowed = rmt_allowed_ids(conf, rmts, query_source, &tsig,
+			                          qdata->params->quic_conn);
+		} else {
+			const yp_name_t *item = (action == ACL_ACTION_NOTIFY) ? C_MASTER : C_NOTIFY;
+			conf_val_t rmts = conf_zone_get(conf, item, zone_name);
+			allowed = rmt_allowed(conf, &rmts, query_source, &tsig,
+			                      qdata->params->quic_conn);
+		}
 		automatic = allowed;
 	}
 	if (!allowed) {
-		conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
-		allowed = acl_allowed(conf, &acl, action, query_source, &tsig,
-		                      zone_name, query, qdata->params->quic_conn);
+		if (zconf != NULL) {
+			allowed = acl_allowed_ids(conf, &zconf->acl, action, query_source,
+			                          &tsig, zone_name, query,
+			                          qdata->params->quic_conn);
+		} else {
+			conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
+			allowed = acl_allowed(conf, &acl, action, query_source, &tsig,
+			                      zone_name, query, qdata->params->quic_conn);
+		}
 	}
+	rcu_read_unlock();
 
 	int pin_size = 0;
 #ifdef ENABLE_QUIC
@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include "contrib/sockaddr.h"
+#include "libdnssec/random.h"
 #include "libknot/attribute.h"
 #include "libknot/probe/data.h"
 #include "libknot/xdp.h"
@@ -645,6 +646,20 @@ uint32_t knotd_qdata_rtt(knotd_qdata_t *qdata)
 	}
 }
 
+_public_
+uint32_t knotd_qdata_rand(knotd_qdata_t *qdata)
+{
+	if (qdata == NULL) {
+		return 0;
+	}
+
+	while (qdata->rand == 0) {
+		qdata->rand = dnssec_random_uint32_t();
+	}
+
+	return qdata->rand;
+}
+
 _public_
 const knot_dname_t *knotd_qdata_zone_name(knotd_qdata_t *qdata)
 {
@@ -24,6 +24,7 @@
 #include "contrib/mempattern.h"
 #include "contrib/net.h"
 #include "contrib/sockaddr.h"
+#include "contrib/time.h"
 
 static bool use_tcp(knot_request_t *request)
 {
@@ -319,9 +320,32 @@ static bool layer_active(knot_layer_state_t state)
 	}
 }
 
+/*! \brief Shortens the operation timeout to meet the request deadline. */
+static int request_timeout(knot_request_t *request, int *timeout_ms)
+{
+	if (request->deadline.tv_sec == 0 && request->deadline.tv_nsec == 0) {
+		return KNOT_EOK;
+	}
+
+	struct timespec now = time_now();
+	double remains = time_diff_ms(&now, &request->deadline);
+	if (remains <= 0) {
+		return KNOT_ETIMEOUT;
+	} else if (*timeout_ms < 0 || remains < *timeout_ms) {
+		*timeout_ms = (int)remains + 1;
+	}
+
+	return KNOT_EOK;
+}
+
 static int request_io(knot_requestor_t *req, knot_request_t *last,
                       int timeout_ms)
 {
+	int ret = request_timeout(last, &timeout_ms);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	switch (req->layer.state) {
 	case KNOT_STATE_CONSUME:
 		return request_consume(req, last, timeout_ms);
@@ -53,6 +53,7 @@ typedef struct {
 	knot_pkt_t *query;
 	knot_pkt_t *resp;
 	tsig_ctx_t tsig;
+	struct timespec deadline; /*!< Optional end of the I/O (zero if none). */
 
 	knot_sign_context_t sign; /*!< Required for async. DDNS processing. */
 } knot_request_t;
@@ -112,6 +113,8 @@ void knot_requestor_clear(knot_requestor_t *requestor);
  * \param request    Request instance.
  * \param timeout_ms Timeout of each operation in milliseconds (-1 for infinity).
  *
+ * \note The operations are further limited by the request deadline, if set.
+ *
  * \return KNOT_EOK or error
  */
 int knot_requestor_exec(knot_requestor_t *requestor,
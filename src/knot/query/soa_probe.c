@@ -0,0 +1,612 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "contrib/time.h"
+#include "contrib/ucw/heap.h"
+#include "libdnssec/random.h"
+#include "knot/common/fdset.h"
+#include "knot/nameserver/tsig_ctx.h"
+#include "knot/query/soa_probe.h"
+#include "knot/server/dthreads.h"
+#include "libknot/libknot.h"
+
+#define PROBE_SOCKETS		8	/*!< Sockets in use for each source address. */
+#define PROBE_SOCKET_QUERIES	64	/*!< Queries sent from a socket before its replacement. */
+
+typedef struct probe_socket probe_socket_t;
+
+typedef struct probe_query {
+	struct heap_val hpos;         //!< Position in the deadline heap (must be first).
+	uint64_t deadline;            //!< Query timeout (ms since the Epoch).
+	probe_socket_t *sock;         //!< Socket the query was sent from.
+	unsigned slot;                //!< Position in the socket queries.
+	uint16_t id;                  //!< Message ID.
+	knot_dname_t *zone;
+	struct sockaddr_storage source; //!< Configured source address.
+	knot_pkt_t *pkt;              //!< Query message until sent.
+	knot_tsig_key_t tsig_key;
+	tsig_ctx_t tsig;
+	soa_probe_result_t result;
+	struct probe_query *next;     //!< Submitted or completed queries linkage.
+} probe_query_t;
+
+/*!
+ * \brief Shared UDP socket with a random source port.
+ *
+ * The socket isn't connected, so it's shared by queries to any remotes.
+ * It's replaced by a fresh one after PROBE_SOCKET_QUERIES queries and closed
+ * when the last of them is completed.
+ */
+struct probe_socket {
+	int fd;
+	struct sockaddr_storage source;             //!< Bound address (without port).
+	unsigned sent;                              //!< Number of queries sent.
+	unsigned pending;                           //!< Number of outstanding queries.
+	probe_query_t *queries[PROBE_SOCKET_QUERIES]; //!< Queries sent (NULL if completed).
+	probe_socket_t *next;
+};
+
+struct soa_probe {
+	pthread_mutex_t lock;         //!< Protects the submitted queries.
+	probe_query_t *submitted;     //!< Queries to be sent by the engine thread.
+	probe_socket_t *sockets;      //!< Open sockets.
+	struct heap deadlines;        //!< Outstanding queries by the deadline.
+	fdset_t set;                  //!< Polled sockets and the wakeup pipe.
+	int notify[2];                //!< Engine thread wakeup pipe.
+	soa_probe_cb_t cb;
+	void *cb_data;
+	dt_unit_t *thread;
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+};
+
+/*! \brief Monotonic time in milliseconds. */
+static uint64_t time_ms(void)
+{
+	struct timespec now = time_now();
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int deadline_cmp(void *a, void *b)
+{
+	uint64_t d1 = ((probe_query_t *)a)->deadline;
+	uint64_t d2 = ((probe_query_t *)b)->deadline;
+	return (d1 > d2) - (d1 < d2);
+}
+
+static void probe_wakeup(soa_probe_t *probe)
+{
+	uint8_t byte = 0;
+	ssize_t ret = write(probe->notify[1], &byte, sizeof(byte));
+	(void)ret; // Full pipe means a pending wakeup anyway.
+}
+
+static void query_free(probe_query_t *q)
+{
+	knot_pkt_free(q->pkt);
+	tsig_cleanup(&q->tsig);
+	knot_tsig_key_deinit(&q->tsig_key);
+	knot_dname_free(q->zone, NULL);
+	free(q);
+}
+
+static bool socket_usable(const probe_socket_t *s, const struct sockaddr_storage *source)
+{
+	return s->sent < PROBE_SOCKET_QUERIES &&
+	       sockaddr_cmp(&s->source, source, true) == 0;
+}
+
+static int socket_open(soa_probe_t *probe, const struct sockaddr_storage *source,
+                       probe_socket_t **out)
+{
+	probe_socket_t *s = calloc(1, sizeof(*s));
+	if (s == NULL) {
+		return KNOT_ENOMEM;
+	}
+	s->source = *source;
+
+	// Port 0, each socket gets a random ephemeral port.
+	s->fd = net_bound_socket(SOCK_DGRAM, &s->source, 0, 0);
+	if (s->fd < 0) {
+		int ret = s->fd;
+		free(s);
+		return ret;
+	}
+
+	int ret = fdset_add(&probe->set, s->fd, FDSET_POLLIN, s);
+	if (ret < 0) {
+		close(s->fd);
+		free(s);
+		return ret;
+	}
+
+	s->next = probe->sockets;
+	probe->sockets = s;
+	*out = s;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Closes the replaced sockets without outstanding queries. */
+static void sockets_sweep(soa_probe_t *probe)
+{
+	probe_socket_t **s = &probe->sockets;
+	while (*s != NULL) {
+		probe_socket_t *cur = *s;
+		if (cur->sent < PROBE_SOCKET_QUERIES || cur->pending > 0) {
+			s = &cur->next;
+			continue;
+		}
+		for (unsigned i = 0; i < fdset_get_length(&probe->set); i++) {
+			if (probe->set.ctx[i] == cur) {
+				(void)fdset_remove(&probe->set, i); // Closes the socket.
+				break;
+			}
+		}
+		*s = cur->next;
+		free(cur);
+	}
+}
+
+/*!
+ * \brief Picks a random one of PROBE_SOCKETS sockets for the source address.
+ *
+ * The sockets are opened on demand, so the number of sockets in use is
+ * independent of the number of outstanding queries.
+ */
+static int socket_pick(soa_probe_t *probe, const struct sockaddr_storage *source,
+                       probe_socket_t **out)
+{
+	probe_socket_t *usable[PROBE_SOCKETS];
+	unsigned count = 0;
+	for (probe_socket_t *s = probe->sockets; s != NULL && count < PROBE_SOCKETS; s = s->next) {
+		if (socket_usable(s, source)) {
+			usable[count++] = s;
+		}
+	}
+
+	if (count < PROBE_SOCKETS) {
+		return socket_open(probe, source, out);
+	}
+
+	*out = usable[dnssec_random_uint16_t() % count];
+	return KNOT_EOK;
+}
+
+/*! \brief Picks a random message ID not outstanding on the socket. */
+static uint16_t socket_unique_id(const probe_socket_t *s)
+{
+	while (true) {
+		uint16_t id = dnssec_random_uint16_t();
+		bool used = false;
+		for (unsigned i = 0; i < s->sent && !used; i++) {
+			used = (s->queries[i] != NULL && s->queries[i]->id == id);
+		}
+		if (!used) {
+			return id;
+		}
+	}
+}
+
+static void query_remove(soa_probe_t *probe, probe_query_t *q)
+{
+	q->sock->queries[q->slot] = NULL;
+	q->sock->pending--;
+	heap_delete(&probe->deadlines, heap_find(&probe->deadlines, &q->hpos));
+}
+
+/*!
+ * \brief Sends the query from a shared socket and registers it.
+ *
+ * The sockets have random source ports, which are rotated as the sockets
+ * are replaced, so that an off-path attacker has to guess the port and
+ * the message ID. The response must come from the remote address and match
+ * the message ID and the question.
+ */
+static int query_send(soa_probe_t *probe, probe_query_t *q)
+{
+	probe_socket_t *s = NULL;
+	int ret = socket_pick(probe, &q->source, &s);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	q->id = socket_unique_id(s);
+	knot_wire_set_id(q->pkt->wire, q->id);
+
+	ret = tsig_sign_packet(&q->tsig, q->pkt);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	const struct sockaddr_storage *remote = &q->result.remote;
+	ssize_t sent = sendto(s->fd, q->pkt->wire, q->pkt->size, 0,
+	                      (const struct sockaddr *)remote, sockaddr_len(remote));
+	if (sent != (ssize_t)q->pkt->size) {
+		return sent < 0 ? knot_map_errno() : KNOT_ECONN;
+	}
+	knot_pkt_free(q->pkt);
+	q->pkt = NULL;
+
+	q->sock = s;
+	q->slot = s->sent++;
+	s->queries[q->slot] = q;
+	s->pending++;
+	heap_insert(&probe->deadlines, &q->hpos);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Returns the source address for the sockets, the port is random. */
+static void query_source(struct sockaddr_storage *source, const conf_remote_t *remote)
+{
+	if (remote->via.ss_family != AF_UNSPEC) {
+		*source = remote->via;
+	} else {
+		const char *any = remote->addr.ss_family == AF_INET6 ? "::" : "0.0.0.0";
+		sockaddr_set(source, remote->addr.ss_family, any, 0);
+	}
+	sockaddr_port_set(source, 0);
+}
+
+int soa_probe_submit(soa_probe_t *probe, const knot_dname_t *zone,
+                     const conf_remote_t *remote, const query_edns_data_t *edns,
+                     int timeout_ms)
+{
+	if (probe == NULL || zone == NULL || remote == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	probe_query_t *q = calloc(1, sizeof(*q));
+	if (q == NULL) {
+		return KNOT_ENOMEM;
+	}
+	q->zone = knot_dname_copy(zone, NULL);
+	memcpy(&q->result.remote, &remote->addr, sizeof(q->result.remote));
+	query_source(&q->source, remote);
+
+	// The key must outlive the configuration used for the submission.
+	int ret = q->zone != NULL ? KNOT_EOK : KNOT_ENOMEM;
+	bool use_tsig = remote->key.name != NULL &&
+	                remote->key.algorithm != DNSSEC_TSIG_UNKNOWN;
+	if (ret == KNOT_EOK && use_tsig) {
+		ret = knot_tsig_key_copy(&q->tsig_key, &remote->key);
+	}
+	tsig_init(&q->tsig, use_tsig ? &q->tsig_key : NULL);
+
+	q->pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	if (q->pkt == NULL) {
+		ret = KNOT_ENOMEM;
+	}
+	if (ret == KNOT_EOK) {
+		query_init_pkt(q->pkt);
+		ret = knot_pkt_put_question(q->pkt, zone, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	}
+	if (ret == KNOT_EOK && edns != NULL) {
+		ret = query_put_edns(q->pkt, edns);
+	}
+	if (ret != KNOT_EOK) {
+		query_free(q);
+		return ret;
+	}
+
+	q->deadline = time_ms() + timeout_ms;
+
+	// The engine thread owns the sockets, it sends the query.
+	pthread_mutex_lock(&probe->lock);
+	q->next = probe->submitted;
+	probe->submitted = q;
+	pthread_mutex_unlock(&probe->lock);
+
+	probe_wakeup(probe);
+
+	return KNOT_EOK;
+}
+
+static int query_answer(probe_query_t *q, knot_pkt_t *pkt)
+{
+	int ret = tsig_verify_packet(&q->tsig, pkt);
+	if (ret != KNOT_EOK) {
+		return ret;
+	} else if (tsig_unsigned_count(&q->tsig) != 0) {
+		return KNOT_TSIG_EBADSIG;
+	}
+
+	// Let the regular (TCP) refresh handle the details.
+	if (knot_wire_get_tc(pkt->wire)) {
+		return KNOT_ESPACE;
+	} else if (knot_pkt_ext_rcode(pkt) != KNOT_RCODE_NOERROR) {
+		return KNOT_EDENIED;
+	}
+
+	const knot_pktsection_t *answer = knot_pkt_section(pkt, KNOT_ANSWER);
+	const knot_rrset_t *rr = answer->count == 1 ? knot_pkt_rr(answer, 0) : NULL;
+	if (!rr || rr->type != KNOT_RRTYPE_SOA || rr->rrs.count != 1) {
+		return KNOT_EMALF;
+	}
+	q->result.serial = knot_soa_serial(rr->rrs.rdata);
+
+	uint8_t *expire_opt = knot_pkt_edns_option(pkt, KNOT_EDNS_OPTION_EXPIRE);
+	if (expire_opt != NULL && knot_edns_opt_get_length(expire_opt) == sizeof(uint32_t)) {
+		q->result.has_expire = true;
+		q->result.expire = knot_wire_read_u32(knot_edns_opt_get_data(expire_opt));
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Finds the query matching the response sender, ID, and question. */
+static probe_query_t *query_match(const probe_socket_t *s, const knot_pkt_t *pkt,
+                                  const struct sockaddr_storage *from)
+{
+	if (!knot_wire_get_qr(pkt->wire) ||
+	    knot_pkt_qtype(pkt) != KNOT_RRTYPE_SOA ||
+	    knot_pkt_qclass(pkt) != KNOT_CLASS_IN) {
+		return NULL;
+	}
+
+	uint16_t id = knot_wire_get_id(pkt->wire);
+	for (unsigned i = 0; i < s->sent; i++) {
+		probe_query_t *q = s->queries[i];
+		if (q != NULL && q->id == id &&
+		    sockaddr_cmp(from, &q->result.remote, false) == 0 &&
+		    knot_dname_is_case_equal(knot_pkt_qname(pkt), q->zone)) {
+			return q;
+		}
+	}
+
+	return NULL;
+}
+
+/*! \brief Reads the pending responses on the socket. */
+static void socket_recv(soa_probe_t *probe, probe_socket_t *s, probe_query_t **done)
+{
+	while (true) {
+		struct sockaddr_storage from = { 0 };
+		socklen_t from_len = sizeof(from);
+		ssize_t len = recvfrom(s->fd, probe->buf, sizeof(probe->buf), 0,
+		                       (struct sockaddr *)&from, &from_len);
+		if (len < 0) {
+			// Nothing else to read, or an error polled again if more data.
+			return;
+		} else if (len < KNOT_WIRE_HEADER_SIZE) {
+			continue;
+		}
+
+		knot_pkt_t *pkt = knot_pkt_new(probe->buf, len, NULL);
+		if (pkt == NULL) {
+			return;
+		}
+		probe_query_t *q = NULL;
+		if (knot_pkt_parse(pkt, 0) == KNOT_EOK) {
+			q = query_match(s, pkt, &from);
+		}
+		if (q != NULL) {
+			q->result.ret = query_answer(q, pkt);
+			query_remove(probe, q);
+			q->next = *done;
+			*done = q;
+		}
+		knot_pkt_free(pkt);
+	}
+}
+
+/*! \brief Sends the submitted queries, the failed ones are completed. */
+static void queries_send(soa_probe_t *probe, probe_query_t **done)
+{
+	pthread_mutex_lock(&probe->lock);
+	probe_query_t *submitted = probe->submitted;
+	probe->submitted = NULL;
+	pthread_mutex_unlock(&probe->lock);
+
+	while (submitted != NULL) {
+		probe_query_t *q = submitted;
+		submitted = q->next;
+		q->result.ret = query_send(probe, q);
+		if (q->result.ret != KNOT_EOK) {
+			q->next = *done;
+			*done = q;
+		}
+	}
+}
+
+/*! \brief Removes the queries with passed deadline. */
+static void queries_expire(soa_probe_t *probe, uint64_t now, probe_query_t **done)
+{
+	while (!EMPTY_HEAP(&probe->deadlines)) {
+		probe_query_t *q = (probe_query_t *)*HHEAD(&probe->deadlines);
+		if (q->deadline > now) {
+			break;
+		}
+		query_remove(probe, q);
+		q->result.ret = KNOT_ETIMEOUT;
+		q->next = *done;
+		*done = q;
+	}
+}
+
+static int probe_run(dthread_t *thread)
+{
+	soa_probe_t *probe = thread->data;
+
+	while (!dt_is_cancelled(thread)) {
+		probe_query_t *done = NULL;
+		queries_send(probe, &done);
+
+		int timeout = -1;
+		if (done != NULL) {
+			timeout = 0;
+		} else if (!EMPTY_HEAP(&probe->deadlines)) {
+			probe_query_t *first = (probe_query_t *)*HHEAD(&probe->deadlines);
+			uint64_t now = time_ms();
+			uint64_t wait = first->deadline > now ? first->deadline - now : 0;
+			timeout = wait > INT_MAX ? INT_MAX : wait;
+		}
+
+		fdset_it_t it;
+		(void)fdset_poll(&probe->set, &it, 0, timeout);
+
+		for (; !fdset_it_is_done(&it); fdset_it_next(&it)) {
+			probe_socket_t *s = fdset_it_get_ctx(&it);
+			if (s == NULL) {
+				int fd = fdset_it_get_fd(&it);
+				while (read(fd, probe->buf, sizeof(probe->buf)) > 0);
+			} else if (fdset_it_is_pollin(&it) || fdset_it_is_error(&it)) {
+				socket_recv(probe, s, &done);
+			}
+		}
+		fdset_it_commit(&it);
+
+		queries_expire(probe, time_ms(), &done);
+		sockets_sweep(probe);
+
+		// Callbacks can submit again, the queries are sent in the next round.
+		while (done != NULL) {
+			probe_query_t *q = done;
+			done = q->next;
+			probe->cb(q->zone, &q->result, probe->cb_data);
+			query_free(q);
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int pipe_nonblock(int fds[2])
+{
+	if (pipe(fds) != 0) {
+		return knot_map_errno();
+	}
+
+	for (int i = 0; i < 2; i++) {
+		int flags = fcntl(fds[i], F_GETFL);
+		if (flags < 0 || fcntl(fds[i], F_SETFL, flags | O_NONBLOCK) != 0) {
+			int ret = knot_map_errno();
+			close(fds[0]);
+			close(fds[1]);
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+soa_probe_t *soa_probe_create(soa_probe_cb_t cb, void *data)
+{
+	if (cb == NULL) {
+		return NULL;
+	}
+
+	soa_probe_t *probe = calloc(1, sizeof(*probe));
+	if (probe == NULL) {
+		return NULL;
+	}
+
+	probe->cb = cb;
+	probe->cb_data = data;
+	probe->notify[0] = probe->notify[1] = -1;
+	pthread_mutex_init(&probe->lock, NULL);
+	heap_init(&probe->deadlines, deadline_cmp, 0);
+
+	if (fdset_init(&probe->set, FDSET_RESIZE_STEP) != KNOT_EOK) {
+		heap_deinit(&probe->deadlines);
+		pthread_mutex_destroy(&probe->lock);
+		free(probe);
+		return NULL;
+	}
+
+	if (pipe_nonblock(probe->notify) != KNOT_EOK ||
+	    fdset_add(&probe->set, probe->notify[0], FDSET_POLLIN, NULL) < 0) {
+		soa_probe_destroy(probe);
+		return NULL;
+	}
+
+	probe->thread = dt_create(1, probe_run, NULL, probe);
+	if (probe->thread == NULL) {
+		soa_probe_destroy(probe);
+		return NULL;
+	}
+
+	return probe;
+}
+
+void soa_probe_destroy(soa_probe_t *probe)
+{
+	if (probe == NULL) {
+		return;
+	}
+
+	if (probe->thread != NULL) {
+		dt_delete(&probe->thread);
+	}
+
+	while (probe->submitted != NULL) {
+		probe_query_t *q = probe->submitted;
+		probe->submitted = q->next;
+		query_free(q);
+	}
+	while (probe->sockets != NULL) {
+		probe_socket_t *s = probe->sockets;
+		probe->sockets = s->next;
+		for (unsigned i = 0; i < s->sent; i++) {
+			if (s->queries[i] != NULL) {
+				query_free(s->queries[i]);
+			}
+		}
+		close(s->fd);
+		free(s);
+	}
+	heap_deinit(&probe->deadlines);
+	fdset_clear(&probe->set);
+
+	if (probe->notify[0] >= 0) {
+		close(probe->notify[0]);
+		close(probe->notify[1]);
+	}
+
+	pthread_mutex_destroy(&probe->lock);
+	free(probe);
+}
+
+void soa_probe_start(soa_probe_t *probe)
+{
+	if (probe != NULL) {
+		dt_start(probe->thread);
+	}
+}
+
+void soa_probe_stop(soa_probe_t *probe)
+{
+	if (probe != NULL) {
+		dt_stop(probe->thread);
+		probe_wakeup(probe);
+	}
+}
+
+void soa_probe_join(soa_probe_t *probe)
+{
+	if (probe != NULL) {
+		dt_join(probe->thread);
+	}
+}
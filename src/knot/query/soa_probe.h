@@ -0,0 +1,107 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Asynchronous SOA queries.
+ *
+ * The engine keeps all outstanding SOA queries of zone refreshes in one
+ * thread. The queries are sent from a small pool of shared UDP sockets with
+ * random source ports, which are replaced regularly, and the response must
+ * come from the remote and match the random message ID and the question.
+ * The number of outstanding queries isn't limited. A completion callback is
+ * called for each submitted query exactly once, either with the received
+ * serial, or with an error (timeout, truncation, error rcode, TSIG failure,
+ * etc.).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "knot/conf/conf.h"
+#include "knot/query/query.h"
+#include "libknot/dname.h"
+
+typedef struct soa_probe soa_probe_t;
+
+/*!
+ * \brief Result of an asynchronous SOA query.
+ */
+typedef struct {
+	struct sockaddr_storage remote; //!< Queried remote address.
+	int ret;                        //!< KNOT_EOK if the serial is valid.
+	uint32_t serial;                //!< Remote SOA serial.
+	bool has_expire;                //!< EDNS EXPIRE option was received.
+	uint32_t expire;                //!< Received EDNS EXPIRE value.
+} soa_probe_result_t;
+
+/*!
+ * \brief Query completion callback.
+ *
+ * \note The callback is called from the engine thread.
+ */
+typedef void (*soa_probe_cb_t)(const knot_dname_t *zone,
+                               const soa_probe_result_t *result, void *data);
+
+/*!
+ * \brief Creates the SOA query engine.
+ *
+ * \param cb    Completion callback.
+ * \param data  Callback context.
+ *
+ * \return Engine or NULL if error.
+ */
+soa_probe_t *soa_probe_create(soa_probe_cb_t cb, void *data);
+
+/*!
+ * \brief Destroys the engine, outstanding queries are dropped without callbacks.
+ */
+void soa_probe_destroy(soa_probe_t *probe);
+
+/*!
+ * \brief Starts the engine thread.
+ */
+void soa_probe_start(soa_probe_t *probe);
+
+/*!
+ * \brief Signals the engine thread to stop.
+ */
+void soa_probe_stop(soa_probe_t *probe);
+
+/*!
+ * \brief Waits for the engine thread to finish.
+ */
+void soa_probe_join(soa_probe_t *probe);
+
+/*!
+ * \brief Prepares a SOA query and registers it for asynchronous completion.
+ *
+ * The query is sent by the engine thread, a sending failure is reported
+ * by the completion callback.
+ *
+ * \param probe       SOA query engine.
+ * \param zone        Zone name.
+ * \param remote      Remote server (address, source address, TSIG key).
+ * \param edns        EDNS parameters (NULL to disable EDNS).
+ * \param timeout_ms  Query timeout.
+ *
+ * \return KNOT_E*
+ */
+int soa_probe_submit(soa_probe_t *probe, const knot_dname_t *zone,
+                     const conf_remote_t *remote, const query_edns_data_t *edns,
+                     int timeout_ms);
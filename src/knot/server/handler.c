@@ -33,6 +33,7 @@ void handle_query(knotd_qdata_params_t *params, knot_layer_t *layer,
 		    proxyv2_header_strip(&query, params->remote, proxied_remote) == KNOT_EOK) {
 			assert(proxied_remote);
 			params->remote = proxied_remote;
+			params->flags |= KNOTD_QUERY_FLAG_PROXIED;
 		} else {
 			query->parsed--; // artificially decreasing "parsed" leads to FORMERR
 		}
@@ -14,8 +14,12 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+#include <errno.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <string.h>
+#include <sys/socket.h>
 
 #include "contrib/macros.h"
 #include "knot/common/log.h"
@@ -30,25 +34,157 @@ static void quic_log_cb(const char *line)
 	log_debug("QUIC: %s", line);
 }
 
-static int uq_alloc_reply(knot_quic_reply_t *r)
+#ifdef UDP_SEGMENT
+#define QUIC_GSO_MAX_SEGS 64    /*!< Kernel limit of segments in one message. */
+#define QUIC_GSO_MAX_SIZE 65000 /*!< Safe limit of one coalesced message. */
+#endif
+
+/*! \brief Outgoing packets of one connection, possibly coalesced for GSO. */
+typedef struct {
+	int fd;                 /*!< Socket to send through. */
+	struct msghdr *mh;      /*!< Prepared outgoing message (address, control). */
+	uint8_t *buf;           /*!< Output buffer. */
+	size_t len;             /*!< Length of the coalesced packets. */
+	size_t seg_size;        /*!< Size of each but the last coalesced packet. */
+	unsigned segs;          /*!< Number of coalesced packets. */
+	bool *gso;              /*!< GSO enabled, cleared if not supported. */
+} uq_batch_t;
+
+/*! \brief Control message to fit IP_PKTINFO or IPv6_PKTINFO and UDP GSO. */
+typedef union {
+	struct cmsghdr cmsg;
+	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(int)) +
+	            CMSG_SPACE(sizeof(uint16_t))];
+} uq_cmsg_t;
+
+/*! \brief Send one message, return the number of bytes sent or a negative errno. */
+static ssize_t uq_sendmsg(uq_batch_t *b, uint8_t *data, size_t len, uint16_t seg_size)
 {
-	r->out_payload->iov_len = KNOT_WIRE_MAX_PKTSIZE;
+	struct iovec iov = { .iov_base = data, .iov_len = len };
+	struct msghdr mh = *b->mh;
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
 
-	return KNOT_EOK;
+#ifdef UDP_SEGMENT
+	uq_cmsg_t ctrl;
+	if (seg_size > 0) {
+		assert(mh.msg_controllen + CMSG_SPACE(sizeof(uint16_t)) <= sizeof(ctrl.buf));
+		memset(&ctrl, 0, sizeof(ctrl));
+		if (mh.msg_controllen > 0) {
+			memcpy(ctrl.buf, mh.msg_control, mh.msg_controllen);
+		}
+		struct cmsghdr *cmsg = (struct cmsghdr *)(ctrl.buf + mh.msg_controllen);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		memcpy(CMSG_DATA(cmsg), &seg_size, sizeof(uint16_t));
+
+		mh.msg_control = ctrl.buf;
+		mh.msg_controllen += CMSG_SPACE(sizeof(uint16_t));
+	}
+#else
+	assert(seg_size == 0);
+#endif
+
+	ssize_t ret = sendmsg(b->fd, &mh, 0);
+	return (ret < 0) ? -errno : ret;
 }
 
-static int uq_send_reply(knot_quic_reply_t *r)
+static int uq_send_result(ssize_t ret, size_t len)
 {
-	int ret = sendmsg(*(int *)r->sock, r->out_ctx, 0);
 	if (ret < 0) {
-		return knot_map_errno();
-	} else if (ret == r->out_payload->iov_len) {
+		return knot_map_errno_code(-ret);
+	} else if (ret == len) {
 		return KNOT_EOK;
 	} else {
 		return KNOT_EAGAIN;
 	}
 }
 
+static int uq_flush(uq_batch_t *b)
+{
+	if (b->segs == 0) {
+		return KNOT_EOK;
+	}
+
+	size_t len = b->len;
+	ssize_t ret = uq_sendmsg(b, b->buf, len, b->segs > 1 ? b->seg_size : 0);
+	if (b->segs > 1 && (ret == -EIO || ret == -EINVAL || (ret >= 0 && ret < len))) {
+		size_t sent = 0;
+		if (ret < 0) {
+			// The outgoing device doesn't support segmentation offload.
+			*b->gso = false;
+		} else {
+			sent = ret - ret % b->seg_size;
+		}
+		// Send the unsent remainder segment by segment.
+		for (size_t off = sent; off < b->len; off += b->seg_size) {
+			len = MIN(b->seg_size, b->len - off);
+			ret = uq_sendmsg(b, b->buf + off, len, 0);
+			if (ret != len) {
+				break;
+			}
+		}
+	}
+
+	b->len = 0;
+	b->segs = 0;
+
+	return uq_send_result(ret, len);
+}
+
+static int uq_alloc_reply(knot_quic_reply_t *r)
+{
+	uq_batch_t *b = r->sock;
+
+#ifdef UDP_SEGMENT
+	if (*b->gso) {
+		if (b->segs > 0 && (b->segs >= QUIC_GSO_MAX_SEGS ||
+		                    b->len + b->seg_size > QUIC_GSO_MAX_SIZE)) {
+			int ret = uq_flush(b);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
+		r->out_payload->iov_base = b->buf + b->len;
+		r->out_payload->iov_len = QUIC_GSO_MAX_SIZE - b->len;
+		return KNOT_EOK;
+	}
+#endif
+	r->out_payload->iov_len = KNOT_WIRE_MAX_PKTSIZE;
+
+	return KNOT_EOK;
+}
+
+static int uq_send_reply(knot_quic_reply_t *r)
+{
+	uq_batch_t *b = r->sock;
+	size_t len = r->out_payload->iov_len;
+
+#ifdef UDP_SEGMENT
+	if (*b->gso) {
+		int ret = KNOT_EOK;
+		if (b->segs > 0 && len > b->seg_size) {
+			// Only the last segment can be shorter, start a new batch.
+			uint8_t *pkt = r->out_payload->iov_base;
+			ret = uq_flush(b);
+			memmove(b->buf, pkt, len);
+		}
+		if (b->segs == 0) {
+			b->seg_size = len;
+		}
+		b->len += len;
+		b->segs++;
+		if (len < b->seg_size) {
+			int flush_ret = uq_flush(b);
+			ret = (ret == KNOT_EOK) ? flush_ret : ret;
+		}
+		return ret;
+	}
+#endif
+	return uq_send_result(uq_sendmsg(b, b->buf, len, 0), len);
+}
+
 static void uq_free_reply(knot_quic_reply_t *r)
 {
 	// This prevents udp send handler from sending.
@@ -56,15 +192,22 @@ static void uq_free_reply(knot_quic_reply_t *r)
 }
 
 void quic_handler(knotd_qdata_params_t *params, knot_layer_t *layer,
-                  uint64_t idle_close, knot_quic_table_t *table,
+                  uint64_t idle_close, knot_quic_table_t *table, bool *gso,
                   struct iovec *rx, struct msghdr *mh_out)
 {
+	uq_batch_t batch = {
+		.fd = params->socket,
+		.mh = mh_out,
+		.buf = mh_out->msg_iov->iov_base,
+		.gso = gso,
+	};
+
 	knot_quic_reply_t rpl = {
 		.ip_rem = params->remote,
 		.ip_loc = params->local,
 		.in_payload = rx,
 		.out_payload = mh_out->msg_iov,
-		.sock = &params->socket,
+		.sock = &batch,
 		.out_ctx = mh_out,
 		.alloc_reply = uq_alloc_reply,
 		.send_reply = uq_send_reply,
@@ -77,6 +220,11 @@ void quic_handler(knotd_qdata_params_t *params, knot_layer_t *layer,
 	handle_quic_streams(conn, params, layer, NULL);
 
 	(void)knot_quic_send(table, conn, &rpl, QUIC_MAX_SEND_PER_RECV, false);
+	(void)uq_flush(&batch);
+
+	// Everything has been sent, restore the output buffer.
+	mh_out->msg_iov->iov_base = batch.buf;
+	mh_out->msg_iov->iov_len = 0;
 
 	knot_quic_cleanup(&conn, 1);
 }
@@ -32,11 +32,13 @@ struct server;
  * \param layer         Query processing layer.
  * \param idle_close    QUIC policy when to close idel connections, in nanoseconds.
  * \param table         QUIC connection table.
+ * \param gso           In/out: coalesce outgoing packets using GSO, cleared
+ *                      if not supported by the outgoing device.
  * \param rx            Incoming packet payload.
  * \param mh_out        Msghdr for outgoing packets.
  */
 void quic_handler(knotd_qdata_params_t *params, knot_layer_t *layer,
-                  uint64_t idle_close, knot_quic_table_t *table,
+                  uint64_t idle_close, knot_quic_table_t *table, bool *gso,
                   struct iovec *rx, struct msghdr *mh_out);
 
 /*!
@@ -20,7 +20,9 @@
 #include <gnutls/x509.h>
 #include <sys/types.h>   // OpenBSD
 #include <netinet/tcp.h> // TCP_FASTOPEN
+#include <netinet/udp.h> // UDP_GRO
 #include <sys/resource.h>
+#include <urcu.h>
 
 #include "libknot/libknot.h"
 #include "libknot/yparser/ypschema.h"
@@ -150,6 +152,48 @@ static bool server_attach_reuseport_bpf(const int sock, const int sock_count)
 #endif
 }
 
+/*!
+ * \brief Attach SO_REUSEPORT socket filter steering QUIC packets by connection ID.
+ *
+ * The socket is selected by the first byte of the Destination Connection ID,
+ * which is generated by the server so that it refers to the owning worker.
+ *
+ * \param sock        Socket where to attach the CBPF filter to.
+ * \param sock_count  Number of sockets.
+ */
+static bool server_attach_reuseport_quic_bpf(const int sock, const int sock_count)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+	if (sock_count > UINT8_MAX + 1) {
+		return false;
+	}
+
+	struct sock_filter code[] = {
+		/* A = first byte of the UDP payload (QUIC header form). */
+		{ BPF_LD  | BPF_B | BPF_ABS, 0, 0, 0 },
+		/* Long header? */
+		{ BPF_JMP | BPF_JSET | BPF_K, 2, 0, 0x80 },
+		/* Short header: A = first byte of DCID. */
+		{ BPF_LD  | BPF_B | BPF_ABS, 0, 0, 1 },
+		{ BPF_JMP | BPF_JA, 0, 0, 1 },
+		/* Long header: A = first byte of DCID (after version and DCID length). */
+		{ BPF_LD  | BPF_B | BPF_ABS, 0, 0, 6 },
+		/* Adjust the byte to socket group size. */
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, sock_count },
+		/* Return A. */
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+
+	struct sock_fprog prog = { 0 };
+	prog.len = sizeof(code) / sizeof(*code);
+	prog.filter = code;
+
+	return setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+#else
+	return false;
+#endif
+}
+
 /*! \brief Set lower bound for socket option. */
 static bool setsockopt_min(int sock, int option, int min)
 {
@@ -209,6 +253,19 @@ static bool enable_pktinfo(int sock, int family)
 	return setsockopt(sock, level, option, &on, sizeof(on)) == 0;
 }
 
+/*!
+ * \brief Enable receiving of coalesced datagrams (Linux 5.0+).
+ */
+static bool enable_gro(int sock)
+{
+#if defined(ENABLE_RECVMMSG) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+	const int on = 1;
+	return setsockopt(sock, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+#else
+	return false;
+#endif
+}
+
 /*!
  * Linux 3.15 has IP_PMTUDISC_OMIT which makes sockets
  * ignore PMTU information and send packets with DF=0.
@@ -335,17 +392,20 @@ static iface_t *server_init_xdp_iface(struct sockaddr_storage *addr, bool route_
  *
  * \param addr              Socket address.
  * \param quic              QUIC interface indication.
+ * \param tls               DoT interface indication (TCP only).
  * \param udp_thread_count  Number of created UDP workers.
  * \param tcp_thread_count  Number of created TCP workers.
  * \param tcp_reuseport     Indication if reuseport on TCP is enabled.
  * \param socket_affinity   Indication if CBPF should be attached.
+ * \param udp_gso           Indication if UDP GRO should be enabled.
  *
  * \retval Pointer to a new initialized interface.
  * \retval NULL if error.
  */
 static iface_t *server_init_iface(struct sockaddr_storage *addr, bool quic,
-                                  int udp_thread_count, int tcp_thread_count,
-                                  bool tcp_reuseport, bool socket_affinity)
+                                  bool tls, int udp_thread_count, int tcp_thread_count,
+                                  bool tcp_reuseport, bool socket_affinity,
+                                  bool udp_gso)
 {
 	iface_t *new_if = calloc(1, sizeof(*new_if));
 	if (new_if == NULL) {
@@ -358,13 +418,13 @@ static iface_t *server_init_iface(struct sockaddr_storage *addr, bool quic,
 	char addr_str[SOCKADDR_STRLEN] = { 0 };
 	sockaddr_tostr(addr_str, sizeof(addr_str), addr);
 
-	int udp_socket_count = 1;
+	int udp_socket_count = !tls ? 1 : 0;
 	int udp_bind_flags = 0;
 	int tcp_socket_count = !quic ? 1 : 0;
 	int tcp_bind_flags = 0;
 
 #ifdef ENABLE_REUSEPORT
-	udp_socket_count = udp_thread_count;
+	udp_socket_count = !tls ? udp_thread_count : 0;
 	udp_bind_flags |= NET_BIND_MULTIPLE;
 
 	if (!quic && tcp_reuseport) {
@@ -388,6 +448,10 @@ static iface_t *server_init_iface(struct sockaddr_storage *addr, bool quic,
 	bool warn_bufsize = true;
 	bool warn_pktinfo = true;
 	bool warn_flag_misc = true;
+	bool warn_gro = true;
+
+	new_if->quic_steer = quic && (udp_bind_flags & NET_BIND_MULTIPLE) &&
+	                     udp_socket_count > 1;
 
 	/* Create bound UDP sockets. */
 	for (int i = 0; i < udp_socket_count; i++) {
@@ -408,8 +472,14 @@ static iface_t *server_init_iface(struct sockaddr_storage *addr, bool quic,
 			return NULL;
 		}
 
+		if (new_if->quic_steer &&
+		    !server_attach_reuseport_quic_bpf(sock, udp_socket_count)) {
+			log_warning("cannot steer QUIC connections to UDP workers");
+			new_if->quic_steer = false;
+		}
+
 		if ((udp_bind_flags & NET_BIND_MULTIPLE) && socket_affinity &&
-		    addr->ss_family != AF_UNIX) {
+		    addr->ss_family != AF_UNIX && !new_if->quic_steer) {
 			if (!server_attach_reuseport_bpf(sock, udp_socket_count) &&
 			    warn_cbpf) {
 				log_warning("cannot ensure optimal CPU locality for UDP");
@@ -438,6 +508,12 @@ static iface_t *server_init_iface(struct sockaddr_storage *addr, bool quic,
 			warn_flag_misc = false;
 		}
 
+		if (udp_gso && !quic && addr->ss_family != AF_UNIX &&
+		    !enable_gro(sock) && warn_gro) {
+			log_warning("failed to enable GRO for UDP");
+			warn_gro = false;
+		}
+
 		new_if->fd_udp[new_if->fd_udp_count] = sock;
 		new_if->fd_udp_count += 1;
 	}
@@ -526,6 +602,22 @@ static void log_sock_conf(conf_t *conf)
 		strlcat(buf, "/outgoing", sizeof(buf));
 	}
 	strlcat(buf, " TCP Fast Open", sizeof(buf));
+#endif
+#if defined(ENABLE_RECVMMSG) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+	if (conf->cache.srv_udp_gso) {
+		if (buf[0] != '\0') {
+			strlcat(buf, ", ", sizeof(buf));
+		}
+		strlcat(buf, "UDP GSO/GRO", sizeof(buf));
+	}
+#endif
+#if defined(ENABLE_IO_URING)
+	if (conf->cache.srv_io_uring) {
+		if (buf[0] != '\0') {
+			strlcat(buf, ", ", sizeof(buf));
+		}
+		strlcat(buf, "io_uring", sizeof(buf));
+	}
 #endif
 	if (buf[0] != '\0') {
 		log_info("using %s", buf);
@@ -588,11 +680,14 @@ static int configure_sockets(conf_t *conf, server_t *s)
 
 	conf_val_t listen_val = conf_get(conf, C_SRV, C_LISTEN);
 	conf_val_t liquic_val = conf_get(conf, C_SRV, C_LISTEN_QUIC);
+	conf_val_t listls_val = conf_get(conf, C_SRV, C_LISTEN_TLS);
 	conf_val_t lisxdp_val = conf_get(conf, C_XDP, C_LISTEN);
 	conf_val_t rundir_val = conf_get(conf, C_SRV, C_RUNDIR);
 	uint16_t convent_quic = conf_val_count(&liquic_val);
+	uint16_t convent_tls = conf_val_count(&listls_val);
 
-	if (listen_val.code == KNOT_EOK || liquic_val.code == KNOT_EOK) {
+	if (listen_val.code == KNOT_EOK || liquic_val.code == KNOT_EOK ||
+	    listls_val.code == KNOT_EOK) {
 		log_sock_conf(conf);
 	} else if (lisxdp_val.code != KNOT_EOK) {
 		log_warning("no network interface configured");
@@ -618,7 +713,7 @@ static int configure_sockets(conf_t *conf, server_t *s)
 
 	size_t real_nifs = 0;
 	size_t nifs = conf_val_count(&listen_val) + conf_val_count(&liquic_val) +
-	              conf_val_count(&lisxdp_val);
+	              conf_val_count(&listls_val) + conf_val_count(&lisxdp_val);
 	iface_t *newlist = calloc(nifs, sizeof(*newlist));
 	if (newlist == NULL) {
 		log_error("failed to allocate memory for network sockets");
@@ -630,6 +725,11 @@ static int configure_sockets(conf_t *conf, server_t *s)
 	unsigned size_tcp = s->handlers[IO_TCP].handler.unit->size;
 	bool tcp_reuseport = conf->cache.srv_tcp_reuseport;
 	bool socket_affinity = conf->cache.srv_socket_affinity;
+	bool udp_gso = conf->cache.srv_udp_gso;
+#ifdef ENABLE_IO_URING
+	/* Coalesced datagrams aren't expected by the io_uring workers. */
+	udp_gso = udp_gso && !conf->cache.srv_io_uring;
+#endif
 	char *rundir = conf_abs_path(&rundir_val, NULL);
 	while (listen_val.code == KNOT_EOK) {
 		struct sockaddr_storage addr = conf_addr(&listen_val, rundir);
@@ -637,8 +737,9 @@ static int configure_sockets(conf_t *conf, server_t *s)
 		sockaddr_tostr(addr_str, sizeof(addr_str), &addr);
 		log_info("binding to interface %s", addr_str);
 
-		iface_t *new_if = server_init_iface(&addr, false, size_udp, size_tcp,
-		                                    tcp_reuseport, socket_affinity);
+		iface_t *new_if = server_init_iface(&addr, false, false, size_udp,
+		                                    size_tcp, tcp_reuseport,
+		                                    socket_affinity, udp_gso);
 		if (new_if == NULL) {
 			server_deinit_iface_list(newlist, nifs);
 			free(rundir);
@@ -655,8 +756,8 @@ static int configure_sockets(conf_t *conf, server_t *s)
 		sockaddr_tostr(addr_str, sizeof(addr_str), &addr);
 		log_info("binding to QUIC interface %s", addr_str);
 
-		iface_t *new_if = server_init_iface(&addr, true, size_udp, 0,
-		                                    false, socket_affinity);
+		iface_t *new_if = server_init_iface(&addr, true, false, size_udp, 0,
+		                                    false, socket_affinity, false);
 		if (new_if == NULL) {
 			server_deinit_iface_list(newlist, nifs);
 			free(rundir);
@@ -668,6 +769,26 @@ static int configure_sockets(conf_t *conf, server_t *s)
 
 		conf_val_next(&liquic_val);
 	}
+	while (listls_val.code == KNOT_EOK) {
+		struct sockaddr_storage addr = conf_addr(&listls_val, rundir);
+		char addr_str[SOCKADDR_STRLEN] = { 0 };
+		sockaddr_tostr(addr_str, sizeof(addr_str), &addr);
+		log_info("binding to TLS interface %s", addr_str);
+
+		iface_t *new_if = server_init_iface(&addr, false, true, 0, size_tcp,
+		                                    tcp_reuseport, socket_affinity,
+		                                    false);
+		if (new_if == NULL) {
+			server_deinit_iface_list(newlist, nifs);
+			free(rundir);
+			return KNOT_ERROR;
+		}
+		new_if->tls = true;
+		memcpy(&newlist[real_nifs++], new_if, sizeof(*newlist));
+		free(new_if);
+
+		conf_val_next(&listls_val);
+	}
 	free(rundir);
 
 	/* XDP sockets. */
@@ -697,8 +818,8 @@ static int configure_sockets(conf_t *conf, server_t *s)
 	assert(real_nifs <= nifs);
 	nifs = real_nifs;
 
-	/* QUIC credentials initialization. */
-	if (xdp_quic > 0 || convent_quic > 0) {
+	/* QUIC and TLS credentials initialization. */
+	if (xdp_quic > 0 || convent_quic > 0 || convent_tls > 0) {
 		if (init_creds(s, conf) != KNOT_EOK) {
 			server_deinit_iface_list(newlist, nifs);
 			return KNOT_ERROR;
@@ -721,6 +842,19 @@ static int configure_sockets(conf_t *conf, server_t *s)
 	return KNOT_EOK;
 }
 
+static void soa_probe_cb(const knot_dname_t *zone_name,
+                         const soa_probe_result_t *result, void *data)
+{
+	server_t *server = data;
+
+	rcu_read_lock();
+	zone_t *zone = knot_zonedb_find(server->zone_db, zone_name);
+	if (zone != NULL) {
+		zone_refresh_probe_done(zone, result);
+	}
+	rcu_read_unlock();
+}
+
 int server_init(server_t *server, int bg_workers)
 {
 	if (server == NULL) {
@@ -741,8 +875,16 @@ int server_init(server_t *server, int bg_workers)
 		return KNOT_ENOMEM;
 	}
 
+	server->soa_probe = soa_probe_create(soa_probe_cb, server);
+	if (server->soa_probe == NULL) {
+		worker_pool_destroy(server->workers);
+		evsched_deinit(&server->sched);
+		return KNOT_ENOMEM;
+	}
+
 	int ret = catalog_update_init(&server->catalog_upd);
 	if (ret != KNOT_EOK) {
+		soa_probe_destroy(server->soa_probe);
 		worker_pool_destroy(server->workers);
 		evsched_deinit(&server->sched);
 		return ret;
@@ -750,6 +892,9 @@ int server_init(server_t *server, int bg_workers)
 
 	zone_backups_init(&server->backup_ctxs);
 
+	pthread_mutex_init(&server->ctl_lock.mutex, NULL);
+	pthread_cond_init(&server->ctl_lock.cond, NULL);
+
 	char *catalog_dir = conf_db(conf(), C_CATALOG_DB);
 	conf_val_t catalog_size = conf_db_param(conf(), C_CATALOG_DB_MAX_SIZE);
 	catalog_init(&server->catalog, catalog_dir, conf_int(&catalog_size));
@@ -759,7 +904,9 @@ int server_init(server_t *server, int bg_workers)
 	char *journal_dir = conf_db(conf(), C_JOURNAL_DB);
 	conf_val_t journal_size = conf_db_param(conf(), C_JOURNAL_DB_MAX_SIZE);
 	conf_val_t journal_mode = conf_db_param(conf(), C_JOURNAL_DB_MODE);
+	conf_val_t journal_group = conf_db_param(conf(), C_JOURNAL_DB_GROUP_COMMIT);
 	knot_lmdb_init(&server->journaldb, journal_dir, conf_int(&journal_size), journal_env_flags(conf_opt(&journal_mode), false), NULL);
+	server->journaldb.group_commit_ms = conf_int(&journal_group);
 	free(journal_dir);
 
 	kasp_db_ensure_init(&server->kaspdb, conf());
@@ -795,6 +942,7 @@ void server_deinit(server_t *server)
 
 	/* Free threads and event handlers. */
 	worker_pool_destroy(server->workers);
+	soa_probe_destroy(server->soa_probe);
 
 	/* Free zone database. */
 	knot_zonedb_deep_free(&server->zone_db, true);
@@ -816,6 +964,9 @@ void server_deinit(server_t *server)
 	/* Close journal database if open. */
 	knot_lmdb_deinit(&server->journaldb);
 
+	pthread_cond_destroy(&server->ctl_lock.cond);
+	pthread_mutex_destroy(&server->ctl_lock.mutex);
+
 	/* Close and deinit connection pool. */
 	conn_pool_deinit(global_conn_pool);
 	global_conn_pool = NULL;
@@ -882,7 +1033,7 @@ static void worker_wait_cb(worker_pool_t *pool)
 	/* Too frequent worker_pool_status() call with many zones is expensive. */
 	if (now_ns - last_ns > 1000000000) {
 		int running, queued;
-		worker_pool_status(pool, true, &running, &queued);
+		worker_pool_status(pool, &running, &queued);
 		systemd_tasks_status_notify(running + queued);
 		last_ns = now_ns;
 	}
@@ -906,6 +1057,9 @@ int server_start(server_t *server, bool async)
 	/* Start evsched handler. */
 	evsched_start(&server->sched);
 
+	/* Start asynchronous SOA queries. */
+	soa_probe_start(server->soa_probe);
+
 	/* Start I/O handlers. */
 	server->state |= ServerRunning;
 	for (int proto = IO_UDP; proto <= IO_XDP; ++proto) {
@@ -928,6 +1082,7 @@ void server_wait(server_t *server)
 
 	evsched_join(&server->sched);
 	worker_pool_join(server->workers);
+	soa_probe_join(server->soa_probe);
 
 	for (int proto = IO_UDP; proto <= IO_XDP; ++proto) {
 		if (server->handlers[proto].size > 0) {
@@ -994,9 +1149,10 @@ static bool listen_changed(conf_t *conf, server_t *server)
 
 	conf_val_t listen_val = conf_get(conf, C_SRV, C_LISTEN);
 	conf_val_t liquic_val = conf_get(conf, C_SRV, C_LISTEN_QUIC);
+	conf_val_t listls_val = conf_get(conf, C_SRV, C_LISTEN_TLS);
 	conf_val_t lisxdp_val = conf_get(conf, C_XDP, C_LISTEN);
 	size_t new_count = conf_val_count(&listen_val) + conf_val_count(&liquic_val) +
-	                   conf_val_count(&lisxdp_val);
+	                   conf_val_count(&listls_val) + conf_val_count(&lisxdp_val);
 	size_t old_count = server->n_ifaces;
 	if (new_count != old_count) {
 		return true;
@@ -1037,6 +1193,21 @@ static bool listen_changed(conf_t *conf, server_t *server)
 		}
 		conf_val_next(&liquic_val);
 	}
+	while (listls_val.code == KNOT_EOK) {
+		struct sockaddr_storage addr = conf_addr(&listls_val, rundir);
+		bool found = false;
+		for (size_t i = 0; i < server->n_ifaces; i++) {
+			if (sockaddr_cmp(&addr, &server->ifaces[i].addr, false) == 0) {
+				matches++;
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			break;
+		}
+		conf_val_next(&listls_val);
+	}
 	free(rundir);
 
 	while (lisxdp_val.code == KNOT_EOK) {
@@ -1065,6 +1236,8 @@ static void warn_server_reconfigure(conf_t *conf, server_t *server)
 
 	static bool warn_tcp_reuseport = true;
 	static bool warn_socket_affinity = true;
+	static bool warn_udp_gso = true;
+	static bool warn_io_uring = true;
 	static bool warn_udp = true;
 	static bool warn_tcp = true;
 	static bool warn_bg = true;
@@ -1085,6 +1258,16 @@ static void warn_server_reconfigure(conf_t *conf, server_t *server)
 		warn_socket_affinity = false;
 	}
 
+	if (warn_udp_gso && conf->cache.srv_udp_gso != conf_get_bool(conf, C_SRV, C_UDP_GSO)) {
+		log_warning(msg, &C_UDP_GSO[1]);
+		warn_udp_gso = false;
+	}
+
+	if (warn_io_uring && conf->cache.srv_io_uring != conf_get_bool(conf, C_SRV, C_IO_URING)) {
+		log_warning(msg, &C_IO_URING[1]);
+		warn_io_uring = false;
+	}
+
 	if (warn_udp && server->handlers[IO_UDP].size != conf_udp_threads(conf)) {
 		log_warning(msg, &C_UDP_WORKERS[1]);
 		warn_udp = false;
@@ -1230,6 +1413,8 @@ void server_stop(server_t *server)
 	evsched_stop(&server->sched);
 	/* Interrupt background workers. */
 	worker_pool_stop(server->workers);
+	/* Stop asynchronous SOA queries. */
+	soa_probe_stop(server->soa_probe);
 
 	/* Clear 'running' flag. */
 	server->state &= ~ServerRunning;
@@ -1270,11 +1455,13 @@ static int reconfigure_journal_db(conf_t *conf, server_t *server)
 	char *journal_dir = conf_db(conf, C_JOURNAL_DB);
 	conf_val_t journal_size = conf_db_param(conf, C_JOURNAL_DB_MAX_SIZE);
 	conf_val_t journal_mode = conf_db_param(conf, C_JOURNAL_DB_MODE);
+	conf_val_t journal_group = conf_db_param(conf, C_JOURNAL_DB_GROUP_COMMIT);
 	int ret = knot_lmdb_reinit(&server->journaldb, journal_dir, conf_int(&journal_size),
 	                           journal_env_flags(conf_opt(&journal_mode), false));
 	if (ret != KNOT_EOK) {
 		log_warning("ignored reconfiguration of journal DB (%s)", knot_strerror(ret));
 	}
+	server->journaldb.group_commit_ms = conf_int(&journal_group);
 	free(journal_dir);
 
 	return KNOT_EOK; // not "ret"
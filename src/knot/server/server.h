@@ -21,6 +21,7 @@
 #include "knot/conf/conf.h"
 #include "knot/catalog/catalog_update.h"
 #include "knot/common/evsched.h"
+#include "knot/query/soa_probe.h"
 #include "knot/common/fdset.h"
 #include "knot/journal/knot_lmdb.h"
 #include "knot/server/dthreads.h"
@@ -74,6 +75,8 @@ typedef struct {
 	unsigned xdp_first_thread_id;
 	bool anyaddr;
 	bool quic;
+	bool quic_steer; /*!< QUIC packets are steered to UDP workers by connection ID. */
+	bool tls;        /*!< DNS over TLS on the TCP sockets. */
 	struct knot_xdp_socket **xdp_sockets;
 	struct sockaddr_storage addr;
 } iface_t;
@@ -114,6 +117,9 @@ typedef struct server {
 	/*! \brief Event scheduler. */
 	evsched_t sched;
 
+	/*! \brief Asynchronous SOA queries of zone refreshes. */
+	soa_probe_t *soa_probe;
+
 	/*! \brief List of interfaces. */
 	iface_t *ifaces;
 	size_t n_ifaces;
@@ -125,6 +131,15 @@ typedef struct server {
 	/*! \brief Context of pending zones' backup. */
 	zone_backup_ctxs_t backup_ctxs;
 
+	/*! \brief Exclusion of control commands and server reloads, see ctl_lock(). */
+	struct {
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		unsigned shared;     // Number of shared holders.
+		unsigned waiting;    // Number of threads waiting for exclusive lock.
+		bool exclusive;      // Locked exclusively.
+	} ctl_lock;
+
 	/*! \brief Crendentials context for QUIC. */
 	struct knot_quic_creds *quic_creds;
 } server_t;
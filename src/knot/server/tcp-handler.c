@@ -43,6 +43,13 @@
 #include "contrib/sockaddr.h"
 #include "contrib/time.h"
 #include "contrib/ucw/mempool.h"
+#ifdef ENABLE_IO_URING
+#include "contrib/uring.h"
+#include "libknot/packet/wire.h"
+#endif // ENABLE_IO_URING
+#ifdef ENABLE_QUIC
+#include "libknot/quic/tls.h"
+#endif // ENABLE_QUIC
 
 /*! \brief TCP context data. */
 typedef struct tcp_context {
@@ -57,6 +64,8 @@ typedef struct tcp_context {
 	unsigned max_worker_fds;         /*!< Max TCP clients per worker configuration + no. of ifaces. */
 	int idle_timeout;                /*!< [s] TCP idle timeout configuration. */
 	int io_timeout;                  /*!< [ms] TCP send/recv timeout configuration. */
+	struct knot_tls_conn **tls;      /*!< DoT connections indexed by socket. */
+	unsigned tls_size;               /*!< Size of the DoT connection table. */
 } tcp_context_t;
 
 #define TCP_SWEEP_INTERVAL 2 /*!< [secs] granularity of connection sweeping. */
@@ -78,11 +87,64 @@ static void update_tcp_conf(tcp_context_t *tcp)
 	rcu_read_unlock();
 }
 
+/*! \brief Get DoT context of a client socket, NULL for plain TCP. */
+static struct knot_tls_conn *tcp_tls_get(const tcp_context_t *tcp, int fd)
+{
+	return (fd < tcp->tls_size) ? tcp->tls[fd] : NULL;
+}
+
+/*! \brief Create DoT context for a newly accepted client socket. */
+static int tcp_tls_add(tcp_context_t *tcp, int fd)
+{
+#ifdef ENABLE_QUIC
+	if (fd >= tcp->tls_size) {
+		unsigned new_size = MAX(2 * tcp->tls_size, fd + 1);
+		struct knot_tls_conn **new_tls = realloc(tcp->tls, new_size * sizeof(*new_tls));
+		if (new_tls == NULL) {
+			return KNOT_ENOMEM;
+		}
+		memset(new_tls + tcp->tls_size, 0,
+		       (new_size - tcp->tls_size) * sizeof(*new_tls));
+		tcp->tls = new_tls;
+		tcp->tls_size = new_size;
+	}
+
+	assert(tcp->tls[fd] == NULL);
+	tcp->tls[fd] = knot_tls_conn_new(tcp->server->quic_creds, fd);
+	return (tcp->tls[fd] != NULL) ? KNOT_EOK : KNOT_ENOMEM;
+#else
+	return KNOT_ENOTSUP;
+#endif // ENABLE_QUIC
+}
+
+/*! \brief Release DoT context of a client socket being closed. */
+static void tcp_tls_del(tcp_context_t *tcp, int fd)
+{
+#ifdef ENABLE_QUIC
+	if (fd >= 0 && fd < tcp->tls_size) {
+		knot_tls_conn_del(tcp->tls[fd]);
+		tcp->tls[fd] = NULL;
+	}
+#endif // ENABLE_QUIC
+}
+
+/*! \brief Check if the DoT connection holds received data not visible to poll. */
+static bool tcp_tls_pending(struct knot_tls_conn *tls)
+{
+#ifdef ENABLE_QUIC
+	return tls != NULL && knot_tls_pending(tls);
+#else
+	return false;
+#endif // ENABLE_QUIC
+}
+
 /*! \brief Sweep TCP connection. */
-static fdset_sweep_state_t tcp_sweep(fdset_t *set, int fd, _unused_ void *data)
+static fdset_sweep_state_t tcp_sweep(fdset_t *set, int fd, void *data)
 {
 	assert(set && fd >= 0);
 
+	tcp_tls_del(data, fd);
+
 	/* Best-effort, name and shame. */
 	struct sockaddr_storage ss = { 0 };
 	socklen_t len = sizeof(struct sockaddr_storage);
@@ -107,7 +169,7 @@ static void tcp_log_error(const struct sockaddr_storage *ss, const char *operati
 }
 
 static unsigned tcp_set_ifaces(const iface_t *ifaces, size_t n_ifaces,
-                               fdset_t *fds, int thread_id)
+                               fdset_t *fds, unsigned tcp_idx)
 {
 	if (n_ifaces == 0) {
 		return 0;
@@ -122,11 +184,9 @@ static unsigned tcp_set_ifaces(const iface_t *ifaces, size_t n_ifaces,
 		int tcp_id = 0;
 #ifdef ENABLE_REUSEPORT
 		if (conf()->cache.srv_tcp_reuseport) {
-			/* Note: thread_ids start with UDP threads, TCP threads follow. */
-			assert((i->fd_udp_count <= thread_id) &&
-			       (thread_id < i->fd_tcp_count + i->fd_udp_count));
-
-			tcp_id = thread_id - i->fd_udp_count;
+			/* Note: DoT interfaces have no UDP sockets. */
+			assert(tcp_idx < i->fd_tcp_count);
+			tcp_id = tcp_idx;
 		}
 #endif
 		int ret = fdset_add(fds, i->fd_tcp[tcp_id], FDSET_POLLIN, (void *)i);
@@ -138,8 +198,31 @@ static unsigned tcp_set_ifaces(const iface_t *ifaces, size_t n_ifaces,
 	return fdset_get_length(fds);
 }
 
-static int tcp_handle(tcp_context_t *tcp, int fd, const sockaddr_t *remote,
-                      const sockaddr_t *local, struct iovec *rx, struct iovec *tx)
+static ssize_t tcp_recv(tcp_context_t *tcp, int fd, struct knot_tls_conn *tls,
+                        uint8_t *buf, size_t size)
+{
+#ifdef ENABLE_QUIC
+	if (tls != NULL) {
+		return knot_tls_recv_dns(tls, buf, size, tcp->io_timeout);
+	}
+#endif // ENABLE_QUIC
+	return net_dns_tcp_recv(fd, buf, size, tcp->io_timeout);
+}
+
+static ssize_t tcp_send(tcp_context_t *tcp, int fd, struct knot_tls_conn *tls,
+                        const uint8_t *buf, size_t size)
+{
+#ifdef ENABLE_QUIC
+	if (tls != NULL) {
+		return knot_tls_send_dns(tls, buf, size, tcp->io_timeout);
+	}
+#endif // ENABLE_QUIC
+	return net_dns_tcp_send(fd, buf, size, tcp->io_timeout, NULL);
+}
+
+static int tcp_handle(tcp_context_t *tcp, int fd, struct knot_tls_conn *tls,
+                      const sockaddr_t *remote, const sockaddr_t *local,
+                      struct iovec *rx, struct iovec *tx)
 {
 	/* Create query processing parameter. */
 	knotd_qdata_params_t params = params_init(KNOTD_QUERY_PROTO_TCP, remote, local,
@@ -149,7 +232,7 @@ static int tcp_handle(tcp_context_t *tcp, int fd, const sockaddr_t *remote,
 	tx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
 
 	/* Receive data. */
-	int recv = net_dns_tcp_recv(fd, rx->iov_base, rx->iov_len, tcp->io_timeout);
+	int recv = tcp_recv(tcp, fd, tls, rx->iov_base, rx->iov_len);
 	if (recv > 0) {
 		rx->iov_len = recv;
 	} else {
@@ -165,8 +248,7 @@ static int tcp_handle(tcp_context_t *tcp, int fd, const sockaddr_t *remote,
 		knot_layer_produce(&tcp->layer, ans);
 		/* Send, if response generation passed and wasn't ignored. */
 		if (ans->size > 0 && send_state(tcp->layer.state)) {
-			int sent = net_dns_tcp_send(fd, ans->wire, ans->size,
-			                            tcp->io_timeout, NULL);
+			int sent = tcp_send(tcp, fd, tls, ans->wire, ans->size);
 			if (sent != ans->size) {
 				tcp_log_error(params.remote, "send", sent);
 				handle_finish(&tcp->layer);
@@ -185,17 +267,27 @@ static void tcp_event_accept(tcp_context_t *tcp, unsigned i, const iface_t *ifac
 	/* Accept client. */
 	int fd = fdset_get_fd(&tcp->set, i);
 	int client = net_accept(fd, NULL);
-	if (client >= 0) {
-		/* Assign to fdset. */
-		int idx = fdset_add(&tcp->set, client, FDSET_POLLIN, (void *)iface);
-		if (idx < 0) {
-			close(client);
-			return;
-		}
+	if (client < 0) {
+		return;
+	}
 
-		/* Update watchdog timer. */
-		(void)fdset_set_watchdog(&tcp->set, idx, tcp->idle_timeout);
+	/* TLS session is established once the client starts the handshake. */
+	if (iface->tls && tcp_tls_add(tcp, client) != KNOT_EOK) {
+		tcp_tls_del(tcp, client);
+		close(client);
+		return;
 	}
+
+	/* Assign to fdset. */
+	int idx = fdset_add(&tcp->set, client, FDSET_POLLIN, (void *)iface);
+	if (idx < 0) {
+		tcp_tls_del(tcp, client);
+		close(client);
+		return;
+	}
+
+	/* Update watchdog timer. */
+	(void)fdset_set_watchdog(&tcp->set, idx, tcp->idle_timeout);
 }
 
 static int tcp_event_serve(tcp_context_t *tcp, unsigned i, const iface_t *iface)
@@ -222,7 +314,34 @@ static int tcp_event_serve(tcp_context_t *tcp, unsigned i, const iface_t *iface)
 		}
 	}
 
-	int ret = tcp_handle(tcp, fd, remote, local, &tcp->iov[0], &tcp->iov[1]);
+	struct knot_tls_conn *tls = tcp_tls_get(tcp, fd);
+#ifdef ENABLE_QUIC
+	if (tls != NULL && !tls->handshake_done) {
+		/* Continued upon the next client data, the watchdog isn't refreshed. */
+		int ret = knot_tls_handshake(tls, tcp->io_timeout);
+		if (ret == KNOT_EAGAIN) {
+			return KNOT_EOK;
+		} else if (ret != KNOT_EOK) {
+			tcp_log_error((struct sockaddr_storage *)remote, "establish TLS", ret);
+			return KNOT_EOF;
+		}
+
+		/* Record crypto is offloaded to the kernel if supported. */
+		(void)knot_tls_ktls_enable(tls);
+
+		/* Wait for the first query unless already received. */
+		if (!tcp_tls_pending(tls)) {
+			(void)fdset_set_watchdog(&tcp->set, i, tcp->idle_timeout);
+			return KNOT_EOK;
+		}
+	}
+#endif // ENABLE_QUIC
+
+	/* Queries already decrypted by GnuTLS aren't signalled by poll. */
+	int ret;
+	do {
+		ret = tcp_handle(tcp, fd, tls, remote, local, &tcp->iov[0], &tcp->iov[1]);
+	} while (ret == KNOT_EOK && tcp_tls_pending(tls));
 	if (ret == KNOT_EOK) {
 		/* Update socket activity timer. */
 		(void)fdset_set_watchdog(&tcp->set, i, tcp->idle_timeout);
@@ -273,12 +392,533 @@ static void tcp_wait_for_events(tcp_context_t *tcp)
 
 		/* Evaluate. */
 		if (should_close) {
+			tcp_tls_del(tcp, fdset_it_get_fd(&it));
 			fdset_it_remove(&it);
 		}
 	}
 	fdset_it_commit(&it);
 }
 
+#ifdef ENABLE_IO_URING
+#define TCP_URING_ENTRIES 1024 /*!< Submission queue size. */
+#define TCP_URING_BUF_MIN 1024 /*!< Initial size of a connection buffer. */
+#define TCP_URING_TX_MAX  (sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE) /*!< Send batch limit. */
+
+/* Operation in the upper part of the completion user data, index in the lower. */
+#define TCP_URING_ACCEPT  (1ULL << 32)
+#define TCP_URING_RECV    (2ULL << 32)
+#define TCP_URING_SEND    (3ULL << 32)
+#define TCP_URING_CANCEL  (4ULL << 32)
+#define TCP_URING_OP_MASK (~0ULL << 32)
+
+typedef struct {
+	const iface_t *iface;
+	int fd;
+	bool armed; /*!< Multishot accept active. */
+} tcp_uring_listener_t;
+
+typedef struct {
+	int fd;                         /*!< Client socket, -1 if unused. */
+	const iface_t *iface;           /*!< Interface the client connected to. */
+	struct sockaddr_storage remote; /*!< Remote address. */
+	struct sockaddr_storage local;  /*!< Local address. */
+	struct timespec active;         /*!< Time of the last activity. */
+	bool busy;                      /*!< Receive or send operation in flight. */
+	bool closing;                   /*!< Connection is being terminated. */
+	uint8_t *rx;                    /*!< Received data. */
+	size_t rx_len;
+	size_t rx_size;
+	uint8_t *tx;                    /*!< Length-prefixed responses to be sent. */
+	size_t tx_len;
+	size_t tx_sent;
+	size_t tx_size;
+} tcp_uring_conn_t;
+
+typedef struct {
+	tcp_context_t *tcp;
+	knot_uring_t ring;
+	tcp_uring_listener_t *listeners;
+	unsigned nlisteners;
+	bool accepting;           /*!< New connections are being accepted. */
+	tcp_uring_conn_t *conns;  /*!< Connection table. */
+	unsigned size;            /*!< Size of the connection table. */
+	unsigned *unused;         /*!< Stack of unused connection indices. */
+	unsigned nunused;
+	unsigned nconns;          /*!< Number of open connections. */
+} tcp_uring_t;
+
+static unsigned tcp_uring_max_clients(const tcp_uring_t *ur)
+{
+	return ur->tcp->max_worker_fds - ur->tcp->client_threshold;
+}
+
+static struct io_uring_sqe *tcp_uring_sqe(tcp_uring_t *ur, uint8_t opcode, int fd,
+                                          uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = knot_uring_sqe(&ur->ring);
+	if (sqe != NULL) {
+		sqe->opcode = opcode;
+		sqe->fd = fd;
+		sqe->user_data = user_data;
+	}
+	return sqe;
+}
+
+static void tcp_uring_accept_arm(tcp_uring_t *ur)
+{
+	for (unsigned i = 0; i < ur->nlisteners; i++) {
+		tcp_uring_listener_t *lst = &ur->listeners[i];
+		if (lst->armed) {
+			continue;
+		}
+		struct io_uring_sqe *sqe = tcp_uring_sqe(ur, IORING_OP_ACCEPT, lst->fd,
+		                                         TCP_URING_ACCEPT | i);
+		if (sqe != NULL) {
+			sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+			sqe->accept_flags = SOCK_NONBLOCK;
+			lst->armed = true;
+		}
+	}
+	ur->accepting = true;
+}
+
+/*! \brief Stop accepting if throttled, resume otherwise. */
+static void tcp_uring_throttle(tcp_uring_t *ur)
+{
+	bool throttled = ur->nconns >= tcp_uring_max_clients(ur);
+	ur->tcp->is_throttled = throttled;
+
+	if (!throttled) {
+		tcp_uring_accept_arm(ur);
+	} else if (ur->accepting) {
+		for (unsigned i = 0; i < ur->nlisteners; i++) {
+			if (!ur->listeners[i].armed) {
+				continue;
+			}
+			struct io_uring_sqe *sqe = tcp_uring_sqe(ur, IORING_OP_ASYNC_CANCEL,
+			                                         -1, TCP_URING_CANCEL);
+			if (sqe != NULL) {
+				sqe->addr = TCP_URING_ACCEPT | i;
+			}
+		}
+		ur->accepting = false;
+	}
+}
+
+static void tcp_uring_close(tcp_uring_t *ur, unsigned idx)
+{
+	tcp_uring_conn_t *conn = &ur->conns[idx];
+
+	/* Pending operation completes after the shutdown. */
+	if (conn->busy) {
+		(void)shutdown(conn->fd, SHUT_RDWR);
+		conn->closing = true;
+		return;
+	}
+
+	close(conn->fd);
+	free(conn->rx);
+	free(conn->tx);
+	memset(conn, 0, sizeof(*conn));
+	conn->fd = -1;
+
+	ur->unused[ur->nunused++] = idx;
+	ur->nconns--;
+	if (!ur->accepting) {
+		tcp_uring_throttle(ur);
+	}
+}
+
+static int tcp_uring_reserve(uint8_t **buf, size_t *size, size_t need)
+{
+	if (need <= *size) {
+		return KNOT_EOK;
+	}
+
+	size_t new_size = MAX(2 * *size, TCP_URING_BUF_MIN);
+	new_size = MAX(new_size, need);
+	uint8_t *new_buf = realloc(*buf, new_size);
+	if (new_buf == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*buf = new_buf;
+	*size = new_size;
+
+	return KNOT_EOK;
+}
+
+static int tcp_uring_post_recv(tcp_uring_t *ur, unsigned idx)
+{
+	tcp_uring_conn_t *conn = &ur->conns[idx];
+
+	/* Make space for the whole message if its length is known. */
+	size_t need = conn->rx_len + 1;
+	if (conn->rx_len >= sizeof(uint16_t)) {
+		need = sizeof(uint16_t) + knot_wire_read_u16(conn->rx);
+	}
+	int ret = tcp_uring_reserve(&conn->rx, &conn->rx_size, need);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	struct io_uring_sqe *sqe = tcp_uring_sqe(ur, IORING_OP_RECV, conn->fd,
+	                                         TCP_URING_RECV | idx);
+	if (sqe == NULL) {
+		return KNOT_EBUSY;
+	}
+	sqe->addr = (uintptr_t)(conn->rx + conn->rx_len);
+	sqe->len = conn->rx_size - conn->rx_len;
+	conn->busy = true;
+
+	return KNOT_EOK;
+}
+
+static int tcp_uring_post_send(tcp_uring_t *ur, unsigned idx)
+{
+	tcp_uring_conn_t *conn = &ur->conns[idx];
+
+	struct io_uring_sqe *sqe = tcp_uring_sqe(ur, IORING_OP_SEND, conn->fd,
+	                                         TCP_URING_SEND | idx);
+	if (sqe == NULL) {
+		return KNOT_EBUSY;
+	}
+	sqe->addr = (uintptr_t)(conn->tx + conn->tx_sent);
+	sqe->len = conn->tx_len - conn->tx_sent;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	conn->busy = true;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Append a response to the send batch, flush the batch synchronously if full. */
+static int tcp_uring_queue(tcp_uring_t *ur, tcp_uring_conn_t *conn,
+                           const uint8_t *wire, size_t size)
+{
+	size_t need = sizeof(uint16_t) + size;
+	if (conn->tx_len + need > TCP_URING_TX_MAX) {
+		ssize_t sent = net_stream_send(conn->fd, conn->tx, conn->tx_len,
+		                               ur->tcp->io_timeout);
+		if (sent != conn->tx_len) {
+			return (sent < 0) ? sent : KNOT_ECONN;
+		}
+		conn->tx_len = 0;
+	}
+
+	int ret = tcp_uring_reserve(&conn->tx, &conn->tx_size, conn->tx_len + need);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	knot_wire_write_u16(conn->tx + conn->tx_len, size);
+	memcpy(conn->tx + conn->tx_len + sizeof(uint16_t), wire, size);
+	conn->tx_len += need;
+
+	return KNOT_EOK;
+}
+
+static int tcp_uring_handle(tcp_uring_t *ur, tcp_uring_conn_t *conn,
+                            uint8_t *query, size_t query_len)
+{
+	tcp_context_t *tcp = ur->tcp;
+
+	/* Create query processing parameter. */
+	knotd_qdata_params_t params = params_init(KNOTD_QUERY_PROTO_TCP, &conn->remote,
+	                                          &conn->local, conn->fd, tcp->server,
+	                                          tcp->thread_id);
+
+	struct iovec rx = { .iov_base = query, .iov_len = query_len };
+	handle_query(&params, &tcp->layer, &rx, NULL);
+
+	/* Resolve until NOOP or finished. */
+	int ret = KNOT_EOK;
+	knot_pkt_t *ans = knot_pkt_new(tcp->iov[1].iov_base, KNOT_WIRE_MAX_PKTSIZE,
+	                               tcp->layer.mm);
+	while (active_state(tcp->layer.state)) {
+		knot_layer_produce(&tcp->layer, ans);
+		/* Queue, if response generation passed and wasn't ignored. */
+		if (ans->size > 0 && send_state(tcp->layer.state)) {
+			ret = tcp_uring_queue(ur, conn, ans->wire, ans->size);
+			if (ret != KNOT_EOK) {
+				tcp_log_error(params.remote, "send", ret);
+				break;
+			}
+		}
+	}
+
+	handle_finish(&tcp->layer);
+
+	return ret;
+}
+
+static void tcp_uring_on_accept(tcp_uring_t *ur, unsigned lidx, int res, unsigned flags)
+{
+	tcp_uring_listener_t *lst = &ur->listeners[lidx];
+
+	if (!(flags & IORING_CQE_F_MORE)) {
+		lst->armed = false;
+		/* Re-arm unless cancelled or failed, then it's resumed later. */
+		if (res >= 0 && ur->accepting) {
+			tcp_uring_accept_arm(ur);
+		}
+	}
+	if (res < 0) {
+		return;
+	}
+
+	int client = res;
+	if (ur->nconns >= tcp_uring_max_clients(ur)) {
+		close(client); // Accepted before the throttling took effect.
+		return;
+	}
+
+	if (ur->nunused == 0) {
+		unsigned new_size = MAX(2 * ur->size, 64);
+		new_size = MIN(new_size, tcp_uring_max_clients(ur));
+		tcp_uring_conn_t *conns = realloc(ur->conns, new_size * sizeof(*conns));
+		unsigned *unused = realloc(ur->unused, new_size * sizeof(*unused));
+		if (conns != NULL) {
+			ur->conns = conns;
+		}
+		if (unused != NULL) {
+			ur->unused = unused;
+		}
+		if (conns == NULL || unused == NULL) {
+			close(client);
+			return;
+		}
+		for (unsigned i = new_size; i > ur->size; i--) {
+			ur->conns[i - 1] = (tcp_uring_conn_t) { .fd = -1 };
+			ur->unused[ur->nunused++] = i - 1;
+		}
+		ur->size = new_size;
+	}
+
+	unsigned idx = ur->unused[--ur->nunused];
+	tcp_uring_conn_t *conn = &ur->conns[idx];
+	conn->fd = client;
+	conn->iface = lst->iface;
+	conn->active = ur->tcp->last_poll_time;
+	ur->nconns++;
+
+	/* Addresses are resolved once per connection. */
+	memcpy(&conn->local, &lst->iface->addr, sizeof(conn->local));
+	if (lst->iface->anyaddr) {
+		socklen_t local_len = sizeof(conn->local);
+		(void)getsockname(client, (struct sockaddr *)&conn->local, &local_len);
+	}
+	memcpy(&conn->remote, &lst->iface->addr, sizeof(conn->remote));
+	if (lst->iface->addr.ss_family != AF_UNIX) {
+		socklen_t remote_len = sizeof(conn->remote);
+		(void)getpeername(client, (struct sockaddr *)&conn->remote, &remote_len);
+	}
+
+	if (tcp_uring_post_recv(ur, idx) != KNOT_EOK) {
+		tcp_uring_close(ur, idx);
+		return;
+	}
+
+	tcp_uring_throttle(ur);
+}
+
+static void tcp_uring_on_recv(tcp_uring_t *ur, unsigned idx, int res)
+{
+	tcp_uring_conn_t *conn = &ur->conns[idx];
+	conn->busy = false;
+
+	if (res <= 0 || conn->closing) {
+		tcp_uring_close(ur, idx);
+		return;
+	}
+	conn->rx_len += res;
+	conn->active = ur->tcp->last_poll_time;
+
+	/* Answer all complete queries, the responses are sent together. */
+	size_t offset = 0;
+	while (conn->rx_len - offset >= sizeof(uint16_t)) {
+		size_t len = knot_wire_read_u16(conn->rx + offset);
+		if (conn->rx_len - offset < sizeof(uint16_t) + len) {
+			break;
+		}
+		if (tcp_uring_handle(ur, conn, conn->rx + offset + sizeof(uint16_t),
+		                     len) != KNOT_EOK) {
+			tcp_uring_close(ur, idx);
+			return;
+		}
+		offset += sizeof(uint16_t) + len;
+	}
+	conn->rx_len -= offset;
+	memmove(conn->rx, conn->rx + offset, conn->rx_len);
+
+	int ret = (conn->tx_len > 0) ? tcp_uring_post_send(ur, idx) :
+	                               tcp_uring_post_recv(ur, idx);
+	if (ret != KNOT_EOK) {
+		tcp_uring_close(ur, idx);
+	}
+}
+
+static void tcp_uring_on_send(tcp_uring_t *ur, unsigned idx, int res)
+{
+	tcp_uring_conn_t *conn = &ur->conns[idx];
+	conn->busy = false;
+
+	if (res <= 0 || conn->closing) {
+		tcp_uring_close(ur, idx);
+		return;
+	}
+	conn->active = ur->tcp->last_poll_time;
+
+	int ret;
+	conn->tx_sent += res;
+	if (conn->tx_sent < conn->tx_len) {
+		ret = tcp_uring_post_send(ur, idx);
+	} else {
+		conn->tx_len = 0;
+		conn->tx_sent = 0;
+		ret = tcp_uring_post_recv(ur, idx);
+	}
+	if (ret != KNOT_EOK) {
+		tcp_uring_close(ur, idx);
+	}
+}
+
+/*! \brief Terminate inactive clients and slow readers. */
+static void tcp_uring_sweep(tcp_uring_t *ur)
+{
+	struct timespec now = ur->tcp->last_poll_time;
+
+	for (unsigned i = 0; i < ur->size; i++) {
+		tcp_uring_conn_t *conn = &ur->conns[i];
+		if (conn->fd < 0 || conn->closing) {
+			continue;
+		}
+
+		double timeout_ms = (conn->tx_len > 0) ? ur->tcp->io_timeout :
+		                                         ur->tcp->idle_timeout * 1000.0;
+		if (timeout_ms < 0 || time_diff_ms(&conn->active, &now) < timeout_ms) {
+			continue;
+		}
+
+		if (conn->tx_len == 0) {
+			char addr_str[SOCKADDR_STRLEN];
+			sockaddr_tostr(addr_str, sizeof(addr_str), &conn->remote);
+			log_notice("TCP, terminated inactive client, address %s", addr_str);
+		}
+		tcp_uring_close(ur, i);
+	}
+
+	/* Resume accepting after failures. */
+	if (ur->accepting) {
+		tcp_uring_accept_arm(ur);
+	}
+}
+
+static void tcp_uring_deinit(tcp_uring_t *ur)
+{
+	for (unsigned i = 0; i < ur->size; i++) {
+		if (ur->conns[i].fd >= 0) {
+			close(ur->conns[i].fd);
+		}
+	}
+
+	/* Pending operations are cancelled before the buffers are freed. */
+	knot_uring_deinit(&ur->ring);
+
+	for (unsigned i = 0; i < ur->size; i++) {
+		free(ur->conns[i].rx);
+		free(ur->conns[i].tx);
+	}
+	free(ur->conns);
+	free(ur->unused);
+	free(ur->listeners);
+}
+
+/*!
+ * \brief Serve TCP clients using io_uring until the thread is cancelled.
+ *
+ * \return KNOT_EOK if finished, or an error if io_uring isn't usable.
+ */
+static int tcp_uring_serve(dthread_t *thread, tcp_context_t *tcp,
+                           struct timespec *next_sweep)
+{
+	tcp_uring_t ur = {
+		.tcp = tcp,
+		.nlisteners = tcp->client_threshold,
+	};
+
+	int ret = knot_uring_init(&ur.ring, TCP_URING_ENTRIES);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ur.listeners = calloc(ur.nlisteners, sizeof(*ur.listeners));
+	if (ur.listeners == NULL) {
+		tcp_uring_deinit(&ur);
+		return KNOT_ENOMEM;
+	}
+	for (unsigned i = 0; i < ur.nlisteners; i++) {
+		ur.listeners[i].fd = fdset_get_fd(&tcp->set, i);
+		ur.listeners[i].iface = tcp->set.ctx[i];
+	}
+
+	tcp->last_poll_time = time_now();
+	tcp_uring_accept_arm(&ur);
+	ret = knot_uring_submit(&ur.ring, 0, 0);
+	if (ret != ur.nlisteners) {
+		tcp_uring_deinit(&ur);
+		return (ret < 0) ? ret : KNOT_ERROR;
+	}
+
+	for (;;) {
+		/* Check for cancellation. */
+		if (dt_is_cancelled(thread)) {
+			break;
+		}
+
+		/* Submit all queued operations and wait for completions. */
+		ret = knot_uring_submit(&ur.ring, 1, TCP_SWEEP_INTERVAL * 1000);
+		if (ret < 0) {
+			log_error("TCP, io_uring failure (%s)", knot_strerror(ret));
+			break;
+		}
+		tcp->last_poll_time = time_now();
+
+		struct io_uring_cqe *cqe;
+		while ((cqe = knot_uring_cqe(&ur.ring)) != NULL) {
+			uint64_t op = cqe->user_data & TCP_URING_OP_MASK;
+			unsigned idx = (uint32_t)cqe->user_data;
+			int res = cqe->res;
+			unsigned flags = cqe->flags;
+			knot_uring_cqe_seen(&ur.ring);
+
+			switch (op) {
+			case TCP_URING_ACCEPT:
+				tcp_uring_on_accept(&ur, idx, res, flags);
+				break;
+			case TCP_URING_RECV:
+				tcp_uring_on_recv(&ur, idx, res);
+				break;
+			case TCP_URING_SEND:
+				tcp_uring_on_send(&ur, idx, res);
+				break;
+			default:
+				break;
+			}
+		}
+
+		/* Sweep inactive clients and refresh TCP configuration. */
+		if (tcp->last_poll_time.tv_sec >= next_sweep->tv_sec) {
+			tcp_uring_sweep(&ur);
+			update_sweep_timer(next_sweep);
+			update_tcp_conf(tcp);
+			tcp_uring_throttle(&ur);
+		}
+	}
+
+	tcp_uring_deinit(&ur);
+
+	return KNOT_EOK;
+}
+#endif // ENABLE_IO_URING
+
 int tcp_master(dthread_t *thread)
 {
 	if (thread == NULL || thread->data == NULL) {
@@ -336,11 +976,28 @@ int tcp_master(dthread_t *thread)
 	/* Set descriptors for the configured interfaces. */
 	tcp.client_threshold = tcp_set_ifaces(handler->server->ifaces,
 	                                      handler->server->n_ifaces,
-	                                      &tcp.set, thread_id);
+	                                      &tcp.set, dt_get_id(thread));
 	if (tcp.client_threshold == 0) {
 		goto finish; /* Terminate on zero interfaces. */
 	}
 
+#ifdef ENABLE_IO_URING
+	/* DoT connections need the TLS handshake, served by the default loop. */
+	bool tls_ifaces = false;
+	for (unsigned i = 0; i < tcp.client_threshold; i++) {
+		tls_ifaces |= ((const iface_t *)tcp.set.ctx[i])->tls;
+	}
+	if (conf()->cache.srv_io_uring && !tls_ifaces) {
+		ret = tcp_uring_serve(thread, &tcp, &next_sweep);
+		if (ret == KNOT_EOK) {
+			goto finish;
+		}
+		log_warning("TCP, failed to initialize io_uring (%s), using default networking",
+		            knot_strerror(ret));
+		ret = KNOT_EOK;
+	}
+#endif // ENABLE_IO_URING
+
 	for (;;) {
 		/* Check for cancellation. */
 		if (dt_is_cancelled(thread)) {
@@ -352,13 +1009,17 @@ int tcp_master(dthread_t *thread)
 
 		/* Sweep inactive clients and refresh TCP configuration. */
 		if (tcp.last_poll_time.tv_sec >= next_sweep.tv_sec) {
-			fdset_sweep(&tcp.set, &tcp_sweep, NULL);
+			fdset_sweep(&tcp.set, &tcp_sweep, &tcp);
 			update_sweep_timer(&next_sweep);
 			update_tcp_conf(&tcp);
 		}
 	}
 
 finish:
+	for (unsigned i = 0; i < tcp.tls_size; i++) {
+		tcp_tls_del(&tcp, i);
+	}
+	free(tcp.tls);
 	free(tcp.iov[0].iov_base);
 	free(tcp.iov[1].iov_base);
 	mp_delete(mm.ctx);
@@ -23,17 +23,24 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 #include <sys/param.h>
+#include <sys/select.h>
 #ifdef HAVE_SYS_UIO_H	// struct iovec (OpenBSD)
 #include <sys/uio.h>
 #endif /* HAVE_SYS_UIO_H */
 #include <unistd.h>
 
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/sockaddr.h"
 #include "contrib/ucw/mempool.h"
+#ifdef ENABLE_IO_URING
+#include "contrib/uring.h"
+#endif // ENABLE_IO_URING
 #include "knot/common/fdset.h"
+#include "knot/common/log.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/query/layer.h"
 #include "knot/server/handler.h"
@@ -45,6 +52,9 @@
 #include "knot/server/xdp-handler.h"
 #include "libknot/xdp/tcp_iobuf.h"
 
+/* Maximum number of receive batches handled per socket event. */
+#define UDP_DRAIN_ROUNDS 8
+
 /* Buffer identifiers. */
 enum {
 	RX = 0,
@@ -63,6 +73,7 @@ typedef struct {
 	knot_quic_table_t *quic_table;  /*!< QUIC connection table if active. */
 	knot_sweep_stats_t quic_closed; /*!< QUIC sweep context. */
 	uint64_t quic_idle_close;       /*!< QUIC idle close timeout (in nanoseconds). */
+	bool quic_gso;                  /*!< Coalesce outgoing QUIC packets using GSO. */
 #endif // ENABLE_QUIC
 } udp_context_t;
 
@@ -81,12 +92,13 @@ typedef struct {
 	void (*udp_handle)(udp_context_t *, const iface_t *, void *);
 	void (*udp_send)(void *);
 	void (*udp_sweep)(udp_context_t *, void *);
+	unsigned batch_len; /*!< Receive batch size if draining deep queues. */
 } udp_api_t;
 
-/*! \brief Control message to fit IP_PKTINFO or IPv6_RECVPKTINFO. */
+/*! \brief Control message to fit IP_PKTINFO or IPv6_RECVPKTINFO and UDP GSO/GRO. */
 typedef union {
 	struct cmsghdr cmsg;
-	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(int))];
 } cmsg_pktinfo_t;
 
 static const sockaddr_t *udp_pktinfo_handle(const struct msghdr *rx, struct msghdr *tx,
@@ -219,7 +231,7 @@ static void udp_msg_handle(udp_context_t *ctx, const iface_t *iface, void *d)
 	if (iface->quic) {
 #ifdef ENABLE_QUIC
 		quic_handler(&params, &ctx->layer, ctx->quic_idle_close,
-		             ctx->quic_table, &rq->iov[RX],  &rq->msg[TX]);
+		             ctx->quic_table, &ctx->quic_gso, &rq->iov[RX], &rq->msg[TX]);
 #else
 		assert(0);
 #endif // ENABLE_QUIC
@@ -245,17 +257,38 @@ static udp_api_t udp_msg_api = {
 	udp_msg_handle,
 	udp_msg_send,
 	udp_sweep,
+	0,
 };
 
 #ifdef ENABLE_RECVMMSG
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define ENABLE_UDP_GSO
+#define UDP_GSO_MAX_SEGS 64    /*!< Kernel limit of segments in one message. */
+#define UDP_GSO_MAX_SIZE 65000 /*!< Safe limit of one coalesced message. */
+#define UDP_GSO_MTU      1500  /*!< Assumed path MTU limiting the segment size. */
+#endif
+
+/*! \brief Coalesced output message state. */
+typedef struct {
+	uint16_t len;      /*!< Total length of all segments. */
+	uint16_t seg_size; /*!< Segment size. */
+	uint16_t segs;     /*!< Number of segments. */
+	bool closed;       /*!< Last (shorter) segment appended. */
+} udp_gso_t;
+
 typedef struct {
 	int fd;
 	unsigned rcvd;
+	bool gro;
+	bool gso;
+	fd_set gso_off; /*!< Sockets with segmentation offload failed. */
 	struct mmsghdr msgs[NBUFS][RECVMMSG_BATCHLEN];
 	struct iovec iov[NBUFS][RECVMMSG_BATCHLEN];
 	uint8_t iobuf[NBUFS][RECVMMSG_BATCHLEN][KNOT_WIRE_MAX_PKTSIZE];
 	sockaddr_t addrs[RECVMMSG_BATCHLEN];
 	cmsg_pktinfo_t pktinfo[RECVMMSG_BATCHLEN];
+	udp_gso_t gso_state[RECVMMSG_BATCHLEN];
+	cmsg_pktinfo_t gso_cmsg[RECVMMSG_BATCHLEN];
 } udp_mmsg_ctx_t;
 
 static void *udp_mmsg_init(_unused_ udp_context_t *ctx, _unused_ void *xdp_sock)
@@ -265,6 +298,11 @@ static void *udp_mmsg_init(_unused_ udp_context_t *ctx, _unused_ void *xdp_sock)
 		return NULL;
 	}
 
+#ifdef ENABLE_UDP_GSO
+	rq->gro = conf()->cache.srv_udp_gso;
+	rq->gso = rq->gro;
+#endif
+
 	for (unsigned i = 0; i < NBUFS; ++i) {
 		for (unsigned k = 0; k < RECVMMSG_BATCHLEN; ++k) {
 			rq->iov[i][k].iov_base = rq->iobuf[i][k];
@@ -300,10 +338,269 @@ static int udp_mmsg_recv(int fd, void *d)
 	return n;
 }
 
+#ifdef ENABLE_UDP_GSO
+static bool udp_gso_enabled(const udp_mmsg_ctx_t *rq)
+{
+	return rq->gso && rq->fd < FD_SETSIZE && !FD_ISSET(rq->fd, &rq->gso_off);
+}
+
+static void udp_gso_disable(udp_mmsg_ctx_t *rq)
+{
+	if (rq->fd < FD_SETSIZE) {
+		FD_SET(rq->fd, &rq->gso_off);
+	} else {
+		rq->gso = false;
+	}
+}
+
+/*! \brief Check if the output message carries the segment size. */
+static bool udp_gso_segmented(const udp_mmsg_ctx_t *rq, unsigned idx)
+{
+	return rq->msgs[TX][idx].msg_hdr.msg_control == rq->gso_cmsg[idx].buf;
+}
+
+/*! \brief Send a coalesced output message as individual datagrams. */
+static void udp_gso_split(udp_mmsg_ctx_t *rq, unsigned idx)
+{
+	const udp_gso_t *state = &rq->gso_state[idx];
+	struct msghdr msg = rq->msgs[TX][idx].msg_hdr;
+
+	/* Drop the trailing segment size, keep the PKTINFO if any. */
+	msg.msg_controllen -= CMSG_SPACE(sizeof(uint16_t));
+	if (msg.msg_controllen == 0) {
+		msg.msg_control = NULL;
+	}
+
+	for (size_t off = 0; off < state->len; off += state->seg_size) {
+		struct iovec seg = {
+			.iov_base = rq->iobuf[TX][idx] + off,
+			.iov_len = MIN(state->seg_size, state->len - off)
+		};
+		msg.msg_iov = &seg;
+		msg.msg_iovlen = 1;
+		(void)sendmsg(rq->fd, &msg, 0);
+	}
+}
+#endif /* ENABLE_UDP_GSO */
+
+static void udp_mmsg_sendmmsg(udp_mmsg_ctx_t *rq, unsigned count)
+{
+	unsigned sent = 0;
+	while (sent < count) {
+		int ret = sendmmsg(rq->fd, rq->msgs[TX] + sent, count - sent, 0);
+		if (ret > 0) {
+			sent += ret;
+			continue;
+		}
+#ifdef ENABLE_UDP_GSO
+		/* Segmentation offload not supported by the output device or path. */
+		if (ret < 0 && (errno == EIO || errno == EINVAL) &&
+		    udp_gso_segmented(rq, sent)) {
+			udp_gso_disable(rq);
+			udp_gso_split(rq, sent);
+		}
+#endif
+		/* Skip the failed message, continue with the rest. */
+		sent++;
+	}
+
+	for (unsigned i = 0; i < count; ++i) {
+		struct msghdr *tx = &rq->msgs[TX][i].msg_hdr;
+
+		/* Reset output context. */
+		tx->msg_iov->iov_len = sizeof(rq->iobuf[TX][i]);
+	}
+}
+
+#ifdef ENABLE_UDP_GSO
+/*! \brief Get the GRO segment size and keep just the PKTINFO control message. */
+static uint16_t udp_gro_strip(struct msghdr *rx)
+{
+	uint16_t seg_size = 0;
+	struct cmsghdr *pktinfo = NULL;
+
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(rx); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(rx, cmsg)) {
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+			int size;
+			memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+			seg_size = size;
+		} else if (pktinfo == NULL) {
+			pktinfo = cmsg;
+		}
+	}
+
+	if (pktinfo != NULL) {
+		size_t len = CMSG_SPACE(pktinfo->cmsg_len - CMSG_LEN(0));
+		memmove(rx->msg_control, pktinfo, pktinfo->cmsg_len);
+		rx->msg_controllen = len;
+	} else {
+		rx->msg_controllen = 0;
+	}
+
+	return seg_size;
+}
+
+/*! \brief Check if a reply can be appended to the output message. */
+static bool udp_gso_appendable(const udp_mmsg_ctx_t *rq, unsigned idx,
+                               const struct msghdr *hdr)
+{
+	const udp_gso_t *state = &rq->gso_state[idx];
+	const struct msghdr *tx = &rq->msgs[TX][idx].msg_hdr;
+
+	/* A segment must fit the path MTU, it's not fragmented otherwise. */
+	const struct sockaddr *remote = tx->msg_name;
+	size_t headers = (remote->sa_family == AF_INET6 ? 40 : 20) + 8;
+
+	return !state->closed &&
+	       state->segs < UDP_GSO_MAX_SEGS &&
+	       state->seg_size + headers <= UDP_GSO_MTU &&
+	       state->len + KNOT_EDNS_MAX_UDP_PAYLOAD <= UDP_GSO_MAX_SIZE &&
+	       sockaddr_cmp(tx->msg_name, hdr->msg_name, false) == 0 &&
+	       tx->msg_controllen == hdr->msg_controllen &&
+	       (hdr->msg_controllen == 0 ||
+	        memcmp(tx->msg_control, hdr->msg_control, hdr->msg_controllen) == 0);
+}
+
+/*! \brief Set the output length and add the segment size if coalesced. */
+static void udp_gso_finish(udp_mmsg_ctx_t *rq, unsigned idx)
+{
+	udp_gso_t *state = &rq->gso_state[idx];
+	struct msghdr *tx = &rq->msgs[TX][idx].msg_hdr;
+
+	tx->msg_iov->iov_len = state->len;
+	rq->msgs[TX][idx].msg_len = state->len;
+	if (state->segs < 2) {
+		return;
+	}
+
+	cmsg_pktinfo_t *ctrl = &rq->gso_cmsg[idx];
+	memcpy(ctrl->buf, tx->msg_control, tx->msg_controllen);
+	struct cmsghdr *cmsg = (struct cmsghdr *)(ctrl->buf + tx->msg_controllen);
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cmsg), &state->seg_size, sizeof(uint16_t));
+
+	tx->msg_control = ctrl->buf;
+	tx->msg_controllen += CMSG_SPACE(sizeof(uint16_t));
+}
+
+static void udp_gso_send(udp_mmsg_ctx_t *rq, unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i) {
+		udp_gso_finish(rq, i);
+	}
+	udp_mmsg_sendmmsg(rq, count);
+}
+
+/*!
+ * \brief Handle received messages with GRO and coalesce replies using GSO.
+ *
+ * Replies of the same size to the same client are appended to one output
+ * message, which is segmented into individual datagrams by the kernel.
+ */
+static void udp_gso_handle(udp_context_t *ctx, const iface_t *iface,
+                           udp_mmsg_ctx_t *rq)
+{
+	unsigned j = 0;
+	for (unsigned i = 0; i < rq->rcvd; ++i) {
+		struct msghdr *rx = &rq->msgs[RX][i].msg_hdr;
+		size_t rx_len = rq->msgs[RX][i].msg_len;
+
+		size_t seg_size = udp_gro_strip(rx);
+		if (seg_size == 0 || seg_size > rx_len) {
+			seg_size = rx_len;
+		}
+
+		/* Output address and control message, common for all segments. */
+		struct msghdr hdr = {
+			.msg_name = rx->msg_name,
+			.msg_namelen = rx->msg_namelen
+		};
+		const sockaddr_t *local = udp_pktinfo_handle(rx, &hdr, &ctx->local, iface);
+
+		knotd_qdata_params_t params = params_init(KNOTD_QUERY_PROTO_UDP,
+			&rq->addrs[i], local, rq->fd, ctx->server, ctx->thread_id);
+
+		for (size_t off = 0; off < rx_len; off += seg_size) {
+			struct iovec rx_seg = {
+				.iov_base = (uint8_t *)rx->msg_iov->iov_base + off,
+				.iov_len = MIN(seg_size, rx_len - off)
+			};
+
+			bool append = j > 0 && udp_gso_enabled(rq) &&
+			              udp_gso_appendable(rq, j - 1, &hdr);
+			unsigned idx = append ? j - 1 : j;
+			if (!append && j == RECVMMSG_BATCHLEN) {
+				udp_gso_send(rq, j);
+				idx = j = 0;
+			}
+			udp_gso_t *state = &rq->gso_state[idx];
+			size_t offset = append ? state->len : 0;
+
+			struct iovec tx_seg = {
+				.iov_base = rq->iobuf[TX][idx] + offset,
+				.iov_len = sizeof(rq->iobuf[TX][idx]) - offset
+			};
+			udp_handler(ctx, &params, &rx_seg, &tx_seg);
+			if (tx_seg.iov_len == 0) {
+				continue;
+			}
+
+			if (append && tx_seg.iov_len <= state->seg_size) {
+				state->len += tx_seg.iov_len;
+				state->segs++;
+				state->closed = (tx_seg.iov_len < state->seg_size);
+				continue;
+			}
+
+			/* Start a new output message. */
+			if (append) {
+				if (j == RECVMMSG_BATCHLEN) {
+					udp_gso_send(rq, j);
+					j = 0;
+				}
+				memmove(rq->iobuf[TX][j], tx_seg.iov_base, tx_seg.iov_len);
+				state = &rq->gso_state[j];
+			}
+			struct msghdr *tx = &rq->msgs[TX][j].msg_hdr;
+			tx->msg_name = hdr.msg_name;
+			tx->msg_namelen = hdr.msg_namelen;
+			tx->msg_control = hdr.msg_control;
+			tx->msg_controllen = hdr.msg_controllen;
+			*state = (udp_gso_t) {
+				.len = tx_seg.iov_len,
+				.seg_size = tx_seg.iov_len,
+				.segs = 1
+			};
+			j++;
+		}
+
+		/* Reset input context. */
+		rx->msg_iov->iov_len = sizeof(rq->iobuf[RX][i]);
+		rx->msg_namelen = sizeof(rq->addrs[i]);
+		rx->msg_controllen = sizeof(rq->pktinfo[i]);
+	}
+
+	for (unsigned i = 0; i < j; ++i) {
+		udp_gso_finish(rq, i);
+	}
+	rq->rcvd = j;
+}
+#endif /* ENABLE_UDP_GSO */
+
 static void udp_mmsg_handle(udp_context_t *ctx, const iface_t *iface, void *d)
 {
 	udp_mmsg_ctx_t *rq = d;
 
+#ifdef ENABLE_UDP_GSO
+	if (rq->gro && !iface->quic && iface->addr.ss_family != AF_UNIX) {
+		udp_gso_handle(ctx, iface, rq);
+		return;
+	}
+#endif
+
 	/* Handle each received message. */
 	unsigned j = 0;
 	for (unsigned i = 0; i < rq->rcvd; ++i) {
@@ -325,7 +622,7 @@ static void udp_mmsg_handle(udp_context_t *ctx, const iface_t *iface, void *d)
 		if (iface->quic) {
 #ifdef ENABLE_QUIC
 			quic_handler(&params, &ctx->layer, ctx->quic_idle_close,
-			             ctx->quic_table, rx->msg_iov, tx);
+			             ctx->quic_table, &ctx->quic_gso, rx->msg_iov, tx);
 #else
 		assert(0);
 #endif // ENABLE_QUIC
@@ -353,13 +650,7 @@ static void udp_mmsg_send(void *d)
 {
 	udp_mmsg_ctx_t *rq = d;
 
-	(void)sendmmsg(rq->fd, rq->msgs[TX], rq->rcvd, 0);
-	for (unsigned i = 0; i < rq->rcvd; ++i) {
-		struct msghdr *tx = &rq->msgs[TX][i].msg_hdr;
-
-		/* Reset output context. */
-		tx->msg_iov->iov_len = sizeof(rq->iobuf[TX][i]);
-	}
+	udp_mmsg_sendmmsg(rq, rq->rcvd);
 }
 
 static udp_api_t udp_mmsg_api = {
@@ -369,9 +660,292 @@ static udp_api_t udp_mmsg_api = {
 	udp_mmsg_handle,
 	udp_mmsg_send,
 	udp_sweep,
+	RECVMMSG_BATCHLEN,
 };
 #endif /* ENABLE_RECVMMSG */
 
+#ifdef ENABLE_IO_URING
+#define UDP_URING_ENTRIES 256  /*!< Submission queue size. */
+#define UDP_URING_BUFS    64   /*!< Number of provided receive buffers. */
+#define UDP_URING_TX      64   /*!< Number of reply slots. */
+#define UDP_URING_BATCH   64   /*!< Maximum number of completions per round. */
+#define UDP_URING_BGID    0    /*!< Receive buffer group. */
+#define UDP_URING_TIMEOUT 1000 /*!< [ms] Maximum waiting for events. */
+
+/* Operation in the upper part of the completion user data, index in the lower. */
+#define UDP_URING_RECV    (1ULL << 32)
+#define UDP_URING_SEND    (2ULL << 32)
+#define UDP_URING_OP_MASK (~0ULL << 32)
+
+/*! \brief Layout of a provided buffer filled by the multishot receive. */
+typedef struct {
+	struct io_uring_recvmsg_out out;
+	sockaddr_t name;
+	cmsg_pktinfo_t ctrl;
+	uint8_t payload[KNOT_WIRE_MAX_PKTSIZE];
+} udp_uring_rxbuf_t;
+
+/*! \brief Received datagram waiting for processing. */
+typedef struct {
+	int len;      /*!< Length of the filled buffer. */
+	uint16_t bid; /*!< Buffer identifier. */
+	uint16_t sock; /*!< Socket index. */
+} udp_uring_rx_t;
+
+/*! \brief Reply slot, reusable after the send completion. */
+typedef struct {
+	struct msghdr msg;
+	struct iovec iov;
+	sockaddr_t addr;
+	cmsg_pktinfo_t ctrl;
+	/* UDP responses never exceed the maximum EDNS payload. */
+	uint8_t buf[KNOT_EDNS_MAX_UDP_PAYLOAD];
+} udp_uring_tx_t;
+
+typedef struct {
+	const iface_t *iface;
+	int fd;
+	bool armed; /*!< Multishot receive active. */
+} udp_uring_sock_t;
+
+typedef struct {
+	knot_uring_t ring;
+	knot_uring_bufs_t bufs;
+	struct msghdr rx_msg;                /*!< Receive template (name and control lengths). */
+	udp_uring_rx_t rx[UDP_URING_BUFS];   /*!< Received datagrams to be processed. */
+	unsigned rx_count;
+	udp_uring_tx_t tx[UDP_URING_TX];
+	unsigned tx_free[UDP_URING_TX];      /*!< Stack of unused reply slots. */
+	unsigned tx_free_count;
+	unsigned nsocks;
+	udp_uring_sock_t socks[];
+} udp_uring_ctx_t;
+
+static void udp_uring_arm(udp_uring_ctx_t *rq, unsigned idx)
+{
+	struct io_uring_sqe *sqe = knot_uring_sqe(&rq->ring);
+	if (sqe == NULL) {
+		return;
+	}
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = rq->socks[idx].fd;
+	sqe->addr = (uintptr_t)&rq->rx_msg;
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = UDP_URING_BGID;
+	sqe->user_data = UDP_URING_RECV | idx;
+
+	rq->socks[idx].armed = true;
+}
+
+static void udp_uring_deinit(void *d)
+{
+	udp_uring_ctx_t *rq = d;
+	if (rq == NULL) {
+		return;
+	}
+
+	knot_uring_bufs_deinit(&rq->ring, &rq->bufs);
+	knot_uring_deinit(&rq->ring);
+	free(rq);
+}
+
+/*! \note The initialization parameter is the set of UDP sockets to be served. */
+static void *udp_uring_init(_unused_ udp_context_t *ctx, void *fdset)
+{
+	fdset_t *fds = fdset;
+	unsigned nsocks = fdset_get_length(fds);
+
+	udp_uring_ctx_t *rq = calloc(1, sizeof(*rq) + nsocks * sizeof(rq->socks[0]));
+	if (rq == NULL) {
+		return NULL;
+	}
+
+	if (knot_uring_init(&rq->ring, UDP_URING_ENTRIES) != KNOT_EOK) {
+		free(rq);
+		return NULL;
+	}
+
+	if (knot_uring_bufs_init(&rq->ring, &rq->bufs, UDP_URING_BGID, UDP_URING_BUFS,
+	                         sizeof(udp_uring_rxbuf_t)) != KNOT_EOK) {
+		knot_uring_deinit(&rq->ring);
+		free(rq);
+		return NULL;
+	}
+
+	rq->rx_msg.msg_namelen = sizeof(((udp_uring_rxbuf_t *)0)->name);
+	rq->rx_msg.msg_controllen = sizeof(((udp_uring_rxbuf_t *)0)->ctrl);
+
+	for (unsigned i = 0; i < UDP_URING_TX; i++) {
+		rq->tx_free[i] = i;
+	}
+	rq->tx_free_count = UDP_URING_TX;
+
+	rq->nsocks = nsocks;
+	for (unsigned i = 0; i < nsocks; i++) {
+		rq->socks[i].fd = fdset_get_fd(fds, i);
+		rq->socks[i].iface = fds->ctx[i];
+		udp_uring_arm(rq, i);
+	}
+
+	if (knot_uring_submit(&rq->ring, 0, 0) != (int)nsocks) {
+		udp_uring_deinit(rq);
+		return NULL;
+	}
+
+	return rq;
+}
+
+/*! \brief Submit queued operations, wait for and collect completions. */
+static int udp_uring_recv(_unused_ int fd, void *d)
+{
+	udp_uring_ctx_t *rq = d;
+
+	/* Restart receiving terminated e.g. by exhausted buffers. */
+	if (rq->rx_count < UDP_URING_BUFS) {
+		for (unsigned i = 0; i < rq->nsocks; i++) {
+			if (!rq->socks[i].armed) {
+				udp_uring_arm(rq, i);
+			}
+		}
+	}
+
+	/* Don't wait if there are datagrams which can be processed immediately. */
+	unsigned wait = (rq->rx_count > 0 && rq->tx_free_count > 0) ? 0 : 1;
+	if (knot_uring_submit(&rq->ring, wait, UDP_URING_TIMEOUT) < 0) {
+		return 0;
+	}
+
+	struct io_uring_cqe *cqe;
+	for (unsigned n = 0; n < UDP_URING_BATCH &&
+	     (cqe = knot_uring_cqe(&rq->ring)) != NULL; n++) {
+		unsigned idx = (uint32_t)cqe->user_data;
+		switch (cqe->user_data & UDP_URING_OP_MASK) {
+		case UDP_URING_SEND:
+			rq->tx_free[rq->tx_free_count++] = idx;
+			break;
+		case UDP_URING_RECV:
+			if (!(cqe->flags & IORING_CQE_F_MORE)) {
+				rq->socks[idx].armed = false;
+			}
+			if (cqe->flags & IORING_CQE_F_BUFFER) {
+				assert(rq->rx_count < UDP_URING_BUFS);
+				rq->rx[rq->rx_count++] = (udp_uring_rx_t) {
+					.len = cqe->res,
+					.bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT,
+					.sock = idx,
+				};
+			}
+			break;
+		default:
+			break;
+		}
+		knot_uring_cqe_seen(&rq->ring);
+	}
+
+	return rq->rx_count;
+}
+
+static void udp_uring_reply(udp_context_t *ctx, udp_uring_ctx_t *rq,
+                            const udp_uring_sock_t *sock, udp_uring_rxbuf_t *buf)
+{
+	struct msghdr rx = {
+		.msg_name = &buf->name,
+		.msg_namelen = buf->out.namelen,
+		.msg_control = &buf->ctrl,
+		.msg_controllen = buf->out.controllen,
+	};
+	struct iovec rx_iov = {
+		.iov_base = buf->payload,
+		.iov_len = buf->out.payloadlen,
+	};
+
+	unsigned slot = rq->tx_free[rq->tx_free_count - 1];
+	udp_uring_tx_t *tx = &rq->tx[slot];
+	tx->msg = (struct msghdr) {
+		.msg_name = &tx->addr,
+		.msg_namelen = buf->out.namelen,
+		.msg_iov = &tx->iov,
+		.msg_iovlen = 1,
+	};
+	tx->iov.iov_base = tx->buf;
+	tx->iov.iov_len = sizeof(tx->buf);
+
+	struct msghdr hdr = { 0 };
+	const sockaddr_t *local = udp_pktinfo_handle(&rx, &hdr, &ctx->local, sock->iface);
+
+	knotd_qdata_params_t params = params_init(KNOTD_QUERY_PROTO_UDP, &buf->name,
+	                                          local, sock->fd, ctx->server,
+	                                          ctx->thread_id);
+	udp_handler(ctx, &params, &rx_iov, &tx->iov);
+	if (tx->iov.iov_len == 0) {
+		return;
+	}
+
+	/* The receive buffer is recycled before the send completes. */
+	memcpy(&tx->addr, &buf->name, buf->out.namelen);
+	if (hdr.msg_controllen > 0) {
+		memcpy(&tx->ctrl, hdr.msg_control, hdr.msg_controllen);
+		tx->msg.msg_control = &tx->ctrl;
+		tx->msg.msg_controllen = hdr.msg_controllen;
+	}
+
+	struct io_uring_sqe *sqe = knot_uring_sqe(&rq->ring);
+	if (sqe == NULL) {
+		return;
+	}
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = sock->fd;
+	sqe->addr = (uintptr_t)&tx->msg;
+	sqe->len = 1;
+	sqe->user_data = UDP_URING_SEND | slot;
+
+	rq->tx_free_count--;
+}
+
+static void udp_uring_handle(udp_context_t *ctx, _unused_ const iface_t *iface, void *d)
+{
+	udp_uring_ctx_t *rq = d;
+
+	/* Stop if all reply slots are in flight, the rest is processed later. */
+	unsigned i = 0;
+	for (; i < rq->rx_count && rq->tx_free_count > 0; i++) {
+		udp_uring_rx_t *item = &rq->rx[i];
+		udp_uring_rxbuf_t *buf = (udp_uring_rxbuf_t *)knot_uring_buf(&rq->bufs, item->bid);
+
+		if (item->len >= (int)offsetof(udp_uring_rxbuf_t, payload) &&
+		    !(buf->out.flags & (MSG_TRUNC | MSG_CTRUNC))) {
+			udp_uring_reply(ctx, rq, &rq->socks[item->sock], buf);
+		}
+
+		knot_uring_bufs_put(&rq->bufs, item->bid);
+	}
+
+	if (i > 0) {
+		knot_uring_bufs_commit(&rq->bufs);
+		rq->rx_count -= i;
+		memmove(rq->rx, rq->rx + i, rq->rx_count * sizeof(rq->rx[0]));
+	}
+}
+
+static void udp_uring_send(_unused_ void *d)
+{
+	/* Replies are submitted together with waiting for next events. */
+}
+
+static udp_api_t udp_uring_api = {
+	udp_uring_init,
+	udp_uring_deinit,
+	udp_uring_recv,
+	udp_uring_handle,
+	udp_uring_send,
+	udp_sweep,
+	0,
+};
+#endif /* ENABLE_IO_URING */
+
 #ifdef ENABLE_XDP
 static void *xdp_mmsg_init(udp_context_t *ctx, void *xdp_sock)
 {
@@ -414,6 +988,7 @@ static udp_api_t xdp_mmsg_api = {
 	xdp_mmsg_handle,
 	xdp_mmsg_send,
 	xdp_mmsg_sweep,
+	0,
 };
 #endif /* ENABLE_XDP */
 
@@ -442,7 +1017,7 @@ static int iface_udp_fd(const iface_t *iface, int thread_id, bool xdp_thread,
 #endif
 	} else { // UDP thread.
 		if (iface->fd_udp_count == 0) { // No UDP interfaces.
-			assert(iface->fd_xdp_count > 0);
+			assert(iface->fd_xdp_count > 0 || iface->tls);
 			return -1;
 		}
 #ifdef ENABLE_REUSEPORT
@@ -551,13 +1126,40 @@ int udp_master(dthread_t *thread)
 		if (udp.quic_table == NULL) {
 			goto finish;
 		}
+		udp.quic_gso = conf()->cache.srv_udp_gso;
+
+		/* Generate connection IDs which are steered back to this worker. */
+		for (size_t i = 0; i < nifs; i++) {
+			const iface_t *iface = &handler->server->ifaces[i];
+			if (iface->quic && iface->quic_steer) {
+				assert(thread_id < iface->fd_udp_count);
+				udp.quic_table->cid_steer_count = iface->fd_udp_count;
+				udp.quic_table->cid_steer_idx = thread_id;
+				break;
+			}
+		}
 	}
 #endif // ENABLE_QUIC
 
+#ifdef ENABLE_IO_URING
+	/* Use io_uring for plain UDP if possible. */
+	if (conf()->cache.srv_io_uring && !quic &&
+	    !is_xdp_thread(handler->server, thread_id)) {
+		api_ctx = udp_uring_api.udp_init(&udp, &fds);
+		if (api_ctx != NULL) {
+			api = &udp_uring_api;
+		} else {
+			log_warning("UDP, failed to initialize io_uring, using default networking");
+		}
+	}
+#endif // ENABLE_IO_URING
+
 	/* Initialize the networking API. */
-	api_ctx = api->udp_init(&udp, xdp_socket);
 	if (api_ctx == NULL) {
-		goto finish;
+		api_ctx = api->udp_init(&udp, xdp_socket);
+		if (api_ctx == NULL) {
+			goto finish;
+		}
 	}
 
 	/* Loop until all data is read. */
@@ -567,6 +1169,18 @@ int udp_master(dthread_t *thread)
 			break;
 		}
 
+#ifdef ENABLE_IO_URING
+		/* Completion-based API waits for the events itself. */
+		if (api == &udp_uring_api) {
+			if (api->udp_recv(-1, api_ctx) > 0) {
+				api->udp_handle(&udp, NULL, api_ctx);
+				api->udp_send(api_ctx);
+			}
+			api->udp_sweep(&udp, api_ctx);
+			continue;
+		}
+#endif // ENABLE_IO_URING
+
 		/* Wait for events. */
 		fdset_it_t it;
 		(void)fdset_poll(&fds, &it, 0, 1000);
@@ -576,11 +1190,20 @@ int udp_master(dthread_t *thread)
 			if (!fdset_it_is_pollin(&it)) {
 				continue;
 			}
-			if (api->udp_recv(fdset_it_get_fd(&it), api_ctx) > 0) {
-				const iface_t *iface = fdset_it_get_ctx(&it);
-				assert(iface);
+			const iface_t *iface = fdset_it_get_ctx(&it);
+			assert(iface);
+
+			/* Keep receiving while whole batches are queued. */
+			for (unsigned round = 0; round < UDP_DRAIN_ROUNDS; round++) {
+				int ret = api->udp_recv(fdset_it_get_fd(&it), api_ctx);
+				if (ret <= 0) {
+					break;
+				}
 				api->udp_handle(&udp, iface, api_ctx);
 				api->udp_send(api_ctx);
+				if (api->batch_len == 0 || ret < (int)api->batch_len) {
+					break;
+				}
 			}
 		}
 
@@ -52,6 +52,7 @@ typedef struct xdp_handle_ctx {
 	bool tcp;
 	size_t tcp_max_conns;
 	size_t tcp_syn_conns;
+	bool tcp_syn_cookies;
 	size_t tcp_max_inbufs;
 	size_t tcp_max_obufs;
 	uint32_t tcp_idle_close;  // In microseconds.
@@ -77,8 +78,13 @@ void xdp_handle_reconfigure(xdp_handle_ctx_t *ctx)
 	ctx->tcp_idle_close = pconf->cache.xdp_tcp_idle_close * 1000000;
 	ctx->tcp_idle_reset = pconf->cache.xdp_tcp_idle_reset * 1000000;
 	ctx->tcp_idle_resend= pconf->cache.xdp_tcp_idle_resend * 1000000;
+	ctx->tcp_syn_cookies= pconf->cache.xdp_tcp_syn_cookies;
 	ctx->quic_idle_close= pconf->cache.srv_quic_idle_close * 1000000000LU;
 	rcu_read_unlock();
+
+	if (ctx->tcp_table != NULL) {
+		ctx->tcp_table->syn_cookies = ctx->tcp_syn_cookies;
+	}
 }
 
 void xdp_handle_free(xdp_handle_ctx_t *ctx)
@@ -126,6 +132,7 @@ xdp_handle_ctx_t *xdp_handle_init(server_t *server, knot_xdp_socket_t *xdp_sock)
 			xdp_handle_free(ctx);
 			return NULL;
 		}
+		ctx->tcp_table->syn_cookies = ctx->tcp_syn_cookies;
 		ctx->syn_table = knot_tcp_table_new(ctx->tcp_syn_conns, ctx->tcp_table);
 		if (ctx->syn_table == NULL) {
 			xdp_handle_free(ctx);
@@ -14,10 +14,16 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include "knot/updates/acl.h"
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "knot/updates/acl.h"
+#include "contrib/qp-trie/trie.h"
 #include "contrib/string.h"
 #include "contrib/wire_ctx.h"
+#include "libknot/dynarray.h"
 #ifdef ENABLE_QUIC
 #include "libknot/quic/quic.h"
 #endif // ENABLE_QUIC
@@ -112,17 +118,18 @@ static bool match_names(const knot_dname_t *rr_owner, const knot_dname_t *zone_n
 	return false;
 }
 
-static bool update_match(conf_t *conf, conf_val_t *acl, knot_dname_t *key_name,
-                         const knot_dname_t *zone_name, knot_pkt_t *query)
+static bool update_match(conf_t *conf, const uint8_t *acl, size_t acl_len,
+                         knot_dname_t *key_name, const knot_dname_t *zone_name,
+                         knot_pkt_t *query)
 {
 	if (query == NULL) {
 		return true;
 	}
 
-	conf_val_t val_types = conf_id_get(conf, C_ACL, C_UPDATE_TYPE, acl);
+	conf_val_t val_types = conf_rawid_get(conf, C_ACL, C_UPDATE_TYPE, acl, acl_len);
 	conf_val_t *types = (conf_val_count(&val_types) > 0) ? &val_types : NULL;
 
-	conf_val_t val = conf_id_get(conf, C_ACL, C_UPDATE_OWNER, acl);
+	conf_val_t val = conf_rawid_get(conf, C_ACL, C_UPDATE_OWNER, acl, acl_len);
 	acl_update_owner_t owner = conf_opt(&val);
 
 	/* Return if no specific requirements configured. */
@@ -132,14 +139,14 @@ static bool update_match(conf_t *conf, conf_val_t *acl, knot_dname_t *key_name,
 
 	acl_update_owner_match_t match = ACL_UPDATE_MATCH_SUBEQ;
 	if (owner != ACL_UPDATE_OWNER_NONE) {
-		val = conf_id_get(conf, C_ACL, C_UPDATE_OWNER_MATCH, acl);
+		val = conf_rawid_get(conf, C_ACL, C_UPDATE_OWNER_MATCH, acl, acl_len);
 		match = conf_opt(&val);
 	}
 
 	conf_val_t *names = NULL;
 	conf_val_t val_names;
 	if (owner == ACL_UPDATE_OWNER_NAME) {
-		val_names = conf_id_get(conf, C_ACL, C_UPDATE_OWNER_NAME, acl);
+		val_names = conf_rawid_get(conf, C_ACL, C_UPDATE_OWNER_NAME, acl, acl_len);
 		if (conf_val_count(&val_names) > 0) {
 			names = &val_names;
 		}
@@ -252,6 +259,852 @@ static bool check_addr_key(conf_t *conf, conf_val_t *addr_val, conf_val_t *key_v
 	return true;
 }
 
+/*! \brief Maximum address length in the matcher (IPv6). */
+#define IDX_ADDR_LEN	16
+
+/*! \brief Address family index in the matcher. */
+enum {
+	IDX_IPV4 = 0,
+	IDX_IPV6 = 1,
+	IDX_FAMILIES
+};
+
+typedef struct {
+	uint8_t addr[IDX_ADDR_LEN];
+} idx_bound_t;
+
+typedef struct {
+	idx_bound_t min;
+	idx_bound_t max;
+	uint32_t entry;
+} idx_interval_t;
+
+typedef struct {
+	uint32_t entry;
+	uint32_t key;
+} idx_keyref_t;
+
+/*! \brief Matcher entry (single ACL address/key set or a remote). */
+typedef struct {
+	dnssec_binary_t *pins;   //!< Required certificate pins.
+	size_t pins_count;       //!< Number of pins, zero if no pin required.
+} idx_entry_t;
+
+/*! \brief Compiled ACL or remote (group). */
+typedef struct {
+	uint32_t first;          //!< First entry.
+	uint32_t count;          //!< Number of entries.
+	uint8_t actions;         //!< Bitmap of allowed actions.
+	bool no_action;          //!< Empty action list.
+	bool deny;               //!< Deny rule.
+	bool update_rules;       //!< Update type or owner restrictions set.
+} idx_rule_t;
+
+typedef struct {
+	knot_dname_t *name;
+	dnssec_tsig_algorithm_t alg;
+	dnssec_binary_t secret;
+} idx_key_t;
+
+/*! \brief Address space split into segments with the same matching entries. */
+typedef struct {
+	size_t count;            //!< Number of segments.
+	idx_bound_t *bounds;     //!< Sorted segment lower bounds.
+	uint64_t *bits;          //!< Segment entry bitmaps (count * words).
+} idx_segments_t;
+
+struct acl_index {
+	trie_t *rules;           //!< ACL id -> idx_rule_t.
+	trie_t *remotes;         //!< Remote or remote group id -> idx_rule_t.
+	trie_t *keys;            //!< Key name -> idx_key_t.
+	idx_rule_t *rule_arr;
+	size_t rule_count;
+	idx_key_t *key_arr;
+	size_t key_count;
+	idx_entry_t *entries;
+	size_t entry_count;
+	size_t words;            //!< Length of entry bitmaps in words.
+	uint64_t *nokey;         //!< Entries without a key.
+	uint64_t *key_bits;      //!< Entries per key (key_count * words).
+	idx_segments_t segs[IDX_FAMILIES];
+};
+
+knot_dynarray_declare(idx_entry, idx_entry_t, DYNARRAY_VISIBILITY_STATIC, 16)
+knot_dynarray_define(idx_entry, idx_entry_t, DYNARRAY_VISIBILITY_STATIC)
+knot_dynarray_declare(idx_interval, idx_interval_t, DYNARRAY_VISIBILITY_STATIC, 16)
+knot_dynarray_define(idx_interval, idx_interval_t, DYNARRAY_VISIBILITY_STATIC)
+knot_dynarray_declare(idx_keyref, idx_keyref_t, DYNARRAY_VISIBILITY_STATIC, 16)
+knot_dynarray_define(idx_keyref, idx_keyref_t, DYNARRAY_VISIBILITY_STATIC)
+knot_dynarray_declare(idx_u32, uint32_t, DYNARRAY_VISIBILITY_STATIC, 16)
+knot_dynarray_define(idx_u32, uint32_t, DYNARRAY_VISIBILITY_STATIC)
+
+typedef struct {
+	conf_t *conf;
+	acl_index_t *idx;
+	idx_entry_dynarray_t entries;
+	idx_interval_dynarray_t intervals[IDX_FAMILIES];
+	idx_keyref_dynarray_t keyrefs;
+	idx_u32_dynarray_t nokey;
+	size_t rule_max;
+	size_t key_max;
+	bool failed;
+} idx_build_t;
+
+static inline bool bit_test(const uint64_t *bits, uint32_t pos)
+{
+	return bits[pos / 64] & (1ULL << (pos % 64));
+}
+
+static inline void bit_set(uint64_t *bits, uint32_t pos)
+{
+	bits[pos / 64] |= (1ULL << (pos % 64));
+}
+
+static int bound_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(idx_bound_t));
+}
+
+static size_t family_len(int fam)
+{
+	return (fam == IDX_IPV4) ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+}
+
+/*! \brief Converts the address into a matcher bound, returns family index. */
+static int addr_bound(const struct sockaddr_storage *ss, idx_bound_t *out)
+{
+	memset(out, 0, sizeof(*out));
+
+	switch (ss->ss_family) {
+	case AF_INET:
+		memcpy(out->addr, &((const struct sockaddr_in *)ss)->sin_addr,
+		       sizeof(struct in_addr));
+		return IDX_IPV4;
+	case AF_INET6:
+		memcpy(out->addr, &((const struct sockaddr_in6 *)ss)->sin6_addr,
+		       sizeof(struct in6_addr));
+		return IDX_IPV6;
+	default:
+		return -1;
+	}
+}
+
+/*! \brief Increments the bound, returns false on overflow. */
+static bool bound_inc(idx_bound_t *bound, size_t len)
+{
+	for (int i = len - 1; i >= 0; i--) {
+		if (++bound->addr[i] != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static uint32_t add_entry(idx_build_t *ctx, conf_val_t *pins)
+{
+	idx_entry_t entry = { 0 };
+
+	size_t count = conf_val_count(pins);
+	if (count > 0) {
+		entry.pins = calloc(count, sizeof(*entry.pins));
+		if (entry.pins == NULL) {
+			ctx->failed = true;
+		}
+	}
+	while (entry.pins != NULL && pins->code == KNOT_EOK) {
+		dnssec_binary_t pin = { 0 };
+		pin.data = (uint8_t *)conf_bin(pins, &pin.size);
+		if (dnssec_binary_dup(&pin, &entry.pins[entry.pins_count]) != KNOT_EOK) {
+			ctx->failed = true;
+			break;
+		}
+		entry.pins_count++;
+		conf_val_next(pins);
+	}
+
+	if (idx_entry_dynarray_add(&ctx->entries, &entry) == NULL) {
+		for (size_t i = 0; i < entry.pins_count; i++) {
+			dnssec_binary_free(&entry.pins[i]);
+		}
+		free(entry.pins);
+		ctx->failed = true;
+	}
+
+	return ctx->entries.size - 1;
+}
+
+static void add_interval(idx_build_t *ctx, int fam, const idx_bound_t *min,
+                         const idx_bound_t *max, uint32_t entry)
+{
+	if (bound_cmp(min, max) > 0) {
+		return;
+	}
+
+	idx_interval_t interval = { *min, *max, entry };
+	if (idx_interval_dynarray_add(&ctx->intervals[fam], &interval) == NULL) {
+		ctx->failed = true;
+	}
+}
+
+static void add_any_addr(idx_build_t *ctx, uint32_t entry)
+{
+	for (int fam = 0; fam < IDX_FAMILIES; fam++) {
+		idx_bound_t min = { { 0 } }, max = { { 0 } };
+		memset(max.addr, 0xff, family_len(fam));
+		add_interval(ctx, fam, &min, &max, entry);
+	}
+}
+
+static void add_addr(idx_build_t *ctx, const struct sockaddr_storage *ss,
+                     uint32_t entry)
+{
+	idx_bound_t bound;
+	int fam = addr_bound(ss, &bound);
+	if (fam >= 0) {
+		add_interval(ctx, fam, &bound, &bound, entry);
+	}
+}
+
+static void add_addr_range(idx_build_t *ctx, conf_val_t *range, uint32_t entry)
+{
+	while (range->code == KNOT_EOK) {
+		int prefix;
+		struct sockaddr_storage min_ss, max_ss;
+		min_ss = conf_addr_range(range, &max_ss, &prefix);
+
+		idx_bound_t min, max;
+		int fam = addr_bound(&min_ss, &min);
+		if (fam < 0) {
+			goto next_range;
+		}
+
+		if (max_ss.ss_family == AF_UNSPEC) {
+			// Prefix, the same as sockaddr_net_match().
+			size_t bits = family_len(fam) * 8;
+			if (prefix >= 0 && (size_t)prefix < bits) {
+				bits = prefix;
+			}
+			max = min;
+			for (size_t i = bits; i < family_len(fam) * 8; i++) {
+				uint8_t mask = 1 << (7 - i % 8);
+				min.addr[i / 8] &= ~mask;
+				max.addr[i / 8] |= mask;
+			}
+		} else if (addr_bound(&max_ss, &max) != fam) {
+			goto next_range;
+		}
+
+		add_interval(ctx, fam, &min, &max, entry);
+next_range:
+		conf_val_next(range);
+	}
+}
+
+static void add_key(idx_build_t *ctx, const knot_dname_t *name, uint32_t entry)
+{
+	trie_val_t *val = trie_get_try(ctx->idx->keys, name, knot_dname_size(name));
+	if (val == NULL) {
+		return;
+	}
+
+	idx_keyref_t ref = { entry, (idx_key_t *)*val - ctx->idx->key_arr };
+	if (idx_keyref_dynarray_add(&ctx->keyrefs, &ref) == NULL) {
+		ctx->failed = true;
+	}
+}
+
+static void add_nokey(idx_build_t *ctx, uint32_t entry)
+{
+	if (idx_u32_dynarray_add(&ctx->nokey, &entry) == NULL) {
+		ctx->failed = true;
+	}
+}
+
+/*! \brief Compiles a remote referenced from an ACL or used for automatic ACL. */
+static void add_remote(idx_build_t *ctx, conf_val_t *id, bool automatic)
+{
+	conf_t *conf = ctx->conf;
+
+	conf_val_t addr_val = conf_id_get(conf, C_RMT, C_ADDR, id);
+	if (automatic) {
+		conf_val_t val = conf_id_get(conf, C_RMT, C_AUTO_ACL, id);
+		if (!conf_bool(&val) || addr_val.code != KNOT_EOK) {
+			return;
+		}
+	}
+
+	conf_val_t pin_val = conf_id_get(conf, C_RMT, C_CERT_PIN, id);
+	uint32_t entry = add_entry(ctx, &pin_val);
+
+	if (addr_val.code == KNOT_ENOENT) {
+		add_any_addr(ctx, entry);
+	}
+	while (addr_val.code == KNOT_EOK) {
+		struct sockaddr_storage ss = conf_addr(&addr_val, NULL);
+		add_addr(ctx, &ss, entry);
+		conf_val_next(&addr_val);
+	}
+
+	conf_val_t key_val = conf_id_get(conf, C_RMT, C_KEY, id);
+	if (key_val.code == KNOT_EOK) {
+		add_key(ctx, conf_dname(&key_val), entry);
+	} else {
+		add_nokey(ctx, entry);
+	}
+}
+
+static idx_rule_t *add_rule(idx_build_t *ctx, trie_t *trie, conf_val_t *id)
+{
+	acl_index_t *idx = ctx->idx;
+	if (idx->rule_count >= ctx->rule_max) {
+		ctx->failed = true;
+		return NULL;
+	}
+
+	const char *name = conf_str(id);
+	trie_val_t *val = trie_get_ins(trie, (const trie_key_t *)name, strlen(name));
+	if (val == NULL) {
+		ctx->failed = true;
+		return NULL;
+	}
+
+	idx_rule_t *rule = &idx->rule_arr[idx->rule_count++];
+	rule->first = ctx->entries.size;
+	*val = rule;
+
+	return rule;
+}
+
+static void add_acl(idx_build_t *ctx, conf_val_t *id)
+{
+	conf_t *conf = ctx->conf;
+
+	idx_rule_t *rule = add_rule(ctx, ctx->idx->rules, id);
+	if (rule == NULL) {
+		return;
+	}
+
+	conf_val_t val = conf_id_get(conf, C_ACL, C_DENY, id);
+	rule->deny = conf_bool(&val);
+
+	val = conf_id_get(conf, C_ACL, C_ACTION, id);
+	rule->no_action = (val.code == KNOT_ENOENT);
+	while (val.code == KNOT_EOK) {
+		rule->actions |= 1 << conf_opt(&val);
+		conf_val_next(&val);
+	}
+
+	val = conf_id_get(conf, C_ACL, C_UPDATE_TYPE, id);
+	conf_val_t owner = conf_id_get(conf, C_ACL, C_UPDATE_OWNER, id);
+	rule->update_rules = (conf_val_count(&val) > 0 ||
+	                      conf_opt(&owner) != ACL_UPDATE_OWNER_NONE);
+
+	conf_val_t rmt_val = conf_id_get(conf, C_ACL, C_RMT, id);
+	if (rmt_val.code == KNOT_EOK) {
+		conf_mix_iter_t iter;
+		conf_mix_iter_init(conf, &rmt_val, &iter);
+		while (iter.id->code == KNOT_EOK) {
+			add_remote(ctx, iter.id, false);
+			conf_mix_iter_next(&iter);
+		}
+	} else {
+		conf_val_t pin_val = conf_id_get(conf, C_ACL, C_CERT_PIN, id);
+		uint32_t entry = add_entry(ctx, &pin_val);
+
+		conf_val_t addr_val = conf_id_get(conf, C_ACL, C_ADDR, id);
+		if (addr_val.code == KNOT_ENOENT) {
+			add_any_addr(ctx, entry);
+		} else {
+			add_addr_range(ctx, &addr_val, entry);
+		}
+
+		conf_val_t key_val = conf_id_get(conf, C_ACL, C_KEY, id);
+		if (key_val.code == KNOT_ENOENT) {
+			add_nokey(ctx, entry);
+		}
+		while (key_val.code == KNOT_EOK) {
+			add_key(ctx, conf_dname(&key_val), entry);
+			conf_val_next(&key_val);
+		}
+	}
+
+	rule->count = ctx->entries.size - rule->first;
+}
+
+static void add_keys(idx_build_t *ctx)
+{
+	conf_t *conf = ctx->conf;
+	acl_index_t *idx = ctx->idx;
+
+	for (conf_iter_t iter = conf_iter(conf, C_KEY); iter.code == KNOT_EOK;
+	     conf_iter_next(conf, &iter)) {
+		if (idx->key_count >= ctx->key_max) {
+			ctx->failed = true;
+			conf_iter_finish(conf, &iter);
+			return;
+		}
+		idx_key_t *key = &idx->key_arr[idx->key_count++];
+
+		conf_val_t id = conf_iter_id(conf, &iter);
+		key->name = knot_dname_copy(conf_dname(&id), NULL);
+		conf_val_t val = conf_id_get(conf, C_KEY, C_ALG, &id);
+		key->alg = conf_opt(&val);
+		val = conf_id_get(conf, C_KEY, C_SECRET, &id);
+		dnssec_binary_t secret = { 0 };
+		secret.data = (uint8_t *)conf_bin(&val, &secret.size);
+
+		trie_val_t *trie_val = NULL;
+		if (key->name != NULL) {
+			trie_val = trie_get_ins(idx->keys, key->name,
+			                        knot_dname_size(key->name));
+		}
+		if (trie_val == NULL ||
+		    dnssec_binary_dup(&secret, &key->secret) != KNOT_EOK) {
+			ctx->failed = true;
+			conf_iter_finish(conf, &iter);
+			return;
+		}
+		*trie_val = key;
+	}
+}
+
+static void add_remotes(idx_build_t *ctx)
+{
+	conf_t *conf = ctx->conf;
+
+	for (conf_iter_t iter = conf_iter(conf, C_RMT); iter.code == KNOT_EOK;
+	     conf_iter_next(conf, &iter)) {
+		conf_val_t id = conf_iter_id(conf, &iter);
+		idx_rule_t *rule = add_rule(ctx, ctx->idx->remotes, &id);
+		if (rule == NULL) {
+			conf_iter_finish(conf, &iter);
+			return;
+		}
+		add_remote(ctx, &id, true);
+		rule->count = ctx->entries.size - rule->first;
+	}
+
+	/* Remote groups take precedence, the same as in conf_mix_iter. */
+	for (conf_iter_t iter = conf_iter(conf, C_RMTS); iter.code == KNOT_EOK;
+	     conf_iter_next(conf, &iter)) {
+		conf_val_t id = conf_iter_id(conf, &iter);
+		idx_rule_t *rule = add_rule(ctx, ctx->idx->remotes, &id);
+		if (rule == NULL) {
+			conf_iter_finish(conf, &iter);
+			return;
+		}
+		conf_val_t val = conf_id_get(conf, C_RMTS, C_RMT, &id);
+		while (val.code == KNOT_EOK) {
+			add_remote(ctx, &val, true);
+			conf_val_next(&val);
+		}
+		rule->count = ctx->entries.size - rule->first;
+	}
+}
+
+/*! \brief Returns the index of the last bound not greater than the address. */
+static ssize_t segment_find(const idx_segments_t *segs, const idx_bound_t *addr)
+{
+	ssize_t lo = 0, hi = segs->count;
+	while (lo < hi) {
+		ssize_t mid = lo + (hi - lo) / 2;
+		if (bound_cmp(&segs->bounds[mid], addr) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo - 1;
+}
+
+static int build_segments(idx_build_t *ctx, int fam)
+{
+	idx_segments_t *segs = &ctx->idx->segs[fam];
+	idx_interval_dynarray_t *intervals = &ctx->intervals[fam];
+	size_t len = family_len(fam);
+	size_t words = ctx->idx->words;
+
+	if (intervals->size == 0) {
+		return KNOT_EOK;
+	}
+
+	/* Segment bounds are the interval starts and the successors of the ends. */
+	segs->bounds = calloc(2 * intervals->size, sizeof(*segs->bounds));
+	if (segs->bounds == NULL) {
+		return KNOT_ENOMEM;
+	}
+	knot_dynarray_foreach(idx_interval, idx_interval_t, it, *intervals) {
+		segs->bounds[segs->count++] = it->min;
+		idx_bound_t next = it->max;
+		if (bound_inc(&next, len)) {
+			segs->bounds[segs->count++] = next;
+		}
+	}
+	qsort(segs->bounds, segs->count, sizeof(*segs->bounds), bound_cmp);
+	size_t unique = 1;
+	for (size_t i = 1; i < segs->count; i++) {
+		if (bound_cmp(&segs->bounds[i], &segs->bounds[unique - 1]) != 0) {
+			segs->bounds[unique++] = segs->bounds[i];
+		}
+	}
+	segs->count = unique;
+
+	segs->bits = calloc(segs->count * words, sizeof(uint64_t));
+	if (segs->bits == NULL) {
+		return KNOT_ENOMEM;
+	}
+	knot_dynarray_foreach(idx_interval, idx_interval_t, it, *intervals) {
+		ssize_t i = segment_find(segs, &it->min);
+		assert(i >= 0);
+		for (; i < (ssize_t)segs->count && bound_cmp(&segs->bounds[i], &it->max) <= 0; i++) {
+			bit_set(segs->bits + i * words, it->entry);
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int build_bitmaps(idx_build_t *ctx)
+{
+	acl_index_t *idx = ctx->idx;
+
+	idx->entry_count = ctx->entries.size;
+	idx->entries = calloc(idx->entry_count, sizeof(*idx->entries));
+	idx->words = (idx->entry_count + 63) / 64;
+	idx->nokey = calloc(idx->words, sizeof(uint64_t));
+	idx->key_bits = calloc(idx->key_count * idx->words, sizeof(uint64_t));
+	if ((idx->entry_count > 0 && idx->entries == NULL) ||
+	    (idx->words > 0 && idx->nokey == NULL) ||
+	    (idx->key_count * idx->words > 0 && idx->key_bits == NULL)) {
+		return KNOT_ENOMEM;
+	}
+
+	memcpy(idx->entries, idx_entry_dynarray_arr(&ctx->entries),
+	       idx->entry_count * sizeof(*idx->entries));
+	ctx->entries.size = 0; // Pins moved to the index.
+
+	knot_dynarray_foreach(idx_u32, uint32_t, it, ctx->nokey) {
+		bit_set(idx->nokey, *it);
+	}
+	knot_dynarray_foreach(idx_keyref, idx_keyref_t, it, ctx->keyrefs) {
+		bit_set(idx->key_bits + it->key * idx->words, it->entry);
+	}
+
+	for (int fam = 0; fam < IDX_FAMILIES; fam++) {
+		int ret = build_segments(ctx, fam);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static void free_entries(idx_entry_t *entries, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		for (size_t j = 0; j < entries[i].pins_count; j++) {
+			dnssec_binary_free(&entries[i].pins[j]);
+		}
+		free(entries[i].pins);
+	}
+}
+
+acl_index_t *acl_index_new(conf_t *conf)
+{
+	if (conf == NULL) {
+		return NULL;
+	}
+
+	acl_index_t *idx = calloc(1, sizeof(*idx));
+	if (idx == NULL) {
+		return NULL;
+	}
+
+	idx_build_t ctx = {
+		.conf = conf,
+		.idx = idx,
+		.rule_max = conf_id_count(conf, C_ACL) + conf_id_count(conf, C_RMT) +
+		            conf_id_count(conf, C_RMTS),
+		.key_max = conf_id_count(conf, C_KEY),
+	};
+
+	idx->rules = trie_create(NULL);
+	idx->remotes = trie_create(NULL);
+	idx->keys = trie_create(NULL);
+	idx->rule_arr = calloc(ctx.rule_max, sizeof(*idx->rule_arr));
+	idx->key_arr = calloc(ctx.key_max, sizeof(*idx->key_arr));
+	if (idx->rules == NULL || idx->remotes == NULL || idx->keys == NULL ||
+	    (ctx.rule_max > 0 && idx->rule_arr == NULL) ||
+	    (ctx.key_max > 0 && idx->key_arr == NULL)) {
+		ctx.failed = true;
+	}
+
+	if (!ctx.failed) {
+		add_keys(&ctx);
+	}
+	for (conf_iter_t iter = conf_iter(conf, C_ACL);
+	     !ctx.failed && iter.code == KNOT_EOK; conf_iter_next(conf, &iter)) {
+		conf_val_t id = conf_iter_id(conf, &iter);
+		add_acl(&ctx, &id);
+		if (ctx.failed) {
+			conf_iter_finish(conf, &iter);
+		}
+	}
+	if (!ctx.failed) {
+		add_remotes(&ctx);
+	}
+	if (!ctx.failed && build_bitmaps(&ctx) != KNOT_EOK) {
+		ctx.failed = true;
+	}
+
+	free_entries(idx_entry_dynarray_arr(&ctx.entries), ctx.entries.size);
+	idx_entry_dynarray_free(&ctx.entries);
+	for (int fam = 0; fam < IDX_FAMILIES; fam++) {
+		idx_interval_dynarray_free(&ctx.intervals[fam]);
+	}
+	idx_keyref_dynarray_free(&ctx.keyrefs);
+	idx_u32_dynarray_free(&ctx.nokey);
+
+	if (ctx.failed) {
+		acl_index_free(idx);
+		return NULL;
+	}
+
+	return idx;
+}
+
+void acl_index_free(acl_index_t *idx)
+{
+	if (idx == NULL) {
+		return;
+	}
+
+	trie_free(idx->rules);
+	trie_free(idx->remotes);
+	trie_free(idx->keys);
+	free(idx->rule_arr);
+	for (size_t i = 0; i < idx->key_count; i++) {
+		knot_dname_free(idx->key_arr[i].name, NULL);
+		dnssec_binary_free(&idx->key_arr[i].secret);
+	}
+	free(idx->key_arr);
+	free_entries(idx->entries, idx->entry_count);
+	free(idx->entries);
+	free(idx->nokey);
+	free(idx->key_bits);
+	for (int fam = 0; fam < IDX_FAMILIES; fam++) {
+		free(idx->segs[fam].bounds);
+		free(idx->segs[fam].bits);
+	}
+	free(idx);
+}
+
+/*! \brief Returns the entry bitmap of the address segment or NULL. */
+static const uint64_t *idx_addr_bits(const acl_index_t *idx,
+                                     const struct sockaddr_storage *addr)
+{
+	idx_bound_t bound;
+	int fam = addr_bound(addr, &bound);
+	assert(fam >= 0);
+
+	const idx_segments_t *segs = &idx->segs[fam];
+	ssize_t pos = segment_find(segs, &bound);
+
+	return (pos >= 0) ? segs->bits + pos * idx->words : NULL;
+}
+
+/*! \brief Returns the configured key matching the TSIG name and algorithm. */
+static const idx_key_t *idx_key(const acl_index_t *idx, const knot_tsig_key_t *tsig)
+{
+	if (tsig->name == NULL) {
+		return NULL;
+	}
+
+	trie_val_t *val = trie_get_try(idx->keys, tsig->name,
+	                               knot_dname_size(tsig->name));
+	if (val == NULL) {
+		return NULL;
+	}
+
+	const idx_key_t *key = *val;
+	return (key->alg == tsig->algorithm) ? key : NULL;
+}
+
+/*! \brief Identifiers from the confdb or from a pre-resolved copy. */
+typedef struct {
+	conf_val_t *val;
+	const conf_ids_t *ids;
+	size_t pos;
+} idx_ids_t;
+
+static const char *idx_ids_get(idx_ids_t *it)
+{
+	if (it->ids != NULL) {
+		return (it->pos < it->ids->count) ? it->ids->ids[it->pos] : NULL;
+	} else {
+		return (it->val->code == KNOT_EOK) ? conf_str(it->val) : NULL;
+	}
+}
+
+static void idx_ids_next(idx_ids_t *it)
+{
+	if (it->ids != NULL) {
+		it->pos++;
+	} else {
+		conf_val_next(it->val);
+	}
+}
+
+static const idx_rule_t *idx_rule(trie_t *trie, const char *id)
+{
+	trie_val_t *val = trie_get_try(trie, (const trie_key_t *)id, strlen(id));
+
+	return (val != NULL) ? *val : NULL;
+}
+
+static bool idx_pin_check(const idx_entry_t *entry, const uint8_t *session_pin,
+                          size_t session_pin_size)
+{
+	if (entry->pins_count == 0) { // No certificate pin authentication required.
+		return true;
+	}
+
+	for (size_t i = 0; i < entry->pins_count; i++) {
+		const dnssec_binary_t *pin = &entry->pins[i];
+		if (pin->size == session_pin_size && session_pin_size > 0 &&
+		    const_time_memcmp(pin->data, session_pin, pin->size) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*!
+ * \brief Checks if any entry of the rule matches the address, key and pin.
+ *
+ * Same semantics as check_addr_key(): an entry with keys requires one of them,
+ * an entry without keys requires no TSIG unless it's a deny rule.
+ */
+static bool idx_rule_match(const acl_index_t *idx, const idx_rule_t *rule,
+                           const uint64_t *addr_bits, const knot_tsig_key_t *tsig,
+                           const idx_key_t *key, const uint8_t *session_pin,
+                           size_t session_pin_size)
+{
+	if (addr_bits == NULL) {
+		return false;
+	}
+
+	const uint64_t *key_bits = (key != NULL) ?
+	                           idx->key_bits + (key - idx->key_arr) * idx->words : NULL;
+
+	for (uint32_t e = rule->first; e < rule->first + rule->count; e++) {
+		if (!bit_test(addr_bits, e)) {
+			continue;
+		}
+		if (tsig->name == NULL || rule->deny) {
+			if (!bit_test(idx->nokey, e) &&
+			    (key_bits == NULL || !bit_test(key_bits, e))) {
+				continue;
+			}
+		} else if (key_bits == NULL || !bit_test(key_bits, e)) {
+			continue;
+		}
+		if (!idx_pin_check(&idx->entries[e], session_pin, session_pin_size)) {
+			continue;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+static bool idx_acl_allowed(conf_t *conf, idx_ids_t *acl, acl_action_t action,
+                            const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
+                            const knot_dname_t *zone_name, knot_pkt_t *query,
+                            const uint8_t *session_pin, size_t session_pin_size)
+{
+	const acl_index_t *idx = conf->acl_index;
+	const uint64_t *addr_bits = idx_addr_bits(idx, addr);
+	const idx_key_t *key = idx_key(idx, tsig);
+
+	for (const char *id; (id = idx_ids_get(acl)) != NULL; idx_ids_next(acl)) {
+		const idx_rule_t *rule = idx_rule(idx->rules, id);
+		if (rule == NULL ||
+		    !idx_rule_match(idx, rule, addr_bits, tsig, key, session_pin,
+		                    session_pin_size)) {
+			continue;
+		}
+
+		/* Check if the action is allowed. */
+		if (action != ACL_ACTION_QUERY) {
+			if (rule->no_action) { /* Empty action list allowed with deny only. */
+				return false;
+			} else if (!(rule->actions & (1 << action))) {
+				continue;
+			}
+		}
+
+		/* If the action is update, check for update rule match. */
+		if (action == ACL_ACTION_UPDATE && rule->update_rules &&
+		    !update_match(conf, (const uint8_t *)id, strlen(id) + 1,
+		                  tsig->name, zone_name, query)) {
+			continue;
+		}
+
+		/* Check if denied. */
+		if (rule->deny) {
+			return false;
+		}
+
+		/* Fill the output with tsig secret if provided. */
+		if (tsig->name != NULL) {
+			assert(key != NULL);
+			tsig->secret = key->secret;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+static bool idx_rmt_allowed(const acl_index_t *idx, idx_ids_t *rmts,
+                            const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
+                            const uint8_t *session_pin, size_t session_pin_size)
+{
+	const uint64_t *addr_bits = idx_addr_bits(idx, addr);
+	const idx_key_t *key = idx_key(idx, tsig);
+
+	for (const char *id; (id = idx_ids_get(rmts)) != NULL; idx_ids_next(rmts)) {
+		const idx_rule_t *rule = idx_rule(idx->remotes, id);
+		if (rule == NULL ||
+		    !idx_rule_match(idx, rule, addr_bits, tsig, key, session_pin,
+		                    session_pin_size)) {
+			continue;
+		}
+
+		/* Fill out the output with tsig secret if provided. */
+		if (tsig->name != NULL) {
+			assert(key != NULL);
+			tsig->secret = key->secret;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+bool acl_index_usable(conf_t *conf, const struct sockaddr_storage *addr)
+{
+	return conf->acl_index != NULL && addr != NULL &&
+	       (addr->ss_family == AF_INET || addr->ss_family == AF_INET6);
+}
+
 bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
                  const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
                  const knot_dname_t *zone_name, knot_pkt_t *query,
@@ -270,6 +1123,12 @@ bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
 	size_t session_pin_size = 0;
 #endif // ENABLE_QUIC
 
+	if (acl_index_usable(conf, addr)) {
+		idx_ids_t ids = { .val = acl };
+		return idx_acl_allowed(conf, &ids, action, addr, tsig, zone_name,
+		                       query, session_pin, session_pin_size);
+	}
+
 	while (acl->code == KNOT_EOK) {
 		conf_val_t rmt_val = conf_id_get(conf, C_ACL, C_RMT, acl);
 		bool remote = (rmt_val.code == KNOT_EOK);
@@ -329,7 +1188,7 @@ bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
 
 		/* If the action is update, check for update rule match. */
 		if (action == ACL_ACTION_UPDATE &&
-		    !update_match(conf, acl, tsig->name, zone_name, query)) {
+		    !update_match(conf, acl->data, acl->len, tsig->name, zone_name, query)) {
 			goto next_acl;
 		}
 
@@ -368,6 +1227,12 @@ bool rmt_allowed(conf_t *conf, conf_val_t *rmts, const struct sockaddr_storage *
 	size_t session_pin_size = 0;
 #endif // ENABLE_QUIC
 
+	if (acl_index_usable(conf, addr)) {
+		idx_ids_t ids = { .val = rmts };
+		return idx_rmt_allowed(conf->acl_index, &ids, addr, tsig,
+		                       session_pin, session_pin_size);
+	}
+
 	conf_mix_iter_t iter;
 	conf_mix_iter_init(conf, rmts, &iter);
 	while (iter.id->code == KNOT_EOK) {
@@ -423,3 +1288,52 @@ next_remote:
 
 	return false;
 }
+
+bool acl_allowed_ids(conf_t *conf, const conf_ids_t *acl, acl_action_t action,
+                     const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
+                     const knot_dname_t *zone_name, knot_pkt_t *query,
+                     struct knot_quic_conn *conn)
+{
+	if (acl == NULL || tsig == NULL || !acl_index_usable(conf, addr)) {
+		return false;
+	}
+
+#ifdef ENABLE_QUIC
+	uint8_t session_pin[KNOT_QUIC_PIN_LEN];
+	size_t session_pin_size = sizeof(session_pin);
+	knot_quic_conn_pin(conn, session_pin, &session_pin_size, false);
+#else
+	uint8_t session_pin[1];
+	size_t session_pin_size = 0;
+#endif // ENABLE_QUIC
+
+	idx_ids_t ids = { .ids = acl };
+	return idx_acl_allowed(conf, &ids, action, addr, tsig, zone_name, query,
+	                       session_pin, session_pin_size);
+}
+
+bool rmt_allowed_ids(conf_t *conf, const conf_ids_t *rmts,
+                     const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
+                     struct knot_quic_conn *conn)
+{
+	if (!conf->cache.srv_auto_acl) {
+		return false;
+	}
+
+	if (rmts == NULL || !acl_index_usable(conf, addr)) {
+		return false;
+	}
+
+#ifdef ENABLE_QUIC
+	uint8_t session_pin[KNOT_QUIC_PIN_LEN];
+	size_t session_pin_size = sizeof(session_pin);
+	knot_quic_conn_pin(conn, session_pin, &session_pin_size, false);
+#else
+	uint8_t session_pin[1];
+	size_t session_pin_size = 0;
+#endif // ENABLE_QUIC
+
+	idx_ids_t ids = { .ids = rmts };
+	return idx_rmt_allowed(conf->acl_index, &ids, addr, tsig,
+	                       session_pin, session_pin_size);
+}
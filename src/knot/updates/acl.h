@@ -45,6 +45,30 @@ typedef enum {
 	ACL_UPDATE_MATCH_SUB   = 2,
 } acl_update_owner_match_t;
 
+/*!
+ * \brief Compiled ACL and automatic ACL matcher.
+ *
+ * The matcher is built once per configuration and published together with
+ * it. It holds a partition of the address space into segments, each with
+ * a bitmap of matching ACL entries, key bitmaps, and per-rule action masks,
+ * so that a request check doesn't walk the configuration database.
+ */
+typedef struct acl_index acl_index_t;
+
+/*!
+ * \brief Compiles ACLs, remotes and keys of the configuration into a matcher.
+ *
+ * \param conf  Configuration.
+ *
+ * \return Matcher or NULL if error.
+ */
+acl_index_t *acl_index_new(conf_t *conf);
+
+/*!
+ * \brief Frees the ACL matcher.
+ */
+void acl_index_free(acl_index_t *idx);
+
 /*!
  * \brief Checks if the address and/or tsig key matches given ACL list.
  *
@@ -84,3 +108,32 @@ bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
  */
 bool rmt_allowed(conf_t *conf, conf_val_t *rmts, const struct sockaddr_storage *addr,
                  knot_tsig_key_t *tsig, struct knot_quic_conn *conn);
+
+/*!
+ * \brief Checks if the compiled matcher can be used for the check.
+ *
+ * \param conf  Configuration.
+ * \param addr  IP address.
+ *
+ * \retval True if the configuration has a compiled matcher and addr is IP.
+ */
+bool acl_index_usable(conf_t *conf, const struct sockaddr_storage *addr);
+
+/*!
+ * \brief Same as acl_allowed(), with pre-resolved ACL identifiers.
+ *
+ * \note The compiled matcher must be usable, see acl_index_usable().
+ */
+bool acl_allowed_ids(conf_t *conf, const conf_ids_t *acl, acl_action_t action,
+                     const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
+                     const knot_dname_t *zone_name, knot_pkt_t *query,
+                     struct knot_quic_conn *conn);
+
+/*!
+ * \brief Same as rmt_allowed(), with pre-resolved remote identifiers.
+ *
+ * \note The compiled matcher must be usable, see acl_index_usable().
+ */
+bool rmt_allowed_ids(conf_t *conf, const conf_ids_t *rmts,
+                     const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
+                     struct knot_quic_conn *conn);
@@ -374,6 +374,7 @@ void update_free_zone(zone_contents_t *contents)
 	free(contents->nsec3_nodes);
 
 	dnssec_nsec3_params_free(&contents->nsec3_params);
+	answer_cache_free(contents->answer_cache);
 
 	free(contents);
 }
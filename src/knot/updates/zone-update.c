@@ -678,8 +678,8 @@ int zone_update_increment_soa(zone_update_t *update, conf_t *conf)
 		return KNOT_EINVAL;
 	}
 
-	conf_val_t val = conf_zone_get(conf, C_SERIAL_POLICY, update->zone->name);
-	return set_new_soa(update, conf_opt(&val));
+	return set_new_soa(update, zone_conf_serial_policy(conf, &update->zone->settings,
+	                                                   update->zone->name));
 }
 
 static void get_zone_diff(zone_diff_t *zdiff, zone_update_t *up)
@@ -691,8 +691,8 @@ static void get_zone_diff(zone_diff_t *zdiff, zone_update_t *up)
 
 static int commit_journal(conf_t *conf, zone_update_t *update)
 {
-	conf_val_t val = conf_zone_get(conf, C_JOURNAL_CONTENT, update->zone->name);
-	unsigned content = conf_opt(&val);
+	unsigned content = zone_conf_journal_content(conf, &update->zone->settings,
+	                                             update->zone->name);
 	int ret = KNOT_EOK;
 	if (update->flags & UPDATE_NO_CHSET) {
 		zone_diff_t diff;
@@ -896,7 +896,11 @@ int zone_update_verify_digest(conf_t *conf, zone_update_t *update)
 		return KNOT_EOK;
 	}
 
-	int ret = zone_contents_digest_verify(update->new_cont);
+	// The cached digest can be trusted only for the unchanged contents.
+	val = conf_zone_get(conf, C_ADJUST_THR, update->zone->name);
+	int ret = zone_contents_digest_verify(update->new_cont, conf_int(&val),
+	                                      &update->zone->digest_cache,
+	                                      zone_update_no_change(update));
 	if (ret != KNOT_EOK) {
 		log_zone_error(update->zone->name, "ZONEMD, verification failed (%s)",
 		               knot_strerror(ret));
@@ -1001,6 +1005,12 @@ int zone_update_commit(conf_t *conf, zone_update_t *update)
 		}
 	}
 
+	/* Attach an empty answer cache to the new zone version. */
+	val = conf_zone_get(conf, C_ANS_CACHE, update->zone->name);
+	if (conf_int(&val) > 0 && update->new_cont->answer_cache == NULL) {
+		update->new_cont->answer_cache = answer_cache_new(conf_int(&val));
+	}
+
 	/* Switch zone contents. */
 	zone_contents_t *old_contents;
 	old_contents = zone_switch_contents(update->zone, update->new_cont);
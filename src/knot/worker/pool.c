@@ -16,33 +16,219 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "contrib/macros.h"
+#include "contrib/spinlock.h"
 #include "libknot/libknot.h"
 #include "knot/server/dthreads.h"
 #include "knot/worker/pool.h"
 
+/*!
+ * \brief Task queue with its own lock.
+ */
+typedef struct {
+	knot_spin_t lock;
+	worker_queue_t tasks;
+	atomic_size_t length;	/*!< Queue length readable without locking. */
+} worker_lane_t;
+
 /*!
  * \brief Worker pool state.
+ *
+ * Each worker has its own lane where ordinary tasks are distributed in
+ * a round-robin manner. A worker takes tasks from the front of its lane
+ * and if empty, it steals from the end of the other lanes. Priority tasks
+ * are taken before all others from a shared lane. CPU-heavy tasks are
+ * in another shared lane and only a limited number of them can run
+ * concurrently, so that the remaining workers process I/O-bound tasks.
+ *
+ * The pool mutex is only used for sleeping of idle workers and waiting
+ * for finished tasks.
  */
 struct worker_pool {
 	dt_unit_t *threads;
 
-	pthread_mutex_t lock;
-	pthread_cond_t wake;
+	worker_lane_t *lanes;	/*!< Per-worker lanes. */
+	unsigned lanes_count;
+	worker_lane_t prio;	/*!< Lane of priority tasks. */
+	worker_lane_t cpu;	/*!< Lane of CPU-heavy tasks. */
+	unsigned cpu_limit;	/*!< Maximum number of concurrently running CPU-heavy tasks. */
 
-	bool terminating;	/*!< Is the pool terminating? .*/
-	bool suspended;		/*!< Is execution temporarily suspended? .*/
-	int running;		/*!< Number of running threads. */
-	worker_queue_t tasks;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;	/*!< Idle workers wakeup. */
+	pthread_cond_t done;	/*!< Task finished notification for waiters. */
+
+	atomic_bool terminating;	/*!< Is the pool terminating? .*/
+	atomic_bool suspended;		/*!< Is execution temporarily suspended? .*/
+	atomic_int running;		/*!< Number of running tasks. */
+	atomic_int queued;		/*!< Number of queued tasks. */
+	atomic_uint cpu_running;	/*!< Number of running CPU-heavy tasks. */
+	atomic_uint idle;		/*!< Number of sleeping workers. */
+	atomic_uint waiters;		/*!< Number of threads waiting for tasks to finish. */
+	atomic_uint generation;		/*!< Incremented when a task may become available. */
+	atomic_uint next_lane;		/*!< Round-robin lane selector. */
 };
 
+static void lane_init(worker_lane_t *lane)
+{
+	knot_spin_init(&lane->lock);
+	worker_queue_init(&lane->tasks);
+	atomic_init(&lane->length, 0);
+}
+
+static void lane_deinit(worker_lane_t *lane)
+{
+	worker_queue_deinit(&lane->tasks);
+	knot_spin_destroy(&lane->lock);
+}
+
+static int lane_push(worker_lane_t *lane, worker_task_t *task)
+{
+	knot_spin_lock(&lane->lock);
+	int ret = worker_queue_enqueue(&lane->tasks, task);
+	atomic_store(&lane->length, worker_queue_length(&lane->tasks));
+	knot_spin_unlock(&lane->lock);
+
+	return ret;
+}
+
+static worker_task_t *lane_pop(worker_lane_t *lane, bool last)
+{
+	if (atomic_load(&lane->length) == 0) {
+		return NULL;
+	}
+
+	knot_spin_lock(&lane->lock);
+	worker_task_t *task = last ? worker_queue_dequeue_last(&lane->tasks) :
+	                             worker_queue_dequeue(&lane->tasks);
+	atomic_store(&lane->length, worker_queue_length(&lane->tasks));
+	knot_spin_unlock(&lane->lock);
+
+	return task;
+}
+
+static size_t lane_clear(worker_lane_t *lane)
+{
+	knot_spin_lock(&lane->lock);
+	size_t count = worker_queue_length(&lane->tasks);
+	worker_queue_deinit(&lane->tasks);
+	worker_queue_init(&lane->tasks);
+	atomic_store(&lane->length, 0);
+	knot_spin_unlock(&lane->lock);
+
+	return count;
+}
+
+/*!
+ * \brief Signal that a task may have become available.
+ */
+static void notify_workers(worker_pool_t *pool, bool all)
+{
+	atomic_fetch_add(&pool->generation, 1);
+	if (atomic_load(&pool->idle) > 0) {
+		pthread_mutex_lock(&pool->lock);
+		if (all) {
+			pthread_cond_broadcast(&pool->wake);
+		} else {
+			pthread_cond_signal(&pool->wake);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+static void notify_waiters(worker_pool_t *pool)
+{
+	if (atomic_load(&pool->waiters) > 0) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+static bool cpu_reserve(worker_pool_t *pool)
+{
+	unsigned running = atomic_load(&pool->cpu_running);
+	while (running < pool->cpu_limit) {
+		if (atomic_compare_exchange_weak(&pool->cpu_running, &running, running + 1)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*!
+ * \brief Take the next task to be run by the given worker.
+ *
+ * \param cpu  Output: the task took a CPU-heavy task slot.
+ */
+static worker_task_t *take_task(worker_pool_t *pool, unsigned id, bool *cpu)
+{
+	worker_task_t *task = lane_pop(&pool->prio, false);
+
+	if (task == NULL && atomic_load(&pool->cpu.length) > 0 && cpu_reserve(pool)) {
+		task = lane_pop(&pool->cpu, false);
+		if (task != NULL) {
+			*cpu = true;
+		} else {
+			atomic_fetch_sub(&pool->cpu_running, 1);
+		}
+	}
+
+	if (task == NULL) {
+		task = lane_pop(&pool->lanes[id], false);
+	}
+
+	for (unsigned i = 1; task == NULL && i < pool->lanes_count; i++) {
+		task = lane_pop(&pool->lanes[(id + i) % pool->lanes_count], true);
+	}
+
+	if (task != NULL) {
+		/* Keep the task accounted all the time for the waiters. */
+		atomic_fetch_add(&pool->running, 1);
+		atomic_fetch_sub(&pool->queued, 1);
+	}
+
+	return task;
+}
+
+/*!
+ * \brief Sleep until a task may be available or the pool is terminating.
+ *
+ * \param generation  Pool generation before the last unsuccessful take.
+ */
+static void idle_wait(worker_pool_t *pool, unsigned generation)
+{
+	pthread_mutex_lock(&pool->lock);
+	atomic_fetch_add(&pool->idle, 1);
+	while (!atomic_load(&pool->terminating) &&
+	       atomic_load(&pool->generation) == generation) {
+		pthread_cond_wait(&pool->wake, &pool->lock);
+	}
+	atomic_fetch_sub(&pool->idle, 1);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static unsigned worker_id(worker_pool_t *pool, dthread_t *thread)
+{
+	for (unsigned i = 0; i < pool->lanes_count; i++) {
+		if (pool->threads->threads[i] == thread) {
+			return i;
+		}
+	}
+
+	assert(0);
+	return 0;
+}
+
 /*!
  * \brief Worker thread.
  *
- * The thread takes a task from the tasks queue and runs it, while checking
+ * The thread takes a task from the lanes and runs it, while checking
  * if the dispatching of new tasks is allowed by the thread pool.
  *
  * An execution of a running thread cannot be enforced.
@@ -53,36 +239,35 @@ static int worker_main(dthread_t *thread)
 	assert(thread);
 
 	worker_pool_t *pool = thread->data;
+	unsigned id = worker_id(pool, thread);
 
-	pthread_mutex_lock(&pool->lock);
-
-	for (;;) {
-		if (pool->terminating) {
-			break;
-		}
+	while (!atomic_load(&pool->terminating)) {
+		unsigned generation = atomic_load(&pool->generation);
 
 		worker_task_t *task = NULL;
-		if (!pool->suspended) {
-			task = worker_queue_dequeue(&pool->tasks);
+		bool cpu = false;
+		if (!atomic_load(&pool->suspended)) {
+			task = take_task(pool, id, &cpu);
 		}
 
 		if (task == NULL) {
-			pthread_cond_wait(&pool->wake, &pool->lock);
+			idle_wait(pool, generation);
 			continue;
 		}
 
 		assert(task->run);
-		pool->running += 1;
-
-		pthread_mutex_unlock(&pool->lock);
 		task->run(task);
-		pthread_mutex_lock(&pool->lock);
 
-		pool->running -= 1;
-		pthread_cond_broadcast(&pool->wake);
-	}
+		if (cpu) {
+			atomic_fetch_sub(&pool->cpu_running, 1);
+			if (atomic_load(&pool->cpu.length) > 0) {
+				notify_workers(pool, false);
+			}
+		}
 
-	pthread_mutex_unlock(&pool->lock);
+		atomic_fetch_sub(&pool->running, 1);
+		notify_waiters(pool);
+	}
 
 	return KNOT_EOK;
 }
@@ -91,12 +276,32 @@ static int worker_main(dthread_t *thread)
 
 worker_pool_t *worker_pool_create(unsigned threads)
 {
+	if (threads == 0) {
+		return NULL;
+	}
+
 	worker_pool_t *pool = malloc(sizeof(worker_pool_t));
 	if (pool == NULL) {
 		return NULL;
 	}
 
 	memset(pool, 0, sizeof(worker_pool_t));
+
+	pool->lanes = calloc(threads, sizeof(*pool->lanes));
+	if (pool->lanes == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pool->lanes_count = threads;
+	for (unsigned i = 0; i < threads; i++) {
+		lane_init(&pool->lanes[i]);
+	}
+	lane_init(&pool->prio);
+	lane_init(&pool->cpu);
+
+	int cpus = dt_online_cpus();
+	pool->cpu_limit = (cpus > 0) ? MIN(threads, (unsigned)cpus) : threads;
+
 	pool->threads = dt_create(threads, worker_main, NULL, pool);
 	if (pool->threads == NULL) {
 		goto fail;
@@ -110,12 +315,20 @@ worker_pool_t *worker_pool_create(unsigned threads)
 		goto fail;
 	}
 
-	worker_queue_init(&pool->tasks);
+	if (pthread_cond_init(&pool->done, NULL) != 0) {
+		goto fail;
+	}
 
 	return pool;
 
 fail:
 	dt_delete(&pool->threads);
+	for (unsigned i = 0; i < threads; i++) {
+		lane_deinit(&pool->lanes[i]);
+	}
+	lane_deinit(&pool->prio);
+	lane_deinit(&pool->cpu);
+	free(pool->lanes);
 	free(pool);
 	return NULL;
 }
@@ -130,8 +343,14 @@ void worker_pool_destroy(worker_pool_t *pool)
 
 	pthread_mutex_destroy(&pool->lock);
 	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
 
-	worker_queue_deinit(&pool->tasks);
+	for (unsigned i = 0; i < pool->lanes_count; i++) {
+		lane_deinit(&pool->lanes[i]);
+	}
+	lane_deinit(&pool->prio);
+	lane_deinit(&pool->cpu);
+	free(pool->lanes);
 
 	free(pool);
 }
@@ -152,7 +371,7 @@ void worker_pool_stop(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	pool->terminating = true;
+	atomic_store(&pool->terminating, true);
 	pthread_cond_broadcast(&pool->wake);
 	pthread_mutex_unlock(&pool->lock);
 
@@ -165,9 +384,7 @@ void worker_pool_suspend(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	pool->suspended = true;
-	pthread_mutex_unlock(&pool->lock);
+	atomic_store(&pool->suspended, true);
 }
 
 void worker_pool_resume(worker_pool_t *pool)
@@ -176,10 +393,8 @@ void worker_pool_resume(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	pool->suspended = false;
-	pthread_cond_broadcast(&pool->wake);
-	pthread_mutex_unlock(&pool->lock);
+	atomic_store(&pool->suspended, false);
+	notify_workers(pool, true);
 }
 
 void worker_pool_join(worker_pool_t *pool)
@@ -198,12 +413,14 @@ void worker_pool_wait_cb(worker_pool_t *pool, wait_callback_t cb)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	while (!EMPTY_LIST(pool->tasks.list) || pool->running > 0) {
+	atomic_fetch_add(&pool->waiters, 1);
+	while (atomic_load(&pool->queued) > 0 || atomic_load(&pool->running) > 0) {
 		if (cb != NULL) {
 			cb(pool);
 		}
-		pthread_cond_wait(&pool->wake, &pool->lock);
+		pthread_cond_wait(&pool->done, &pool->lock);
 	}
+	atomic_fetch_sub(&pool->waiters, 1);
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -218,10 +435,23 @@ void worker_pool_assign(worker_pool_t *pool, struct task *task)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	worker_queue_enqueue(&pool->tasks, task);
-	pthread_cond_signal(&pool->wake);
-	pthread_mutex_unlock(&pool->lock);
+	worker_lane_t *lane;
+	if (task->flags & WORKER_TASK_PRIO) {
+		lane = &pool->prio;
+	} else if (task->flags & WORKER_TASK_CPU) {
+		lane = &pool->cpu;
+	} else {
+		unsigned next = atomic_fetch_add(&pool->next_lane, 1);
+		lane = &pool->lanes[next % pool->lanes_count];
+	}
+
+	atomic_fetch_add(&pool->queued, 1);
+	if (lane_push(lane, task) != KNOT_EOK) {
+		atomic_fetch_sub(&pool->queued, 1);
+		return;
+	}
+
+	notify_workers(pool, false);
 }
 
 void worker_pool_clear(worker_pool_t *pool)
@@ -230,25 +460,22 @@ void worker_pool_clear(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	worker_queue_deinit(&pool->tasks);
-	worker_queue_init(&pool->tasks);
-	pthread_mutex_unlock(&pool->lock);
+	size_t cleared = lane_clear(&pool->prio) + lane_clear(&pool->cpu);
+	for (unsigned i = 0; i < pool->lanes_count; i++) {
+		cleared += lane_clear(&pool->lanes[i]);
+	}
+	atomic_fetch_sub(&pool->queued, cleared);
+
+	notify_waiters(pool);
 }
 
-void worker_pool_status(worker_pool_t *pool, bool locked, int *running, int *queued)
+void worker_pool_status(worker_pool_t *pool, int *running, int *queued)
 {
 	if (!pool) {
 		*running = *queued = 0;
 		return;
 	}
 
-	if (!locked) {
-		pthread_mutex_lock(&pool->lock);
-	}
-	*running = pool->running;
-	*queued = worker_queue_length(&pool->tasks);
-	if (!locked) {
-		pthread_mutex_unlock(&pool->lock);
-	}
+	*running = atomic_load(&pool->running);
+	*queued = atomic_load(&pool->queued);
 }
@@ -77,6 +77,8 @@ void worker_pool_wait_cb(worker_pool_t *pool, wait_callback_t cb);
 
 /*!
  * \brief Assign a task to be performed by a worker in the pool.
+ *
+ * The task is scheduled according to its flags (see worker_task_flag_t).
  */
 void worker_pool_assign(worker_pool_t *pool, struct task *task);
 
@@ -87,7 +89,5 @@ void worker_pool_clear(worker_pool_t *pool);
 
 /*!
  * \brief Obtain info regarding how the pool is busy.
- *
- * \note Locked means if the mutex `pool->lock` is locked.
  */
-void worker_pool_status(worker_pool_t *pool, bool locked, int *running, int *queued);
+void worker_pool_status(worker_pool_t *pool, int *running, int *queued);
@@ -14,8 +14,13 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "knot/worker/queue.h"
-#include "contrib/mempattern.h"
+#include "libknot/errcode.h"
+
+#define QUEUE_MIN_CAPACITY	16
 
 void worker_queue_init(worker_queue_t *queue)
 {
@@ -24,44 +29,82 @@ void worker_queue_init(worker_queue_t *queue)
 	}
 
 	memset(queue, 0, sizeof(worker_queue_t));
-
-	init_list(&queue->list);
-	mm_ctx_init(&queue->mm_ctx);
 }
 
 void worker_queue_deinit(worker_queue_t *queue)
 {
-	ptrlist_free(&queue->list, &queue->mm_ctx);
+	if (!queue) {
+		return;
+	}
+
+	free(queue->items);
+	memset(queue, 0, sizeof(worker_queue_t));
 }
 
-void worker_queue_enqueue(worker_queue_t *queue, worker_task_t *task)
+static int queue_grow(worker_queue_t *queue)
+{
+	size_t capacity = queue->capacity > 0 ? 2 * queue->capacity : QUEUE_MIN_CAPACITY;
+	worker_task_t **items = malloc(capacity * sizeof(*items));
+	if (items == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	/* Unwrap the ring into the new buffer. */
+	for (size_t i = 0; i < queue->length; i++) {
+		items[i] = queue->items[(queue->head + i) % queue->capacity];
+	}
+
+	free(queue->items);
+	queue->items = items;
+	queue->capacity = capacity;
+	queue->head = 0;
+
+	return KNOT_EOK;
+}
+
+int worker_queue_enqueue(worker_queue_t *queue, worker_task_t *task)
 {
 	if (!queue || !task) {
-		return;
+		return KNOT_EINVAL;
 	}
 
-	ptrlist_add(&queue->list, task, &queue->mm_ctx);
+	if (queue->length == queue->capacity) {
+		int ret = queue_grow(queue);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	queue->items[(queue->head + queue->length) % queue->capacity] = task;
+	queue->length++;
+
+	return KNOT_EOK;
 }
 
 worker_task_t *worker_queue_dequeue(worker_queue_t *queue)
 {
-	if (!queue) {
+	if (!queue || queue->length == 0) {
 		return NULL;
 	}
 
-	worker_task_t *task = NULL;
+	worker_task_t *task = queue->items[queue->head];
+	queue->head = (queue->head + 1) % queue->capacity;
+	queue->length--;
 
-	if (!EMPTY_LIST(queue->list)) {
-		ptrnode_t *node = HEAD(queue->list);
-		task = (void *)node->d;
-		rem_node(&node->n);
-		queue->mm_ctx.free(&node->n);
+	return task;
+}
+
+worker_task_t *worker_queue_dequeue_last(worker_queue_t *queue)
+{
+	if (!queue || queue->length == 0) {
+		return NULL;
 	}
 
-	return task;
+	queue->length--;
+	return queue->items[(queue->head + queue->length) % queue->capacity];
 }
 
 size_t worker_queue_length(worker_queue_t *queue)
 {
-	return queue ? list_size(&queue->list) : 0;
+	return queue ? queue->length : 0;
 }
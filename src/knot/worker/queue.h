@@ -16,25 +16,40 @@
 
 #pragma once
 
-#include "contrib/ucw/lists.h"
+#include <stddef.h>
 
 struct task;
 typedef void (*task_cb)(struct task *);
 
+/*!
+ * \brief Task scheduling flags.
+ */
+typedef enum {
+	WORKER_TASK_PRIO = 1 << 0, /*!< Run before the other tasks (user-triggered, urgent). */
+	WORKER_TASK_CPU  = 1 << 1, /*!< CPU-heavy task, concurrency limited to CPU count. */
+} worker_task_flag_t;
+
 /*!
  * \brief Task executable by a worker.
  */
 typedef struct task {
 	void *ctx;
 	task_cb run;
+	unsigned flags; /*!< Scheduling flags (worker_task_flag_t), set before assigning. */
 } worker_task_t;
 
 /*!
  * \brief Worker queue.
+ *
+ * Double-ended queue of tasks stored in a growing ring buffer.
+ *
+ * \note The queue is not thread-safe.
  */
 typedef struct worker_queue {
-	knot_mm_t mm_ctx;
-	list_t list;
+	worker_task_t **items;
+	size_t capacity;
+	size_t head;
+	size_t length;
 } worker_queue_t;
 
 /*!
@@ -48,17 +63,26 @@ void worker_queue_init(worker_queue_t *queue);
 void worker_queue_deinit(worker_queue_t *queue);
 
 /*!
- * \brief Insert new item into the queue.
+ * \brief Insert new item at the end of the queue.
+ *
+ * \return KNOT_E*
  */
-void worker_queue_enqueue(worker_queue_t *queue, worker_task_t *task);
+int worker_queue_enqueue(worker_queue_t *queue, worker_task_t *task);
 
 /*!
- * \brief Remove item from the queue.
+ * \brief Remove item from the front of the queue.
  *
  * \return Task or NULL if the queue is empty.
  */
 worker_task_t *worker_queue_dequeue(worker_queue_t *queue);
 
+/*!
+ * \brief Remove item from the end of the queue.
+ *
+ * \return Task or NULL if the queue is empty.
+ */
+worker_task_t *worker_queue_dequeue_last(worker_queue_t *queue);
+
 /*!
  * \brief Return number of tasks in worker queue.
  */
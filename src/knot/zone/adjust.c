@@ -521,6 +521,78 @@ int zone_adjust_contents(zone_contents_t *zone, adjust_cb_t nodes_cb, adjust_cb_
 	return ret;
 }
 
+static bool prev_candidate(const zone_node_t *node)
+{
+	return !(node->flags & (NODE_FLAGS_NONAUTH | NODE_FLAGS_DELETED)) &&
+	       node->rrset_count > 0;
+}
+
+static int adjust_prevs_around(zone_tree_t *tree, const knot_dname_t *owner,
+                               zone_tree_t *changed_nodes)
+{
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_leq_begin(tree, owner, &it);
+	if (ret < 0) {
+		return ret == KNOT_ENONODE ? KNOT_EOK : ret;
+	}
+
+	// start at the node strictly preceding the owner
+	size_t count = zone_tree_count(tree);
+	bool exact = (ret > 0);
+	if (exact) {
+		zone_tree_it_prev_loop(&it);
+	}
+
+	// find the closest preceding node possibly pointed to
+	size_t back = 0;
+	while (back < count && !prev_candidate(zone_tree_it_val(&it))) {
+		zone_tree_it_prev_loop(&it);
+		back++;
+	}
+	if (back == count) {
+		zone_tree_it_free(&it);
+		return KNOT_EOK;
+	}
+
+	// fix nodes till the first candidate following the owner
+	zone_node_t *previous = zone_tree_it_val(&it);
+	for (size_t step = 1; step <= count; step++) {
+		zone_tree_it_next_loop(&it);
+		zone_node_t *node = zone_tree_it_val(&it);
+		if (!(node->flags & NODE_FLAGS_DELETED) && node->prev != previous &&
+		    (node->prev == NULL || node->prev != binode_counterpart(previous))) {
+			if (changed_nodes != NULL) {
+				zone_tree_insert(changed_nodes, &node);
+			}
+			node->prev = previous;
+		}
+		if (prev_candidate(node)) {
+			previous = node;
+			if (step > back && !(exact && step == back + 1)) {
+				break;
+			}
+		}
+	}
+
+	zone_tree_it_free(&it);
+	return KNOT_EOK;
+}
+
+int zone_adjust_prevs_incremental(zone_tree_t *tree, zone_tree_t *node_ptrs,
+                                  zone_tree_t *changed_nodes)
+{
+	// node_ptrs and changed_nodes may be the same tree
+	zone_tree_delsafe_it_t it = { 0 };
+	int ret = zone_tree_delsafe_it_begin(node_ptrs, &it, true);
+	while (ret == KNOT_EOK && !zone_tree_delsafe_it_finished(&it)) {
+		zone_node_t *node = zone_tree_delsafe_it_val(&it);
+		ret = adjust_prevs_around(tree, node->owner, changed_nodes);
+		zone_tree_delsafe_it_next(&it);
+	}
+	zone_tree_delsafe_it_free(&it);
+	return ret;
+}
+
 int zone_adjust_update(zone_update_t *update, adjust_cb_t nodes_cb, adjust_cb_t nsec3_cb, bool measure_diff)
 {
 	int ret = KNOT_EOK;
@@ -99,6 +99,21 @@ int zone_adjust_contents(zone_contents_t *zone, adjust_cb_t nodes_cb, adjust_cb_
  */
 int zone_adjust_update(zone_update_t *update, adjust_cb_t nodes_cb, adjust_cb_t nsec3_cb, bool measure_diff);
 
+/*!
+ * \brief Fix prev pointers only around changed nodes.
+ *
+ * This is an incremental alternative to adjusting whole tree with adjust_prevs.
+ * Only the changed nodes and their closest neighbours are visited.
+ *
+ * \param tree           Zone tree to be adjusted.
+ * \param node_ptrs      Nodes (possibly already deleted ones) that were added to or removed from the tree.
+ * \param changed_nodes  Optional: tree to add nodes with changed prev pointer into.
+ *
+ * \return KNOT_E*
+ */
+int zone_adjust_prevs_incremental(zone_tree_t *tree, zone_tree_t *node_ptrs,
+                                  zone_tree_t *changed_nodes);
+
 /*!
  * \brief Do a general-purpose full update.
  *
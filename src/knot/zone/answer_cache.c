@@ -0,0 +1,202 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/zone/answer_cache.h"
+#include "libdnssec/error.h"
+#include "libdnssec/random.h"
+#include "libknot/libknot.h"
+#include "contrib/openbsd/siphash.h"
+#include "contrib/spinlock.h"
+
+typedef struct {
+	uint64_t hash;
+	uint16_t qtype;
+	uint16_t qclass;
+	uint16_t rcode;
+	uint16_t size;
+	uint16_t limit;
+	bool dnssec;
+	bool udp;
+	uint8_t wire[];
+} answer_cache_entry_t;
+
+typedef struct {
+	knot_spin_t lock;
+	answer_cache_entry_t *entry;
+} answer_cache_slot_t;
+
+struct answer_cache {
+	SIPHASH_KEY key;
+	size_t size;
+	answer_cache_slot_t slots[];
+};
+
+answer_cache_t *answer_cache_new(size_t size)
+{
+	if (size == 0) {
+		return NULL;
+	}
+
+	answer_cache_t *cache = calloc(1, sizeof(*cache) + size * sizeof(cache->slots[0]));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	if (dnssec_random_buffer((uint8_t *)&cache->key, sizeof(cache->key)) != DNSSEC_EOK) {
+		free(cache);
+		return NULL;
+	}
+
+	cache->size = size;
+	for (size_t i = 0; i < size; i++) {
+		knot_spin_init(&cache->slots[i].lock);
+	}
+
+	return cache;
+}
+
+void answer_cache_free(answer_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < cache->size; i++) {
+		free(cache->slots[i].entry);
+		knot_spin_destroy(&cache->slots[i].lock);
+	}
+
+	free(cache);
+}
+
+/*! \brief Size limit the answer was or is to be built for. */
+static uint16_t pkt_limit(const knot_pkt_t *pkt)
+{
+	return pkt->max_size - pkt->reserved;
+}
+
+static uint64_t pkt_hash(const answer_cache_t *cache, const knot_pkt_t *pkt,
+                         bool dnssec, bool udp)
+{
+	SIPHASH_CTX ctx;
+	SipHash24_Init(&ctx, &cache->key);
+	SipHash24_Update(&ctx, knot_pkt_qname(pkt), pkt->qname_size);
+	uint16_t qtype = knot_pkt_qtype(pkt);
+	uint16_t qclass = knot_pkt_qclass(pkt);
+	SipHash24_Update(&ctx, &qtype, sizeof(qtype));
+	SipHash24_Update(&ctx, &qclass, sizeof(qclass));
+	uint16_t limit = pkt_limit(pkt);
+	SipHash24_Update(&ctx, &limit, sizeof(limit));
+	SipHash24_Update(&ctx, &dnssec, sizeof(dnssec));
+	SipHash24_Update(&ctx, &udp, sizeof(udp));
+	return SipHash24_End(&ctx);
+}
+
+static bool entry_match(const answer_cache_entry_t *entry, const knot_pkt_t *pkt,
+                        uint64_t hash, bool dnssec, bool udp)
+{
+	return entry != NULL &&
+	       entry->hash == hash &&
+	       entry->dnssec == dnssec &&
+	       entry->udp == udp &&
+	       entry->limit == pkt_limit(pkt) &&
+	       entry->qtype == knot_pkt_qtype(pkt) &&
+	       entry->qclass == knot_pkt_qclass(pkt) &&
+	       knot_dname_is_case_equal(entry->wire + KNOT_WIRE_HEADER_SIZE,
+	                                knot_pkt_qname(pkt));
+}
+
+bool answer_cache_get(answer_cache_t *cache, knot_pkt_t *pkt, bool dnssec,
+                      bool udp, uint16_t *rcode)
+{
+	if (cache == NULL || pkt == NULL || rcode == NULL || pkt->qname_size == 0) {
+		return false;
+	}
+
+	uint64_t hash = pkt_hash(cache, pkt, dnssec, udp);
+	answer_cache_slot_t *slot = &cache->slots[hash % cache->size];
+	size_t qend = KNOT_WIRE_HEADER_SIZE + knot_pkt_question_size(pkt);
+	bool hit = false;
+
+	knot_spin_lock(&slot->lock);
+	answer_cache_entry_t *entry = slot->entry;
+	if (entry_match(entry, pkt, hash, dnssec, udp) &&
+	    entry->size + pkt->reserved <= pkt->max_size) {
+		/* Keep the ID, RD and CD of the response, take the rest of the header. */
+		bool rd = knot_wire_get_rd(pkt->wire);
+		bool cd = knot_wire_get_cd(pkt->wire);
+		memcpy(pkt->wire + KNOT_WIRE_OFFSET_FLAGS1,
+		       entry->wire + KNOT_WIRE_OFFSET_FLAGS1, 2 * sizeof(uint8_t));
+		if (rd) {
+			knot_wire_set_rd(pkt->wire);
+		} else {
+			knot_wire_clear_rd(pkt->wire);
+		}
+		if (cd) {
+			knot_wire_set_cd(pkt->wire);
+		} else {
+			knot_wire_clear_cd(pkt->wire);
+		}
+		memcpy(pkt->wire + KNOT_WIRE_OFFSET_ANCOUNT,
+		       entry->wire + KNOT_WIRE_OFFSET_ANCOUNT,
+		       KNOT_WIRE_HEADER_SIZE - KNOT_WIRE_OFFSET_ANCOUNT);
+
+		/* The question section is already in place with its original case. */
+		memcpy(pkt->wire + qend, entry->wire + qend, entry->size - qend);
+		pkt->size = entry->size;
+		*rcode = entry->rcode;
+		hit = true;
+	}
+	knot_spin_unlock(&slot->lock);
+
+	return hit;
+}
+
+void answer_cache_put(answer_cache_t *cache, const knot_pkt_t *pkt, bool dnssec,
+                      bool udp, uint16_t rcode)
+{
+	if (cache == NULL || pkt == NULL || pkt->qname_size == 0 ||
+	    knot_wire_get_tc(pkt->wire)) {
+		return;
+	}
+
+	answer_cache_entry_t *entry = malloc(sizeof(*entry) + pkt->size);
+	if (entry == NULL) {
+		return;
+	}
+
+	entry->hash = pkt_hash(cache, pkt, dnssec, udp);
+	entry->qtype = knot_pkt_qtype(pkt);
+	entry->qclass = knot_pkt_qclass(pkt);
+	entry->rcode = rcode;
+	entry->size = pkt->size;
+	entry->limit = pkt_limit(pkt);
+	entry->dnssec = dnssec;
+	entry->udp = udp;
+	memcpy(entry->wire, pkt->wire, pkt->size);
+
+	answer_cache_slot_t *slot = &cache->slots[entry->hash % cache->size];
+
+	knot_spin_lock(&slot->lock);
+	answer_cache_entry_t *old = slot->entry;
+	slot->entry = entry;
+	knot_spin_unlock(&slot->lock);
+
+	free(old);
+}
@@ -0,0 +1,78 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "libknot/packet/pkt.h"
+
+/*!
+ * \brief Cache of pre-rendered wire-format answers.
+ *
+ * The cache is bound to one version of zone contents and is dropped together
+ * with it. Entries are stored without OPT and TSIG records and are keyed by
+ * (QNAME, QTYPE, QCLASS, DO bit, transport, response size limit), as an answer
+ * built for a small limit may lack records omitted for space. The table is
+ * direct-mapped, a colliding entry simply replaces the previous one.
+ */
+typedef struct answer_cache answer_cache_t;
+
+/*!
+ * \brief Create an empty answer cache.
+ *
+ * \param size  Number of cache slots.
+ *
+ * \return New cache or NULL on error.
+ */
+answer_cache_t *answer_cache_new(size_t size);
+
+/*!
+ * \brief Free the answer cache including all stored answers.
+ */
+void answer_cache_free(answer_cache_t *cache);
+
+/*!
+ * \brief Fill the response from the cache if there is a matching answer.
+ *
+ * The response must be initialized with knot_pkt_init_response(). Message ID,
+ * RD and CD flags, and QNAME letter case of the response are preserved.
+ *
+ * \param cache   Answer cache.
+ * \param pkt     Response to be filled.
+ * \param dnssec  DNSSEC records requested (DO bit).
+ * \param udp     The response is to be sent over UDP.
+ * \param rcode   Out: RCODE of the cached answer.
+ *
+ * \retval true if the response was filled from the cache.
+ */
+bool answer_cache_get(answer_cache_t *cache, knot_pkt_t *pkt, bool dnssec,
+                      bool udp, uint16_t *rcode);
+
+/*!
+ * \brief Store a complete answer into the cache.
+ *
+ * \note The response must not contain OPT or TSIG records yet.
+ *
+ * \param cache   Answer cache.
+ * \param pkt     Complete response.
+ * \param dnssec  DNSSEC records requested (DO bit).
+ * \param udp     The response is to be sent over UDP.
+ * \param rcode   RCODE of the response.
+ */
+void answer_cache_put(answer_cache_t *cache, const knot_pkt_t *pkt, bool dnssec,
+                      bool udp, uint16_t rcode);
@@ -513,6 +513,7 @@ void zone_contents_free(zone_contents_t *contents)
 
 	dnssec_nsec3_params_free(&contents->nsec3_params);
 	additionals_tree_free(contents->adds_tree);
+	answer_cache_free(contents->answer_cache);
 
 	free(contents);
 }
@@ -18,6 +18,7 @@
 
 #include "libdnssec/nsec.h"
 #include "libknot/rrtype/nsec3param.h"
+#include "knot/zone/answer_cache.h"
 #include "knot/zone/node.h"
 #include "knot/zone/zone-tree.h"
 
@@ -34,6 +35,8 @@ typedef struct zone_contents {
 
 	trie_t *adds_tree; // "additionals tree" for reverse lookup of nodes affected by additionals
 
+	answer_cache_t *answer_cache; // optional cache of pre-rendered answers
+
 	dnssec_nsec3_params_t nsec3_params;
 	size_t size;
 	uint32_t max_ttl;
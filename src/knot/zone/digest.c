@@ -17,33 +17,44 @@
 #include <stdio.h>
 
 #include "knot/zone/digest.h"
+#include "knot/conf/conf.h"
 #include "knot/dnssec/rrset-sign.h"
 #include "knot/updates/zone-update.h"
+#include "contrib/macros.h"
 #include "contrib/wire_ctx.h"
 #include "libdnssec/digest.h"
 #include "libknot/libknot.h"
 
 #define DIGEST_BUF_MIN 4096
-#define DIGEST_BUF_MAX (40 * 1024 * 1024)
+
+#define DIGEST_BATCH_NODES 1024 // Nodes serialized by a worker at once.
+#define DIGEST_BATCH_SLOTS 4    // Serialized batches in flight per worker.
 
 typedef struct {
-	size_t buf_size;
+	size_t size;
+	size_t used;
 	uint8_t *buf;
+} digest_buf_t;
+
+typedef struct {
+	digest_buf_t out;
 	struct dnssec_digest_ctx *digest_ctx;
 	const zone_node_t *apex;
 } contents_digest_ctx_t;
 
-static int digest_rrset(knot_rrset_t *rrset, const zone_node_t *node, void *vctx)
+/*!
+ * \brief Appends canonical wire format of the RRSet to the buffer.
+ */
+static int digest_serialize_rrset(knot_rrset_t *rrset, const zone_node_t *node,
+                                  const zone_node_t *apex, digest_buf_t *out)
 {
-	contents_digest_ctx_t *ctx = vctx;
-
 	// ignore apex ZONEMD
-	if (node == ctx->apex && rrset->type == KNOT_RRTYPE_ZONEMD) {
+	if (node == apex && rrset->type == KNOT_RRTYPE_ZONEMD) {
 		return KNOT_EOK;
 	}
 
 	// ignore RRSIGs of apex ZONEMD
-	if (node == ctx->apex && rrset->type == KNOT_RRTYPE_RRSIG) {
+	if (node == apex && rrset->type == KNOT_RRTYPE_RRSIG) {
 		knot_rdataset_t cpy = rrset->rrs, zonemd_rrsig = { 0 };
 		int ret = knot_rdataset_copy(&rrset->rrs, &cpy, NULL);
 		if (ret != KNOT_EOK) {
@@ -62,21 +73,24 @@ static int digest_rrset(knot_rrset_t *rrset, const zone_node_t *node, void *vctx
 	}
 
 	// serialize RRSet, expand buf as needed
-	int ret = knot_rrset_to_wire_extra(rrset, ctx->buf, ctx->buf_size, 0,
-	                                   NULL, KNOT_PF_ORIGTTL);
-	while (ret == KNOT_ESPACE && ctx->buf_size < DIGEST_BUF_MAX) {
-		free(ctx->buf);
-		ctx->buf_size *= 2;
-		ctx->buf = malloc(ctx->buf_size);
-		if (ctx->buf == NULL) {
-			return KNOT_ENOMEM;
+	int ret = knot_rrset_to_wire_extra(rrset, out->buf + out->used,
+	                                   MIN(out->size - out->used, UINT16_MAX),
+	                                   0, NULL, KNOT_PF_ORIGTTL);
+	while (ret == KNOT_ESPACE && out->size - out->used < UINT16_MAX) {
+		uint8_t *buf = realloc(out->buf, out->size * 2);
+		if (buf == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
 		}
-		ret = knot_rrset_to_wire_extra(rrset, ctx->buf, ctx->buf_size, 0,
-		                               NULL, KNOT_PF_ORIGTTL);
+		out->buf = buf;
+		out->size *= 2;
+		ret = knot_rrset_to_wire_extra(rrset, out->buf + out->used,
+		                               MIN(out->size - out->used, UINT16_MAX),
+		                               0, NULL, KNOT_PF_ORIGTTL);
 	}
 
 	// cleanup apex RRSIGs mess
-	if (node == ctx->apex && rrset->type == KNOT_RRTYPE_RRSIG) {
+	if (node == apex && rrset->type == KNOT_RRTYPE_RRSIG) {
 		knot_rdataset_clear(&rrset->rrs, NULL);
 	}
 
@@ -84,23 +98,217 @@ static int digest_rrset(knot_rrset_t *rrset, const zone_node_t *node, void *vctx
 		return ret;
 	}
 
-	// digest serialized RRSet
-	dnssec_binary_t bufbin = { ret, ctx->buf };
-	return dnssec_digest(ctx->digest_ctx, &bufbin);
+	out->used += ret;
+	return KNOT_EOK;
 }
 
-static int digest_node(zone_node_t *node, void *ctx)
+static int digest_serialize_node(const zone_node_t *node, const zone_node_t *apex,
+                                 digest_buf_t *out)
 {
 	int i = 0, ret = KNOT_EOK;
 	for ( ; i < node->rrset_count && ret == KNOT_EOK; i++) {
 		knot_rrset_t rrset = node_rrset_at(node, i);
-		ret = digest_rrset(&rrset, node, ctx);
+		ret = digest_serialize_rrset(&rrset, node, apex, out);
+	}
+	return ret;
+}
+
+static int digest_node(zone_node_t *node, void *vctx)
+{
+	contents_digest_ctx_t *ctx = vctx;
+
+	ctx->out.used = 0;
+	int ret = digest_serialize_node(node, ctx->apex, &ctx->out);
+	if (ret != KNOT_EOK || ctx->out.used == 0) {
+		return ret;
+	}
+
+	// digest serialized RRSets
+	dnssec_binary_t bufbin = { ctx->out.used, ctx->out.buf };
+	return knot_error_from_libdnssec(dnssec_digest(ctx->digest_ctx, &bufbin));
+}
+
+/*!
+ * \brief Pipeline of serializing workers feeding one hashing thread.
+ *
+ * The nodes are split into batches of consecutive nodes. Each worker claims
+ * the next unprocessed batch and serializes it into the slot of the batch,
+ * the caller thread hashes the slots strictly in the batch order. A batch
+ * is claimed only if its slot has already been consumed, which bounds the
+ * memory to the number of slots.
+ */
+typedef struct {
+	zone_node_t **nodes;
+	size_t count;
+	const zone_node_t *apex;
+
+	digest_buf_t *slots;
+	bool *ready;
+	size_t nslots;
+
+	size_t batches;
+	size_t next_batch;
+	size_t consumed;
+	int ret;
+
+	pthread_mutex_t mx;
+	pthread_cond_t cond;
+} digest_pipeline_t;
+
+static int collect_node(zone_node_t *node, void *ctx)
+{
+	digest_pipeline_t *p = ctx;
+	p->nodes[p->count++] = node;
+	return KNOT_EOK;
+}
+
+static void *digest_worker(void *arg)
+{
+	digest_pipeline_t *p = arg;
+
+	while (true) {
+		pthread_mutex_lock(&p->mx);
+		while (p->ret == KNOT_EOK && p->next_batch < p->batches &&
+		       p->next_batch >= p->consumed + p->nslots) {
+			pthread_cond_wait(&p->cond, &p->mx);
+		}
+		if (p->ret != KNOT_EOK || p->next_batch >= p->batches) {
+			pthread_mutex_unlock(&p->mx);
+			break;
+		}
+		size_t batch = p->next_batch++;
+		pthread_mutex_unlock(&p->mx);
+
+		digest_buf_t *out = &p->slots[batch % p->nslots];
+		out->used = 0;
+
+		int ret = KNOT_EOK;
+		size_t end = MIN((batch + 1) * DIGEST_BATCH_NODES, p->count);
+		for (size_t i = batch * DIGEST_BATCH_NODES; i < end && ret == KNOT_EOK; i++) {
+			ret = digest_serialize_node(p->nodes[i], p->apex, out);
+		}
+
+		pthread_mutex_lock(&p->mx);
+		if (ret != KNOT_EOK) {
+			if (p->ret == KNOT_EOK) {
+				p->ret = ret;
+			}
+		} else {
+			p->ready[batch % p->nslots] = true;
+		}
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mx);
+	}
+
+	return NULL;
+}
+
+static int digest_pipeline_run(digest_pipeline_t *p, unsigned threads,
+                               struct dnssec_digest_ctx *digest_ctx)
+{
+	pthread_t workers[threads];
+	unsigned started = 0;
+	for ( ; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, digest_worker, p) != 0) {
+			break;
+		}
+	}
+
+	int ret = (started > 0) ? KNOT_EOK : KNOT_ENOMEM;
+	for (size_t batch = 0; ret == KNOT_EOK && batch < p->batches; batch++) {
+		size_t slot = batch % p->nslots;
+
+		pthread_mutex_lock(&p->mx);
+		while (p->ret == KNOT_EOK && !p->ready[slot]) {
+			pthread_cond_wait(&p->cond, &p->mx);
+		}
+		ret = p->ret;
+		pthread_mutex_unlock(&p->mx);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+
+		dnssec_binary_t bufbin = { p->slots[slot].used, p->slots[slot].buf };
+		ret = knot_error_from_libdnssec(dnssec_digest(digest_ctx, &bufbin));
+
+		pthread_mutex_lock(&p->mx);
+		p->ready[slot] = false;
+		p->consumed++;
+		if (ret != KNOT_EOK && p->ret == KNOT_EOK) {
+			p->ret = ret;
+		}
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mx);
+	}
+
+	if (ret != KNOT_EOK) {
+		pthread_mutex_lock(&p->mx);
+		if (p->ret == KNOT_EOK) {
+			p->ret = ret;
+		}
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->mx);
 	}
+
+	for (unsigned i = 0; i < started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+
+	return ret;
+}
+
+static int digest_tree_pipelined(zone_tree_t *tree, const zone_node_t *apex,
+                                 unsigned threads, struct dnssec_digest_ctx *digest_ctx)
+{
+	digest_pipeline_t p = {
+		.nodes = malloc(zone_tree_count(tree) * sizeof(*p.nodes)),
+		.apex = apex,
+		.nslots = threads * DIGEST_BATCH_SLOTS,
+	};
+	p.slots = calloc(p.nslots, sizeof(*p.slots));
+	p.ready = calloc(p.nslots, sizeof(*p.ready));
+	if (p.nodes == NULL || p.slots == NULL || p.ready == NULL) {
+		free(p.nodes);
+		free(p.slots);
+		free(p.ready);
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < p.nslots && ret == KNOT_EOK; i++) {
+		p.slots[i].size = DIGEST_BUF_MIN;
+		p.slots[i].buf = malloc(DIGEST_BUF_MIN);
+		if (p.slots[i].buf == NULL) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+
+	// Snapshot of the canonical node order for random access by the workers.
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_apply(tree, collect_node, &p);
+	}
+
+	if (ret == KNOT_EOK) {
+		p.batches = (p.count + DIGEST_BATCH_NODES - 1) / DIGEST_BATCH_NODES;
+		pthread_mutex_init(&p.mx, NULL);
+		pthread_cond_init(&p.cond, NULL);
+		ret = digest_pipeline_run(&p, threads, digest_ctx);
+		pthread_cond_destroy(&p.cond);
+		pthread_mutex_destroy(&p.mx);
+	}
+
+	for (size_t i = 0; i < p.nslots; i++) {
+		free(p.slots[i].buf);
+	}
+	free(p.slots);
+	free(p.ready);
+	free(p.nodes);
+
 	return ret;
 }
 
 int zone_contents_digest(const zone_contents_t *contents, int algorithm,
-                         uint8_t **out_digest, size_t *out_size)
+                         unsigned threads, uint8_t **out_digest, size_t *out_size)
 {
 	if (out_digest == NULL || out_size == NULL) {
 		return KNOT_EINVAL;
@@ -111,17 +319,16 @@ int zone_contents_digest(const zone_contents_t *contents, int algorithm,
 	}
 
 	contents_digest_ctx_t ctx = {
-		.buf_size = DIGEST_BUF_MIN,
-		.buf = malloc(DIGEST_BUF_MIN),
+		.out = { .size = DIGEST_BUF_MIN, .buf = malloc(DIGEST_BUF_MIN) },
 		.apex = contents->apex,
 	};
-	if (ctx.buf == NULL) {
+	if (ctx.out.buf == NULL) {
 		return KNOT_ENOMEM;
 	}
 
 	int ret = dnssec_digest_init(algorithm, &ctx.digest_ctx);
 	if (ret != DNSSEC_EOK) {
-		free(ctx.buf);
+		free(ctx.out.buf);
 		return knot_error_from_libdnssec(ret);
 	}
 
@@ -137,7 +344,11 @@ int zone_contents_digest(const zone_contents_t *contents, int algorithm,
 	}
 
 	if (ret == KNOT_EOK) {
-		ret = zone_tree_apply(conts, digest_node, &ctx);
+		if (threads > 1 && zone_tree_count(conts) > DIGEST_BATCH_NODES) {
+			ret = digest_tree_pipelined(conts, contents->apex, threads, ctx.digest_ctx);
+		} else {
+			ret = zone_tree_apply(conts, digest_node, &ctx);
+		}
 	}
 
 	if (conts != contents->nodes) {
@@ -148,17 +359,80 @@ int zone_contents_digest(const zone_contents_t *contents, int algorithm,
 	if (ret == KNOT_EOK) {
 		ret = dnssec_digest_finish(ctx.digest_ctx, &res);
 	}
-	free(ctx.buf);
+	free(ctx.out.buf);
 	*out_digest = res.data;
 	*out_size = res.size;
 	return ret;
 }
 
-static int verify_zonemd(const knot_rdata_t *zonemd, const zone_contents_t *contents)
+void zone_digest_cache_init(zone_digest_cache_t *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+	pthread_mutex_init(&cache->lock, NULL);
+}
+
+void zone_digest_cache_deinit(zone_digest_cache_t *cache)
+{
+	pthread_mutex_destroy(&cache->lock);
+}
+
+static void cache_store(zone_digest_cache_t *cache, uint32_t serial, uint8_t algorithm,
+                        const uint8_t *digest, size_t size)
+{
+	if (cache == NULL || size > sizeof(cache->digest)) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	cache->serial = serial;
+	cache->algorithm = algorithm;
+	cache->size = size;
+	memcpy(cache->digest, digest, size);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void zone_digest_cache_copy(zone_digest_cache_t *dst, zone_digest_cache_t *src)
+{
+	pthread_mutex_lock(&src->lock);
+	uint32_t serial = src->serial;
+	uint8_t algorithm = src->algorithm;
+	size_t size = src->size;
+	uint8_t digest[sizeof(src->digest)];
+	memcpy(digest, src->digest, size);
+	pthread_mutex_unlock(&src->lock);
+
+	if (algorithm != 0) {
+		cache_store(dst, serial, algorithm, digest, size);
+	}
+}
+
+static bool cache_match(zone_digest_cache_t *cache, const knot_rdata_t *zonemd)
 {
+	if (cache == NULL) {
+		return false;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	bool match = cache->algorithm != 0 &&
+	             cache->serial == knot_zonemd_soa_serial(zonemd) &&
+	             cache->algorithm == knot_zonemd_algorithm(zonemd) &&
+	             cache->size == knot_zonemd_digest_size(zonemd) &&
+	             memcmp(cache->digest, knot_zonemd_digest(zonemd), cache->size) == 0;
+	pthread_mutex_unlock(&cache->lock);
+
+	return match;
+}
+
+static int verify_zonemd(const knot_rdata_t *zonemd, const zone_contents_t *contents,
+                         unsigned threads, zone_digest_cache_t *cache, bool use_cached)
+{
+	if (use_cached && cache_match(cache, zonemd)) {
+		return KNOT_EOK;
+	}
+
 	uint8_t *computed = NULL;
 	size_t comp_size = 0;
-	int ret = zone_contents_digest(contents, knot_zonemd_algorithm(zonemd),
+	int ret = zone_contents_digest(contents, knot_zonemd_algorithm(zonemd), threads,
 	                               &computed, &comp_size);
 	if (ret != KNOT_EOK) {
 		return ret;
@@ -169,12 +443,16 @@ static int verify_zonemd(const knot_rdata_t *zonemd, const zone_contents_t *cont
 		ret = KNOT_EFEWDATA;
 	} else if (memcmp(knot_zonemd_digest(zonemd), computed, comp_size) != 0) {
 		ret = KNOT_EMALF;
+	} else {
+		cache_store(cache, knot_zonemd_soa_serial(zonemd), knot_zonemd_algorithm(zonemd),
+		            computed, comp_size);
 	}
 	free(computed);
 	return ret;
 }
 
-bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify)
+bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify,
+                                 unsigned threads, zone_digest_cache_t *cache)
 {
 	if (alg == 0) {
 		return true;
@@ -194,7 +472,7 @@ bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool
 		return true;
 	}
 
-	return verify_zonemd(zonemd->rdata, contents) == KNOT_EOK;
+	return verify_zonemd(zonemd->rdata, contents, threads, cache, true) == KNOT_EOK;
 }
 
 static bool check_duplicate_schalg(const knot_rdataset_t *zonemd, int check_upto,
@@ -212,7 +490,8 @@ static bool check_duplicate_schalg(const knot_rdataset_t *zonemd, int check_upto
 	return true;
 }
 
-int zone_contents_digest_verify(const zone_contents_t *contents)
+int zone_contents_digest_verify(const zone_contents_t *contents, unsigned threads,
+                                zone_digest_cache_t *cache, bool use_cached)
 {
 	if (contents == NULL) {
 		return KNOT_EEMPTYZONE;
@@ -239,7 +518,8 @@ int zone_contents_digest_verify(const zone_contents_t *contents)
 		rr = knot_rdataset_next(rr);
 	}
 
-	return supported == NULL ? KNOT_ENOTSUP : verify_zonemd(supported, contents);
+	return supported == NULL ? KNOT_ENOTSUP :
+	       verify_zonemd(supported, contents, threads, cache, use_cached);
 }
 
 static ptrdiff_t zonemd_hash_offs(void)
@@ -268,7 +548,9 @@ int zone_update_add_digest(struct zone_update *update, int algorithm, bool place
 			return KNOT_EOK;
 		}
 	} else {
-		int ret = zone_contents_digest(update->new_cont, algorithm, &digest, &dsize);
+		conf_val_t val = conf_zone_get(conf(), C_ADJUST_THR, update->zone->name);
+		int ret = zone_contents_digest(update->new_cont, algorithm, conf_int(&val),
+		                               &digest, &dsize);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -282,6 +564,11 @@ int zone_update_add_digest(struct zone_update *update, int algorithm, bool place
 
 	knot_rrset_t zonemd, soa = node_rrset(update->new_cont->apex, KNOT_RRTYPE_SOA);
 
+	if (!placeholder) {
+		cache_store(&update->zone->digest_cache, knot_soa_serial(soa.rrs.rdata),
+		            algorithm, digest, dsize);
+	}
+
 	uint8_t rdata[zonemd_hash_offs() + dsize];
 	wire_ctx_t wire = wire_ctx_init(rdata, sizeof(rdata));
 	wire_ctx_write_u32(&wire, knot_soa_serial(soa.rrs.rdata));
@@ -16,20 +16,51 @@
 
 #pragma once
 
+#include <pthread.h>
+
 #include "knot/zone/contents.h"
 
+#define ZONE_DIGEST_MAX_SIZE 64
+
+/*!
+ * \brief Last zone digest computed or successfully verified by the server.
+ *
+ * The digest is trusted for zone contents which are known to be identical
+ * to the digested ones, e.g. a zone reload without any change.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	uint32_t serial;       //!< SOA serial of the digested contents.
+	uint8_t algorithm;     //!< ZONEMD algorithm, zero if nothing is cached.
+	size_t size;           //!< Digest size.
+	uint8_t digest[ZONE_DIGEST_MAX_SIZE];
+} zone_digest_cache_t;
+
+void zone_digest_cache_init(zone_digest_cache_t *cache);
+
+void zone_digest_cache_deinit(zone_digest_cache_t *cache);
+
+/*!
+ * \brief Copies the cached digest, e.g. to a new zone with the same contents.
+ */
+void zone_digest_cache_copy(zone_digest_cache_t *dst, zone_digest_cache_t *src);
+
 /*!
  * \brief Compute hash over whole zone by concatenating RRSets in wire format.
  *
+ * \note With more threads, the nodes are serialized in parallel and hashed
+ *       in the canonical order by the calling thread.
+ *
  * \param contents     Zone contents to digest.
  * \param algorithm    Algorithm to use.
+ * \param threads      Number of serializing threads (1 to digest sequentially).
  * \param out_digest   Output: buffer with computed hash (to be freed).
  * \param out_size     Output: size of the resulting hash.
  *
  * \return KNOT_E*
  */
 int zone_contents_digest(const zone_contents_t *contents, int algorithm,
-                         uint8_t **out_digest, size_t *out_size);
+                         unsigned threads, uint8_t **out_digest, size_t *out_size);
 
 /*!
  * \brief Check whether exactly one ZONEMD exists in the zone, is valid and matches given algorithm.
@@ -39,13 +70,21 @@ int zone_contents_digest(const zone_contents_t *contents, int algorithm,
  * \param contents   Zone contents to be verified.
  * \param alg        Required algorithm of the ZONEMD.
  * \param no_verify  Don't verify the validness of the digest in ZONEMD.
+ * \param threads    Number of threads for the digest computation.
+ * \param cache      Optional digest cache, the contents must be identical
+ *                   to the contents the cached digest was computed for.
  */
-bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify);
+bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify,
+                                 unsigned threads, zone_digest_cache_t *cache);
 
 /*!
  * \brief Verify zone dgest in ZONEMD record.
  *
  * \param contents   Zone contents ot be verified.
+ * \param threads    Number of threads for the digest computation.
+ * \param cache      Optional digest cache updated upon successful verification.
+ * \param use_cached Skip the computation if the cached digest matches ZONEMD
+ *                   (the contents must be identical to the cached ones).
  *
  * \retval KNOT_EEMPTYZONE  The zone is empty.
  * \retval KNOT_ENOENT      There is no ZONEMD in contents' apex.
@@ -55,7 +94,8 @@ bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool
  * \retval KNOT_EMALF       The computed hash differs from ZONEMD.
  * \return KNOT_E*
  */
-int zone_contents_digest_verify(const zone_contents_t *contents);
+int zone_contents_digest_verify(const zone_contents_t *contents, unsigned threads,
+                                zone_digest_cache_t *cache, bool use_cached);
 
 struct zone_update;
 /*!
@@ -66,6 +106,7 @@ struct zone_update;
  * \param placeholder   Don't calculate, just put placeholder (if ZONEMD not yet present).
  *
  * \note Special value 255 of algorithm means to remove ZONEMD.
+ * \note The computed digest is stored into the digest cache of the zone.
  *
  * \return KNOT_E*
  */
@@ -0,0 +1,508 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "knot/zone/snapshot.h"
+#include "contrib/files.h"
+#include "contrib/openbsd/siphash.h"
+#include "contrib/string.h"
+#include "libknot/libknot.h"
+
+#define SNAP_MAGIC	"KNOTSNAP"
+#define SNAP_VERSION	3
+#define SNAP_BYTE_ORDER	0x0102
+#define SNAP_ALIGN	8
+#define SNAP_SUFFIX	".snap"
+
+/*!
+ * \brief Node flags which are stored, the others are runtime-only or derived
+ *        from the tree structure while loading.
+ */
+#define SNAP_NODE_FLAGS	(NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH | NODE_FLAGS_EMPTY | \
+			 NODE_FLAGS_IN_NSEC3_CHAIN | NODE_FLAGS_APEX | \
+			 NODE_FLAGS_SUBTREE_AUTH | NODE_FLAGS_SUBTREE_DATA)
+
+typedef struct {
+	uint8_t magic[8];
+	uint16_t version;
+	uint16_t byte_order;
+	uint32_t mtime_nsec; /*!< Zone file modification time. */
+	uint64_t mtime_sec;
+	uint64_t ctime_sec;  /*!< Zone file status change time. */
+	uint32_t ctime_nsec;
+	uint32_t reserved1;
+	uint64_t params;     /*!< Hash of the loading parameters. */
+	uint64_t file_size;  /*!< Zone file size. */
+	uint64_t file_ino;   /*!< Zone file inode. */
+	uint64_t size;       /*!< Measured zone size. */
+	uint32_t max_ttl;    /*!< Measured zone maximal TTL. */
+	uint32_t nodes;      /*!< Number of nodes in the normal tree. */
+	uint32_t nsec3_nodes;/*!< Number of nodes in the NSEC3 tree. */
+	uint32_t reserved;
+} snap_header_t;
+
+/*! \brief Node header followed by aligned owner and RRSets. */
+typedef struct {
+	uint16_t flags;
+	uint16_t rrset_count;
+	uint16_t owner_size;
+	uint16_t reserved;
+} snap_node_t;
+
+/*! \brief RRSet header followed by aligned rdataset data. */
+typedef struct {
+	uint16_t type;
+	uint16_t count;
+	uint32_t ttl;
+	uint32_t size;
+	uint32_t reserved;
+} snap_rrset_t;
+
+#define ALIGNED(x)	(((x) + SNAP_ALIGN - 1) & ~((size_t)SNAP_ALIGN - 1))
+
+bool zone_snapshot_enabled(conf_t *conf, const knot_dname_t *zone_name)
+{
+	conf_val_t val = conf_zone_get(conf, C_ZONEFILE_SNAP, zone_name);
+	return conf_bool(&val);
+}
+
+char *zone_snapshot_path(const char *zonefile)
+{
+	if (zonefile == NULL) {
+		return NULL;
+	}
+
+	return sprintf_alloc("%s%s", zonefile, SNAP_SUFFIX);
+}
+
+uint64_t zone_snapshot_params(semcheck_optional_t semcheck_mode, bool fail_on_warning,
+                              bool master)
+{
+	const uint8_t params[] = { semcheck_mode, fail_on_warning, master };
+
+	SIPHASH_KEY key = { 0 }; // only used for hashing -> zero key
+	return SipHash24(&key, params, sizeof(params));
+}
+
+bool zone_snapshot_detect(const char *path)
+{
+	struct stat st;
+	if (path == NULL || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return false;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	uint8_t magic[sizeof(SNAP_MAGIC) - 1];
+	bool match = (read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+	              memcmp(magic, SNAP_MAGIC, sizeof(magic)) == 0);
+	close(fd);
+
+	return match;
+}
+
+static bool write_aligned(FILE *file, const void *data, size_t len)
+{
+	static const uint8_t padding[SNAP_ALIGN] = { 0 };
+
+	return fwrite(data, 1, len, file) == len &&
+	       fwrite(padding, 1, ALIGNED(len) - len, file) == ALIGNED(len) - len;
+}
+
+static int write_tree(FILE *file, zone_tree_t *tree)
+{
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(tree, &it);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	for (; !zone_tree_it_finished(&it) && ret == KNOT_EOK; zone_tree_it_next(&it)) {
+		const zone_node_t *node = zone_tree_it_val(&it);
+
+		snap_node_t hdr = {
+			.flags = node->flags & SNAP_NODE_FLAGS,
+			.rrset_count = node->rrset_count,
+			.owner_size = knot_dname_size(node->owner),
+		};
+		if (!write_aligned(file, &hdr, sizeof(hdr)) ||
+		    !write_aligned(file, node->owner, hdr.owner_size)) {
+			ret = KNOT_EFILE;
+		}
+
+		for (uint16_t i = 0; i < node->rrset_count && ret == KNOT_EOK; i++) {
+			const struct rr_data *data = &node->rrs[i];
+			snap_rrset_t rrset = {
+				.type = data->type,
+				.count = data->rrs.count,
+				.ttl = data->ttl,
+				.size = data->rrs.size,
+			};
+			if (!write_aligned(file, &rrset, sizeof(rrset)) ||
+			    !write_aligned(file, data->rrs.rdata, rrset.size)) {
+				ret = KNOT_EFILE;
+			}
+		}
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+/*!
+ * \brief Checks if the snapshot belongs to the zone file version.
+ *
+ * The modification time can be preserved or reset by the tool which rewrote
+ * the file, so the size, inode, and status change time are compared too.
+ */
+static bool stamp_match(const snap_header_t *hdr, const struct stat *st)
+{
+	return hdr->mtime_sec == st->st_mtim.tv_sec &&
+	       hdr->mtime_nsec == st->st_mtim.tv_nsec &&
+	       hdr->ctime_sec == st->st_ctim.tv_sec &&
+	       hdr->ctime_nsec == st->st_ctim.tv_nsec &&
+	       hdr->file_size == st->st_size &&
+	       hdr->file_ino == st->st_ino;
+}
+
+int zone_snapshot_write(const char *path, const zone_contents_t *contents,
+                        const struct stat *zonefile, uint64_t params)
+{
+	if (path == NULL || contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	snap_header_t hdr = {
+		.version = SNAP_VERSION,
+		.byte_order = SNAP_BYTE_ORDER,
+		.size = contents->size,
+		.max_ttl = contents->max_ttl,
+		.nodes = zone_tree_count(contents->nodes),
+		.nsec3_nodes = zone_tree_count(contents->nsec3_nodes),
+		.params = params,
+	};
+	memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+	if (zonefile != NULL) {
+		hdr.mtime_sec = zonefile->st_mtim.tv_sec;
+		hdr.mtime_nsec = zonefile->st_mtim.tv_nsec;
+		hdr.ctime_sec = zonefile->st_ctim.tv_sec;
+		hdr.ctime_nsec = zonefile->st_ctim.tv_nsec;
+		hdr.file_size = zonefile->st_size;
+		hdr.file_ino = zonefile->st_ino;
+	}
+
+	int ret = make_path(path, S_IRUSR | S_IWUSR | S_IXUSR |
+	                          S_IRGRP | S_IWGRP | S_IXGRP);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	FILE *file = NULL;
+	char *tmp_name = NULL;
+	ret = open_tmp_file(path, &tmp_name, &file, S_IRUSR | S_IWUSR |
+	                                            S_IRGRP | S_IWGRP);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	if (!write_aligned(file, &hdr, sizeof(hdr))) {
+		ret = KNOT_EFILE;
+	}
+	if (ret == KNOT_EOK) {
+		ret = write_tree(file, contents->nodes);
+	}
+	if (ret == KNOT_EOK && hdr.nsec3_nodes > 0) {
+		ret = write_tree(file, contents->nsec3_nodes);
+	}
+	if (fclose(file) != 0 && ret == KNOT_EOK) {
+		ret = knot_map_errno();
+	}
+
+	if (ret == KNOT_EOK && rename(tmp_name, path) != 0) {
+		ret = knot_map_errno();
+	}
+	if (ret != KNOT_EOK) {
+		unlink(tmp_name);
+	}
+	free(tmp_name);
+
+	return ret;
+}
+
+typedef struct {
+	const uint8_t *pos;
+	const uint8_t *end;
+} snap_reader_t;
+
+static const void *reader_take(snap_reader_t *r, size_t len)
+{
+	if ((size_t)(r->end - r->pos) < ALIGNED(len)) {
+		return NULL;
+	}
+
+	const void *data = r->pos;
+	r->pos += ALIGNED(len);
+	return data;
+}
+
+static bool rdataset_valid(const knot_rdataset_t *rrs)
+{
+	const uint8_t *pos = (const uint8_t *)rrs->rdata;
+	const uint8_t *end = pos + rrs->size;
+
+	for (uint16_t i = 0; i < rrs->count; i++) {
+		if ((size_t)(end - pos) < sizeof(uint16_t)) {
+			return false;
+		}
+		size_t size = knot_rdata_size(((const knot_rdata_t *)pos)->len);
+		if ((size_t)(end - pos) < size) {
+			return false;
+		}
+		pos += size;
+	}
+
+	return rrs->count > 0 && pos == end;
+}
+
+static int read_node(snap_reader_t *r, zone_tree_t *tree, zone_node_t **node)
+{
+	const snap_node_t *hdr = reader_take(r, sizeof(*hdr));
+	if (hdr == NULL) {
+		return KNOT_EMALF;
+	}
+
+	const knot_dname_t *owner = reader_take(r, hdr->owner_size);
+	if (owner == NULL || knot_dname_wire_check(owner, owner + hdr->owner_size,
+	                                           NULL) != hdr->owner_size) {
+		return KNOT_EMALF;
+	}
+
+	if (*node == NULL) {
+		*node = node_new_for_tree(owner, tree, NULL);
+		if (*node == NULL) {
+			return KNOT_ENOMEM;
+		}
+	} else if (!knot_dname_is_equal((*node)->owner, owner)) {
+		return KNOT_EOUTOFZONE;
+	}
+
+	zone_node_t *n = *node;
+	n->flags = (n->flags & ~SNAP_NODE_FLAGS) | (hdr->flags & SNAP_NODE_FLAGS);
+
+	for (uint16_t i = 0; i < hdr->rrset_count; i++) {
+		const snap_rrset_t *rrset = reader_take(r, sizeof(*rrset));
+		if (rrset == NULL) {
+			return KNOT_EMALF;
+		}
+
+		knot_rrset_t rr;
+		knot_rrset_init(&rr, n->owner, rrset->type, KNOT_CLASS_IN, rrset->ttl);
+		rr.rrs.count = rrset->count;
+		rr.rrs.size = rrset->size;
+		rr.rrs.rdata = (knot_rdata_t *)reader_take(r, rrset->size);
+		if (rr.rrs.rdata == NULL || !rdataset_valid(&rr.rrs)) {
+			return KNOT_EMALF;
+		}
+
+		int ret = node_add_rrset(n, &rr, NULL);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Reads the normal tree nodes.
+ *
+ * The nodes come in canonical order, so the parent of each node is on
+ * the stack of its predecessors' ancestors.
+ */
+static int read_nodes(snap_reader_t *r, zone_contents_t *z, uint32_t count)
+{
+	if (count == 0) {
+		return KNOT_EMALF;
+	}
+
+	zone_node_t **stack = malloc(KNOT_DNAME_MAXLABELS * sizeof(*stack));
+	if (stack == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = read_node(r, z->nodes, &z->apex);
+	stack[0] = z->apex;
+	unsigned depth = 1;
+
+	for (uint32_t i = 1; i < count && ret == KNOT_EOK; i++) {
+		zone_node_t *node = NULL;
+		ret = read_node(r, z->nodes, &node);
+		if (ret != KNOT_EOK) {
+			node_free_rrsets(node, NULL);
+			node_free(node, NULL);
+			break;
+		}
+
+		const knot_dname_t *parent = knot_wire_next_label(node->owner, NULL);
+		while (depth > 0 && (parent == NULL ||
+		       !knot_dname_is_equal(stack[depth - 1]->owner, parent))) {
+			depth--;
+		}
+		if (depth == 0 || depth == KNOT_DNAME_MAXLABELS ||
+		    zone_tree_get(z->nodes, node->owner) != NULL) {
+			node_free_rrsets(node, NULL);
+			node_free(node, NULL);
+			ret = KNOT_EMALF;
+			break;
+		}
+
+		node->parent = stack[depth - 1];
+		node->parent->children++;
+		if (knot_dname_is_wildcard(node->owner)) {
+			node->parent->flags |= NODE_FLAGS_WILDCARD_CHILD;
+		}
+		ret = zone_tree_insert(z->nodes, &node);
+		stack[depth++] = node;
+	}
+	free(stack);
+
+	return ret;
+}
+
+static int read_nsec3_nodes(snap_reader_t *r, zone_contents_t *z, uint32_t count)
+{
+	if (count == 0) {
+		return KNOT_EOK;
+	}
+
+	z->nsec3_nodes = zone_tree_create(z->nodes->flags & ZONE_TREE_USE_BINODES);
+	if (z->nsec3_nodes == NULL) {
+		return KNOT_ENOMEM;
+	}
+	z->nsec3_nodes->flags = z->nodes->flags;
+
+	int ret = KNOT_EOK;
+	for (uint32_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		zone_node_t *node = NULL;
+		ret = read_node(r, z->nsec3_nodes, &node);
+		if (ret == KNOT_EOK &&
+		    (!knot_dname_is_equal(knot_wire_next_label(node->owner, NULL),
+		                          z->apex->owner) ||
+		     zone_tree_get(z->nsec3_nodes, node->owner) != NULL)) {
+			ret = KNOT_EMALF;
+		}
+		if (ret != KNOT_EOK) {
+			node_free_rrsets(node, NULL);
+			node_free(node, NULL);
+			break;
+		}
+
+		node->parent = z->apex;
+		z->apex->children++;
+		ret = zone_tree_insert(z->nsec3_nodes, &node);
+	}
+
+	return ret;
+}
+
+static int load_contents(const uint8_t *data, size_t size, const knot_dname_t *zone_name,
+                         const struct stat *zonefile, uint64_t params,
+                         zone_contents_t **contents)
+{
+	snap_reader_t r = { data, data + size };
+
+	const snap_header_t *hdr = reader_take(&r, sizeof(*hdr));
+	if (hdr == NULL || memcmp(hdr->magic, SNAP_MAGIC, sizeof(hdr->magic)) != 0) {
+		return KNOT_EMALF;
+	}
+	if (hdr->version != SNAP_VERSION || hdr->byte_order != SNAP_BYTE_ORDER) {
+		return KNOT_ENOTSUP;
+	}
+	if (zonefile != NULL && (!stamp_match(hdr, zonefile) || hdr->params != params)) {
+		return KNOT_ENOENT;
+	}
+
+	zone_contents_t *z = zone_contents_new(zone_name, true);
+	if (z == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = read_nodes(&r, z, hdr->nodes);
+	if (ret == KNOT_EOK) {
+		ret = read_nsec3_nodes(&r, z, hdr->nsec3_nodes);
+	}
+	if (ret == KNOT_EOK && (r.pos != r.end ||
+	                        !node_rrtype_exists(z->apex, KNOT_RRTYPE_SOA))) {
+		ret = KNOT_EMALF;
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(z);
+		return ret;
+	}
+
+	z->size = hdr->size;
+	z->max_ttl = hdr->max_ttl;
+	*contents = z;
+
+	return KNOT_EOK;
+}
+
+int zone_snapshot_load(const char *path, const knot_dname_t *zone_name,
+                       const struct stat *zonefile, uint64_t params,
+                       zone_contents_t **contents)
+{
+	if (path == NULL || zone_name == NULL || contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return knot_map_errno();
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int ret = knot_map_errno();
+		close(fd);
+		return ret;
+	}
+	if ((size_t)st.st_size < sizeof(snap_header_t)) {
+		close(fd);
+		return KNOT_EMALF;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return knot_map_errno();
+	}
+	(void)madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	int ret = load_contents(data, st.st_size, zone_name, zonefile, params, contents);
+	munmap(data, st.st_size);
+
+	return ret;
+}
@@ -0,0 +1,99 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Binary zone snapshot.
+ *
+ * The snapshot is a binary image of zone contents bound to a particular
+ * version (modification and status change time, size, and inode) of the zone
+ * file and to the parameters it was loaded with. It contains nodes in
+ * canonical order with their flags and the rdata in the in-memory format,
+ * so it can be memory-mapped and loaded without parsing.
+ *
+ * \note The snapshot is specific to the host byte order and is ignored
+ *       on a host with a different one.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "knot/conf/conf.h"
+#include "knot/zone/contents.h"
+#include "knot/zone/semantic-check.h"
+
+/*!
+ * \brief Checks if zone snapshots are enabled for the zone.
+ */
+bool zone_snapshot_enabled(conf_t *conf, const knot_dname_t *zone_name);
+
+/*!
+ * \brief Returns the snapshot path belonging to the zone file.
+ *
+ * \param zonefile  Zone file path.
+ *
+ * \return Allocated snapshot path or NULL.
+ */
+char *zone_snapshot_path(const char *zonefile);
+
+/*!
+ * \brief Computes the hash of the parameters the loaded zone depends on.
+ *
+ * \param semcheck_mode    Semantic checks performed.
+ * \param fail_on_warning  Semantic warnings are fatal.
+ * \param master           The zone is loaded as primary (no bootstrap).
+ *
+ * \return Parameters hash stored in the snapshot.
+ */
+uint64_t zone_snapshot_params(semcheck_optional_t semcheck_mode, bool fail_on_warning,
+                              bool master);
+
+/*!
+ * \brief Checks if the file is a zone snapshot.
+ */
+bool zone_snapshot_detect(const char *path);
+
+/*!
+ * \brief Writes zone contents into a snapshot.
+ *
+ * \param path      Snapshot path.
+ * \param contents  Zone contents.
+ * \param zonefile  Status of the corresponding zone file (can be NULL).
+ * \param params    Hash of the loading parameters, see zone_snapshot_params().
+ *
+ * \return KNOT_E*
+ */
+int zone_snapshot_write(const char *path, const zone_contents_t *contents,
+                        const struct stat *zonefile, uint64_t params);
+
+/*!
+ * \brief Loads zone contents from a snapshot.
+ *
+ * \param path       Snapshot path.
+ * \param zone_name  Zone name.
+ * \param zonefile   Required status of the zone file (NULL to ignore it
+ *                   and the parameters).
+ * \param params     Required hash of the loading parameters.
+ * \param contents   Output: loaded contents.
+ *
+ * \retval KNOT_ENOENT  if there is no snapshot or it doesn't match the zone file
+ *                      or the parameters.
+ * \return KNOT_E*
+ */
+int zone_snapshot_load(const char *path, const knot_dname_t *zone_name,
+                       const struct stat *zonefile, uint64_t params,
+                       zone_contents_t **contents);
@@ -0,0 +1,101 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+
+#include "knot/zone/zone-conf.h"
+#include "libknot/errcode.h"
+
+#define ZONE_CONF_GET(type, getter, item, field) \
+type zone_conf_##field(conf_t *conf, zone_conf_t *const *zconf, \
+                       const knot_dname_t *zone) \
+{ \
+	if (zconf != NULL) { \
+		rcu_read_lock(); \
+		const zone_conf_t *cached = rcu_dereference(*zconf); \
+		if (cached != NULL) { \
+			type res = cached->field; \
+			rcu_read_unlock(); \
+			return res; \
+		} \
+		rcu_read_unlock(); \
+	} \
+	conf_val_t val = conf_zone_get(conf, item, zone); \
+	return getter(&val); \
+}
+
+ZONE_CONF_GET(bool,     conf_bool, C_PROVIDE_IXFR,      provide_ixfr)
+ZONE_CONF_GET(bool,     conf_bool, C_DNSSEC_SIGNING,    dnssec_signing)
+ZONE_CONF_GET(unsigned, conf_opt,  C_ZONEMD_GENERATE,   zonemd_generate)
+ZONE_CONF_GET(unsigned, conf_opt,  C_SERIAL_POLICY,     serial_policy)
+ZONE_CONF_GET(unsigned, conf_opt,  C_JOURNAL_CONTENT,   journal_content)
+ZONE_CONF_GET(size_t,   conf_int,  C_JOURNAL_MAX_USAGE, journal_max_usage)
+ZONE_CONF_GET(size_t,   conf_int,  C_JOURNAL_MAX_DEPTH, journal_max_depth)
+ZONE_CONF_GET(unsigned, conf_opt,  C_JOURNAL_COMPRESSION, journal_compression)
+ZONE_CONF_GET(int64_t,  conf_int,  C_ZONEFILE_SYNC,     zonefile_sync)
+ZONE_CONF_GET(size_t,   conf_int,  C_AXFR_SNAP_MAX_SIZE, axfr_snapshot_max_size)
+
+static int get_ids(conf_t *conf, const yp_name_t *item, const knot_dname_t *zone,
+                   conf_ids_t *ids)
+{
+	conf_val_t val = conf_zone_get(conf, item, zone);
+	return conf_ids_copy(&val, ids);
+}
+
+zone_conf_t *zone_conf_new(conf_t *conf, const knot_dname_t *zone)
+{
+	if (conf == NULL || zone == NULL) {
+		return NULL;
+	}
+
+	zone_conf_t *zconf = calloc(1, sizeof(*zconf));
+	if (zconf == NULL) {
+		return NULL;
+	}
+
+	if (get_ids(conf, C_ACL, zone, &zconf->acl) != KNOT_EOK ||
+	    get_ids(conf, C_MASTER, zone, &zconf->master) != KNOT_EOK ||
+	    get_ids(conf, C_NOTIFY, zone, &zconf->notify) != KNOT_EOK) {
+		zone_conf_free(zconf);
+		return NULL;
+	}
+
+	zconf->provide_ixfr = zone_conf_provide_ixfr(conf, NULL, zone);
+	zconf->dnssec_signing = zone_conf_dnssec_signing(conf, NULL, zone);
+	zconf->zonemd_generate = zone_conf_zonemd_generate(conf, NULL, zone);
+	zconf->serial_policy = zone_conf_serial_policy(conf, NULL, zone);
+	zconf->journal_content = zone_conf_journal_content(conf, NULL, zone);
+	zconf->journal_max_usage = zone_conf_journal_max_usage(conf, NULL, zone);
+	zconf->journal_max_depth = zone_conf_journal_max_depth(conf, NULL, zone);
+	zconf->journal_compression = zone_conf_journal_compression(conf, NULL, zone);
+	zconf->zonefile_sync = zone_conf_zonefile_sync(conf, NULL, zone);
+	zconf->axfr_snapshot_max_size = zone_conf_axfr_snapshot_max_size(conf, NULL, zone);
+
+	return zconf;
+}
+
+void zone_conf_free(zone_conf_t *zconf)
+{
+	if (zconf == NULL) {
+		return;
+	}
+
+	conf_ids_deinit(&zconf->acl);
+	conf_ids_deinit(&zconf->master);
+	conf_ids_deinit(&zconf->notify);
+	free(zconf);
+}
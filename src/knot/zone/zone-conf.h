@@ -0,0 +1,106 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Pre-resolved zone configuration.
+ *
+ * Frequently used zone options are resolved (including templates and
+ * defaults) on every reload and configuration commit, so that hot paths
+ * don't walk the configuration database. The structure is immutable; for
+ * a reused zone it's replaced with rcu_xchg_pointer() and the previous one
+ * is freed after sync RCU. So the pointer may only be dereferenced within
+ * an RCU read-side section, which the getters below take themselves.
+ *
+ * The accessors fall back to the configuration lookup if no cache is
+ * available (e.g. zones not created by the zone database reload).
+ */
+
+#pragma once
+
+#include "knot/conf/conf.h"
+#include "libknot/dname.h"
+
+typedef struct zone_conf {
+	conf_ids_t acl;             //!< ACL identifiers.
+	conf_ids_t master;          //!< Primary remote (group) identifiers.
+	conf_ids_t notify;          //!< NOTIFY target remote (group) identifiers.
+	bool provide_ixfr;          //!< Answer IXFR with differences.
+	bool dnssec_signing;        //!< Automatic DNSSEC signing enabled.
+	unsigned zonemd_generate;   //!< ZONEMD generation algorithm.
+	unsigned serial_policy;     //!< SOA serial policy.
+	unsigned journal_content;   //!< Journal content mode.
+	size_t journal_max_usage;   //!< Journal usage limit.
+	size_t journal_max_depth;   //!< Journal changeset count limit.
+	unsigned journal_compression; //!< Journal chunk compression.
+	int64_t zonefile_sync;      //!< Zone file flush interval.
+	size_t axfr_snapshot_max_size; //!< Limit of the shared outgoing AXFR messages.
+} zone_conf_t;
+
+/*!
+ * \brief Resolves the zone configuration.
+ *
+ * \param conf  Configuration.
+ * \param zone  Zone name.
+ *
+ * \return Pre-resolved configuration or NULL if error.
+ */
+zone_conf_t *zone_conf_new(conf_t *conf, const knot_dname_t *zone);
+
+/*!
+ * \brief Frees the pre-resolved zone configuration.
+ */
+void zone_conf_free(zone_conf_t *zconf);
+
+/*!
+ * \brief Pre-resolved option getters.
+ *
+ * The value is read within an RCU read-side section, so that the getters
+ * can be used outside of it, e.g. by zone events running during a reload.
+ *
+ * \param conf   Configuration (used only if no cache is available).
+ * \param zconf  Location of the pre-resolved zone configuration (e.g.
+ *               &zone->settings) or NULL.
+ * \param zone   Zone name (used only if no cache is available).
+ */
+bool zone_conf_provide_ixfr(conf_t *conf, zone_conf_t *const *zconf,
+                            const knot_dname_t *zone);
+
+bool zone_conf_dnssec_signing(conf_t *conf, zone_conf_t *const *zconf,
+                              const knot_dname_t *zone);
+
+unsigned zone_conf_zonemd_generate(conf_t *conf, zone_conf_t *const *zconf,
+                                   const knot_dname_t *zone);
+
+unsigned zone_conf_serial_policy(conf_t *conf, zone_conf_t *const *zconf,
+                                 const knot_dname_t *zone);
+
+unsigned zone_conf_journal_content(conf_t *conf, zone_conf_t *const *zconf,
+                                   const knot_dname_t *zone);
+
+size_t zone_conf_journal_max_usage(conf_t *conf, zone_conf_t *const *zconf,
+                                   const knot_dname_t *zone);
+
+size_t zone_conf_journal_max_depth(conf_t *conf, zone_conf_t *const *zconf,
+                                   const knot_dname_t *zone);
+
+unsigned zone_conf_journal_compression(conf_t *conf, zone_conf_t *const *zconf,
+                                       const knot_dname_t *zone);
+
+int64_t zone_conf_zonefile_sync(conf_t *conf, zone_conf_t *const *zconf,
+                                const knot_dname_t *zone);
+
+size_t zone_conf_axfr_snapshot_max_size(conf_t *conf, zone_conf_t *const *zconf,
+                                        const knot_dname_t *zone);
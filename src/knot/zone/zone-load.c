@@ -17,6 +17,7 @@
 #include "knot/common/log.h"
 #include "knot/journal/journal_metadata.h"
 #include "knot/journal/journal_read.h"
+#include "knot/zone/snapshot.h"
 #include "knot/zone/zone-diff.h"
 #include "knot/zone/zone-load.h"
 #include "knot/zone/zonefile.h"
@@ -24,6 +25,30 @@
 #include "knot/dnssec/zone-events.h"
 #include "libknot/libknot.h"
 
+semcheck_optional_t zone_load_semcheck_mode(conf_t *conf, const knot_dname_t *zone_name)
+{
+	conf_val_t val = conf_zone_get(conf, C_SEM_CHECKS, zone_name);
+	semcheck_optional_t mode = conf_opt(&val);
+	if (mode == SEMCHECK_DNSSEC_AUTO) {
+		val = conf_zone_get(conf, C_DNSSEC_VALIDATION, zone_name);
+		if (conf_bool(&val)) {
+			/* Disable duplicate DNSSEC checks, which are the
+			   same as DNSSEC validation in zone update commit. */
+			mode = SEMCHECK_DNSSEC_OFF;
+		}
+	}
+
+	return mode;
+}
+
+uint64_t zone_load_snapshot_params(conf_t *conf, const knot_dname_t *zone_name,
+                                   semcheck_optional_t semcheck_mode,
+                                   bool fail_on_warning)
+{
+	return zone_snapshot_params(semcheck_mode, fail_on_warning,
+	                            !zone_load_can_bootstrap(conf, zone_name));
+}
+
 int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
                        zone_contents_t **contents, semcheck_optional_t semcheck_mode,
                        bool fail_on_warning)
@@ -34,10 +59,31 @@ int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
 
 	char *zonefile = conf_zonefile(conf, zone_name);
 
+	/* Prefer an up-to-date snapshot of the zone file, loaded the same way. */
+	char *snapshot = NULL;
+	struct stat st;
+	uint64_t params = zone_load_snapshot_params(conf, zone_name, semcheck_mode,
+	                                            fail_on_warning);
+	if (zone_snapshot_enabled(conf, zone_name) && zonefile != NULL &&
+	    stat(zonefile, &st) == 0) {
+		snapshot = zone_snapshot_path(zonefile);
+		int ret = zone_snapshot_load(snapshot, zone_name, &st, params, contents);
+		if (ret == KNOT_EOK) {
+			log_zone_debug(zone_name, "zone snapshot loaded");
+			free(snapshot);
+			free(zonefile);
+			return KNOT_EOK;
+		} else if (ret != KNOT_ENOENT) {
+			log_zone_warning(zone_name, "failed to load zone snapshot (%s)",
+			                 knot_strerror(ret));
+		}
+	}
+
 	zloader_t zl;
 	int ret = zonefile_open(&zl, zonefile, zone_name, semcheck_mode, time(NULL));
 	free(zonefile);
 	if (ret != KNOT_EOK) {
+		free(snapshot);
 		return ret;
 	}
 
@@ -45,20 +91,34 @@ int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
 		.cb = err_handler_logger
 	};
 
+	conf_val_t val = conf_zone_get(conf, C_ADJUST_THR, zone_name);
+
 	zl.err_handler = &handler;
 	zl.creator->master = !zone_load_can_bootstrap(conf, zone_name);
+	zl.threads = conf_int(&val);
 
 	*contents = zonefile_load(&zl);
 	zonefile_close(&zl);
 	if (*contents == NULL) {
+		free(snapshot);
 		return KNOT_ERROR;
 	}
 	if (handler.warning && fail_on_warning) {
 		zone_contents_deep_free(*contents);
 		*contents = NULL;
+		free(snapshot);
 		return KNOT_ESEMCHECK;
 	}
 
+	if (snapshot != NULL) {
+		ret = zone_snapshot_write(snapshot, *contents, &st, params);
+		if (ret != KNOT_EOK) {
+			log_zone_warning(zone_name, "failed to write zone snapshot (%s)",
+			                 knot_strerror(ret));
+		}
+		free(snapshot);
+	}
+
 	return KNOT_EOK;
 }
 
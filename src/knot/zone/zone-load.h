@@ -37,6 +37,26 @@ int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
                        zone_contents_t **contents, semcheck_optional_t semcheck_mode,
                        bool fail_on_warning);
 
+/*!
+ * \brief Returns the configured semantic checks of zone file loading.
+ *
+ * \param conf
+ * \param zone_name
+ */
+semcheck_optional_t zone_load_semcheck_mode(conf_t *conf, const knot_dname_t *zone_name);
+
+/*!
+ * \brief Returns the hash of the zone loading parameters for the zone snapshot.
+ *
+ * \param conf
+ * \param zone_name
+ * \param semcheck_mode
+ * \param fail_on_warning
+ */
+uint64_t zone_load_snapshot_params(conf_t *conf, const knot_dname_t *zone_name,
+                                   semcheck_optional_t semcheck_mode,
+                                   bool fail_on_warning);
+
 /*!
  * \brief Update zone contents from the journal.
  *
@@ -365,6 +365,39 @@ int zone_tree_it_double_begin(zone_tree_t *first, zone_tree_t *second, zone_tree
 	return KNOT_EOK;
 }
 
+int zone_tree_it_leq_begin(zone_tree_t *tree, const knot_dname_t *owner,
+                           zone_tree_it_t *it)
+{
+	if (tree == NULL || owner == NULL) {
+		return KNOT_EINVAL;
+	}
+	if (zone_tree_is_empty(tree)) {
+		return KNOT_ENONODE;
+	}
+	int ret = zone_tree_it_begin(tree, it);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(owner, lf_storage);
+	ret = trie_it_get_leq(it->it, lf + 1, *lf);
+	if (ret == KNOT_ENOENT) {
+		// Owner precedes all the nodes, continue with the last one.
+		trie_it_free(it->it);
+		it->it = trie_it_begin(tree->trie);
+		if (it->it == NULL) {
+			memset(it, 0, sizeof(*it));
+			return KNOT_ENOMEM;
+		}
+		trie_it_prev_loop(it->it);
+		return 0;
+	} else if (ret < 0) {
+		zone_tree_it_free(it);
+		return ret;
+	}
+	return (ret == KNOT_EOK) ? 1 : 0;
+}
+
 static bool sub_done(zone_tree_it_t *it)
 {
 	return it->sub_root != NULL &&
@@ -401,6 +434,18 @@ void zone_tree_it_next(zone_tree_it_t *it)
 	}
 }
 
+void zone_tree_it_next_loop(zone_tree_it_t *it)
+{
+	assert(it->next_tree == NULL && it->sub_root == NULL);
+	trie_it_next_loop(it->it);
+}
+
+void zone_tree_it_prev_loop(zone_tree_it_t *it)
+{
+	assert(it->next_tree == NULL && it->sub_root == NULL);
+	trie_it_prev_loop(it->it);
+}
+
 void zone_tree_it_free(zone_tree_it_t *it)
 {
 	trie_it_free(it->it);
@@ -270,6 +270,23 @@ int zone_tree_it_sub_begin(zone_tree_t *tree, const knot_dname_t *sub_root,
  */
 int zone_tree_it_double_begin(zone_tree_t *first, zone_tree_t *second, zone_tree_it_t *it);
 
+/*!
+ * \brief Start cyclic iteration at the node less or equal to given name.
+ *
+ * If the name precedes all the nodes, the iteration starts at the last node.
+ *
+ * \param tree    Zone tree to iterate in.
+ * \param owner   Name to start at.
+ * \param it      Out: iteration context, shall be zeroed before.
+ *
+ * \retval > 0 if the iteration points to the node of \a owner.
+ * \retval 0 if the iteration points to the node preceding \a owner.
+ * \retval KNOT_ENONODE if the tree is empty.
+ * \return KNOT_E*
+ */
+int zone_tree_it_leq_begin(zone_tree_t *tree, const knot_dname_t *owner,
+                           zone_tree_it_t *it);
+
 /*!
  * \brief Return true iff iteration is finished.
  *
@@ -296,6 +313,20 @@ void zone_tree_it_del(zone_tree_it_t *it);
  */
 void zone_tree_it_next(zone_tree_it_t *it);
 
+/*!
+ * \brief Move the iteration to next node, continuing with the first one after the last.
+ *
+ * \note Only for iteration over a single tree without sub_root.
+ */
+void zone_tree_it_next_loop(zone_tree_it_t *it);
+
+/*!
+ * \brief Move the iteration to previous node, continuing with the last one before the first.
+ *
+ * \note Only for iteration over a single tree without sub_root.
+ */
+void zone_tree_it_prev_loop(zone_tree_it_t *it);
+
 /*!
  * \brief Free zone iteration context.
  */
@@ -26,13 +26,16 @@
 #include "knot/events/replan.h"
 #include "knot/journal/journal_read.h"
 #include "knot/journal/journal_write.h"
+#include "knot/nameserver/axfr.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/query/requestor.h"
 #include "knot/updates/zone-update.h"
 #include "knot/server/server.h"
 #include "knot/zone/contents.h"
 #include "knot/zone/serial.h"
+#include "knot/zone/snapshot.h"
 #include "knot/zone/zone.h"
+#include "knot/zone/zone-load.h"
 #include "knot/zone/zonefile.h"
 #include "libknot/libknot.h"
 #include "contrib/sockaddr.h"
@@ -72,8 +75,7 @@ static int flush_journal(conf_t *conf, zone_t *zone, bool allow_empty_zone, bool
 	bool force = zone_get_flag(zone, ZONE_FORCE_FLUSH, true);
 	bool user_flush = zone_get_flag(zone, ZONE_USER_FLUSH, true);
 
-	conf_val_t val = conf_zone_get(conf, C_ZONEFILE_SYNC, zone->name);
-	int64_t sync_timeout = conf_int(&val);
+	int64_t sync_timeout = zone_conf_zonefile_sync(conf, &zone->settings, zone->name);
 
 	if (zone_contents_is_empty(zone->contents)) {
 		if (allow_empty_zone && journal_is_existing(j)) {
@@ -132,6 +134,19 @@ static int flush_journal(conf_t *conf, zone_t *zone, bool allow_empty_zone, bool
 		goto flush_journal_replan;
 	}
 
+	/* Keep the zone snapshot in sync with the zone file. */
+	if (zone_snapshot_enabled(conf, zone->name)) {
+		char *snapshot = zone_snapshot_path(zonefile);
+		uint64_t params = zone_load_snapshot_params(conf, zone->name,
+		                  zone_load_semcheck_mode(conf, zone->name), false);
+		int snap_ret = zone_snapshot_write(snapshot, contents, &st, params);
+		if (snap_ret != KNOT_EOK) {
+			log_zone_warning(zone->name, "failed to update zone snapshot (%s)",
+			                 knot_strerror(snap_ret));
+		}
+		free(snapshot);
+	}
+
 	free(zonefile);
 
 	/* Update zone file attributes. */
@@ -179,9 +194,16 @@ zone_t* zone_new(const knot_dname_t *name)
 
 	knot_sem_init(&zone->cow_lock, 1);
 
+	// Control update lock
+	pthread_mutex_init(&zone->control_lock, NULL);
+
 	// Preferred master lock
 	pthread_mutex_init(&zone->preferred_lock, NULL);
 
+	pthread_mutex_init(&zone->axfr_snapshot_lock, NULL);
+
+	zone_digest_cache_init(&zone->digest_cache);
+
 	// Initialize events
 	zone_events_init(zone);
 
@@ -223,6 +245,7 @@ void zone_free(zone_t **zone_ptr)
 
 	/* Control update. */
 	zone_control_clear(zone);
+	pthread_mutex_destroy(&zone->control_lock);
 
 	free(zone->catalog_gen);
 	catalog_update_free(zone->cat_members);
@@ -232,12 +255,17 @@ void zone_free(zone_t **zone_ptr)
 	free(zone->preferred_master);
 
 	/* Free zone contents. */
+	axfr_snapshot_drop(zone);
+	pthread_mutex_destroy(&zone->axfr_snapshot_lock);
+	zone_digest_cache_deinit(&zone->digest_cache);
 	zone_contents_deep_free(zone->contents);
 
 	conf_deactivate_modules(&zone->query_modules, &zone->query_plan);
 
 	ptrlist_free(&zone->internal_notify, NULL);
 
+	zone_conf_free(zone->settings);
+
 	free(zone);
 	*zone_ptr = NULL;
 }
@@ -364,7 +392,7 @@ int zone_change_store(conf_t *conf, zone_t *zone, changeset_t *change, changeset
 		return KNOT_EINVAL;
 	}
 
-	zone_journal_t j = { zone_journaldb(zone), zone->name, conf };
+	zone_journal_t j = { zone_journaldb(zone), zone->name, conf, &zone->settings };
 
 	int ret = journal_insert(j, change, extra, NULL);
 	if (ret == KNOT_EBUSY) {
@@ -386,7 +414,7 @@ int zone_diff_store(conf_t *conf, zone_t *zone, const zone_diff_t *diff)
 		return KNOT_EINVAL;
 	}
 
-	zone_journal_t j = { zone_journaldb(zone), zone->name, conf };
+	zone_journal_t j = { zone_journaldb(zone), zone->name, conf, &zone->settings };
 
 	int ret = journal_insert(j, NULL, NULL, diff);
 	if (ret == KNOT_EBUSY) {
@@ -421,7 +449,7 @@ int zone_in_journal_store(conf_t *conf, zone_t *zone, zone_contents_t *new_conte
 		return KNOT_EEMPTYZONE;
 	}
 
-	zone_journal_t j = { zone_journaldb(zone), zone->name, conf };
+	zone_journal_t j = { zone_journaldb(zone), zone->name, conf, &zone->settings };
 
 	int ret = journal_insert_zone(j, new_contents);
 	if (ret == KNOT_EOK) {
@@ -471,6 +499,9 @@ zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_content
 	zone_contents_t **current_contents = &zone->contents;
 	old_contents = rcu_xchg_pointer(current_contents, new_contents);
 
+	/* Pre-encoded AXFR of the old contents is not valid anymore. */
+	axfr_snapshot_drop(zone);
+
 	return old_contents;
 }
 
@@ -509,6 +540,55 @@ void zone_clear_preferred_master(zone_t *zone)
 	pthread_mutex_unlock(&zone->preferred_lock);
 }
 
+zone_probe_state_t zone_refresh_probe_take(zone_t *zone, soa_probe_result_t *result)
+{
+	assert(zone);
+	assert(result);
+
+	pthread_mutex_lock(&zone->preferred_lock);
+	zone_probe_state_t state = zone->refresh_probe;
+	switch (state) {
+	case ZONE_PROBE_NONE:
+		zone->refresh_probe = ZONE_PROBE_PENDING;
+		break;
+	case ZONE_PROBE_DONE:
+		*result = zone->refresh_probe_result;
+		zone->refresh_probe = ZONE_PROBE_NONE;
+		break;
+	default:
+		break;
+	}
+	pthread_mutex_unlock(&zone->preferred_lock);
+
+	return state;
+}
+
+void zone_refresh_probe_cancel(zone_t *zone)
+{
+	assert(zone);
+
+	pthread_mutex_lock(&zone->preferred_lock);
+	zone->refresh_probe = ZONE_PROBE_NONE;
+	pthread_mutex_unlock(&zone->preferred_lock);
+}
+
+void zone_refresh_probe_done(zone_t *zone, const soa_probe_result_t *result)
+{
+	assert(zone);
+	assert(result);
+
+	pthread_mutex_lock(&zone->preferred_lock);
+	zone->refresh_probe_result = *result;
+	zone->refresh_probe = ZONE_PROBE_DONE;
+	pthread_mutex_unlock(&zone->preferred_lock);
+
+	// The responding master is tried first by the refresh.
+	if (result->ret == KNOT_EOK) {
+		zone_set_preferred_master(zone, &result->remote);
+	}
+	zone_events_schedule_now(zone, ZONE_EVENT_REFRESH);
+}
+
 static void set_flag(zone_t *zone, zone_flag_t flag, bool remove)
 {
 	if (zone == NULL) {
@@ -800,8 +880,7 @@ int slave_zone_serial(zone_t *zone, conf_t *conf, uint32_t *serial)
 	assert(zone->contents != NULL);
 	*serial = zone_contents_serial(zone->contents);
 
-	conf_val_t val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	if (conf_bool(&val)) {
+	if (zone_conf_dnssec_signing(conf, &zone->settings, zone->name)) {
 		ret = zone_get_master_serial(zone, serial);
 	}
 
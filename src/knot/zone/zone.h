@@ -23,15 +23,19 @@
 #include "knot/journal/journal_basic.h"
 #include "knot/journal/serialization.h"
 #include "knot/events/events.h"
+#include "knot/query/soa_probe.h"
 #include "knot/updates/changesets.h"
 #include "knot/zone/contents.h"
+#include "knot/zone/digest.h"
 #include "knot/zone/timers.h"
+#include "knot/zone/zone-conf.h"
 #include "libknot/dname.h"
 #include "libknot/dynarray.h"
 #include "libknot/packet/pkt.h"
 
 struct zone_update;
 struct zone_backup_ctx;
+struct axfr_snapshot;
 
 /*!
  * \brief Zone flags.
@@ -70,6 +74,15 @@ typedef enum {
 	PURGE_ZONE_CATALOG  = 1 << 7, /*!< Purge the catalog. */
 } purge_flag_t;
 
+/*!
+ * \brief State of the asynchronous SOA query of zone refresh.
+ */
+typedef enum {
+	ZONE_PROBE_NONE = 0, /*!< No query outstanding. */
+	ZONE_PROBE_PENDING,  /*!< Query submitted, waiting for the result. */
+	ZONE_PROBE_DONE,     /*!< Result ready for the refresh event. */
+} zone_probe_state_t;
+
 #define PURGE_ZONE_FULL       ~0U     /*!< Purge everything possible. */
                                       /*!< Standard purge (respect C_ZONEFILE_SYNC param). */
 #define PURGE_ZONE_ALL        (PURGE_ZONE_FULL ^ PURGE_ZONE_NOSYNC)
@@ -112,8 +125,9 @@ typedef struct zone
 	size_t ddns_queue_size;
 	list_t ddns_queue;
 
-	/*! \brief Control update context. */
+	/*! \brief Control update context and lock serializing its control commands. */
 	struct zone_update *control_update;
+	pthread_mutex_t control_lock;
 
 	/*! \brief Ensue one COW transaction on zone's trees at a time. */
 	knot_sem_t cow_lock;
@@ -138,9 +152,23 @@ typedef struct zone
 	/*! \brief Preferred master for remote operation. */
 	struct sockaddr_storage *preferred_master;
 
+	/*! \brief Asynchronous refresh SOA query (protected by the preferred lock). */
+	zone_probe_state_t refresh_probe;
+	soa_probe_result_t refresh_probe_result;
+
+	/*! \brief Pre-encoded AXFR of current contents and its lock. */
+	struct axfr_snapshot *axfr_snapshot;
+	pthread_mutex_t axfr_snapshot_lock;
+
+	/*! \brief Last computed or verified ZONEMD digest. */
+	zone_digest_cache_t digest_cache;
+
 	/*! \brief Query modules. */
 	list_t query_modules;
 	struct query_plan *query_plan;
+
+	/*! \brief Pre-resolved zone configuration (NULL if not available). */
+	zone_conf_t *settings;
 } zone_t;
 
 /*!
@@ -202,7 +230,7 @@ catalog_update_t *zone_catalog_upd(const zone_t *zone);
  */
 inline static zone_journal_t zone_journal(zone_t *zone)
 {
-	zone_journal_t j = { zone_journaldb(zone), zone->name, NULL };
+	zone_journal_t j = { zone_journaldb(zone), zone->name, NULL, &zone->settings };
 	return j;
 }
 
@@ -236,6 +264,26 @@ void zone_set_preferred_master(zone_t *zone, const struct sockaddr_storage *addr
 /*! \brief Clears the current preferred master address. */
 void zone_clear_preferred_master(zone_t *zone);
 
+/*!
+ * \brief Takes the state of the asynchronous refresh SOA query.
+ *
+ * If there is no query outstanding, the state is set to pending and the caller
+ * is expected to submit the query (or to cancel it on failure). A finished
+ * result is passed to the caller and the state is reset.
+ *
+ * \param zone    Zone.
+ * \param result  Output: the query result if done.
+ *
+ * \return Previous query state.
+ */
+zone_probe_state_t zone_refresh_probe_take(zone_t *zone, soa_probe_result_t *result);
+
+/*! \brief Resets the pending refresh SOA query state after a failed submission. */
+void zone_refresh_probe_cancel(zone_t *zone);
+
+/*! \brief Stores the refresh SOA query result and schedules the refresh. */
+void zone_refresh_probe_done(zone_t *zone, const soa_probe_result_t *result);
+
 /*! \brief Sets a zone flag. */
 void zone_set_flag(zone_t *zone, zone_flag_t flag);
 
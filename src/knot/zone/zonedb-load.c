@@ -87,7 +87,7 @@ static void replan_events(conf_t *conf, zone_t *zone, zone_t *old_zone)
 	bool conf_updated = (old_zone->change_type & CONF_IO_TRELOAD);
 
 	conf_val_t digest = conf_zone_get(conf, C_ZONEMD_GENERATE, zone->name);
-	if (zone->contents != NULL && !zone_contents_digest_exists(zone->contents, conf_opt(&digest), true)) {
+	if (zone->contents != NULL && !zone_contents_digest_exists(zone->contents, conf_opt(&digest), true, 1, NULL)) {
 		conf_updated = true;
 	}
 
@@ -111,6 +111,7 @@ static zone_t *create_zone_reload(conf_t *conf, const knot_dname_t *name,
 	}
 
 	zone->contents = old_zone->contents;
+	zone_digest_cache_copy(&zone->digest_cache, &old_zone->digest_cache);
 	zone_set_flag(zone, zone_get_flag(old_zone, ~0, false));
 
 	zone->timers = old_zone->timers;
@@ -220,6 +221,7 @@ static zone_t *create_zone(conf_t *conf, const knot_dname_t *name, server_t *ser
 
 	if (z != NULL) {
 		zone_get_catalog_group(conf, z);
+		z->settings = zone_conf_new(conf, name);
 	}
 
 	return z;
@@ -276,8 +278,25 @@ static bool check_open_catalog(catalog_t *cat)
 	return false;
 }
 
+/*!
+ * \brief Re-resolves the pre-resolved configuration of a reused zone.
+ *
+ * The previous configuration may still be read by queries or by zone events
+ * through the getters, both within RCU read-side sections, so it's freed
+ * after sync RCU.
+ */
+static void refresh_settings(conf_t *conf, zone_t *zone, list_t *expired_settings)
+{
+	zone_conf_t *old = rcu_xchg_pointer(&zone->settings,
+	                                    zone_conf_new(conf, zone->name));
+	if (old != NULL) {
+		ptrlist_add(expired_settings, old, NULL);
+	}
+}
+
 static zone_t *reuse_member_zone(zone_t *zone, server_t *server, conf_t *conf,
-                                 reload_t mode, list_t *expired_contents)
+                                 reload_t mode, list_t *expired_contents,
+                                 list_t *expired_settings)
 {
 	if (!zone_get_flag(zone, ZONE_IS_CAT_MEMBER, false)) {
 		return NULL;
@@ -297,6 +316,7 @@ static zone_t *reuse_member_zone(zone_t *zone, server_t *server, conf_t *conf,
 			break; // reload the member zone
 		case CAT_UPD_INVALID:
 		case CAT_UPD_MINOR:
+			refresh_settings(conf, zone, expired_settings);
 			return zone; // reuse the member zone
 		case CAT_UPD_REM:
 			return NULL; // remove the member zone
@@ -306,6 +326,7 @@ static zone_t *reuse_member_zone(zone_t *zone, server_t *server, conf_t *conf,
 			return NULL;
 		}
 	} else if (mode & (RELOAD_COMMIT | RELOAD_CATALOG)) {
+		refresh_settings(conf, zone, expired_settings);
 		return zone; // reuse the member zone
 	}
 
@@ -399,11 +420,12 @@ static zone_t *add_member_zone(catalog_upd_val_t *val, knot_zonedb_t *check,
  * \param server            Server instance.
  * \param mode              Reload mode.
  * \param expired_contents  Out: ptrlist of zone_contents_t to be deep freed after sync RCU.
+ * \param expired_settings  Out: ptrlist of zone_conf_t to be freed after sync RCU.
  *
  * \return New zone database.
  */
 static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server, reload_t mode,
-                                    list_t *expired_contents)
+                                    list_t *expired_contents, list_t *expired_settings)
 {
 	assert(conf);
 	assert(server);
@@ -429,6 +451,7 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server, reload_t mod
 		if (old_zone != NULL && (mode & (RELOAD_COMMIT | RELOAD_CATALOG))) {
 			/* Reuse unchanged zone. */
 			if (!(old_zone->change_type & CONF_IO_TRELOAD)) {
+				refresh_settings(conf, old_zone, expired_settings);
 				knot_zonedb_insert(db_new, old_zone);
 				continue;
 			}
@@ -473,7 +496,8 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server, reload_t mod
 		while (!knot_zonedb_iter_finished(it)) {
 			zone_t *newzone = reuse_member_zone(knot_zonedb_iter_val(it),
 			                                    server, conf, mode,
-			                                    expired_contents);
+			                                    expired_contents,
+			                                    expired_settings);
 			if (newzone != NULL) {
 				knot_zonedb_insert(db_new, newzone);
 			}
@@ -600,8 +624,9 @@ void zonedb_reload(conf_t *conf, server_t *server, reload_t mode)
 		}
 	}
 
-	list_t contents_tofree;
+	list_t contents_tofree, settings_tofree;
 	init_list(&contents_tofree);
+	init_list(&settings_tofree);
 
 	catalog_update_finalize(&server->catalog_upd, &server->catalog, conf);
 	size_t cat_upd_size = trie_weight(server->catalog_upd.upd);
@@ -610,7 +635,8 @@ void zonedb_reload(conf_t *conf, server_t *server, reload_t mode)
 	}
 
 	/* Insert all required zones to the new zone DB. */
-	knot_zonedb_t *db_new = create_zonedb(conf, server, mode, &contents_tofree);
+	knot_zonedb_t *db_new = create_zonedb(conf, server, mode, &contents_tofree,
+	                                      &settings_tofree);
 	if (db_new == NULL) {
 		log_error("failed to create new zone database");
 		return;
@@ -626,6 +652,7 @@ void zonedb_reload(conf_t *conf, server_t *server, reload_t mode)
 	synchronize_rcu();
 
 	ptrlist_free_custom(&contents_tofree, NULL, (ptrlist_free_cb)zone_contents_deep_free);
+	ptrlist_free_custom(&settings_tofree, NULL, (ptrlist_free_cb)zone_conf_free);
 
 	/* Remove old zone DB. */
 	remove_old_zonedb(conf, db_old, server, mode);
@@ -135,12 +135,9 @@ zone_t **knot_zonedb_find_ptr(knot_zonedb_t *db, const knot_dname_t *zone_name)
 	return (zone_t **)val;
 }
 
-zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name)
+/*! \brief Find the closest enclosing zone by stripping the labels one by one. */
+static zone_t *find_suffix_labels(knot_zonedb_t *db, const knot_dname_t *zone_name)
 {
-	if (db == NULL || zone_name == NULL) {
-		return NULL;
-	}
-
 	while (true) {
 		knot_dname_storage_t lf_storage;
 		uint8_t *lf = knot_dname_lf(zone_name, lf_storage);
@@ -157,6 +154,30 @@ zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name
 	}
 }
 
+zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name)
+{
+	if (db == NULL || zone_name == NULL) {
+		return NULL;
+	}
+
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(zone_name, lf_storage);
+	assert(lf);
+
+	trie_val_t *val = trie_get_lpm(db->trie, lf + 1, *lf);
+	if (val == NULL) {
+		return NULL;
+	}
+
+	// The byte prefix may end inside a label containing a zero byte.
+	zone_t *zone = *val;
+	if (knot_dname_in_bailiwick(zone_name, zone->name) < 0) {
+		return find_suffix_labels(db, zone_name);
+	}
+
+	return zone;
+}
+
 size_t knot_zonedb_size(const knot_zonedb_t *db)
 {
 	if (db == NULL) {
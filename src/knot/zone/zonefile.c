@@ -15,9 +15,11 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -27,6 +29,7 @@
 
 #include "libknot/libknot.h"
 #include "contrib/files.h"
+#include "contrib/macros.h"
 #include "knot/common/log.h"
 #include "knot/dnssec/zone-nsec.h"
 #include "knot/zone/semantic-check.h"
@@ -39,6 +42,24 @@
 #define WARNING(zone, fmt, ...) log_zone_warning(zone, "zone loader, " fmt, ##__VA_ARGS__)
 #define NOTICE(zone, fmt, ...) log_zone_notice(zone, "zone loader, " fmt, ##__VA_ARGS__)
 
+/*! \brief Minimal size of a zone file chunk parsed by one thread. */
+#define CHUNK_MIN_SIZE	(1024 * 1024)
+
+/*! \brief Part of the zone file parsed by one thread into own contents. */
+typedef struct {
+	zs_scanner_t scanner;
+	zcreator_t creator;
+	const char *start;
+	size_t size;
+	uint64_t line;
+	uint32_t default_ttl;
+	uint32_t origin_length;
+	uint8_t origin[ZS_MAX_DNAME_LENGTH + ZS_MAX_LABEL_LENGTH];
+	pthread_t thread;
+	bool threaded;
+	int ret;
+} zchunk_t;
+
 static void process_error(zs_scanner_t *s)
 {
 	zcreator_t *zc = s->process.data;
@@ -186,10 +207,363 @@ int zonefile_open(zloader_t *loader, const char *source,
 	loader->creator = zc;
 	loader->semantic_checks = semantic_checks;
 	loader->time = time;
+	loader->threads = 1;
+
+	return KNOT_EOK;
+}
+
+static void chunk_begin(zchunk_t *chunk, const zs_scanner_t *state,
+                        const char *start, uint64_t line)
+{
+	chunk->start = start;
+	chunk->line = line;
+	chunk->default_ttl = state->default_ttl;
+	chunk->origin_length = state->zone_origin_length;
+	memcpy(chunk->origin, state->zone_origin, state->zone_origin_length);
+}
+
+static void apply_directive(zs_scanner_t *state, const char *entry, size_t len)
+{
+	// Included file doesn't change the state of the including one.
+	if (len >= 8 && strncasecmp(entry, "$INCLUDE", 8) == 0) {
+		return;
+	}
+
+	if (zs_set_input_string(state, entry, len) == 0) {
+		(void)zs_parse_all(state);
+	}
+}
+
+static bool is_owner_char(char c)
+{
+	return c != ' ' && c != '\t' && c != '\r' && c != '\n' &&
+	       c != ';' && c != '$' && c != '(';
+}
+
+/*!
+ * \brief Splits the input into chunks, each starting with an explicit owner.
+ *
+ * Parentheses, quoted strings, and comments are tracked so that the input is
+ * only split between complete records. $ORIGIN and $TTL directives are
+ * applied to the state scanner to obtain the initial state of each chunk.
+ *
+ * \return Number of chunks.
+ */
+static unsigned split_input(const char *data, size_t size, zs_scanner_t *state,
+                            zchunk_t *chunks, unsigned count)
+{
+	const char *end = data + size;
+	const char *entry = data;
+	uint64_t line = 1;
+	unsigned depth = 0;
+	bool quoted = false;
+	unsigned n = 1;
+
+	chunk_begin(&chunks[0], state, data, line);
+	size_t next = size / count;
+
+	for (const char *p = data; p < end; p++) {
+		if (p == entry && n < count && p - data >= next && is_owner_char(*p)) {
+			chunks[n - 1].size = p - chunks[n - 1].start;
+			chunk_begin(&chunks[n], state, p, line);
+			n++;
+			next = (size / count) * n;
+		}
+
+		switch (*p) {
+		case '\\':
+			if (p + 1 < end && p[1] != '\n') {
+				p++;
+			}
+			break;
+		case '"':
+			quoted = !quoted;
+			break;
+		case '(':
+			depth += !quoted;
+			break;
+		case ')':
+			if (!quoted && depth > 0) {
+				depth--;
+			}
+			break;
+		case ';':
+			if (!quoted) {
+				const char *eol = memchr(p, '\n', end - p);
+				p = (eol != NULL ? eol : end) - 1;
+			}
+			break;
+		case '\n':
+			line++;
+			if (depth == 0) {
+				if (*entry == '$') {
+					apply_directive(state, entry, p + 1 - entry);
+				}
+				entry = p + 1;
+				quoted = false;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	chunks[n - 1].size = end - chunks[n - 1].start;
+
+	return n;
+}
+
+static int chunk_init(zchunk_t *chunk, const zs_scanner_t *whole,
+                      const char *origin, zcreator_t *zc)
+{
+	zs_scanner_t *s = &chunk->scanner;
+
+	if (zs_init(s, origin, KNOT_CLASS_IN, 3600) != 0 ||
+	    zs_set_input_string(s, chunk->start, chunk->size) != 0 ||
+	    zs_set_processing(s, process_data, process_error, zc) != 0) {
+		return KNOT_EFILE;
+	}
+
+	// Continue in the state of the whole file at the chunk beginning.
+	free(s->path);
+	s->path = strdup(whole->path);
+	s->file.name = strdup(whole->file.name);
+	if (s->path == NULL || s->file.name == NULL) {
+		return KNOT_ENOMEM;
+	}
+	s->zone_origin_length = chunk->origin_length;
+	memcpy(s->zone_origin, chunk->origin, chunk->origin_length);
+	s->default_ttl = chunk->default_ttl;
+	s->line_counter = chunk->line;
 
 	return KNOT_EOK;
 }
 
+static void *chunk_parse(void *arg)
+{
+	zchunk_t *chunk = arg;
+	chunk->ret = zs_parse_all(&chunk->scanner);
+	return NULL;
+}
+
+static zone_node_t *new_parent_cb(const knot_dname_t *owner, void *tree)
+{
+	return node_new_for_tree(owner, tree, NULL);
+}
+
+static int merge_node(zcreator_t *zc, zone_node_t *node, const zone_node_t *from)
+{
+	for (uint16_t i = 0; i < from->rrset_count; i++) {
+		knot_rrset_t rr = node_rrset_at(from, i);
+		if (rr.type == KNOT_RRTYPE_SOA &&
+		    node_rrtype_exists(zc->z->apex, KNOT_RRTYPE_SOA)) {
+			// Ignore extra SOA
+			continue;
+		}
+
+		int ret = node_add_rrset(node, &rr, NULL);
+		if (ret != KNOT_EOK && !handle_err(zc, &rr, ret, zc->master)) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int move_node(zone_contents_t *z, zone_tree_t *tree, zone_node_t *node)
+{
+	zone_node_t *parent = NULL;
+	int ret = zone_tree_add_node(tree, z->apex, knot_wire_next_label(node->owner, NULL),
+	                             new_parent_cb, tree, &parent);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	node->parent = parent;
+	node->children = 0;
+	node->flags &= ~NODE_FLAGS_WILDCARD_CHILD;
+	parent->children++;
+	if (knot_dname_is_wildcard(node->owner)) {
+		parent->flags |= NODE_FLAGS_WILDCARD_CHILD;
+	}
+
+	return zone_tree_insert(tree, &node);
+}
+
+/*!
+ * \brief Moves nodes of a partial tree to the zone, merges the existing ones.
+ *
+ * The partial tree is traversed in canonical order, so parents are always
+ * processed before their children. The partial tree nodes are consumed.
+ */
+static int merge_tree(zcreator_t *zc, zone_tree_t *tree, zone_tree_t *part)
+{
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(part, &it);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	for (; !zone_tree_it_finished(&it); zone_tree_it_next(&it)) {
+		zone_node_t *node = zone_tree_it_val(&it);
+		if (ret == KNOT_EOK) {
+			zone_node_t *dst = zone_tree_get(tree, node->owner);
+			if (dst == NULL) {
+				ret = move_node(zc->z, tree, node);
+				if (ret == KNOT_EOK) {
+					continue;
+				}
+			} else {
+				ret = merge_node(zc, dst, node);
+			}
+		}
+		binode_unify(node, false, NULL);
+		node_free_rrsets(node, NULL);
+		node_free(node, NULL);
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+static int merge_contents(zcreator_t *zc, zone_contents_t *part)
+{
+	zone_contents_t *z = zc->z;
+
+	int ret = merge_tree(zc, z->nodes, part->nodes);
+	if (ret == KNOT_EOK && !zone_tree_is_empty(part->nsec3_nodes)) {
+		if (z->nsec3_nodes == NULL) {
+			z->nsec3_nodes = zone_tree_create(z->nodes->flags & ZONE_TREE_USE_BINODES);
+			if (z->nsec3_nodes == NULL) {
+				ret = KNOT_ENOMEM;
+			} else {
+				z->nsec3_nodes->flags = z->nodes->flags;
+			}
+		}
+		if (ret == KNOT_EOK) {
+			ret = merge_tree(zc, z->nsec3_nodes, part->nsec3_nodes);
+		}
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Parses the zone file in parallel chunks.
+ *
+ * The chunks are parsed into separate contents and merged into the loader
+ * contents in the order of the file. Parsing errors are accumulated in the
+ * loader scanner as if it parsed the whole file.
+ *
+ * \retval 1 if the file wasn't split and must be parsed sequentially.
+ * \retval 0 if success.
+ * \retval -1 if error.
+ */
+static int parse_chunks(zloader_t *loader, unsigned count)
+{
+	zs_scanner_t *whole = &loader->scanner;
+	zcreator_t *zc = loader->creator;
+
+	zs_scanner_t *state = malloc(sizeof(*state));
+	zchunk_t *chunks = calloc(count, sizeof(*chunks));
+	char *origin = knot_dname_to_str_alloc(zc->z->apex->owner);
+	if (state == NULL || chunks == NULL || origin == NULL ||
+	    zs_init(state, origin, KNOT_CLASS_IN, 3600) != 0) {
+		free(origin);
+		free(chunks);
+		free(state);
+		return 1;
+	}
+
+	count = split_input(whole->input.start, whole->input.end - whole->input.start,
+	                    state, chunks, count);
+	zs_deinit(state);
+	free(state);
+	if (count < 2) {
+		free(origin);
+		free(chunks);
+		return 1;
+	}
+
+	int ret = KNOT_EOK;
+	unsigned ready = 0;
+	for (; ready < count && ret == KNOT_EOK; ready++) {
+		zchunk_t *chunk = &chunks[ready];
+		chunk->creator.master = zc->master;
+		chunk->creator.z = (ready == 0) ? zc->z :
+		                   zone_contents_new(zc->z->apex->owner, true);
+		if (chunk->creator.z == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+		ret = chunk_init(chunk, whole, origin,
+		                 (ready == 0) ? zc : &chunk->creator);
+	}
+	free(origin);
+
+	if (ret == KNOT_EOK) {
+		for (unsigned i = 1; i < count; i++) {
+			chunks[i].threaded = (pthread_create(&chunks[i].thread, NULL,
+			                                     chunk_parse, &chunks[i]) == 0);
+			if (!chunks[i].threaded) {
+				chunk_parse(&chunks[i]);
+			}
+		}
+		chunk_parse(&chunks[0]);
+	}
+
+	for (unsigned i = 0; i < ready; i++) {
+		zchunk_t *chunk = &chunks[i];
+		if (chunk->threaded) {
+			(void)pthread_join(chunk->thread, NULL);
+		}
+
+		zs_scanner_t *s = &chunk->scanner;
+		if (ret == KNOT_EOK) {
+			if (chunk->ret != 0 && whole->error.code == 0) {
+				whole->error.code = s->error.code;
+			}
+			whole->error.counter += s->error.counter;
+			whole->error.fatal |= s->error.fatal;
+		}
+
+		if (i > 0) {
+			if (zc->ret == KNOT_EOK) {
+				zc->ret = chunk->creator.ret;
+			}
+			if (ret == KNOT_EOK && zc->ret == KNOT_EOK && whole->error.counter == 0) {
+				zc->ret = merge_contents(zc, chunk->creator.z);
+				zone_contents_free(chunk->creator.z);
+			} else {
+				zone_contents_deep_free(chunk->creator.z);
+			}
+		}
+		zs_deinit(s);
+	}
+	free(chunks);
+
+	if (ret != KNOT_EOK) {
+		zc->ret = ret;
+	}
+
+	return (whole->error.counter > 0 || whole->error.code != 0) ? -1 : 0;
+}
+
+static int parse_input(zloader_t *loader)
+{
+	zs_scanner_t *s = &loader->scanner;
+	size_t size = s->input.end - s->input.start;
+
+	unsigned count = MIN(loader->threads, size / CHUNK_MIN_SIZE);
+	if (count > 1) {
+		int ret = parse_chunks(loader, count);
+		if (ret <= 0) {
+			return ret;
+		}
+	}
+
+	return zs_parse_all(s);
+}
+
 zone_contents_t *zonefile_load(zloader_t *loader)
 {
 	if (!loader) {
@@ -200,7 +574,7 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 	const knot_dname_t *zname = zc->z->apex->owner;
 
 	assert(zc);
-	int ret = zs_parse_all(&loader->scanner);
+	int ret = parse_input(loader);
 	if (ret != 0 && loader->scanner.error.counter == 0) {
 		ERROR(zname, "failed to load zone, file '%s' (%s)",
 		      loader->source, zs_strerror(loader->scanner.error.code));
@@ -246,7 +620,7 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 	/* The contents will now change possibly messing up NSEC3 tree, it will
 	   be adjusted again at zone_update_commit. */
 	ret = zone_adjust_contents(zc->z, unadjust_cb_point_to_nsec3, NULL,
-	                           false, false, 1, NULL);
+	                           false, false, loader->threads, NULL);
 	if (ret != KNOT_EOK) {
 		ERROR(zname, "failed to finalize zone contents (%s)",
 		      knot_strerror(ret));
@@ -41,6 +41,7 @@ typedef struct {
 	zcreator_t *creator;         /*!< Loader context. */
 	zs_scanner_t scanner;        /*!< Zone scanner. */
 	time_t time;                 /*!< time for zone check. */
+	unsigned threads;            /*!< Number of threads for parsing and adjusting. */
 } zloader_t;
 
 void err_handler_logger(sem_handler_t *handler, const zone_contents_t *zone,
@@ -64,6 +65,9 @@ int zonefile_open(zloader_t *loader, const char *source,
 /*!
  * \brief Loads zone from a zone file.
  *
+ * If more threads are allowed and the file is large enough, it is split
+ * at record boundaries into chunks which are parsed in parallel and merged.
+ *
  * \param loader Zone loader instance.
  *
  * \retval Loaded zone contents on success.
@@ -272,6 +272,25 @@ int knot_ctl_accept(knot_ctl_t *ctx)
 	return KNOT_EOK;
 }
 
+_public_
+knot_ctl_t *knot_ctl_detach(knot_ctl_t *ctx)
+{
+	if (ctx == NULL || ctx->sock < 0) {
+		return NULL;
+	}
+
+	knot_ctl_t *res = knot_ctl_alloc();
+	if (res == NULL) {
+		return NULL;
+	}
+
+	res->timeout = ctx->timeout;
+	res->sock = ctx->sock;
+	ctx->sock = -1;
+
+	return res;
+}
+
 _public_
 int knot_ctl_connect(knot_ctl_t *ctx, const char *path)
 {
@@ -127,6 +127,14 @@ int knot_ctl_connect(knot_ctl_t *ctx, const char *path);
  */
 int knot_ctl_accept(knot_ctl_t *ctx);
 
+/*!
+ * Detaches the accepted connection into a newly allocated control context.
+ * \note Server operation. The original context remains listening.
+ * \param[in] ctx  Control context with an accepted connection.
+ * \return Control context of the connection, or NULL if error.
+ */
+knot_ctl_t *knot_ctl_detach(knot_ctl_t *ctx);
+
 /*!
  * Closes the remote connections.
  *
@@ -30,6 +30,7 @@
 #include <time.h>
 
 #include "libknot/quic/quic.h"
+#include "libknot/quic/tls_common.h"
 
 #include "contrib/macros.h"
 #include "contrib/sockaddr.h"
@@ -59,14 +60,6 @@ const gnutls_datum_t doq_alpn = {
 	(unsigned char *)"doq", 3
 };
 
-typedef struct knot_quic_creds {
-	gnutls_certificate_credentials_t tls_cert;
-	gnutls_anti_replay_t tls_anti_replay;
-	gnutls_datum_t tls_ticket_key;
-	uint8_t *peer_pin;
-	uint8_t peer_pin_len;
-} knot_quic_creds_t;
-
 typedef struct knot_quic_session {
 	node_t n;
 	gnutls_datum_t tls_session;
@@ -492,12 +485,25 @@ static void init_random_cid(ngtcp2_cid *cid, size_t len)
 	}
 }
 
+static void steer_cid(ngtcp2_cid *cid, const knot_quic_table_t *table)
+{
+	if (table->cid_steer_count > 1 && cid->datalen > 0) {
+		unsigned first = cid->data[0] - cid->data[0] % table->cid_steer_count +
+		                 table->cid_steer_idx;
+		if (first > UINT8_MAX) {
+			first -= table->cid_steer_count;
+		}
+		cid->data[0] = first;
+	}
+}
+
 static bool init_unique_cid(ngtcp2_cid *cid, size_t len, knot_quic_table_t *table)
 {
 	do {
 		if (init_random_cid(cid, len), cid->datalen == 0) {
 			return false;
 		}
+		steer_cid(cid, table);
 	} while (quic_table_lookup(cid, table) != NULL);
 	return true;
 }
@@ -1021,6 +1027,7 @@ static int send_special(knot_quic_table_t *quic_table, knot_quic_reply_t *rpl)
 		ngtcp2_cid_init(&scid, decoded_cids.scid, decoded_cids.scidlen);
 
 		init_random_cid(&new_dcid, 0);
+		steer_cid(&new_dcid, quic_table);
 
 		ret = ngtcp2_crypto_generate_retry_token(
 			retry_token, (const uint8_t *)quic_table->hash_secret,
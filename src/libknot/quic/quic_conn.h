@@ -108,6 +108,8 @@ typedef struct knot_quic_table {
 	void (*log_cb)(const char *);
 	uint64_t hash_secret[4];
 	struct knot_quic_creds *creds;
+	uint16_t cid_steer_count; // if > 1, first byte of our CIDs modulo this ...
+	uint16_t cid_steer_idx;   // ... equals this, for steering packets to a socket
 	knot_quic_ucw_list_t timeout;
 	knot_quic_cid_t *conns[];
 } knot_quic_table_t;
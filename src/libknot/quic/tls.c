@@ -0,0 +1,686 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <gnutls/crypto.h>
+#include <gnutls/gnutls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <linux/tls.h>
+#endif
+
+#include "libknot/quic/tls.h"
+
+#include "contrib/macros.h"
+#include "contrib/net.h"
+#include "contrib/time.h"
+#include "libknot/attribute.h"
+#include "libknot/errcode.h"
+#include "libknot/quic/tls_common.h"
+#include "libknot/wire.h"
+
+#define TLS_PRIORITIES "NORMAL:-VERS-ALL:+VERS-TLS1.3:+VERS-TLS1.2"
+
+#if defined(__linux__) && defined(TLS_TX) && defined(TLS_1_3_VERSION)
+#define ENABLE_KTLS
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
+#define TLS_SECRET_MAX 64 /*!< Traffic secret of the longest PRF hash (SHA-512). */
+
+static const gnutls_datum_t dot_alpn = {
+	(unsigned char *)"dot", 3
+};
+
+/*! \brief DoT connection with the private handshake and key update state. */
+typedef struct {
+	knot_tls_conn_t conn;
+	struct timespec hs_begin;           /*!< Time of the first handshake step. */
+	bool hs_started;                    /*!< Handshake step already performed. */
+	uint8_t rx_secret[TLS_SECRET_MAX];  /*!< TLS 1.3 client traffic secret. */
+	uint8_t tx_secret[TLS_SECRET_MAX];  /*!< TLS 1.3 server traffic secret. */
+	size_t secret_len;                  /*!< Length of the traffic secrets. */
+} tls_conn_t;
+
+#ifdef ENABLE_KTLS
+/*! \brief Keep the traffic secrets for key updates of offloaded directions. */
+static int tls_keylog(gnutls_session_t session, const char *label,
+                      const gnutls_datum_t *secret)
+{
+	tls_conn_t *ctx = gnutls_session_get_ptr(session);
+
+	uint8_t *dst = NULL;
+	if (strcmp(label, "CLIENT_TRAFFIC_SECRET_0") == 0) {
+		dst = ctx->rx_secret;
+	} else if (strcmp(label, "SERVER_TRAFFIC_SECRET_0") == 0) {
+		dst = ctx->tx_secret;
+	}
+	if (dst != NULL && secret->size <= TLS_SECRET_MAX) {
+		memcpy(dst, secret->data, secret->size);
+		ctx->secret_len = secret->size;
+	}
+
+	return 0;
+}
+#endif // ENABLE_KTLS
+
+_public_
+knot_tls_conn_t *knot_tls_conn_new(struct knot_quic_creds *creds, int fd)
+{
+	if (creds == NULL || fd < 0) {
+		return NULL;
+	}
+
+	tls_conn_t *ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return NULL;
+	}
+	knot_tls_conn_t *conn = &ctx->conn;
+	conn->fd = fd;
+
+	if (gnutls_init(&conn->session, GNUTLS_SERVER | GNUTLS_NONBLOCK |
+	                GNUTLS_NO_SIGNAL) != GNUTLS_E_SUCCESS) {
+		free(ctx);
+		return NULL;
+	}
+	gnutls_session_set_ptr(conn->session, ctx);
+
+	if (gnutls_priority_set_direct(conn->session, TLS_PRIORITIES,
+	                               NULL) != GNUTLS_E_SUCCESS ||
+	    gnutls_credentials_set(conn->session, GNUTLS_CRD_CERTIFICATE,
+	                           creds->tls_cert) != GNUTLS_E_SUCCESS ||
+	    gnutls_session_ticket_enable_server(conn->session,
+	                                        &creds->tls_ticket_key) != GNUTLS_E_SUCCESS ||
+	    gnutls_alpn_set_protocols(conn->session, &dot_alpn, 1, 0) != GNUTLS_E_SUCCESS) {
+		knot_tls_conn_del(conn);
+		return NULL;
+	}
+
+	gnutls_transport_set_int(conn->session, fd);
+#ifdef ENABLE_KTLS
+	gnutls_session_set_keylog_function(conn->session, tls_keylog);
+#endif
+
+	return conn;
+}
+
+_public_
+void knot_tls_conn_del(knot_tls_conn_t *conn)
+{
+	if (conn == NULL) {
+		return;
+	}
+
+	tls_conn_t *ctx = (tls_conn_t *)conn;
+	gnutls_deinit(conn->session);
+	gnutls_memset(ctx->rx_secret, 0, sizeof(ctx->rx_secret));
+	gnutls_memset(ctx->tx_secret, 0, sizeof(ctx->tx_secret));
+	free(ctx);
+}
+
+/*! \brief Remaining time of the operation, -1 if unlimited, 0 if expired. */
+static int tls_remain(const struct timespec *begin, int timeout_ms)
+{
+	if (timeout_ms < 0) {
+		return -1;
+	}
+
+	struct timespec now = time_now();
+	int remain_ms = timeout_ms - time_diff_ms(begin, &now);
+	return MAX(remain_ms, 0);
+}
+
+/*! \brief Wait until the interrupted operation can continue. */
+static int tls_wait_events(knot_tls_conn_t *conn, short events,
+                           const struct timespec *begin, int timeout_ms)
+{
+	int remain_ms = tls_remain(begin, timeout_ms);
+	if (remain_ms == 0) {
+		return KNOT_ETIMEOUT;
+	}
+
+	struct pollfd pfd = {
+		.fd = conn->fd,
+		.events = events
+	};
+
+	int ret = poll(&pfd, 1, remain_ms);
+	if (ret == 0) {
+		return KNOT_ETIMEOUT;
+	} else if (ret < 0 && errno != EINTR) {
+		return knot_map_errno();
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Wait until the interrupted GnuTLS operation can continue. */
+static int tls_wait(knot_tls_conn_t *conn, const struct timespec *begin,
+                    int timeout_ms)
+{
+	short events = gnutls_record_get_direction(conn->session) ? POLLOUT : POLLIN;
+	return tls_wait_events(conn, events, begin, timeout_ms);
+}
+
+_public_
+int knot_tls_handshake(knot_tls_conn_t *conn, int timeout_ms)
+{
+	if (conn == NULL) {
+		return KNOT_EINVAL;
+	} else if (conn->handshake_done) {
+		return KNOT_EOK;
+	}
+
+	tls_conn_t *ctx = (tls_conn_t *)conn;
+	if (!ctx->hs_started) {
+		ctx->hs_begin = time_now();
+		ctx->hs_started = true;
+	}
+
+	int ret;
+	while ((ret = gnutls_handshake(conn->session)) != GNUTLS_E_SUCCESS) {
+		if (gnutls_error_is_fatal(ret) != 0) {
+			return KNOT_ECONN;
+		} else if (tls_remain(&ctx->hs_begin, timeout_ms) == 0) {
+			return KNOT_ETIMEOUT;
+		} else if (ret != GNUTLS_E_AGAIN) {
+			continue; // Interrupted or a warning alert.
+		}
+
+		/* Don't block the caller until the client sends more data. */
+		if (gnutls_record_get_direction(conn->session) == 0) {
+			return KNOT_EAGAIN;
+		}
+
+		/* Full socket send buffer, unlikely during the handshake. */
+		ret = tls_wait_events(conn, POLLOUT, &ctx->hs_begin, timeout_ms);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	conn->handshake_done = true;
+
+	return KNOT_EOK;
+}
+
+#ifdef ENABLE_KTLS
+#define TLS_CONTENT_ALERT      21
+#define TLS_CONTENT_HANDSHAKE  22
+#define TLS_CONTENT_DATA       23
+#define TLS_HS_KEY_UPDATE      24
+#define TLS_HS_HEADER_SIZE     4
+#define TLS_KEY_UPDATE_SIZE    (TLS_HS_HEADER_SIZE + 1)
+#define TLS13_IV_SIZE          12
+
+/*! \brief Control message with the TLS record content type. */
+typedef union {
+	struct cmsghdr cmsg;
+	uint8_t buf[CMSG_SPACE(sizeof(uint8_t))];
+} ktls_cmsg_t;
+
+#define KTLS_INFO(name, NAME) \
+	struct tls12_crypto_info_##name info = { \
+		.info.version = version, \
+		.info.cipher_type = TLS_CIPHER_##NAME \
+	}; \
+	if (key->size != TLS_CIPHER_##NAME##_KEY_SIZE) { \
+		return KNOT_ENOTSUP; \
+	} \
+	memcpy(info.key, key->data, sizeof(info.key)); \
+	memcpy(info.rec_seq, seq, sizeof(info.rec_seq));
+
+/*!
+ * \brief Pass the record crypto state of one direction to the kernel.
+ *
+ * The nonce layout follows the kernel: TLS 1.3 and ChaCha20 take the whole
+ * static IV, TLS 1.2 AES-GCM takes the implicit part as salt and the
+ * explicit part is initialized with the record sequence number.
+ */
+static int ktls_set_crypto(knot_tls_conn_t *conn, bool read, const gnutls_datum_t *key,
+                           const gnutls_datum_t *iv, const uint8_t seq[8])
+{
+	uint16_t version;
+	switch (gnutls_protocol_get_version(conn->session)) {
+	case GNUTLS_TLS1_2:
+		version = TLS_1_2_VERSION;
+		break;
+	case GNUTLS_TLS1_3:
+		version = TLS_1_3_VERSION;
+		break;
+	default:
+		return KNOT_ENOTSUP;
+	}
+	bool tls13 = (version == TLS_1_3_VERSION);
+
+	int ret;
+	int optname = read ? TLS_RX : TLS_TX;
+	switch (gnutls_cipher_get(conn->session)) {
+	case GNUTLS_CIPHER_AES_128_GCM: {
+		KTLS_INFO(aes_gcm_128, AES_GCM_128);
+		if (iv->size != sizeof(info.salt) + (tls13 ? sizeof(info.iv) : 0)) {
+			return KNOT_ENOTSUP;
+		}
+		memcpy(info.salt, iv->data, sizeof(info.salt));
+		memcpy(info.iv, tls13 ? iv->data + sizeof(info.salt) : seq, sizeof(info.iv));
+		ret = setsockopt(conn->fd, SOL_TLS, optname, &info, sizeof(info));
+		gnutls_memset(&info, 0, sizeof(info));
+		break;
+	}
+	case GNUTLS_CIPHER_AES_256_GCM: {
+		KTLS_INFO(aes_gcm_256, AES_GCM_256);
+		if (iv->size != sizeof(info.salt) + (tls13 ? sizeof(info.iv) : 0)) {
+			return KNOT_ENOTSUP;
+		}
+		memcpy(info.salt, iv->data, sizeof(info.salt));
+		memcpy(info.iv, tls13 ? iv->data + sizeof(info.salt) : seq, sizeof(info.iv));
+		ret = setsockopt(conn->fd, SOL_TLS, optname, &info, sizeof(info));
+		gnutls_memset(&info, 0, sizeof(info));
+		break;
+	}
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case GNUTLS_CIPHER_CHACHA20_POLY1305: {
+		KTLS_INFO(chacha20_poly1305, CHACHA20_POLY1305);
+		if (iv->size != sizeof(info.iv)) {
+			return KNOT_ENOTSUP;
+		}
+		memcpy(info.iv, iv->data, sizeof(info.iv));
+		ret = setsockopt(conn->fd, SOL_TLS, optname, &info, sizeof(info));
+		gnutls_memset(&info, 0, sizeof(info));
+		break;
+	}
+#endif
+	default:
+		return KNOT_ENOTSUP;
+	}
+
+	return (ret == 0) ? KNOT_EOK : knot_map_errno();
+}
+#undef KTLS_INFO
+
+/*! \brief Pass the current GnuTLS record state of one direction to the kernel. */
+static int ktls_set_state(knot_tls_conn_t *conn, bool read)
+{
+	gnutls_datum_t mac, iv, key;
+	uint8_t seq[8];
+	if (gnutls_record_get_state(conn->session, read ? 1 : 0, &mac, &iv, &key,
+	                            seq) != GNUTLS_E_SUCCESS) {
+		return KNOT_ENOTSUP;
+	}
+
+	return ktls_set_crypto(conn, read, &key, &iv, seq);
+}
+
+/*! \brief TLS 1.3 HKDF-Expand-Label with an empty context (RFC 8446, Section 7.1). */
+static int tls13_expand_label(gnutls_mac_algorithm_t mac, const uint8_t *secret,
+                              size_t secret_len, const char *label,
+                              uint8_t *out, size_t out_len)
+{
+	const char prefix[] = "tls13 ";
+	size_t label_len = sizeof(prefix) - 1 + strlen(label);
+
+	uint8_t info[2 + 1 + 255 + 1];
+	knot_wire_write_u16(info, out_len);
+	info[2] = label_len;
+	memcpy(info + 3, prefix, sizeof(prefix) - 1);
+	memcpy(info + 3 + sizeof(prefix) - 1, label, strlen(label));
+	info[3 + label_len] = 0;
+
+	gnutls_datum_t key = { (uint8_t *)secret, secret_len };
+	gnutls_datum_t inf = { info, 4 + label_len };
+	return gnutls_hkdf_expand(mac, &key, &inf, out, out_len) == GNUTLS_E_SUCCESS ?
+	       KNOT_EOK : KNOT_ERROR;
+}
+
+/*!
+ * \brief Update the traffic secret of one offloaded direction and rekey the kernel.
+ *
+ * \note Rekeying requires TLS 1.3 key update support in the kernel.
+ */
+static int ktls_key_update(knot_tls_conn_t *conn, bool read)
+{
+	tls_conn_t *ctx = (tls_conn_t *)conn;
+	uint8_t *secret = read ? ctx->rx_secret : ctx->tx_secret;
+	gnutls_mac_algorithm_t mac = (gnutls_mac_algorithm_t)gnutls_prf_hash_get(conn->session);
+	size_t key_len = gnutls_cipher_get_key_size(gnutls_cipher_get(conn->session));
+	if (ctx->secret_len == 0 || key_len == 0) {
+		return KNOT_ENOTSUP;
+	}
+
+	uint8_t key_buf[32], iv_buf[TLS13_IV_SIZE], seq[8] = { 0 };
+	if (key_len > sizeof(key_buf)) {
+		return KNOT_ENOTSUP;
+	}
+
+	int ret = tls13_expand_label(mac, secret, ctx->secret_len, "traffic upd",
+	                             secret, ctx->secret_len);
+	if (ret == KNOT_EOK) {
+		ret = tls13_expand_label(mac, secret, ctx->secret_len, "key", key_buf, key_len);
+	}
+	if (ret == KNOT_EOK) {
+		ret = tls13_expand_label(mac, secret, ctx->secret_len, "iv", iv_buf, sizeof(iv_buf));
+	}
+	if (ret == KNOT_EOK) {
+		gnutls_datum_t key = { key_buf, key_len };
+		gnutls_datum_t iv = { iv_buf, sizeof(iv_buf) };
+		ret = ktls_set_crypto(conn, read, &key, &iv, seq);
+	}
+
+	gnutls_memset(key_buf, 0, sizeof(key_buf));
+	gnutls_memset(iv_buf, 0, sizeof(iv_buf));
+
+	return ret;
+}
+
+/*! \brief Send our KeyUpdate message through the kernel and rekey the sending. */
+static int ktls_send_key_update(knot_tls_conn_t *conn, const struct timespec *begin,
+                                int timeout_ms)
+{
+	// KeyUpdate with update_not_requested.
+	uint8_t msg[TLS_KEY_UPDATE_SIZE] = { TLS_HS_KEY_UPDATE, 0, 0, 1, 0 };
+	struct iovec iov = { .iov_base = msg, .iov_len = sizeof(msg) };
+
+	ktls_cmsg_t ctrl = { 0 };
+	ctrl.cmsg.cmsg_level = SOL_TLS;
+	ctrl.cmsg.cmsg_type = TLS_SET_RECORD_TYPE;
+	ctrl.cmsg.cmsg_len = CMSG_LEN(sizeof(uint8_t));
+	*CMSG_DATA(&ctrl.cmsg) = TLS_CONTENT_HANDSHAKE;
+
+	struct msghdr mh = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = ctrl.buf,
+		.msg_controllen = sizeof(ctrl.buf)
+	};
+
+	ssize_t ret;
+	while ((ret = sendmsg(conn->fd, &mh, MSG_NOSIGNAL)) < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			return KNOT_ECONN;
+		}
+		ret = tls_wait_events(conn, POLLOUT, begin, timeout_ms);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+	if (ret != sizeof(msg)) {
+		return KNOT_ECONN;
+	}
+
+	return ktls_key_update(conn, false);
+}
+
+/*! \brief Receive from a kTLS socket, records of one content type at most. */
+static ssize_t ktls_recvmsg(knot_tls_conn_t *conn, uint8_t *buf, size_t size,
+                            uint8_t *type, const struct timespec *begin, int timeout_ms)
+{
+	while (true) {
+		struct iovec iov = { .iov_base = buf, .iov_len = size };
+		ktls_cmsg_t ctrl;
+		struct msghdr mh = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = ctrl.buf,
+			.msg_controllen = sizeof(ctrl.buf)
+		};
+
+		ssize_t ret = recvmsg(conn->fd, &mh, 0);
+		if (ret > 0) {
+			*type = TLS_CONTENT_DATA;
+			struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+			if (cmsg != NULL && cmsg->cmsg_level == SOL_TLS &&
+			    cmsg->cmsg_type == TLS_GET_RECORD_TYPE) {
+				*type = *CMSG_DATA(cmsg);
+			}
+			return ret;
+		} else if (ret == 0) {
+			return KNOT_ECONN;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			ret = tls_wait_events(conn, POLLIN, begin, timeout_ms);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		} else {
+			return KNOT_ECONN;
+		}
+	}
+}
+
+/*!
+ * \brief Process a non-data record received by the kernel.
+ *
+ * The kernel returns the record, possibly truncated to the buffer size,
+ * with its content type. The rest of the record follows on the next read.
+ */
+static int ktls_control(knot_tls_conn_t *conn, uint8_t type, const uint8_t *data,
+                        size_t len, const struct timespec *begin, int timeout_ms)
+{
+	/* An alert, typically close_notify, ends the connection. */
+	if (type != TLS_CONTENT_HANDSHAKE ||
+	    gnutls_protocol_get_version(conn->session) != GNUTLS_TLS1_3) {
+		return KNOT_ECONN;
+	}
+
+	/* The only expected post-handshake message from the client is KeyUpdate. */
+	uint8_t msg[TLS_KEY_UPDATE_SIZE];
+	if (len > sizeof(msg)) {
+		return KNOT_ECONN;
+	}
+	memcpy(msg, data, len);
+	while (len < sizeof(msg)) {
+		uint8_t next_type;
+		ssize_t ret = ktls_recvmsg(conn, msg + len, sizeof(msg) - len, &next_type,
+		                           begin, timeout_ms);
+		if (ret < 0) {
+			return ret;
+		} else if (next_type != type) {
+			return KNOT_ECONN;
+		}
+		len += ret;
+	}
+	if (msg[0] != TLS_HS_KEY_UPDATE || knot_wire_read_u16(msg + 2) != 1 ||
+	    msg[1] != 0 || msg[4] > 1) {
+		return KNOT_ECONN;
+	}
+
+	int ret = ktls_key_update(conn, true);
+	if (ret != KNOT_EOK) {
+		return KNOT_ECONN;
+	}
+
+	/* Update our sending keys if requested by the client. */
+	if (msg[4] == 1) {
+		if (conn->ktls_tx) {
+			ret = ktls_send_key_update(conn, begin, timeout_ms);
+		} else {
+			while ((ret = gnutls_session_key_update(conn->session, 0)) < 0) {
+				if (ret != GNUTLS_E_AGAIN && ret != GNUTLS_E_INTERRUPTED) {
+					return KNOT_ECONN;
+				}
+				ret = tls_wait(conn, begin, timeout_ms);
+				if (ret != KNOT_EOK) {
+					return ret;
+				}
+			}
+		}
+	}
+
+	return (ret == KNOT_EOK) ? KNOT_EOK : KNOT_ECONN;
+}
+
+static ssize_t ktls_recv(knot_tls_conn_t *conn, uint8_t *buf, size_t size,
+                         const struct timespec *begin, int timeout_ms)
+{
+	size_t done = 0;
+	while (done < size) {
+		uint8_t type;
+		ssize_t ret = ktls_recvmsg(conn, buf + done, size - done, &type,
+		                           begin, timeout_ms);
+		if (ret < 0) {
+			return ret;
+		} else if (type == TLS_CONTENT_DATA) {
+			done += ret;
+			continue;
+		}
+
+		ret = ktls_control(conn, type, buf + done, ret, begin, timeout_ms);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return done;
+}
+#endif // ENABLE_KTLS
+
+_public_
+int knot_tls_ktls_enable(knot_tls_conn_t *conn)
+{
+	if (conn == NULL || !conn->handshake_done) {
+		return KNOT_EINVAL;
+	}
+
+#ifdef ENABLE_KTLS
+	if (!conn->ktls_rx && !conn->ktls_tx &&
+	    setsockopt(conn->fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+		return KNOT_ENOTSUP;
+	}
+
+	/* Records already buffered by GnuTLS would be lost for the kernel.
+	 * Sending is offloaded only along with receiving, as GnuTLS would
+	 * react to a post-handshake message (e.g. a key update) with its own
+	 * record behind the kernel's back.
+	 */
+	if (!conn->ktls_rx && gnutls_record_check_pending(conn->session) == 0 &&
+	    ktls_set_state(conn, true) == KNOT_EOK) {
+		conn->ktls_rx = true;
+	}
+	if (conn->ktls_rx && !conn->ktls_tx && ktls_set_state(conn, false) == KNOT_EOK) {
+		conn->ktls_tx = true;
+	}
+
+	return (conn->ktls_rx && conn->ktls_tx) ? KNOT_EOK : KNOT_ENOTSUP;
+#else
+	return KNOT_ENOTSUP;
+#endif // ENABLE_KTLS
+}
+
+_public_
+bool knot_tls_pending(knot_tls_conn_t *conn)
+{
+	return conn != NULL && !conn->ktls_rx &&
+	       gnutls_record_check_pending(conn->session) > 0;
+}
+
+static ssize_t tls_recv(knot_tls_conn_t *conn, uint8_t *buf, size_t size,
+                        const struct timespec *begin, int timeout_ms)
+{
+#ifdef ENABLE_KTLS
+	/* Kernel verifies and decrypts the records. */
+	if (conn->ktls_rx) {
+		return ktls_recv(conn, buf, size, begin, timeout_ms);
+	}
+#endif // ENABLE_KTLS
+
+	size_t done = 0;
+	while (done < size) {
+		ssize_t ret = gnutls_record_recv(conn->session, buf + done, size - done);
+		if (ret > 0) {
+			done += ret;
+		} else if (ret == 0) {
+			return KNOT_ECONN;
+		} else if (ret == GNUTLS_E_AGAIN || ret == GNUTLS_E_INTERRUPTED) {
+			ret = tls_wait(conn, begin, timeout_ms);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		} else if (gnutls_error_is_fatal(ret) != 0) {
+			return KNOT_ECONN;
+		}
+	}
+
+	return done;
+}
+
+_public_
+ssize_t knot_tls_recv_dns(knot_tls_conn_t *conn, uint8_t *buf, size_t size,
+                          int timeout_ms)
+{
+	if (conn == NULL || buf == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	struct timespec begin = time_now();
+
+	uint8_t pktsize[sizeof(uint16_t)];
+	ssize_t ret = tls_recv(conn, pktsize, sizeof(pktsize), &begin, timeout_ms);
+	if (ret != sizeof(pktsize)) {
+		return ret;
+	}
+
+	size_t len = knot_wire_read_u16(pktsize);
+	if (len > size) {
+		return KNOT_ESPACE;
+	}
+
+	return tls_recv(conn, buf, len, &begin, timeout_ms);
+}
+
+_public_
+ssize_t knot_tls_send_dns(knot_tls_conn_t *conn, const uint8_t *buf, size_t size,
+                          int timeout_ms)
+{
+	if (conn == NULL || buf == NULL || size > UINT16_MAX) {
+		return KNOT_EINVAL;
+	}
+
+	/* Plain socket writes, kernel builds and encrypts the records. */
+	if (conn->ktls_tx) {
+		return net_dns_tcp_send(conn->fd, buf, size, timeout_ms, NULL);
+	}
+
+	struct timespec begin = time_now();
+
+	/* Length and message are coalesced into common records. */
+	uint8_t pktsize[sizeof(uint16_t)];
+	knot_wire_write_u16(pktsize, size);
+	gnutls_record_cork(conn->session);
+	if (gnutls_record_send(conn->session, pktsize, sizeof(pktsize)) < 0 ||
+	    gnutls_record_send(conn->session, buf, size) < 0) {
+		return KNOT_ECONN;
+	}
+
+	ssize_t ret;
+	while ((ret = gnutls_record_uncork(conn->session, 0)) < 0) {
+		if (ret == GNUTLS_E_AGAIN || ret == GNUTLS_E_INTERRUPTED) {
+			ret = tls_wait(conn, &begin, timeout_ms);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		} else {
+			return KNOT_ECONN;
+		}
+	}
+
+	return size;
+}
@@ -0,0 +1,123 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \file
+ *
+ * \brief Server-side DNS over TLS connection with optional kernel TLS offload.
+ *
+ * \addtogroup quic
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct gnutls_session_int;
+struct knot_quic_creds;
+
+/*! \brief DoT connection context. */
+typedef struct knot_tls_conn {
+	struct gnutls_session_int *session; /*!< TLS session. */
+	int fd;                             /*!< Connected TCP socket. */
+	bool handshake_done;                /*!< TLS handshake finished. */
+	bool ktls_tx;                       /*!< Outgoing records encrypted by the kernel. */
+	bool ktls_rx;                       /*!< Incoming records decrypted by the kernel. */
+} knot_tls_conn_t;
+
+/*!
+ * \brief Create a server-side DoT connection on an accepted TCP socket.
+ *
+ * \note The credentials (certificate, session ticket key) are shared with DoQ.
+ *
+ * \param creds  Server credentials from knot_quic_init_creds().
+ * \param fd     Non-blocking connected socket (not owned by the connection).
+ *
+ * \return Connection context or NULL.
+ */
+knot_tls_conn_t *knot_tls_conn_new(struct knot_quic_creds *creds, int fd);
+
+/*!
+ * \brief Free a DoT connection context (the socket isn't closed).
+ */
+void knot_tls_conn_del(knot_tls_conn_t *conn);
+
+/*!
+ * \brief Advance the TLS handshake, including possible session resumption.
+ *
+ * The handshake doesn't wait for incoming data. If more data is needed,
+ * KNOT_EAGAIN is returned and the call should be repeated once the socket
+ * is readable. The handshake state is kept in the connection.
+ *
+ * \param conn        DoT connection.
+ * \param timeout_ms  Timeout for the whole handshake, counted from the first call.
+ *
+ * \return KNOT_EOK, KNOT_EAGAIN, KNOT_ETIMEOUT, or KNOT_ECONN if the handshake failed.
+ */
+int knot_tls_handshake(knot_tls_conn_t *conn, int timeout_ms);
+
+/*!
+ * \brief Hand the symmetric crypto of an established session over to the kernel.
+ *
+ * Receiving (TLS_RX) is offloaded first and sending (TLS_TX) only along with
+ * it. A direction not offloaded is processed by GnuTLS. The connection
+ * remains usable on failure.
+ *
+ * \note With receiving offloaded, TLS 1.3 key updates from the client are
+ *       applied to the kernel state (requires kernel support for rekeying).
+ *
+ * \param conn  DoT connection after a successful handshake.
+ *
+ * \return KNOT_EOK if both directions offloaded, KNOT_ENOTSUP otherwise.
+ */
+int knot_tls_ktls_enable(knot_tls_conn_t *conn);
+
+/*!
+ * \brief Check if GnuTLS holds decrypted data not signalled by the socket.
+ */
+bool knot_tls_pending(knot_tls_conn_t *conn);
+
+/*!
+ * \brief Receive one length-prefixed DNS message.
+ *
+ * \param conn        DoT connection.
+ * \param buf         Output buffer.
+ * \param size        Buffer size.
+ * \param timeout_ms  I/O timeout.
+ *
+ * \return Size of the message or a negative KNOT_E* error code.
+ */
+ssize_t knot_tls_recv_dns(knot_tls_conn_t *conn, uint8_t *buf, size_t size,
+                          int timeout_ms);
+
+/*!
+ * \brief Send one DNS message with its length prefix.
+ *
+ * \param conn        DoT connection.
+ * \param buf         DNS message.
+ * \param size        Size of the message.
+ * \param timeout_ms  I/O timeout.
+ *
+ * \return Size of the message or a negative KNOT_E* error code.
+ */
+ssize_t knot_tls_send_dns(knot_tls_conn_t *conn, const uint8_t *buf, size_t size,
+                          int timeout_ms);
+
+/*! @} */
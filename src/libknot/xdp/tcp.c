@@ -60,6 +60,74 @@ static uint64_t hash_four_tuple(const struct sockaddr_in6 *rem, const struct soc
 	return SipHash24_End(&ctx);
 }
 
+#define SYN_COOKIE_INFO_BITS	6
+#define SYN_COOKIE_INFO_MASK	((1 << SYN_COOKIE_INFO_BITS) - 1)
+#define SYN_COOKIE_WSC_MASK	0x0f
+#define SYN_COOKIE_PERIOD_LOG	6 // Cookie validity period is 64 seconds.
+
+static const uint16_t syn_cookie_mss[] = { 536, 1220, 1440, 1460 };
+
+static uint32_t syn_cookie_period(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec >> SYN_COOKIE_PERIOD_LOG;
+}
+
+static uint32_t syn_cookie_hash(const knot_xdp_msg_t *msg, uint32_t isn,
+                                uint32_t period, uint32_t info,
+                                knot_tcp_table_t *table)
+{
+	size_t socka_data_len = sockaddr_data_len(&msg->ip_from, &msg->ip_to);
+	SIPHASH_CTX ctx;
+	SipHash24_Init(&ctx, (const SIPHASH_KEY *)(table->hash_secret));
+	SipHash24_Update(&ctx, &msg->ip_from, socka_data_len);
+	SipHash24_Update(&ctx, &msg->ip_to, socka_data_len);
+	SipHash24_Update(&ctx, &isn, sizeof(isn));
+	SipHash24_Update(&ctx, &period, sizeof(period));
+	SipHash24_Update(&ctx, &info, sizeof(info));
+	uint32_t hash = SipHash24_End(&ctx);
+	return (hash & ~SYN_COOKIE_INFO_MASK) | info;
+}
+
+/*!
+ * The cookie (our ISN) consists of a keyed hash of the four-tuple, client ISN
+ * and a coarse time, with the lowest bits encoding the client's MSS (index
+ * into syn_cookie_mss) and window scale.
+ */
+static uint32_t syn_cookie_make(const knot_xdp_msg_t *syn, knot_tcp_table_t *table)
+{
+	uint32_t mss_idx = 0;
+	for (uint32_t i = 1; i < sizeof(syn_cookie_mss) / sizeof(syn_cookie_mss[0]); i++) {
+		if (syn->mss >= syn_cookie_mss[i]) {
+			mss_idx = i;
+		}
+	}
+	uint32_t wscale = (syn->flags & KNOT_XDP_MSG_WSC) ? MIN(syn->win_scale, 14) : 0;
+	uint32_t info = (mss_idx << 4) | wscale;
+
+	return syn_cookie_hash(syn, syn->seqno, syn_cookie_period(), info, table);
+}
+
+static bool syn_cookie_check(const knot_xdp_msg_t *ack, knot_tcp_table_t *table,
+                             uint16_t *mss, uint8_t *wscale)
+{
+	uint32_t cookie = ack->ackno - 1;
+	uint32_t isn = ack->seqno - 1;
+	uint32_t info = cookie & SYN_COOKIE_INFO_MASK;
+	uint32_t period = syn_cookie_period();
+
+	// Accept cookies from the current and the previous period.
+	if (syn_cookie_hash(ack, isn, period, info, table) != cookie &&
+	    syn_cookie_hash(ack, isn, period - 1, info, table) != cookie) {
+		return false;
+	}
+
+	*mss = syn_cookie_mss[info >> 4];
+	*wscale = info & SYN_COOKIE_WSC_MASK;
+	return true;
+}
+
 static list_t *tcp_table_timeout(knot_tcp_table_t *table)
 {
 	return (list_t *)&table->conns[table->size];
@@ -303,6 +371,24 @@ int knot_tcp_recv(knot_tcp_relay_t *relays, knot_xdp_msg_t msgs[], uint32_t msg_
 		knot_tcp_conn_t **pconn = tcp_table_lookup(&msg->ip_from, &msg->ip_to,
 		                                           &conn_hash, tcp_table);
 		knot_tcp_conn_t *conn = *pconn;
+
+		// ACK completing a handshake answered with a SYN cookie
+		uint16_t cookie_mss;
+		uint8_t cookie_wscale;
+		if (conn == NULL && tcp_table->syn_cookies &&
+		    (msg->flags & (KNOT_XDP_MSG_SYN | KNOT_XDP_MSG_ACK |
+		                   KNOT_XDP_MSG_FIN | KNOT_XDP_MSG_RST)) == KNOT_XDP_MSG_ACK &&
+		    syn_cookie_check(msg, tcp_table, &cookie_mss, &cookie_wscale)) {
+			ret = tcp_table_add(msg, conn_hash, tcp_table, &conn);
+			if (ret != KNOT_EOK) {
+				break;
+			}
+			conn->mss = cookie_mss;
+			conn->window_scale = cookie_wscale;
+			conn->last_active = 0; // RTT of the handshake is unknown
+			relay->action = XDP_TCP_ESTABLISH;
+		}
+
 		bool seq_ack_match = check_seq_ack(msg, conn);
 		if (seq_ack_match) {
 			assert(conn->mss != 0);
@@ -344,6 +430,15 @@ int knot_tcp_recv(knot_tcp_relay_t *relays, knot_xdp_msg_t msgs[], uint32_t msg_
 			if (conn == NULL) {
 				bool synack = (msg->flags & KNOT_XDP_MSG_ACK);
 
+				if (tcp_table->syn_cookies && !synack) {
+					relay->action = XDP_TCP_SYN;
+					if (!(ignore & XDP_TCP_IGNORE_ESTABLISH)) {
+						relay->auto_answer = KNOT_XDP_MSG_SYN | KNOT_XDP_MSG_ACK;
+						relay->auto_seqno = syn_cookie_make(msg, tcp_table);
+					}
+					break;
+				}
+
 				knot_tcp_table_t *add_table = tcp_table;
 				if (syn_table != NULL && !synack) {
 					add_table = syn_table;
@@ -501,6 +596,25 @@ static void msg_init_from_conn(knot_xdp_msg_t *msg, knot_tcp_conn_t *conn)
 	msg->win = 0xffff;
 }
 
+static void msg_init_from_syn(knot_xdp_msg_t *msg, const knot_xdp_msg_t *syn,
+                              uint32_t cookie)
+{
+	memcpy( msg->eth_from, syn->eth_to,   sizeof(msg->eth_from));
+	memcpy( msg->eth_to,   syn->eth_from, sizeof(msg->eth_to));
+	memcpy(&msg->ip_from, &syn->ip_to,    sizeof(msg->ip_from));
+	memcpy(&msg->ip_to,   &syn->ip_from,  sizeof(msg->ip_to));
+
+	msg->vlan_tci = syn->vlan_tci;
+
+	msg->ackno = syn->seqno + 1;
+	msg->seqno = cookie;
+
+	msg->payload.iov_len = 0;
+
+	msg->win_scale = 14; // maximum possible
+	msg->win = 0xffff;
+}
+
 static int next_msg(knot_xdp_msg_t *msgs, uint32_t n_msgs, knot_xdp_msg_t **cur,
                     knot_xdp_socket_t *socket, knot_tcp_relay_t *rl)
 {
@@ -517,11 +631,16 @@ static int next_msg(knot_xdp_msg_t *msgs, uint32_t n_msgs, knot_xdp_msg_t **cur,
 	knot_xdp_msg_t *msg = *cur;
 
 	knot_xdp_msg_flag_t fl = KNOT_XDP_MSG_TCP;
-	if (rl->conn->ip_loc.sin6_family == AF_INET6) {
-		fl |= KNOT_XDP_MSG_IPV6;
-	}
-	if (rl->conn->state == XDP_TCP_ESTABLISHING) {
-		fl |= KNOT_XDP_MSG_MSS | KNOT_XDP_MSG_WSC;
+	if (rl->conn == NULL) { // stateless SYN-ACK with a SYN cookie
+		fl |= (rl->msg->flags & KNOT_XDP_MSG_IPV6) |
+		      KNOT_XDP_MSG_MSS | KNOT_XDP_MSG_WSC;
+	} else {
+		if (rl->conn->ip_loc.sin6_family == AF_INET6) {
+			fl |= KNOT_XDP_MSG_IPV6;
+		}
+		if (rl->conn->state == XDP_TCP_ESTABLISHING) {
+			fl |= KNOT_XDP_MSG_MSS | KNOT_XDP_MSG_WSC;
+		}
 	}
 
 	int ret = knot_xdp_send_alloc(socket, fl, msg);
@@ -529,7 +648,11 @@ static int next_msg(knot_xdp_msg_t *msgs, uint32_t n_msgs, knot_xdp_msg_t **cur,
 		return ret;
 	}
 
-	msg_init_from_conn(msg, rl->conn);
+	if (rl->conn == NULL) {
+		msg_init_from_syn(msg, rl->msg, rl->auto_seqno);
+	} else {
+		msg_init_from_conn(msg, rl->conn);
+	}
 
 	return ret;
 }
@@ -558,7 +681,8 @@ int knot_tcp_send(knot_xdp_socket_t *socket, knot_tcp_relay_t relays[],
 		if (rl->auto_answer != 0) {
 			NEXT_MSG
 			msg->flags |= rl->auto_answer;
-			if (msg->flags & (KNOT_XDP_MSG_SYN | KNOT_XDP_MSG_FIN)) {
+			if ((msg->flags & (KNOT_XDP_MSG_SYN | KNOT_XDP_MSG_FIN)) &&
+			    rl->conn != NULL) {
 				rl->conn->ackno++;
 			}
 			if (rl->auto_answer == KNOT_XDP_MSG_RST) {
@@ -90,6 +90,7 @@ typedef struct {
 	size_t inbufs_total;
 	size_t outbufs_total;
 	uint64_t hash_secret[2];
+	bool syn_cookies; // answer SYNs statelessly, create connections on valid ACK
 	knot_tcp_conn_t *next_close;
 	knot_tcp_conn_t *next_ibuf;
 	knot_tcp_conn_t *next_obuf;
@@ -158,6 +159,12 @@ void knot_tcp_table_free(knot_tcp_table_t *table);
  * \param syn_table   Optional: extra table for handling partially established connections.
  * \param ignore      Ignore specific TCP packets indication.
  *
+ * \note If tcp_table->syn_cookies is set, incoming SYNs are answered with
+ *       a SYN-ACK carrying a SYN cookie and no state is kept (syn_table is not
+ *       used for them). The connection is created upon a matching ACK.
+ *       Such SYN relays have no connection and refer to the received message
+ *       (only its addresses and header fields, not the payload) in knot_tcp_send().
+ *
  * \return KNOT_E*
  */
 int knot_tcp_recv(knot_tcp_relay_t *relays, knot_xdp_msg_t msgs[], uint32_t msg_count,
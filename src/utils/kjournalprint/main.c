@@ -231,10 +231,17 @@ int print_journal(char *path, knot_dname_t *name, print_params_t *params)
 		}
 	}
 
+	uint64_t stored, raw;
+	if (params->debug && ret == KNOT_EOK) {
+		ret = journal_chunk_sizes(j, &stored, &raw);
+	}
 	if (params->debug && ret == KNOT_EOK) {
 		printf("Total number of changesets:  %zu\n", params->changes);
 		printf("Occupied this zone (approx): %"PRIu64" KiB\n", occupied / 1024);
 		printf("Occupied all zones together: %"PRIu64" KiB\n", occupied_all / 1024);
+		printf("Changesets stored size:      %"PRIu64" KiB\n", stored / 1024);
+		printf("Changesets uncompressed:     %"PRIu64" KiB\n", raw / 1024);
+		printf("Compression ratio:           %.2f\n", stored > 0 ? (double)raw / stored : 1.0);
 	}
 
 	knot_lmdb_deinit(&jdb);
@@ -260,14 +267,18 @@ static int list_zone(const knot_dname_t *zone, bool detailed, knot_lmdb_db_t *jd
 	if (detailed) {
 		zone_journal_t j = { jdb, zone };
 		bool exists;
-		uint64_t occupied;
+		uint64_t occupied, stored, raw;
 
 		int ret = journal_info(j, &exists, NULL, NULL, NULL, NULL, NULL, &occupied, occupied_all);
+		if (ret == KNOT_EOK) {
+			ret = journal_chunk_sizes(j, &stored, &raw);
+		}
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
 		assert(exists);
-		printf("%s \t%"PRIu64" KiB\n", zone_str, occupied / 1024);
+		printf("%s \t%"PRIu64" KiB \tcompression ratio %.2f\n", zone_str,
+		       occupied / 1024, stored > 0 ? (double)raw / stored : 1.0);
 	} else {
 		printf("%s\n", zone_str);
 	}
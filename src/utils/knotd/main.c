@@ -33,6 +33,7 @@
 #include "libdnssec/crypto.h"
 #include "libknot/libknot.h"
 #include "contrib/strtonum.h"
+#include "knot/ctl/commands.h"
 #include "knot/ctl/process.h"
 #include "knot/conf/conf.h"
 #include "knot/conf/migration.h"
@@ -119,7 +120,7 @@ static const struct signal SIGNALS[] = {
 	{ SIGUSR1, true  },  /* Reload zones. */
 	{ SIGINT,  true  },  /* Terminate server. */
 	{ SIGTERM, true  },  /* Terminate server. */
-	{ SIGALRM, false },  /* Internal thread synchronization. */
+	{ SIGALRM, true  },  /* Internal thread synchronization. */
 	{ SIGPIPE, false },  /* Ignored. Some I/O errors. */
 	{ 0 }
 };
@@ -246,6 +247,16 @@ static void event_loop(server_t *server, const char *socket)
 	}
 	free(listen);
 
+	/* Start processing of control sessions (before unblocking the signals). */
+	ctl_pool_t *pool = ctl_pool_create(server, CTL_THREADS);
+	if (pool == NULL) {
+		knot_ctl_unbind(ctl);
+		knot_ctl_free(ctl);
+		log_fatal("control, failed to initialize (%s)",
+		          knot_strerror(KNOT_ENOMEM));
+		return;
+	}
+
 	enable_signals();
 
 	/* Notify systemd about successful start. */
@@ -256,25 +267,43 @@ static void event_loop(server_t *server, const char *socket)
 
 	/* Run event loop. */
 	for (;;) {
-		/* Interrupts. */
+		/* Interrupts, postponed if control commands are running. */
+		bool postponed = false;
 		if (sig_req_reload && !sig_req_stop) {
-			sig_req_reload = false;
-			server_reload(server, RELOAD_FULL);
+			if (ctl_lock(server, CTL_LOCK_EXCLUSIVE, CTL_LOCK_WAIT_MS) == KNOT_EOK) {
+				sig_req_reload = false;
+				server_reload(server, RELOAD_FULL);
+				ctl_unlock(server);
+			} else {
+				postponed = true;
+			}
 		}
-		if (sig_req_zones_reload && !sig_req_stop) {
-			sig_req_zones_reload = false;
-			reload_t mode = server->catalog_upd_signal ? RELOAD_CATALOG : RELOAD_ZONES;
-			server->catalog_upd_signal = false;
-			server_update_zones(conf(), server, mode);
+		if (sig_req_zones_reload && !sig_req_stop && !postponed) {
+			if (ctl_lock(server, CTL_LOCK_EXCLUSIVE, CTL_LOCK_WAIT_MS) == KNOT_EOK) {
+				sig_req_zones_reload = false;
+				reload_t mode = server->catalog_upd_signal ? RELOAD_CATALOG : RELOAD_ZONES;
+				server->catalog_upd_signal = false;
+				server_update_zones(conf(), server, mode);
+				ctl_unlock(server);
+			} else {
+				postponed = true;
+			}
 		}
 		if (sig_req_stop) {
 			break;
 		}
 
+		/* Exclusive control commands from the sessions. */
+		ret = ctl_pool_exec(pool);
+		if (ret == KNOT_CTL_ESTOP) {
+			break;
+		}
+
 		// Update control timeout.
 		knot_ctl_set_timeout(ctl, conf()->cache.ctl_timeout);
 
-		if (sig_req_reload || sig_req_zones_reload) {
+		/* Keep accepting if a reload is postponed, it is retried afterwards. */
+		if ((sig_req_reload || sig_req_zones_reload) && !postponed) {
 			continue;
 		}
 
@@ -283,13 +312,16 @@ static void event_loop(server_t *server, const char *socket)
 			continue;
 		}
 
-		ret = ctl_process(ctl, server);
-		knot_ctl_close(ctl);
-		if (ret == KNOT_CTL_ESTOP) {
-			break;
+		ret = ctl_pool_assign(pool, ctl);
+		if (ret != KNOT_EOK) {
+			log_ctl_debug("control, connection not processed (%s)",
+			              knot_strerror(ret));
 		}
 	}
 
+	/* Finish the running sessions. */
+	ctl_pool_destroy(pool);
+
 	if (conf()->cache.srv_dbus_event & DBUS_EVENT_RUNNING) {
 		systemd_emit_running(false);
 	}
@@ -23,6 +23,8 @@
 #include "libknot/libknot.h"
 #include "knot/common/log.h"
 #include "knot/zone/semantic-check.h"
+#include "knot/zone/snapshot.h"
+#include "knot/zone/zonefile.h"
 #include "utils/common/msg.h"
 #include "utils/common/params.h"
 #include "utils/kzonecheck/zone_check.h"
@@ -38,10 +40,12 @@ static void print_help(void)
 	       "\n"
 	       "Parameters:\n"
 	       " -o, --origin <zone_origin>  Zone name.\n"
-	       "                              (default filename without .zone)\n"
+	       "                              (default filename without .snap and .zone)\n"
 	       " -d, --dnssec <on|off>       Also check DNSSEC-related records.\n"
 	       " -t, --time <timestamp>      Current time specification.\n"
 	       "                              (default current UNIX time)\n"
+	       " -w, --write <filename>      Write the zone as a snapshot (or as a zone file\n"
+	       "                              if the input is a snapshot).\n"
 	       " -v, --verbose               Enable debug output.\n"
 	       " -h, --help                  Print the program help.\n"
 	       " -V, --version               Print the program version.\n"
@@ -63,9 +67,37 @@ static bool str2bool(const char *s)
 	}
 }
 
+static void strip_ext(char *name, const char *ext)
+{
+	size_t len = strlen(name), ext_len = strlen(ext);
+	if (len > ext_len && strcmp(name + len - ext_len, ext) == 0) {
+		name[len - ext_len] = '\0';
+	}
+}
+
+/*!
+ * \brief Writes the checked zone in the other format than the input one.
+ */
+static int write_zone(const char *input, const char *output, zone_contents_t *contents)
+{
+	if (zone_snapshot_detect(input)) {
+		return zonefile_write(output, contents);
+	}
+
+	/* Bind the snapshot to the input zone file if possible. The zone has
+	   passed the checks, mark it as loaded with the default configuration. */
+	uint64_t params = zone_snapshot_params(SEMCHECK_MANDATORY_ONLY, false, true);
+	struct stat st;
+	if (stat(input, &st) != 0) {
+		return zone_snapshot_write(output, contents, NULL, params);
+	}
+	return zone_snapshot_write(output, contents, &st, params);
+}
+
 int main(int argc, char *argv[])
 {
 	const char *origin = NULL;
+	const char *output = NULL;
 	bool verbose = false;
 	semcheck_optional_t optional = SEMCHECK_DNSSEC_AUTO; // default value for --dnssec
 	knot_time_t check_time = (knot_time_t)time(NULL);
@@ -75,6 +107,7 @@ int main(int argc, char *argv[])
 		{ "origin",  required_argument, NULL, 'o' },
 		{ "time",    required_argument, NULL, 't' },
 		{ "dnssec",  required_argument, NULL, 'd' },
+		{ "write",   required_argument, NULL, 'w' },
 		{ "verbose", no_argument,       NULL, 'v' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "version", no_argument,       NULL, 'V' },
@@ -86,11 +119,14 @@ int main(int argc, char *argv[])
 
 	/* Parse command line arguments */
 	int opt = 0;
-	while ((opt = getopt_long(argc, argv, "o:t:d:vVh", opts, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "o:t:d:w:vVh", opts, NULL)) != -1) {
 		switch (opt) {
 		case 'o':
 			origin = optarg;
 			break;
+		case 'w':
+			output = optarg;
+			break;
 		case 'v':
 			verbose = true;
 			break;
@@ -131,13 +167,9 @@ int main(int argc, char *argv[])
 	char *zonename;
 	if (origin == NULL) {
 		/* Get zone name from file name. */
-		const char *ext = ".zone";
-		zonename = basename(filename);
-		if (strcmp(zonename + strlen(zonename) - strlen(ext), ext) == 0) {
-			zonename = strndup(zonename, strlen(zonename) - strlen(ext));
-		} else {
-			zonename = strdup(zonename);
-		}
+		zonename = strdup(basename(filename));
+		strip_ext(zonename, ".snap");
+		strip_ext(zonename, ".zone");
 	} else {
 		zonename = strdup(origin);
 	}
@@ -154,9 +186,22 @@ int main(int argc, char *argv[])
 	knot_dname_t *dname = knot_dname_from_str_alloc(zonename);
 	knot_dname_to_lower(dname);
 	free(zonename);
-	int ret = zone_check(filename, dname, optional, (time_t)check_time);
+	zone_contents_t *contents = NULL;
+	int ret = zone_check(filename, dname, optional, (time_t)check_time,
+	                     (output != NULL) ? &contents : NULL);
 	knot_dname_free(dname, NULL);
 
+	if (contents != NULL && ret != KNOT_EZONEINVAL) {
+		int write_ret = write_zone(filename, output, contents);
+		if (write_ret != KNOT_EOK) {
+			ERR2("failed to write '%s' (%s)", output, knot_strerror(write_ret));
+			zone_contents_deep_free(contents);
+			log_close();
+			return EXIT_FAILURE;
+		}
+	}
+	zone_contents_deep_free(contents);
+
 	log_close();
 
 	switch (ret) {
@@ -19,7 +19,9 @@
 
 #include "utils/kzonecheck/zone_check.h"
 
+#include "knot/zone/adjust.h"
 #include "knot/zone/contents.h"
+#include "knot/zone/snapshot.h"
 #include "knot/zone/zonefile.h"
 #include "utils/common/msg.h"
 
@@ -61,27 +63,68 @@ static void print_statistics(err_handler_stats_t *stats)
 	}
 }
 
+static int load_snapshot(const char *path, const knot_dname_t *zone_name,
+                         semcheck_optional_t optional, time_t time,
+                         sem_handler_t *handler, zone_contents_t **contents)
+{
+	int ret = zone_snapshot_load(path, zone_name, NULL, 0, contents);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = zone_adjust_contents(*contents, adjust_cb_flags_and_nsec3,
+	                           adjust_cb_nsec3_flags, true, true, 1, NULL);
+	if (ret == KNOT_EOK) {
+		ret = sem_checks_process(*contents, optional, handler, time);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_adjust_contents(*contents, unadjust_cb_point_to_nsec3, NULL,
+		                           false, false, 1, NULL);
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(*contents);
+		*contents = NULL;
+	}
+
+	/* Semantic errors are reported by the handler. */
+	return handler->error ? KNOT_EOK : ret;
+}
+
 int zone_check(const char *zone_file, const knot_dname_t *zone_name,
-               semcheck_optional_t optional, time_t time)
+               semcheck_optional_t optional, time_t time, zone_contents_t **out)
 {
 	err_handler_stats_t stats = {
 		.handler = { .cb = err_callback },
 	};
 
-	zloader_t zl;
-	int ret = zonefile_open(&zl, zone_file, zone_name, optional, time);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-	zl.err_handler = (sem_handler_t *)&stats;
-	zl.creator->master = true;
+	zone_contents_t *contents = NULL;
+	if (zone_snapshot_detect(zone_file)) {
+		int ret = load_snapshot(zone_file, zone_name, optional, time,
+		                        (sem_handler_t *)&stats, &contents);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	} else {
+		zloader_t zl;
+		int ret = zonefile_open(&zl, zone_file, zone_name, optional, time);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		zl.err_handler = (sem_handler_t *)&stats;
+		zl.creator->master = true;
 
-	zone_contents_t *contents = zonefile_load(&zl);
-	zonefile_close(&zl);
+		contents = zonefile_load(&zl);
+		zonefile_close(&zl);
+	}
 	if (contents == NULL && !stats.handler.error) {
 		return KNOT_ERROR;
 	}
-	zone_contents_deep_free(contents);
+
+	if (out != NULL) {
+		*out = contents;
+	} else {
+		zone_contents_deep_free(contents);
+	}
 
 	if (stats.error_count > 0) {
 		print_statistics(&stats);
@@ -16,8 +16,20 @@
 
 #pragma once
 
+#include "knot/zone/contents.h"
 #include "knot/zone/semantic-check.h"
 #include "libknot/libknot.h"
 
+/*!
+ * \brief Loads the zone file or zone snapshot and checks it.
+ *
+ * \param zone_file  Zone file or zone snapshot path.
+ * \param zone_name  Zone name.
+ * \param optional   Optional semantic checks.
+ * \param time       Time for the semantic checks.
+ * \param out        Optional output: loaded contents (if not invalid).
+ *
+ * \return KNOT_E*
+ */
 int zone_check(const char *zone_file, const knot_dname_t *zone_name,
-               semcheck_optional_t optional, time_t time);
+               semcheck_optional_t optional, time_t time, zone_contents_t **out);
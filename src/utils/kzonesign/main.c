@@ -21,6 +21,7 @@
 #include "knot/updates/zone-update.h"
 #include "knot/server/server.h"
 #include "knot/zone/adjust.h"
+#include "knot/zone/snapshot.h"
 #include "knot/zone/zone-load.h"
 #include "knot/zone/zonefile.h"
 #include "utils/common/msg.h"
@@ -59,6 +60,24 @@ typedef struct {
 	bool verify;
 } sign_params_t;
 
+static void write_snapshot(const char *zonefile, const zone_contents_t *contents)
+{
+	struct stat st;
+	int ret = (stat(zonefile, &st) == 0) ? KNOT_EOK : knot_map_errno();
+	if (ret == KNOT_EOK) {
+		// The snapshot is for the server, loading the signed zone file.
+		const knot_dname_t *zone = contents->apex->owner;
+		uint64_t params = zone_load_snapshot_params(conf(), zone,
+		                  zone_load_semcheck_mode(conf(), zone), false);
+		char *snapshot = zone_snapshot_path(zonefile);
+		ret = zone_snapshot_write(snapshot, contents, &st, params);
+		free(snapshot);
+	}
+	if (ret != KNOT_EOK) {
+		WARN2("failed to update zone snapshot (%s)", knot_strerror(ret));
+	}
+}
+
 static int zonesign(sign_params_t *params)
 {
 	char *zonefile = NULL;
@@ -146,6 +165,9 @@ static int zonesign(sign_params_t *params)
 	if (params->outdir == NULL) {
 		zonefile = conf_zonefile(conf(), params->zone_name);
 		ret = zonefile_write(zonefile, up.new_cont);
+		if (ret == KNOT_EOK && zone_snapshot_enabled(conf(), params->zone_name)) {
+			write_snapshot(zonefile, up.new_cont);
+		}
 	} else {
 		zone_contents_t *temp = zone_struct->contents;
 		zone_struct->contents = up.new_cont;
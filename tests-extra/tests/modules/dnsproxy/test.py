@@ -133,6 +133,40 @@ fallback_checks(local, zone_local[0], zone_remote[0], nxdomain=True)
 resp = local.dig("remote.test", "A")
 resp.check(rcode="NOERROR", flags="AA", rdata="1.1.1.2")
 
+### Asynchronous, fallback, nxdomain
+
+local.clear_modules(None)
+local.add_module(None, ModDnsproxy(remote.addr, remote.port, fallback=True, nxdomain=True,
+                                   asynchronous=True))
+local.gen_confile()
+local.reload()
+
+fallback_checks(local, zone_local[0], zone_remote[0], nxdomain=True)
+
+# Local NOK, but forwarded OK.
+resp = local.dig("remote.test", "A", udp=True)
+resp.check(rcode="NOERROR", flags="AA", rdata="1.1.1.2")
+
+### Asynchronous, no fallback
+
+local.clear_modules(None)
+local.add_module(None, ModDnsproxy(remote.addr, remote.port, fallback=False,
+                                   asynchronous=True))
+local.gen_confile()
+local.reload()
+
+# Remote OK, try with remote TSIG.
+resp = local.dig("dns1.test", "A", udp=True, tsig=True)
+resp.check(rcode="NOERROR", flags="AA", rdata="192.0.2.2", nordata="192.0.2.1")
+
+# Remote NOK, not existing owner.
+resp = local.dig("u-n-k-n-o-w-n." + zone_remote[0].name, "A", udp=True)
+resp.check(rcode="NXDOMAIN", flags="AA")
+
+# Remote XFR OK, forwarded synchronously.
+resp = local.dig("test", "AXFR", tsig=True)
+resp.check_xfr(rcode="NOERROR")
+
 ### Per zone, fallback
 
 local.clear_modules(None)
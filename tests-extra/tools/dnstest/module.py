@@ -146,12 +146,13 @@ class ModDnsproxy(KnotModule):
 
     mod_name = "dnsproxy"
 
-    def __init__(self, addr, port=53, nxdomain=False, fallback=True):
+    def __init__(self, addr, port=53, nxdomain=False, fallback=True, asynchronous=False):
         super().__init__()
         self.addr = addr
         self.port = port
         self.fallback = fallback
         self.nxdomain = nxdomain
+        self.asynchronous = asynchronous
 
     def get_conf(self, conf=None):
         if not conf:
@@ -167,6 +168,7 @@ class ModDnsproxy(KnotModule):
         conf.item_str("remote", "%s_%s" % (self.conf_name, self.conf_id))
         conf.item_str("fallback", "on" if self.fallback else "off")
         conf.item_str("catch-nxdomain", "on" if self.nxdomain else "off")
+        conf.item_str("async", "on" if self.asynchronous else "off")
         conf.end()
 
         return conf
@@ -178,6 +178,105 @@ static void test_wildcards(void)
 	ok(true, "trie: wildcard searches");
 }
 
+/* Check longest prefix result against the lookups of all prefix lengths. */
+static bool str_key_get_lpm(trie_t *trie, const char *key)
+{
+	uint8_t key_buf[2 * KEY_MAXLEN];
+
+	/* The key itself (incl. the terminator) followed by a random tail. */
+	size_t key_len = strlen(key) + 1;
+	size_t tail_len = rand() % KEY_MAXLEN;
+	memcpy(key_buf, key, key_len);
+	for (size_t i = 0; i < tail_len; ++i) {
+		key_buf[key_len + i] = alphabet[rand() % strlen(alphabet)];
+	}
+
+	for (size_t len = key_len + tail_len; len > 0; --len) {
+		trie_val_t *lpm = trie_get_lpm(trie, key_buf, len);
+		trie_val_t *exp = NULL;
+		for (size_t i = len; i > 0 && exp == NULL; --i) {
+			exp = trie_get_try(trie, key_buf, i);
+		}
+		if (lpm != exp) {
+			diag("%s: lpm for key '%s' len %zu", __func__, key, len);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void test_lpm(void)
+{
+	/* Test zones. */
+	const char *names[] = {
+		"example.cz",
+		"sub.example.cz",
+		"a.b.c.sub.example.cz",
+		"example.com",
+		"ex.com",
+	};
+	/* Query-answer pairs for longest prefix search. */
+	const char *qa_pairs[][2] = {
+		{ ".", NULL },
+		{ "cz", NULL },
+		{ "example.cz", "example.cz" },
+		{ "www.example.cz", "example.cz" },
+		{ "sub.example.cz", "sub.example.cz" },
+		{ "subb.example.cz", "example.cz" },
+		{ "su.example.cz", "example.cz" },
+		{ "b.c.sub.example.cz", "sub.example.cz" },
+		{ "x.a.b.c.sub.example.cz", "a.b.c.sub.example.cz" },
+		{ "xexample.cz", NULL },
+		{ "www.example.com", "example.com" },
+		{ "e.com", NULL },
+		{ "x.ex.com", "ex.com" },
+	};
+
+	trie_t *trie = trie_create(NULL);
+	if (!trie) ok(false, "trie: create");
+
+	for (int i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+		knot_dname_storage_t dname_st, lf_st;
+		const knot_dname_t
+			*dname = knot_dname_from_str(dname_st, names[i], sizeof(dname_st)),
+			*lf = knot_dname_lf(dname, lf_st);
+		if (!dname || !lf) {
+			ok(false, "trie: converting '%s'", names[i]);
+			return;
+		}
+		*trie_get_ins(trie, lf + 1, lf[0]) = (void *)names[i];
+	}
+
+	bool passed = true;
+	for (int round = 0; round < 2 && passed; ++round) {
+		for (int i = 0; i < sizeof(qa_pairs) / sizeof(qa_pairs[0]); ++i) {
+			knot_dname_storage_t q_dname_st, q_lf_st;
+			const knot_dname_t *q_dname =
+				knot_dname_from_str(q_dname_st, qa_pairs[i][0], sizeof(q_dname_st));
+			const knot_dname_t *q_lf = knot_dname_lf(q_dname, q_lf_st);
+
+			const char **ans = (const char **)trie_get_lpm(trie, q_lf + 1, q_lf[0]);
+			const char *exp = qa_pairs[i][1];
+			if (round == 1 && exp == NULL) {
+				exp = ".";
+			}
+			if (!!ans != !!exp || (ans && strcmp(*ans, exp) != 0)) {
+				diag("trie: lpm test for '%s' -> '%s'",
+				     qa_pairs[i][0], ans ? *ans : "<null>");
+				passed = false;
+				break;
+			}
+		}
+
+		/* The root name is a prefix of everything. */
+		*trie_get_ins(trie, (const trie_key_t *)"", 0) = ".";
+	}
+	ok(passed, "trie: longest prefix searches");
+
+	trie_free(trie);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -250,6 +349,13 @@ int main(int argc, char *argv[])
 	}
 	ok(passed, "trie: find lesser or equal for all keys");
 
+	/* Longest prefix lookup. */
+	passed = true;
+	for (unsigned i = 0; i < key_count && passed; i += 10) {
+		passed = str_key_get_lpm(trie, keys[i]);
+	}
+	ok(passed, "trie: find longest prefix");
+
 	/* Sorted iteration. */
 	char key_buf[KEY_MAXLEN] = {'\0'};
 	size_t iterated = 0;
@@ -280,5 +386,8 @@ int main(int argc, char *argv[])
 	/* Test trie_get_try_wildcard(). */
 	test_wildcards();
 
+	/* Test trie_get_lpm(). */
+	test_lpm();
+
 	return 0;
 }
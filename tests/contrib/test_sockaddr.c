@@ -52,6 +52,56 @@ static void check_sockaddr_set(struct sockaddr_storage *ss, int family,
 	is_int(KNOT_EOK, ret, "set address '%s'", straddr);
 }
 
+static void test_cmp(void)
+{
+	struct sockaddr_storage a = { 0 };
+	struct sockaddr_storage b = { 0 };
+
+	// Equality, as used for interface, remote and connection lookups.
+
+	check_sockaddr_set(&a, AF_INET, "192.0.2.1", 53);
+	check_sockaddr_set(&b, AF_INET, "192.0.2.1", 53);
+	ok(sockaddr_cmp(&a, &b, false) == 0, "cmp: ipv4 equal");
+	sockaddr_port_set(&b, 853);
+	ok(sockaddr_cmp(&a, &b, false) != 0, "cmp: ipv4 port differs");
+	ok(sockaddr_cmp(&a, &b, true) == 0, "cmp: ipv4 port ignored");
+
+	check_sockaddr_set(&a, AF_INET6, "2001:db8::1", 53);
+	check_sockaddr_set(&b, AF_INET6, "2001:db8::1", 853);
+	ok(sockaddr_cmp(&a, &b, false) != 0, "cmp: ipv6 port differs");
+	ok(sockaddr_cmp(&a, &b, true) == 0, "cmp: ipv6 port ignored");
+
+	check_sockaddr_set(&a, AF_INET, "192.0.2.1", 53);
+	check_sockaddr_set(&b, AF_INET6, "::ffff:192.0.2.1", 53);
+	ok(sockaddr_cmp(&a, &b, true) != 0, "cmp: family differs");
+
+	check_sockaddr_set(&a, AF_UNIX, "/tmp/knot.sock", 0);
+	check_sockaddr_set(&b, AF_UNIX, "/tmp/knot.sock", 0);
+	ok(sockaddr_cmp(&a, &b, false) == 0, "cmp: UNIX equal");
+	check_sockaddr_set(&b, AF_UNIX, "/tmp/knot.sock2", 0);
+	ok(sockaddr_cmp(&a, &b, false) < 0, "cmp: UNIX shorter");
+
+	// Ordering, as used for address ranges.
+
+	check_sockaddr_set(&a, AF_INET, "10.0.0.255", 0);
+	check_sockaddr_set(&b, AF_INET, "10.0.1.0", 0);
+	ok(sockaddr_cmp(&a, &b, true) < 0, "cmp: ipv4 last byte overflow");
+	ok(sockaddr_cmp(&b, &a, true) > 0, "cmp: ipv4 last byte overflow, reversed");
+	check_sockaddr_set(&a, AF_INET, "9.255.255.255", 0);
+	check_sockaddr_set(&b, AF_INET, "10.0.0.0", 0);
+	ok(sockaddr_cmp(&a, &b, true) < 0, "cmp: ipv4 first byte");
+
+	check_sockaddr_set(&a, AF_INET, "10.0.0.1", 53);
+	check_sockaddr_set(&b, AF_INET, "10.0.0.1", 54);
+	ok(sockaddr_cmp(&a, &b, false) < 0, "cmp: ipv4 port order");
+	check_sockaddr_set(&b, AF_INET, "10.0.0.0", 54);
+	ok(sockaddr_cmp(&a, &b, false) > 0, "cmp: ipv4 address before port");
+
+	check_sockaddr_set(&a, AF_INET6, "2001:db8::ff", 0);
+	check_sockaddr_set(&b, AF_INET6, "2001:db8::100", 0);
+	ok(sockaddr_cmp(&a, &b, true) < 0, "cmp: ipv6 byte overflow");
+}
+
 static void test_net_match(void)
 {
 	int ret;
@@ -193,6 +243,25 @@ static void test_range_match(void)
 	ret = sockaddr_range_match(&t, &min, &max);
 	ok(ret == false, "match: ipv4 middle range - negative far max");
 
+	check_sockaddr_set(&min, AF_INET, "10.0.0.250", 0);
+	check_sockaddr_set(&max, AF_INET, "10.0.1.5", 0);
+
+	check_sockaddr_set(&t, AF_INET, "10.0.0.249", 0);
+	ret = sockaddr_range_match(&t, &min, &max);
+	ok(ret == false, "match: ipv4 byte overflow range - negative min");
+	check_sockaddr_set(&t, AF_INET, "10.0.0.255", 0);
+	ret = sockaddr_range_match(&t, &min, &max);
+	ok(ret == true, "match: ipv4 byte overflow range - lower part");
+	check_sockaddr_set(&t, AF_INET, "10.0.1.0", 0);
+	ret = sockaddr_range_match(&t, &min, &max);
+	ok(ret == true, "match: ipv4 byte overflow range - upper part");
+	check_sockaddr_set(&t, AF_INET, "10.0.1.6", 0);
+	ret = sockaddr_range_match(&t, &min, &max);
+	ok(ret == false, "match: ipv4 byte overflow range - negative max");
+	check_sockaddr_set(&t, AF_INET, "10.1.0.0", 0);
+	ret = sockaddr_range_match(&t, &min, &max);
+	ok(ret == false, "match: ipv4 byte overflow range - negative far max");
+
 	// IPv6 tests.
 
 	check_sockaddr_set(&min, AF_INET6, "::0", 0);
@@ -246,6 +315,9 @@ int main(int argc, char *argv[])
 	diag("sockaddr_is_any");
 	test_sockaddr_is_any();
 
+	diag("sockaddr_cmp");
+	test_cmp();
+
 	diag("sockaddr_net_match");
 	test_net_match();
 
@@ -0,0 +1,209 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "contrib/time.h"
+#include "contrib/ucw/heap.h"
+#include "knot/common/evsched.c"
+
+#define BENCH_MAX_DT		(86400 * 1000)	/* Zone timers within a day. */
+
+typedef struct {
+	double schedule;
+	double reschedule;
+	double cancel;
+	double fire;
+} bench_result_t;
+
+static uint32_t random_dt(void)
+{
+	/* Whole seconds like zone event timers. */
+	return (uint32_t)rand() % (BENCH_MAX_DT / 1000) * 1000;
+}
+
+static double mops(size_t ops, const struct timespec *begin)
+{
+	struct timespec end = time_now();
+	return ops / time_diff_ms(begin, &end) / 1000.0;
+}
+
+static void fire_cb(event_t *ev)
+{
+	(*(size_t *)ev->data)++;
+}
+
+static bench_result_t bench_wheel(size_t count)
+{
+	bench_result_t res = { 0 };
+
+	evsched_t sched;
+	if (evsched_init(&sched, NULL) != KNOT_EOK) {
+		return res;
+	}
+
+	size_t fired = 0;
+	event_t **events = malloc(count * sizeof(*events));
+	for (size_t i = 0; i < count; i++) {
+		events[i] = evsched_event_create(&sched, fire_cb, &fired);
+	}
+
+	struct timespec begin = time_now();
+	for (size_t i = 0; i < count; i++) {
+		evsched_schedule(events[i], random_dt());
+	}
+	res.schedule = mops(count, &begin);
+
+	begin = time_now();
+	for (size_t i = 0; i < count; i++) {
+		evsched_schedule(events[i], random_dt());
+	}
+	res.reschedule = mops(count, &begin);
+
+	/* Fire everything as the scheduler thread would do. */
+	begin = time_now();
+	for (uint64_t next = wheel_next(&sched); next != UINT64_MAX;
+	     next = wheel_next(&sched)) {
+		wheel_run(&sched, next);
+	}
+	res.fire = mops(fired, &begin);
+
+	for (size_t i = 0; i < count; i++) {
+		evsched_schedule(events[i], random_dt());
+	}
+	begin = time_now();
+	for (size_t i = 0; i < count; i++) {
+		evsched_cancel(events[i]);
+	}
+	res.cancel = mops(count, &begin);
+
+	for (size_t i = 0; i < count; i++) {
+		evsched_event_free(events[i]);
+	}
+	free(events);
+	evsched_deinit(&sched);
+
+	return res;
+}
+
+/* The former implementation: binary heap with the same locking. */
+
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+	struct heap_val hpos;
+	uint64_t expire;
+} heap_event_t;
+
+static int heap_event_cmp(void *e1, void *e2)
+{
+	uint64_t t1 = ((heap_event_t *)e1)->expire, t2 = ((heap_event_t *)e2)->expire;
+	return (t1 > t2) - (t1 < t2);
+}
+
+static void heap_schedule(struct heap *heap, heap_event_t *ev, uint32_t dt)
+{
+	uint64_t expire = time_ms() + dt;
+	pthread_mutex_lock(&heap_lock);
+	ev->expire = expire;
+	int found = heap_find(heap, (heap_val_t *)ev);
+	if (found > 0) {
+		heap_replace(heap, found, (heap_val_t *)ev);
+	} else {
+		heap_insert(heap, (heap_val_t *)ev);
+	}
+	pthread_mutex_unlock(&heap_lock);
+}
+
+static bench_result_t bench_heap(size_t count)
+{
+	bench_result_t res = { 0 };
+
+	struct heap heap;
+	heap_init(&heap, heap_event_cmp, 0);
+	heap_event_t *events = calloc(count, sizeof(*events));
+
+	struct timespec begin = time_now();
+	for (size_t i = 0; i < count; i++) {
+		heap_schedule(&heap, &events[i], random_dt());
+	}
+	res.schedule = mops(count, &begin);
+
+	begin = time_now();
+	for (size_t i = 0; i < count; i++) {
+		heap_schedule(&heap, &events[i], random_dt());
+	}
+	res.reschedule = mops(count, &begin);
+
+	begin = time_now();
+	while (!EMPTY_HEAP(&heap)) {
+		heap_delmin(&heap);
+	}
+	res.fire = mops(count, &begin);
+
+	for (size_t i = 0; i < count; i++) {
+		heap_schedule(&heap, &events[i], random_dt());
+	}
+	begin = time_now();
+	for (size_t i = 0; i < count; i++) {
+		pthread_mutex_lock(&heap_lock);
+		int found = heap_find(&heap, (heap_val_t *)&events[i]);
+		if (found > 0) {
+			heap_delete(&heap, found);
+		}
+		pthread_mutex_unlock(&heap_lock);
+	}
+	res.cancel = mops(count, &begin);
+
+	free(events);
+	heap_deinit(&heap);
+
+	return res;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t max_count = 4000000;
+	if (argc > 1) {
+		max_count = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2 || max_count == 0) {
+		printf("Event scheduler microbenchmark.\n"
+		       "Usage: bench_evsched [max_events]\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%10s %6s %12s %12s %12s %12s\n", "events", "impl",
+	       "sched Mops", "resched Mops", "cancel Mops", "fire Mops");
+	for (size_t count = 10000; count <= max_count; count *= 10) {
+		srand(count);
+		bench_result_t res = bench_wheel(count);
+		printf("%10zu %6s %12.2f %12.2f %12.2f %12.2f\n", count, "wheel",
+		       res.schedule, res.reschedule, res.cancel, res.fire);
+
+		srand(count);
+		res = bench_heap(count);
+		printf("%10zu %6s %12.2f %12.2f %12.2f %12.2f\n", count, "heap",
+		       res.schedule, res.reschedule, res.cancel, res.fire);
+
+		if (count < max_count && count * 10 > max_count) {
+			count = max_count / 10;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
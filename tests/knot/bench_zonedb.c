@@ -0,0 +1,148 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "contrib/qp-trie/trie.h"
+#include "contrib/time.h"
+#include "libknot/dname.h"
+#include "libknot/packet/wire.h"
+
+#define BENCH_QUERIES	1000000
+
+static const char *tlds[] = { "com.", "net.", "org.", "cz.", "example." };
+
+static double mops(size_t ops, const struct timespec *begin)
+{
+	struct timespec end = time_now();
+	return ops / time_diff_ms(begin, &end) / 1000.0;
+}
+
+static knot_dname_t *zone_name(size_t i)
+{
+	char buf[64];
+	(void)snprintf(buf, sizeof(buf), "zone%zu.%s", i,
+	               tlds[i % (sizeof(tlds) / sizeof(tlds[0]))]);
+	return knot_dname_from_str_alloc(buf);
+}
+
+/*! \brief Subname of a random zone with the given number of extra labels. */
+static knot_dname_t *query_name(size_t zones, unsigned depth)
+{
+	knot_dname_txt_storage_t buf = "";
+	size_t len = 0;
+	for (unsigned i = 0; i < depth; i++) {
+		len += snprintf(buf + len, sizeof(buf) - len, "l%u.", (unsigned)rand() % 10);
+	}
+	knot_dname_t *zone = zone_name((size_t)rand() % zones);
+	knot_dname_txt_storage_t zone_str;
+	(void)knot_dname_to_str(zone_str, zone, sizeof(zone_str));
+	(void)snprintf(buf + len, sizeof(buf) - len, "%s", zone_str);
+	knot_dname_free(zone, NULL);
+	return knot_dname_from_str_alloc(buf);
+}
+
+/*! \brief The former knot_zonedb_find_suffix(): one lookup per stripped label. */
+static trie_val_t *find_labels(trie_t *trie, const knot_dname_t *name)
+{
+	while (true) {
+		knot_dname_storage_t lf_storage;
+		uint8_t *lf = knot_dname_lf(name, lf_storage);
+
+		trie_val_t *val = trie_get_try(trie, lf + 1, *lf);
+		if (val != NULL) {
+			return val;
+		} else if (name[0] == 0) {
+			return NULL;
+		}
+
+		name = knot_wire_next_label(name, NULL);
+	}
+}
+
+static trie_val_t *find_lpm(trie_t *trie, const knot_dname_t *name)
+{
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(name, lf_storage);
+
+	return trie_get_lpm(trie, lf + 1, *lf);
+}
+
+static double bench(trie_t *trie, knot_dname_t **queries, size_t count,
+                    trie_val_t *(*find)(trie_t *, const knot_dname_t *))
+{
+	size_t found = 0;
+	struct timespec begin = time_now();
+	for (size_t i = 0; i < BENCH_QUERIES; i++) {
+		found += (find(trie, queries[i % count]) != NULL);
+	}
+	double res = mops(BENCH_QUERIES, &begin);
+	if (found != BENCH_QUERIES) {
+		printf("unexpected lookup miss\n");
+	}
+	return res;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t max_zones = 1000000;
+	if (argc > 1) {
+		max_zones = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2 || max_zones == 0) {
+		printf("Zone database suffix lookup microbenchmark.\n"
+		       "Usage: bench_zonedb [max_zones]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned depths[] = { 0, 2, 8, 32, 64 };
+	const size_t query_count = 10000;
+	knot_dname_t **queries = malloc(query_count * sizeof(*queries));
+	trie_t *trie = trie_create(NULL);
+	size_t zones = 0;
+
+	printf("%10s %6s %14s %14s\n", "zones", "depth", "labels Mqps", "lpm Mqps");
+	for (size_t count = 1000; count <= max_zones; count *= 10) {
+		for (; zones < count; zones++) {
+			knot_dname_t *name = zone_name(zones);
+			knot_dname_storage_t lf_storage;
+			uint8_t *lf = knot_dname_lf(name, lf_storage);
+			*trie_get_ins(trie, lf + 1, *lf) = trie;
+			knot_dname_free(name, NULL);
+		}
+
+		for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+			srand(count + d);
+			for (size_t i = 0; i < query_count; i++) {
+				queries[i] = query_name(count, depths[d]);
+			}
+
+			double labels = bench(trie, queries, query_count, find_labels);
+			double lpm = bench(trie, queries, query_count, find_lpm);
+			printf("%10zu %6u %14.2f %14.2f\n", count, depths[d], labels, lpm);
+
+			for (size_t i = 0; i < query_count; i++) {
+				knot_dname_free(queries[i], NULL);
+			}
+		}
+	}
+
+	trie_free(trie);
+	free(queries);
+
+	return EXIT_SUCCESS;
+}
@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <tap/basic.h>
@@ -22,6 +23,7 @@
 #include "test_conf.h"
 #include "libknot/libknot.h"
 #include "knot/updates/acl.h"
+#include "knot/zone/zone-conf.h"
 #include "contrib/sockaddr.h"
 
 #define ZONE	"example.zone"
@@ -295,7 +297,7 @@ static void test_acl_allowed(void)
 	knot_dname_free(aa_key2_name, NULL);
 	knot_rdataset_clear(&aaA.rrs, NULL);
 
-	conf_free(conf());
+	test_conf_free();
 	knot_dname_free(zone_name, NULL);
 	knot_dname_free(zone2_name, NULL);
 	knot_dname_free(key1_name, NULL);
@@ -303,6 +305,183 @@ static void test_acl_allowed(void)
 	knot_dname_free(key3_name, NULL);
 }
 
+/*! \brief Evaluates the ACL check with and without the compiled matcher and cache. */
+static bool check_both(knot_dname_t *zone, bool remote, acl_action_t action,
+                       const struct sockaddr_storage *addr, knot_tsig_key_t *tsig,
+                       bool *same)
+{
+	conf_t *c = conf();
+	bool ret[3];
+	dnssec_binary_t secret[3];
+
+	for (int i = 0; i < 2; i++) {
+		acl_index_t *idx = c->acl_index;
+		if (i == 1) {
+			c->acl_index = NULL;
+		}
+
+		conf_val_t val = remote ? conf_zone_get(c, C_MASTER, zone) :
+		                          conf_zone_get(c, C_ACL, zone);
+		tsig->secret = (dnssec_binary_t){ 0 };
+		ret[i] = remote ? rmt_allowed(c, &val, addr, tsig, NULL) :
+		                  acl_allowed(c, &val, action, addr, tsig, zone, NULL, NULL);
+		secret[i] = tsig->secret;
+
+		c->acl_index = idx;
+	}
+
+	/* Pre-resolved zone configuration. */
+	zone_conf_t *zconf = zone_conf_new(c, zone);
+	tsig->secret = (dnssec_binary_t){ 0 };
+	ret[2] = remote ? rmt_allowed_ids(c, &zconf->master, addr, tsig, NULL) :
+	                  acl_allowed_ids(c, &zconf->acl, action, addr, tsig, zone,
+	                                  NULL, NULL);
+	secret[2] = tsig->secret;
+	zone_conf_free(zconf);
+
+	*same = true;
+	for (int i = 1; i < 3; i++) {
+		*same &= (ret[0] == ret[i] && secret[0].size == secret[i].size &&
+		          (secret[0].size == 0 ||
+		           memcmp(secret[0].data, secret[i].data, secret[0].size) == 0));
+	}
+
+	return ret[0];
+}
+
+static void test_acl_compiled(void)
+{
+	const char *conf_str =
+		"server:\n"
+		"    automatic-acl: on\n"
+		"key:\n"
+		"  - id: k1\n"
+		"    algorithm: hmac-md5\n"
+		"    secret: Zm9v\n"
+		"  - id: k2\n"
+		"    algorithm: hmac-sha256\n"
+		"    secret: YmFy\n"
+		"\n"
+		"remote:\n"
+		"  - id: r1\n"
+		"    address: 10.0.0.1\n"
+		"    key: k1\n"
+		"  - id: r2\n"
+		"    address: [ 2001:db8::1, 10.0.0.2 ]\n"
+		"  - id: r3\n"
+		"    address: 10.0.0.3\n"
+		"    automatic-acl: off\n"
+		"\n"
+		"remotes:\n"
+		"  - id: g1\n"
+		"    remote: [ r2, r3 ]\n"
+		"\n"
+		"acl:\n"
+		"  - id: a_deny\n"
+		"    address: 10.0.0.2\n"
+		"    action: transfer\n"
+		"    deny: on\n"
+		"  - id: a_rmt\n"
+		"    remote: [ g1, r1 ]\n"
+		"    action: transfer\n"
+		"  - id: a_range\n"
+		"    address: [ 10.0.0.0/30, 10.1.0.0-10.2.0.255, 2001:db8::/120 ]\n"
+		"    key: [ k1, k2 ]\n"
+		"    action: [ notify, transfer ]\n"
+		"  - id: a_noaction\n"
+		"    address: 10.3.0.0/16\n"
+		"  - id: a_key\n"
+		"    key: k2\n"
+		"    action: update\n"
+		"\n"
+		"zone:\n"
+		"  - domain: z1.\n"
+		"    master: [ g1, r1 ]\n"
+		"    acl: [ a_deny, a_rmt, a_range ]\n"
+		"  - domain: z2.\n"
+		"    master: r1\n"
+		"    acl: [ a_noaction, a_key ]\n";
+
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "compiled: prepare configuration");
+	ok(conf()->acl_index != NULL, "compiled: matcher built");
+
+	const char *addrs[] = {
+		"10.0.0.0", "10.0.0.1", "10.0.0.2", "10.0.0.3", "10.0.0.4",
+		"9.255.255.255", "10.1.0.0", "10.1.255.255", "10.2.0.255",
+		"10.2.1.0", "10.3.5.5", "2001:db8::1", "2001:db8::ff",
+		"2001:db8::100", "::1"
+	};
+	knot_dname_t *k1 = knot_dname_from_str_alloc("k1");
+	knot_dname_t *k2 = knot_dname_from_str_alloc("k2");
+	knot_dname_t *k3 = knot_dname_from_str_alloc("k3");
+	knot_tsig_key_t keys[] = {
+		{ DNSSEC_TSIG_UNKNOWN,     NULL },
+		{ DNSSEC_TSIG_HMAC_MD5,    k1 },
+		{ DNSSEC_TSIG_HMAC_SHA256, k1 },
+		{ DNSSEC_TSIG_HMAC_SHA256, k2 },
+		{ DNSSEC_TSIG_HMAC_MD5,    k3 },
+	};
+	knot_dname_t *zones[] = {
+		knot_dname_from_str_alloc("z1."),
+		knot_dname_from_str_alloc("z2.")
+	};
+
+	unsigned checks = 0, diffs = 0, allowed = 0;
+	for (int a = 0; a < sizeof(addrs) / sizeof(*addrs); a++) {
+		struct sockaddr_storage addr;
+		int family = strchr(addrs[a], ':') != NULL ? AF_INET6 : AF_INET;
+		(void)sockaddr_set(&addr, family, addrs[a], 53);
+		for (int k = 0; k < sizeof(keys) / sizeof(*keys); k++) {
+		for (int z = 0; z < sizeof(zones) / sizeof(*zones); z++) {
+		for (int act = ACL_ACTION_QUERY; act <= ACL_ACTION_UPDATE + 1; act++) {
+			bool same;
+			bool remote = (act > ACL_ACTION_UPDATE);
+			allowed += check_both(zones[z], remote, act, &addr, &keys[k], &same);
+			diffs += !same;
+			checks++;
+		}
+		}
+		}
+	}
+	is_int(0, diffs, "compiled: same results as confdb walk (%u checks)", checks);
+	ok(allowed > 0 && allowed < checks, "compiled: some allowed, some refused");
+
+	struct sockaddr_storage addr;
+	bool same;
+	check_sockaddr_set(&addr, AF_INET, "10.1.128.0", 0);
+	ok(check_both(zones[0], false, ACL_ACTION_NOTIFY, &addr, &keys[1], &same) &&
+	   keys[1].secret.size == 3 && same, "compiled: address range, key, secret");
+	check_sockaddr_set(&addr, AF_INET, "10.0.0.2", 0);
+	ok(!check_both(zones[0], false, ACL_ACTION_TRANSFER, &addr, &keys[0], &same) &&
+	   same, "compiled: denied before remote");
+	ok(check_both(zones[0], false, ACL_ACTION_NOTIFY, &addr, &keys[3], &same) &&
+	   same, "compiled: denied action not matching");
+	check_sockaddr_set(&addr, AF_INET, "10.0.0.3", 0);
+	ok(check_both(zones[0], false, ACL_ACTION_TRANSFER, &addr, &keys[0], &same) &&
+	   same, "compiled: remote from group");
+	ok(!check_both(zones[0], true, ACL_ACTION_QUERY, &addr, &keys[0], &same) &&
+	   same, "compiled: automatic ACL disabled for remote");
+	check_sockaddr_set(&addr, AF_INET6, "2001:db8::1", 0);
+	ok(check_both(zones[0], true, ACL_ACTION_QUERY, &addr, &keys[0], &same) &&
+	   same, "compiled: automatic ACL, remote from group");
+	check_sockaddr_set(&addr, AF_INET, "10.0.0.1", 0);
+	ok(!check_both(zones[1], true, ACL_ACTION_QUERY, &addr, &keys[2], &same) &&
+	   same, "compiled: automatic ACL, key algorithm mismatch");
+	check_sockaddr_set(&addr, AF_INET, "10.3.0.1", 0);
+	ok(!check_both(zones[1], false, ACL_ACTION_UPDATE, &addr, &keys[0], &same) &&
+	   same, "compiled: empty action list");
+	ok(check_both(zones[1], false, ACL_ACTION_UPDATE, &addr, &keys[3], &same) &&
+	   same, "compiled: any address, key");
+
+	test_conf_free();
+	knot_dname_free(k1, NULL);
+	knot_dname_free(k2, NULL);
+	knot_dname_free(k3, NULL);
+	knot_dname_free(zones[0], NULL);
+	knot_dname_free(zones[1], NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -310,5 +489,8 @@ int main(int argc, char *argv[])
 	diag("acl_allowed");
 	test_acl_allowed();
 
+	diag("compiled ACL");
+	test_acl_compiled();
+
 	return 0;
 }
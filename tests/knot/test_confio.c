@@ -916,6 +916,8 @@ static void test_conf_io_list(void)
 	      "server.quic-idle-close-timeout\n"
 	      "server.quic-outbuf-max-size\n"
 	      "server.socket-affinity\n"
+	      "server.udp-gso\n"
+	      "server.io-uring\n"
 	      "server.udp-workers\n"
 	      "server.tcp-workers\n"
 	      "server.background-workers\n"
@@ -983,6 +985,8 @@ static const yp_item_t desc_server[] = {
 	{ C_QUIC_IDLE_CLOSE,	  YP_TINT,  YP_VNONE },
 	{ C_QUIC_OUTBUF_MAX_SIZE, YP_TINT,  YP_VNONE },
 	{ C_SOCKET_AFFINITY,	  YP_TBOOL, YP_VNONE },
+	{ C_UDP_GSO,		  YP_TBOOL, YP_VNONE },
+	{ C_IO_URING,		  YP_TBOOL, YP_VNONE },
 	{ C_UDP_WORKERS,	  YP_TINT,  YP_VNONE },
 	{ C_TCP_WORKERS,	  YP_TINT,  YP_VNONE },
 	{ C_BG_WORKERS,		  YP_TINT,  YP_VNONE },
@@ -1006,6 +1010,7 @@ static const yp_item_t desc_xdp[] = {
 	{ C_TCP_IDLE_CLOSE,     YP_TINT,  YP_VNONE },
 	{ C_TCP_IDLE_RESET,     YP_TINT,  YP_VNONE },
 	{ C_TCP_RESEND,         YP_TINT,  YP_VNONE },
+	{ C_TCP_SYN_COOKIES,    YP_TBOOL, YP_VNONE },
 	{ C_ROUTE_CHECK,        YP_TBOOL, YP_VNONE },
 	{ NULL }
 };
@@ -0,0 +1,347 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "knot/ctl/commands.h"
+#include "knot/ctl/process.h"
+#include "test_server.h"
+
+#define TIMEOUT_MS	5000
+#define SHORT_MS	200
+
+static server_t server;
+static knot_ctl_t *listener;
+static char socket_path[4096];
+
+static void handle_alarm(int signum)
+{
+	// Internal thread synchronization, see dthreads.
+}
+
+/*! Connects to the server and sends a command. */
+static knot_ctl_t *request(const char *cmd, const char *zone, const char *type)
+{
+	knot_ctl_t *client = knot_ctl_alloc();
+	if (client == NULL) {
+		return NULL;
+	}
+	knot_ctl_set_timeout(client, TIMEOUT_MS);
+
+	knot_ctl_data_t data = {
+		[KNOT_CTL_IDX_CMD] = cmd,
+		[KNOT_CTL_IDX_ZONE] = zone,
+		[KNOT_CTL_IDX_TYPE] = type
+	};
+	if (knot_ctl_connect(client, socket_path) != KNOT_EOK ||
+	    knot_ctl_send(client, KNOT_CTL_TYPE_DATA, &data) != KNOT_EOK ||
+	    knot_ctl_send(client, KNOT_CTL_TYPE_BLOCK, NULL) != KNOT_EOK) {
+		knot_ctl_free(client);
+		return NULL;
+	}
+
+	return client;
+}
+
+/*! Accepts a connection and passes it to the pool. */
+static int assign(ctl_pool_t *pool)
+{
+	int ret = knot_ctl_accept(listener);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return ctl_pool_assign(pool, listener);
+}
+
+/*! Receives the reply to one command, KNOT_ERROR if it contains an error. */
+static int reply(knot_ctl_t *client, int timeout_ms)
+{
+	knot_ctl_set_timeout(client, timeout_ms);
+
+	bool failed = false;
+	while (true) {
+		knot_ctl_type_t type;
+		knot_ctl_data_t data;
+		int ret = knot_ctl_receive(client, &type, &data);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		switch (type) {
+		case KNOT_CTL_TYPE_END:
+			return KNOT_EMALF;
+		case KNOT_CTL_TYPE_BLOCK:
+			return failed ? KNOT_ERROR : KNOT_EOK;
+		default:
+			if (data[KNOT_CTL_IDX_ERROR] != NULL) {
+				failed = true;
+			}
+		}
+	}
+}
+
+/*! Waits for the wake-up signal of a command handed over to this thread. */
+static bool handover_requested(void)
+{
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGALRM);
+	struct timespec timeout = { TIMEOUT_MS / 1000, (TIMEOUT_MS % 1000) * 1000000L };
+
+	return sigtimedwait(&mask, NULL, &timeout) == SIGALRM;
+}
+
+static void finish(knot_ctl_t *client)
+{
+	(void)knot_ctl_send(client, KNOT_CTL_TYPE_END, NULL);
+	knot_ctl_free(client);
+}
+
+static void test_parallel(ctl_pool_t *pool)
+{
+	knot_ctl_t *clients[CTL_THREADS + 2];
+	for (int i = 0; i < CTL_THREADS + 2; i++) {
+		clients[i] = request("status", NULL, "version");
+		int ret = assign(pool);
+		ok(clients[i] != NULL && ret == KNOT_EOK, "pool: session %i assigned", i);
+	}
+
+	// The sessions over the number of threads are processed after the finished ones.
+	for (int i = 0; i < CTL_THREADS + 2; i++) {
+		int ret = (clients[i] != NULL) ? reply(clients[i], TIMEOUT_MS) : KNOT_EINVAL;
+		is_int(KNOT_EOK, ret, "pool: session %i answered", i);
+		if (clients[i] != NULL) {
+			finish(clients[i]);
+		}
+	}
+}
+
+static void test_zone_serialization(ctl_pool_t *pool)
+{
+	zone_t *zone = knot_zonedb_find(server.zone_db, ROOT_DNAME);
+
+	pthread_mutex_lock(&zone->control_lock);
+
+	knot_ctl_t *reader = request("zone-read", ".", NULL);
+	int ret = assign(pool);
+	ok(reader != NULL && ret == KNOT_EOK, "zone lock: zone-read assigned");
+
+	knot_ctl_t *other = request("status", NULL, "version");
+	ret = assign(pool);
+	ok(other != NULL && ret == KNOT_EOK, "zone lock: status assigned");
+	if (reader == NULL || other == NULL) {
+		pthread_mutex_unlock(&zone->control_lock);
+		return;
+	}
+
+	is_int(KNOT_EOK, reply(other, TIMEOUT_MS), "zone lock: other commands not blocked");
+	is_int(KNOT_ETIMEOUT, reply(reader, SHORT_MS), "zone lock: zone-read waits");
+
+	pthread_mutex_unlock(&zone->control_lock);
+
+	is_int(KNOT_EOK, reply(reader, TIMEOUT_MS), "zone lock: zone-read answered");
+
+	finish(other);
+	finish(reader);
+}
+
+static void *lock_exclusive(void *arg)
+{
+	int *ret = arg;
+	*ret = ctl_lock(&server, CTL_LOCK_EXCLUSIVE, TIMEOUT_MS);
+	if (*ret == KNOT_EOK) {
+		ctl_unlock(&server);
+	}
+
+	return NULL;
+}
+
+static void test_lock(void)
+{
+	int ret = ctl_lock(&server, CTL_LOCK_SHARED, SHORT_MS);
+	is_int(KNOT_EOK, ret, "lock: shared");
+	ret = ctl_lock(&server, CTL_LOCK_ZONE, SHORT_MS);
+	is_int(KNOT_EOK, ret, "lock: another shared");
+	ctl_unlock(&server);
+	ret = ctl_lock(&server, CTL_LOCK_EXCLUSIVE, SHORT_MS);
+	is_int(KNOT_ETIMEOUT, ret, "lock: exclusive waits for shared");
+
+	// Pretend an exclusive locking attempt in progress.
+	pthread_mutex_lock(&server.ctl_lock.mutex);
+	server.ctl_lock.waiting++;
+	pthread_mutex_unlock(&server.ctl_lock.mutex);
+
+	ret = ctl_lock(&server, CTL_LOCK_SHARED, SHORT_MS);
+	is_int(KNOT_ETIMEOUT, ret, "lock: shared waits for waiting exclusive");
+
+	pthread_mutex_lock(&server.ctl_lock.mutex);
+	server.ctl_lock.waiting--;
+	pthread_mutex_unlock(&server.ctl_lock.mutex);
+
+	pthread_t thread;
+	int thread_ret = KNOT_ERROR;
+	pthread_create(&thread, NULL, lock_exclusive, &thread_ret);
+	ctl_unlock(&server);
+	pthread_join(thread, NULL);
+	is_int(KNOT_EOK, thread_ret, "lock: exclusive after shared unlocked");
+
+	ret = ctl_lock(&server, CTL_LOCK_SHARED, SHORT_MS);
+	is_int(KNOT_EOK, ret, "lock: shared after exclusive unlocked");
+	ctl_unlock(&server);
+}
+
+static void test_handover(ctl_pool_t *pool)
+{
+	int ret = ctl_lock(&server, CTL_LOCK_SHARED, SHORT_MS);
+	is_int(KNOT_EOK, ret, "handover: shared locked");
+
+	knot_ctl_t *client = request("stop", NULL, NULL);
+	ret = assign(pool);
+	ok(client != NULL && ret == KNOT_EOK, "handover: stop assigned");
+	if (client == NULL) {
+		ctl_unlock(&server);
+		return;
+	}
+
+	ok(handover_requested(), "handover: requested");
+	ret = ctl_pool_exec(pool);
+	is_int(KNOT_EAGAIN, ret, "handover: postponed while shared locked");
+	is_int(KNOT_ETIMEOUT, reply(client, SHORT_MS), "handover: not executed");
+
+	// The postponed command stays handed over.
+	ctl_unlock(&server);
+
+	ret = ctl_pool_exec(pool);
+	is_int(KNOT_CTL_ESTOP, ret, "handover: executed");
+	is_int(KNOT_EOK, reply(client, TIMEOUT_MS), "handover: answered");
+
+	knot_ctl_type_t type = KNOT_CTL_TYPE_DATA;
+	knot_ctl_data_t data;
+	ret = knot_ctl_receive(client, &type, &data);
+	ok(ret == KNOT_EOK && type == KNOT_CTL_TYPE_END, "handover: session finished");
+
+	knot_ctl_free(client);
+}
+
+static void test_cancel(void)
+{
+	ctl_pool_t *pool = ctl_pool_create(&server, CTL_THREADS);
+	ok(pool != NULL, "cancel: pool created");
+	if (pool == NULL) {
+		return;
+	}
+
+	// Commands of all sessions wait for the exclusive lock or the handover.
+	int ret = ctl_lock(&server, CTL_LOCK_EXCLUSIVE, SHORT_MS);
+	is_int(KNOT_EOK, ret, "cancel: exclusive locked");
+
+	knot_ctl_t *stop = request("stop", NULL, NULL);
+	int failed = (stop == NULL || assign(pool) != KNOT_EOK) ? 1 : 0;
+
+	knot_ctl_t *clients[CTL_MAX_SESSIONS - 1];
+	for (int i = 0; i < CTL_MAX_SESSIONS - 1; i++) {
+		clients[i] = request("status", NULL, "version");
+		if (clients[i] == NULL || assign(pool) != KNOT_EOK) {
+			failed++;
+		}
+	}
+	is_int(0, failed, "cancel: %i sessions assigned", CTL_MAX_SESSIONS);
+
+	knot_ctl_t *rejected = request("status", NULL, "version");
+	ret = assign(pool);
+	is_int(KNOT_EBUSY, ret, "cancel: session over limit rejected");
+	ret = (rejected != NULL) ? reply(rejected, TIMEOUT_MS) : KNOT_EINVAL;
+	is_int(KNOT_ERROR, ret, "cancel: rejected session got error");
+	knot_ctl_free(rejected);
+
+	ctl_pool_destroy(pool);
+	ok(server.ctl_lock.exclusive, "cancel: pool destroyed while locked");
+
+	ctl_unlock(&server);
+
+	int answered = 0;
+	for (int i = 0; i < CTL_MAX_SESSIONS - 1; i++) {
+		if (clients[i] != NULL && reply(clients[i], SHORT_MS) == KNOT_EOK) {
+			answered++;
+		}
+		knot_ctl_free(clients[i]);
+	}
+	is_int(0, answered, "cancel: waiting sessions closed");
+
+	ret = (stop != NULL) ? reply(stop, SHORT_MS) : KNOT_EINVAL;
+	ok(ret != KNOT_EOK && ret != KNOT_ETIMEOUT, "cancel: handed over command aborted");
+	knot_ctl_free(stop);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *temp_dir = test_mkdtemp();
+	ok(temp_dir != NULL, "make temporary directory");
+	(void)snprintf(socket_path, sizeof(socket_path), "%s/knot.sock", temp_dir);
+
+	int ret = create_fake_server(&server, NULL, temp_dir);
+	is_int(KNOT_EOK, ret, "fake server initialization");
+	if (ret != KNOT_EOK) {
+		goto fatal;
+	}
+
+	struct sigaction action = { .sa_handler = handle_alarm };
+	sigaction(SIGALRM, &action, NULL);
+
+	// The handovers are polled, the wake-up signal would only interrupt the I/O.
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGALRM);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	listener = knot_ctl_alloc();
+	ok(listener != NULL, "allocate control");
+	knot_ctl_set_timeout(listener, TIMEOUT_MS);
+	ret = knot_ctl_bind(listener, socket_path);
+	is_int(KNOT_EOK, ret, "bind control socket");
+
+	ctl_pool_t *pool = ctl_pool_create(&server, CTL_THREADS);
+	ok(pool != NULL, "create control pool");
+	if (pool == NULL || ret != KNOT_EOK) {
+		goto fatal;
+	}
+
+	test_parallel(pool);
+	test_zone_serialization(pool);
+	test_lock();
+	test_handover(pool);
+	ctl_pool_destroy(pool);
+
+	test_cancel();
+
+fatal:
+	knot_ctl_unbind(listener);
+	knot_ctl_free(listener);
+	server_deinit(&server);
+	conf_free(conf());
+	test_rm_rf(temp_dir);
+	free(temp_dir);
+
+	return 0;
+}
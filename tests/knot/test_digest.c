@@ -91,7 +91,7 @@ static zone_contents_t *str2contents(const char *zone_str)
 static int check_contents(const char *zone_str)
 {
 	zone_contents_t *cont = str2contents(zone_str);
-	int ret = zone_contents_digest_verify(cont);
+	int ret = zone_contents_digest_verify(cont, 1, NULL, false);
 	zone_contents_deep_free(cont);
 	return ret;
 }
@@ -438,6 +438,64 @@ example.      86400  IN  SOA     ns1 admin 2018031900 (  \n\
 ns1           3600   IN  A       203.0.113.63            \n\
 ns2           3600   IN  AAAA    2001:db8::63";
 
+static void test_pipelined(void)
+{
+	const size_t nodes = 5000;
+	char *zone_str = malloc(nodes * 160 + 256);
+	int len = sprintf(zone_str, "example. 3600 IN SOA ns1 admin 1 1800 900 604800 86400\n");
+	for (size_t i = 0; i < nodes; i++) {
+		len += sprintf(zone_str + len, "n%zu 3600 IN A 192.0.2.%zu\n", i, i % 256);
+		len += sprintf(zone_str + len, "n%zu 3600 IN TXT \"%080zu\"\n", i, i);
+	}
+	zone_contents_t *cont = str2contents(zone_str);
+	free(zone_str);
+
+	uint8_t *seq = NULL, *par = NULL;
+	size_t seq_size = 0, par_size = 0;
+	int ret = zone_contents_digest(cont, KNOT_ZONEMD_ALGORITHM_SHA384, 1, &seq, &seq_size);
+	is_int(KNOT_EOK, ret, "sequential digest");
+	ret = zone_contents_digest(cont, KNOT_ZONEMD_ALGORITHM_SHA384, 4, &par, &par_size);
+	is_int(KNOT_EOK, ret, "pipelined digest");
+	ok(seq_size == par_size && seq_size > 0 && memcmp(seq, par, seq_size) == 0,
+	   "pipelined digest equals sequential one");
+
+	free(seq);
+	free(par);
+	zone_contents_deep_free(cont);
+}
+
+static void test_cache(void)
+{
+	zone_digest_cache_t cache;
+	zone_digest_cache_init(&cache);
+
+	zone_contents_t *cont = str2contents(simple_zone);
+	int ret = zone_contents_digest_verify(cont, 1, &cache, true);
+	is_int(KNOT_EOK, ret, "cache: verified digest");
+	ok(cache.algorithm == KNOT_ZONEMD_ALGORITHM_SHA384 && cache.serial == 2018031900,
+	   "cache: digest stored");
+	zone_contents_deep_free(cont);
+
+	// Contents not matching the digest, but assumed identical to the cached ones.
+	cont = str2contents(simple_zone);
+	knot_rrset_t *rr = knot_rrset_new(cont->apex->owner, KNOT_RRTYPE_TXT,
+	                                  KNOT_CLASS_IN, 3600, NULL);
+	uint8_t txt[] = { 3, 'f', 'o', 'o' };
+	knot_rrset_add_rdata(rr, txt, sizeof(txt), NULL);
+	zone_node_t *unused = NULL;
+	ret = zone_contents_add_rr(cont, rr, &unused);
+	knot_rrset_free(rr, NULL);
+	is_int(KNOT_EOK, ret, "cache: contents modified");
+
+	ret = zone_contents_digest_verify(cont, 1, &cache, true);
+	is_int(KNOT_EOK, ret, "cache: verification skipped");
+	ret = zone_contents_digest_verify(cont, 1, &cache, false);
+	is_int(KNOT_EMALF, ret, "cache: verification enforced");
+	zone_contents_deep_free(cont);
+
+	zone_digest_cache_deinit(&cache);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -470,5 +528,9 @@ int main(int argc, char *argv[])
 	ret = check_contents(wrong_hash);
 	is_int(KNOT_EMALF, ret, "wrong hash");
 
+	test_pipelined();
+
+	test_cache();
+
 	return 0;
 }
@@ -0,0 +1,204 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <tap/basic.h>
+
+#include <signal.h>
+#include <time.h>
+
+#include "knot/common/evsched.c"
+
+#define EVENTS		20000
+#define BASE_TIME	1000003
+
+typedef struct {
+	uint64_t fired;    /*!< Wheel time the event fired at. */
+	uint64_t till;     /*!< Time the wheel was run till. */
+	unsigned count;    /*!< Number of firings. */
+} fire_log_t;
+
+static uint64_t run_till;
+
+static void virtual_cb(event_t *ev)
+{
+	fire_log_t *log = ev->data;
+	log->fired = ev->sched->now;
+	log->till = run_till;
+	log->count++;
+}
+
+/*!
+ * Drives the wheel with virtual time as the scheduler thread would do.
+ */
+static void test_virtual_time(void)
+{
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	ok(ret == KNOT_EOK, "virtual: init scheduler");
+	sched.now = BASE_TIME;
+
+	static event_t *events[EVENTS];
+	static fire_log_t logs[EVENTS];
+
+	srand(1);
+	for (int i = 0; i < EVENTS; i++) {
+		events[i] = evsched_event_create(&sched, virtual_cb, &logs[i]);
+		/* Spread over all the wheel levels. */
+		uint64_t range = (uint64_t)1 << (rand() % 33);
+		events[i]->expire = BASE_TIME + (uint64_t)rand() * rand() % range;
+		wheel_insert(&sched, events[i]);
+	}
+	ok(sched.count == EVENTS, "virtual: scheduled all");
+
+	/* Cancel every 7th and reschedule every 5th event. */
+	unsigned cancelled = 0;
+	for (int i = 0; i < EVENTS; i++) {
+		if (i % 7 == 0) {
+			wheel_remove(&sched, events[i]);
+			cancelled++;
+		} else if (i % 5 == 0) {
+			wheel_remove(&sched, events[i]);
+			events[i]->expire = BASE_TIME + (uint64_t)rand() % 100000;
+			wheel_insert(&sched, events[i]);
+		}
+	}
+	ok(sched.count == EVENTS - cancelled, "virtual: cancelled and rescheduled");
+
+	/* Sleep till the next planned wakeup, fire, repeat. */
+	unsigned wakeups = 0;
+	bool monotonic = true;
+	for (uint64_t next = wheel_next(&sched); next != UINT64_MAX;
+	     next = wheel_next(&sched)) {
+		monotonic &= (next >= sched.now);
+		run_till = next;
+		wheel_run(&sched, next);
+		wakeups++;
+	}
+	ok(monotonic, "virtual: planned wakeups not in the past");
+	ok(sched.count == 0 && sched.count_l0 == 0, "virtual: all fired (%u wakeups)", wakeups);
+
+	bool exact = true, once = true, skipped = true;
+	for (int i = 0; i < EVENTS; i++) {
+		if (i % 7 == 0) {
+			skipped &= (logs[i].count == 0);
+			continue;
+		}
+		once &= (logs[i].count == 1);
+		exact &= (logs[i].fired == events[i]->expire &&
+		          logs[i].till == events[i]->expire);
+	}
+	ok(once, "virtual: scheduled events fired once");
+	ok(skipped, "virtual: cancelled events not fired");
+	ok(exact, "virtual: events fired exactly on time");
+
+	/* Overdue event fires at the next tick. */
+	events[0]->expire = BASE_TIME;
+	wheel_insert(&sched, events[0]);
+	uint64_t now = sched.now;
+	ok(wheel_next(&sched) == now, "virtual: overdue event planned now");
+	run_till = now;
+	wheel_run(&sched, now);
+	ok(logs[0].count == 1 && logs[0].fired == now, "virtual: overdue event fired");
+
+	for (int i = 0; i < EVENTS; i++) {
+		evsched_event_free(events[i]);
+	}
+	evsched_deinit(&sched);
+}
+
+typedef struct {
+	pthread_mutex_t mx;
+	unsigned fired;
+} real_log_t;
+
+static void real_cb(event_t *ev)
+{
+	real_log_t *log = ev->data;
+	pthread_mutex_lock(&log->mx);
+	log->fired++;
+	pthread_mutex_unlock(&log->mx);
+}
+
+static unsigned real_fired(real_log_t *log)
+{
+	pthread_mutex_lock(&log->mx);
+	unsigned fired = log->fired;
+	pthread_mutex_unlock(&log->mx);
+	return fired;
+}
+
+static void test_real_time(void)
+{
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	ok(ret == KNOT_EOK, "real: init scheduler");
+	evsched_start(&sched);
+
+	real_log_t now_log = { PTHREAD_MUTEX_INITIALIZER }, later_log = now_log,
+	           cancel_log = now_log, never_log = now_log;
+	event_t *now = evsched_event_create(&sched, real_cb, &now_log);
+	event_t *later = evsched_event_create(&sched, real_cb, &later_log);
+	event_t *cancel = evsched_event_create(&sched, real_cb, &cancel_log);
+	event_t *never = evsched_event_create(&sched, real_cb, &never_log);
+
+	/* The later event needs cascading from the second level. */
+	evsched_schedule(never, 100000);
+	evsched_schedule(later, 400);
+	evsched_schedule(cancel, 200);
+	evsched_schedule(now, 0);
+	evsched_cancel(cancel);
+
+	struct timespec delay = { 0, 100000000 };
+	nanosleep(&delay, NULL);
+	ok(real_fired(&now_log) == 1 && real_fired(&later_log) == 0,
+	   "real: immediate event fired");
+
+	for (int i = 0; i < 20 && real_fired(&later_log) == 0; i++) {
+		nanosleep(&delay, NULL);
+	}
+	ok(real_fired(&later_log) == 1, "real: later event fired");
+	ok(real_fired(&cancel_log) == 0, "real: cancelled event not fired");
+	ok(real_fired(&never_log) == 0, "real: distant event not fired");
+
+	evsched_stop(&sched);
+	evsched_join(&sched);
+
+	evsched_event_free(now);
+	evsched_event_free(later);
+	evsched_event_free(cancel);
+	/* The still scheduled event is freed by the scheduler. */
+	evsched_deinit(&sched);
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL); // Interrupt
+
+	test_virtual_time();
+	test_real_time();
+
+	return 0;
+}
@@ -15,10 +15,12 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <tap/basic.h>
@@ -44,6 +46,8 @@ zone_journal_t jj;
 
 unsigned env_flag;
 
+const char *compression = "none";
+
 static unsigned lmdb_page_size(knot_lmdb_db_t *db)
 {
 	knot_lmdb_txn_t txn = { 0 };
@@ -63,8 +67,9 @@ static void set_conf(int zonefile_sync, size_t journal_usage, const knot_dname_t
 	         " - id: default\n"
 	         "   zonefile-sync: %d\n"
 	         "   journal-max-usage: %zu\n"
-	         "   journal-max-depth: 1000\n",
-	         zonefile_sync, journal_usage);
+	         "   journal-max-depth: 1000\n"
+	         "   journal-compression: %s\n",
+	         zonefile_sync, journal_usage, compression);
 	_unused_ int ret = test_conf(conf_str, NULL);
 	assert(ret == KNOT_EOK);
 	jj.conf = conf();
@@ -837,6 +842,177 @@ static void test_stress_base(const knot_dname_t *apex,
 	unset_conf();
 }
 
+#ifdef HAVE_ZSTD
+/*! \brief Test storing and reading compressed changesets. */
+static void test_compression(const knot_dname_t *apex)
+{
+	int ret = knot_lmdb_reconfigure(&jdb, test_dir_name, 16 * 1024 * 1024,
+	                                journal_env_flags(JOURNAL_MODE_ASYNC, false));
+	is_int(KNOT_EOK, ret, "journal: reconfigure for compression (%s)", knot_strerror(ret));
+
+	compression = "zstd";
+	set_conf(1000, 8 * 1024 * 1024, apex);
+	const knot_dname_t *prev_zone = jj.zone;
+	jj.zone = apex;
+
+	list_t k, l;
+	init_list(&k);
+	ret = KNOT_EOK;
+	for (uint32_t serial = 0; ret == KNOT_EOK && serial < 10; ++serial) {
+		changeset_t *ch = changeset_new(apex);
+		init_random_changeset(ch, serial, serial + 1, 400, apex, false);
+		ret = journal_insert(jj, ch, NULL, NULL);
+		add_tail(&k, &ch->n);
+	}
+	is_int(KNOT_EOK, ret, "journal: store compressed changesets (%s)", knot_strerror(ret));
+	ret = journal_sem_check(jj);
+	is_int(KNOT_EOK, ret, "journal: check after compressed store (%s)", knot_strerror(ret));
+
+	journal_read_t *read = NULL;
+	ret = load_j_list(&jj, false, 0, &read, &l);
+	is_int(KNOT_EOK, ret, "journal: read compressed changesets (%s)", knot_strerror(ret));
+	ok(changesets_list_eq(&l, &k), "journal: compressed changesets equal after read");
+	changesets_free(&l);
+	journal_read_end(read);
+	changesets_free(&k);
+
+	uint64_t stored = 0, raw = 0;
+	ret = journal_chunk_sizes(jj, &stored, &raw);
+	is_int(KNOT_EOK, ret, "journal: compressed chunk sizes (%s)", knot_strerror(ret));
+	ok(stored > 0 && stored < raw, "journal: changesets compressed (%"PRIu64" < %"PRIu64")",
+	   stored, raw);
+
+	/* A changeset too big to be kept compressed in advance. */
+	changeset_t *big = changeset_new(apex);
+	init_random_changeset(big, 10, 11, 30000, apex, false);
+	add_tail(&k, &big->n);
+	ret = journal_insert(jj, big, NULL, NULL);
+	is_int(KNOT_EOK, ret, "journal: store big compressed changeset (%s)", knot_strerror(ret));
+	ret = load_j_list(&jj, false, 10, &read, &l);
+	is_int(KNOT_EOK, ret, "journal: read big compressed changeset (%s)", knot_strerror(ret));
+	ok(changesets_list_eq(&l, &k), "journal: big compressed changeset equal after read");
+	changesets_free(&l);
+	journal_read_end(read);
+	changesets_free(&k);
+
+	uint64_t big_stored = 0;
+	ret = journal_chunk_sizes(jj, &big_stored, &raw);
+	ok(ret == KNOT_EOK && big_stored - stored > 1024 * 1024,
+	   "journal: big changeset compressed while writing (%"PRIu64")", big_stored - stored);
+
+	ret = journal_scrape_with_md(jj, true);
+	is_int(KNOT_EOK, ret, "journal: scrape compressed (%s)", knot_strerror(ret));
+
+	jj.zone = prev_zone;
+	compression = "none";
+	unset_conf();
+}
+#endif
+
+#define GROUP_THREADS 12
+#define GROUP_INSERTS 20
+
+typedef struct {
+	pthread_t thread;
+	zone_journal_t j;
+	knot_dname_t apex[16];
+	int ret;
+} group_ctx_t;
+
+static void *group_insert(void *arg)
+{
+	group_ctx_t *ctx = arg;
+
+	changeset_t ch;
+	ctx->ret = changeset_init(&ch, ctx->apex);
+	init_random_changeset(&ch, 0, 1, 16, ctx->apex, false);
+	for (uint32_t serial = 0; ctx->ret == KNOT_EOK && serial < GROUP_INSERTS; ++serial) {
+		changeset_set_soa_serials(&ch, serial, serial + 1, ctx->apex);
+		ctx->ret = journal_insert(ctx->j, &ch, NULL, NULL);
+	}
+	changeset_clear(&ch);
+
+	return NULL;
+}
+
+static void group_fail_txn(knot_lmdb_txn_t *txn, _unused_ void *ctx)
+{
+	MDB_val key = knot_lmdb_make_key("S", "group-fail");
+	knot_lmdb_insert(txn, &key, &key);
+	free(key.mv_data);
+	txn->ret = KNOT_EMALF;
+}
+
+static void *group_fail(void *arg)
+{
+	int *ret = arg;
+	for (int i = 0; *ret == KNOT_EMALF && i < GROUP_INSERTS; i++) {
+		*ret = knot_lmdb_group_run(&jdb, group_fail_txn, NULL);
+	}
+
+	return NULL;
+}
+
+/*! \brief Test concurrent writes to several zones committed in groups. */
+static void test_group_commit(void)
+{
+	int ret = knot_lmdb_reconfigure(&jdb, test_dir_name, 4 * 1024 * 1024,
+	                                journal_env_flags(JOURNAL_MODE_ROBUST, false));
+	is_int(KNOT_EOK, ret, "journal: reconfigure to robust mode (%s)", knot_strerror(ret));
+	jdb.group_commit_ms = 20;
+
+	set_conf(1000, 2 * 1024 * 1024, NULL);
+
+	group_ctx_t ctx[GROUP_THREADS] = { 0 };
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		memcpy(ctx[i].apex, "\6group0", 8);
+		ctx[i].apex[6] += i;
+		ctx[i].j = (zone_journal_t){ .db = &jdb, .zone = ctx[i].apex, .conf = jj.conf };
+		pthread_create(&ctx[i].thread, NULL, group_insert, &ctx[i]);
+	}
+	pthread_t fail_thread;
+	int fail_ret = KNOT_EMALF;
+	pthread_create(&fail_thread, NULL, group_fail, &fail_ret);
+
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		pthread_join(ctx[i].thread, NULL);
+		is_int(KNOT_EOK, ctx[i].ret, "journal: group commit, zone %d inserts (%s)",
+		       i, knot_strerror(ctx[i].ret));
+
+		ret = journal_sem_check(ctx[i].j);
+		is_int(KNOT_EOK, ret, "journal: group commit, zone %d check (%s)",
+		       i, knot_strerror(ret));
+
+		list_t l;
+		journal_read_t *read = NULL;
+		ret = load_j_list(&ctx[i].j, false, 0, &read, &l);
+		is_int(KNOT_EOK, ret, "journal: group commit, zone %d read (%s)",
+		       i, knot_strerror(ret));
+		ok(list_size(&l) == GROUP_INSERTS && test_continuity(&l) == KNOT_EOK,
+		   "journal: group commit, zone %d all changesets stored", i);
+		changesets_free(&l);
+		journal_read_end(read);
+
+		ret = journal_scrape_with_md(ctx[i].j, true);
+		is_int(KNOT_EOK, ret, "journal: group commit, zone %d scrape (%s)",
+		       i, knot_strerror(ret));
+	}
+
+	pthread_join(fail_thread, NULL);
+	is_int(KNOT_EMALF, fail_ret, "journal: group commit, failing transaction (%s)",
+	       knot_strerror(fail_ret));
+	knot_lmdb_txn_t txn = { 0 };
+	knot_lmdb_begin(&jdb, &txn, false);
+	MDB_val key = knot_lmdb_make_key("S", "group-fail");
+	ok(!knot_lmdb_find(&txn, &key, KNOT_LMDB_EXACT) && txn.ret == KNOT_EOK,
+	   "journal: group commit, failing transaction not stored");
+	free(key.mv_data);
+	knot_lmdb_abort(&txn);
+
+	jdb.group_commit_ms = 0;
+	unset_conf();
+}
+
 /*! \brief Test behavior when writing to the journal and flushing it. */
 static void test_stress(const knot_dname_t *apex)
 {
@@ -869,6 +1045,12 @@ int main(int argc, char *argv[])
 
 	test_merge(apex);
 
+#ifdef HAVE_ZSTD
+	test_compression(apex2);
+#endif
+
+	test_group_commit();
+
 	test_stress(apex);
 
 	knot_lmdb_deinit(&jdb);
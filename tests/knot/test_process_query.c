@@ -23,6 +23,8 @@
 #include "libknot/descriptor.h"
 #include "libknot/packet/wire.h"
 #include "knot/nameserver/process_query.h"
+#include "knot/zone/answer_cache.h"
+#include "knot/zone/zonedb-load.h"
 #include "test_server.h"
 #include "contrib/sockaddr.h"
 #include "contrib/ucw/mempool.h"
@@ -72,6 +74,63 @@ static void exec_query(knot_layer_t *layer, const char *name,
 	knot_pkt_free(answer);
 }
 
+/* Resolve query and return TTL of the first answer record (1 TAP test). */
+static uint32_t exec_query_ttl(knot_layer_t *layer, const char *name,
+                               knot_pkt_t *query, uint8_t *flags2)
+{
+	knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	assert(answer);
+
+	knot_pkt_parse(query, 0);
+	knot_layer_consume(layer, query);
+	knot_layer_produce(layer, answer);
+
+	uint32_t ttl = 0;
+	int ret = knot_pkt_parse(answer, 0);
+	ok(ret == KNOT_EOK && layer->state == KNOT_STATE_DONE &&
+	   knot_wire_get_id(query->wire) == knot_wire_get_id(answer->wire) &&
+	   knot_pkt_section(answer, KNOT_ANSWER)->count == 1,
+	   "ns: answer %s query", name);
+	if (ret == KNOT_EOK && knot_pkt_section(answer, KNOT_ANSWER)->count > 0) {
+		ttl = knot_pkt_rr(knot_pkt_section(answer, KNOT_ANSWER), 0)->ttl;
+	}
+	if (flags2 != NULL) {
+		*flags2 = knot_wire_get_flags2(answer->wire);
+	}
+
+	knot_pkt_free(answer);
+
+	return ttl;
+}
+
+/* Replace the configuration and reload the zone database, reusing the zone. */
+static int reload_acl(server_t *server, const char *db_storage, bool allow_xfr)
+{
+	char conf_str[4096 + 512];
+	(void)snprintf(conf_str, sizeof(conf_str),
+		"server:\n"
+		"    identity: bogus.ns\n"
+		"    version: 0.11\n"
+		"    nsid: \n"
+		"database:\n"
+		"    storage: %s\n"
+		"acl:\n"
+		"  - id: xfr\n"
+		"    address: 127.0.0.1\n"
+		"    action: transfer\n"
+		"zone:\n"
+		"  - domain: .\n"
+		"    zonefile-sync: -1\n"
+		"%s",
+		db_storage, allow_xfr ? "    acl: xfr\n" : "");
+
+	int ret = test_conf(conf_str, NULL);
+	if (ret == KNOT_EOK) {
+		zonedb_reload(conf(), server, RELOAD_CATALOG);
+	}
+	return ret;
+}
+
 /* \internal Helpers */
 #define WIRE_COPY(dst, dst_len, src, src_len) \
 	memcpy(dst, src, src_len); \
@@ -162,11 +221,79 @@ int main(int argc, char *argv[])
 	knot_pkt_put(query, KNOT_COMPR_HINT_NONE, &soa_rr, 0);
 	exec_query(&proc, "IN/ixfr", query, KNOT_RCODE_NOTAUTH);
 
+	/* Grant AXFR with a reload, the zone is reused. */
+	ret = reload_acl(&server, temp_dir, true);
+	ok(ret == KNOT_EOK && knot_zonedb_find(server.zone_db, ROOT_DNAME) == zone &&
+	   zone->settings != NULL && zone->settings->acl.count == 1,
+	   "ns: ACL granted by reload");
+	knot_layer_reset(&proc);
+	knot_pkt_clear(query);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_AXFR);
+	exec_query(&proc, "IN/axfr-granted", query, KNOT_RCODE_NOERROR);
+
+	/* Revoke AXFR with another reload. */
+	ret = reload_acl(&server, temp_dir, false);
+	ok(ret == KNOT_EOK && knot_zonedb_find(server.zone_db, ROOT_DNAME) == zone &&
+	   zone->settings != NULL && zone->settings->acl.count == 0,
+	   "ns: ACL revoked by reload");
+	knot_layer_reset(&proc);
+	knot_pkt_clear(query);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_AXFR);
+	exec_query(&proc, "IN/axfr-revoked", query, KNOT_RCODE_NOTAUTH);
+
 	/* \note Tests below are not possible without proper zone and zone data. */
 	/* #189 Process UPDATE query. */
 	/* #189 Process AXFR client. */
 	/* #189 Process IXFR client. */
 
+	/* Query processor (answer cache). */
+	zone->contents->answer_cache = answer_cache_new(16);
+	knot_layer_reset(&proc);
+	knot_pkt_clear(query);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	uint32_t orig_ttl = exec_query_ttl(&proc, "IN/cache-fill", query, NULL);
+	/* Change the zone data behind the cache, the cached answer is expected. */
+	zone->contents->apex->rrs[0].ttl = orig_ttl + 1;
+	knot_layer_reset(&proc);
+	knot_pkt_clear(query);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	knot_wire_set_id(query->wire, knot_wire_get_id(query->wire) + 1);
+	knot_wire_set_cd(query->wire);
+	uint8_t flags2 = 0;
+	is_int(orig_ttl, exec_query_ttl(&proc, "IN/cache-hit", query, &flags2),
+	       "ns: answer from cache");
+	ok(!(flags2 & KNOT_WIRE_CD_MASK), "ns: no CD in answer from cache");
+	/* The same question over UDP must not be answered from the TCP entry. */
+	params.proto = KNOTD_QUERY_PROTO_UDP;
+	knot_layer_reset(&proc);
+	knot_pkt_clear(query);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	is_int(orig_ttl + 1, exec_query_ttl(&proc, "IN/cache-udp", query, NULL),
+	       "ns: answer not from cache of other transport");
+	params.proto = KNOTD_QUERY_PROTO_TCP;
+	zone->contents->apex->rrs[0].ttl = orig_ttl;
+
+	/* The cached answer keeps the RD and CD flags of the current response. */
+	answer_cache_t *cache = answer_cache_new(1);
+	knot_pkt_t *resp = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_pkt_put_question(resp, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	knot_wire_set_qr(resp->wire);
+	answer_cache_put(cache, resp, false, false, KNOT_RCODE_NOERROR);
+	knot_wire_set_rd(resp->wire);
+	knot_wire_set_cd(resp->wire);
+	uint16_t rcode = 0;
+	ok(answer_cache_get(cache, resp, false, false, &rcode) &&
+	   knot_wire_get_rd(resp->wire) && knot_wire_get_cd(resp->wire) &&
+	   knot_wire_get_qr(resp->wire), "ns: RD and CD set in answer from cache");
+	answer_cache_put(cache, resp, false, false, KNOT_RCODE_NOERROR);
+	knot_wire_clear_rd(resp->wire);
+	knot_wire_clear_cd(resp->wire);
+	ok(answer_cache_get(cache, resp, false, false, &rcode) &&
+	   !knot_wire_get_rd(resp->wire) && !knot_wire_get_cd(resp->wire),
+	   "ns: RD and CD clear in answer from cache");
+	knot_pkt_free(resp);
+	answer_cache_free(cache);
+
 	/* Query processor (smaller than DNS header, ignore). */
 	knot_layer_reset(&proc);
 	knot_pkt_clear(query);
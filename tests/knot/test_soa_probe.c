@@ -0,0 +1,292 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <tap/basic.h>
+#include <unistd.h>
+
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "knot/query/soa_probe.h"
+#include "libknot/libknot.h"
+
+static const int TIMEOUT = 2000;
+
+#define QUERIES	2000
+
+typedef struct {
+	pthread_mutex_t mx;
+	pthread_cond_t cond;
+	unsigned count;
+	knot_dname_t *zone;
+	soa_probe_result_t result;
+} probe_log_t;
+
+static probe_log_t plog = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static void probe_cb(const knot_dname_t *zone, const soa_probe_result_t *result,
+                     void *data)
+{
+	probe_log_t *log = data;
+	pthread_mutex_lock(&log->mx);
+	knot_dname_free(log->zone, NULL);
+	log->zone = knot_dname_copy(zone, NULL);
+	log->result = *result;
+	log->count++;
+	pthread_cond_signal(&log->cond);
+	pthread_mutex_unlock(&log->mx);
+}
+
+static bool probe_wait(probe_log_t *log, unsigned count)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += 5;
+
+	pthread_mutex_lock(&log->mx);
+	while (log->count < count &&
+	       pthread_cond_timedwait(&log->cond, &log->mx, &ts) == 0);
+	bool done = (log->count >= count);
+	pthread_mutex_unlock(&log->mx);
+
+	return done;
+}
+
+/*! \brief Receives a query on the responder socket. */
+static knot_pkt_t *recv_query(int fd, struct sockaddr_storage *from, int timeout)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	if (poll(&pfd, 1, timeout) != 1) {
+		return NULL;
+	}
+
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+	socklen_t from_len = sizeof(*from);
+	ssize_t len = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)from, &from_len);
+	if (len <= 0) {
+		return NULL;
+	}
+
+	knot_pkt_t *query = knot_pkt_new(NULL, len, NULL);
+	memcpy(query->wire, buf, len);
+	query->size = len;
+	if (knot_pkt_parse(query, 0) != KNOT_EOK) {
+		knot_pkt_free(query);
+		return NULL;
+	}
+
+	return query;
+}
+
+/*! \brief Sends a SOA response with the given ID, question and serial. */
+static void send_answer(int fd, const struct sockaddr_storage *to, uint16_t id,
+                        const knot_dname_t *qname, uint32_t serial, bool tc)
+{
+	knot_pkt_t *resp = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_wire_set_id(resp->wire, id);
+	knot_wire_set_qr(resp->wire);
+	if (tc) {
+		knot_wire_set_tc(resp->wire);
+	}
+	knot_pkt_put_question(resp, qname, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	knot_pkt_begin(resp, KNOT_ANSWER);
+
+	// Root MNAME and RNAME, serial, refresh, retry, expire, minimum.
+	uint8_t rdata[2 + 5 * sizeof(uint32_t)] = { 0 };
+	knot_wire_write_u32(rdata + 2, serial);
+	knot_rrset_t *soa = knot_rrset_new(qname, KNOT_RRTYPE_SOA, KNOT_CLASS_IN, 3600, NULL);
+	knot_rrset_add_rdata(soa, rdata, sizeof(rdata), NULL);
+	knot_pkt_put(resp, 0, soa, KNOT_PF_FREE);
+
+	(void)sendto(fd, resp->wire, resp->size, 0, (const struct sockaddr *)to,
+	             sockaddr_len(to));
+	knot_pkt_free(resp);
+}
+
+static void test_answer(soa_probe_t *probe, int fd, const conf_remote_t *remote)
+{
+	knot_dname_t *zone = knot_dname_from_str_alloc("example.com.");
+	knot_dname_t *other = knot_dname_from_str_alloc("example.net.");
+	unsigned count = plog.count;
+
+	int ret = soa_probe_submit(probe, zone, remote, NULL, TIMEOUT);
+	is_int(KNOT_EOK, ret, "answer: submit");
+
+	struct sockaddr_storage from;
+	knot_pkt_t *query = recv_query(fd, &from, TIMEOUT);
+	ok(query != NULL && knot_pkt_qtype(query) == KNOT_RRTYPE_SOA &&
+	   knot_dname_is_equal(knot_pkt_qname(query), zone), "answer: SOA query sent");
+	if (query == NULL) {
+		goto cleanup;
+	}
+	uint16_t id = knot_wire_get_id(query->wire);
+
+	/* Responses not matching the query are ignored. */
+	struct sockaddr_storage spoof_addr;
+	sockaddr_set(&spoof_addr, AF_INET, "127.0.0.1", 0);
+	int spoof = net_bound_socket(SOCK_DGRAM, &spoof_addr, 0, 0);
+	send_answer(spoof, &from, id, zone, 4, false);
+	close(spoof);
+	send_answer(fd, &from, id + 1, zone, 1, false);
+	send_answer(fd, &from, id, other, 2, false);
+	send_answer(fd, &from, id, zone, 2023, false);
+	send_answer(fd, &from, id, zone, 3, false);
+
+	ok(probe_wait(&plog, count + 1), "answer: completed");
+	usleep(100000);
+	pthread_mutex_lock(&plog.mx);
+	ok(plog.count == count + 1, "answer: completed once");
+	ok(knot_dname_is_equal(plog.zone, zone), "answer: zone name");
+	is_int(KNOT_EOK, plog.result.ret, "answer: result");
+	is_int(2023, plog.result.serial, "answer: serial");
+	ok(!plog.result.has_expire, "answer: no EDNS EXPIRE");
+	ok(sockaddr_cmp(&plog.result.remote, &remote->addr, false) == 0, "answer: remote");
+	pthread_mutex_unlock(&plog.mx);
+
+	/* Truncated response. */
+	count = plog.count;
+	ret = soa_probe_submit(probe, zone, remote, NULL, TIMEOUT);
+	knot_pkt_free(query);
+	query = recv_query(fd, &from, TIMEOUT);
+	if (ret == KNOT_EOK && query != NULL) {
+		send_answer(fd, &from, knot_wire_get_id(query->wire), zone, 5, true);
+	}
+	ok(probe_wait(&plog, count + 1) && plog.result.ret == KNOT_ESPACE,
+	   "truncated: fallback required");
+
+	/* Responses to outstanding queries matched in any order. */
+	count = plog.count;
+	ret = soa_probe_submit(probe, zone, remote, NULL, TIMEOUT);
+	ret |= soa_probe_submit(probe, other, remote, NULL, TIMEOUT);
+	knot_pkt_free(query);
+	query = recv_query(fd, &from, TIMEOUT);
+	struct sockaddr_storage other_from;
+	knot_pkt_t *other_query = recv_query(fd, &other_from, TIMEOUT);
+	ok(ret == KNOT_EOK && query != NULL && other_query != NULL,
+	   "shared: two queries sent");
+	if (query != NULL && other_query != NULL) {
+		if (!knot_dname_is_equal(knot_pkt_qname(query), zone)) {
+			knot_pkt_t *swap_pkt = query;
+			query = other_query;
+			other_query = swap_pkt;
+			struct sockaddr_storage swap_addr = from;
+			from = other_from;
+			other_from = swap_addr;
+		}
+		send_answer(fd, &other_from, knot_wire_get_id(other_query->wire), other, 20, false);
+		ok(probe_wait(&plog, count + 1) && knot_dname_is_equal(plog.zone, other) &&
+		   plog.result.serial == 20, "shared: second query answered");
+		send_answer(fd, &from, knot_wire_get_id(query->wire), zone, 10, false);
+		ok(probe_wait(&plog, count + 2) && knot_dname_is_equal(plog.zone, zone) &&
+		   plog.result.serial == 10, "shared: first query answered");
+	}
+	knot_pkt_free(other_query);
+
+cleanup:
+	knot_pkt_free(query);
+	knot_dname_free(zone, NULL);
+	knot_dname_free(other, NULL);
+}
+
+static void test_timeout(soa_probe_t *probe, int fd, const conf_remote_t *remote)
+{
+	knot_dname_t *zone = knot_dname_from_str_alloc("example.org.");
+	unsigned count = plog.count;
+
+	/* Many outstanding queries to the same remote, no limit. */
+	unsigned submitted = 0, received = 0, ports_count = 0;
+	uint16_t ports[QUERIES];
+	for (unsigned i = 0; i < QUERIES; i++) {
+		if (soa_probe_submit(probe, zone, remote, NULL, 500) == KNOT_EOK) {
+			submitted++;
+		}
+
+		/* Collect the source ports of the sent queries. */
+		struct sockaddr_storage from;
+		knot_pkt_t *query;
+		while ((i % 100 == 99) && (query = recv_query(fd, &from, 50)) != NULL) {
+			knot_pkt_free(query);
+			received++;
+			uint16_t port = sockaddr_port(&from);
+			bool seen = false;
+			for (unsigned j = 0; j < ports_count && !seen; j++) {
+				seen = (ports[j] == port);
+			}
+			if (!seen) {
+				ports[ports_count++] = port;
+			}
+		}
+	}
+	is_int(QUERIES, submitted, "timeout: submit %u queries", QUERIES);
+	ok(received > 0 && ports_count > 8 && ports_count < received,
+	   "timeout: %u source ports rotated, shared by %u queries",
+	   ports_count, received);
+
+	ok(probe_wait(&plog, count + QUERIES), "timeout: all completed");
+	is_int(KNOT_ETIMEOUT, plog.result.ret, "timeout: result");
+
+	knot_dname_free(zone, NULL);
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL); // Interrupt
+
+	conf_remote_t remote = { { 0 } };
+	sockaddr_set(&remote.addr, AF_INET, "127.0.0.1", 0);
+
+	int fd = net_bound_socket(SOCK_DGRAM, &remote.addr, 0, 0);
+	ok(fd >= 0, "bind responder");
+	socklen_t addr_len = sizeof(remote.addr);
+	int ret = getsockname(fd, (struct sockaddr *)&remote.addr, &addr_len);
+	ok(ret == 0, "responder address");
+
+	soa_probe_t *probe = soa_probe_create(probe_cb, &plog);
+	ok(probe != NULL, "create engine");
+	soa_probe_start(probe);
+
+	test_answer(probe, fd, &remote);
+	test_timeout(probe, fd, &remote);
+
+	/* Outstanding queries are dropped on destroy. */
+	knot_dname_t *zone = knot_dname_from_str_alloc("example.");
+	ret = soa_probe_submit(probe, zone, &remote, NULL, TIMEOUT);
+	is_int(KNOT_EOK, ret, "submit before stop");
+	knot_dname_free(zone, NULL);
+
+	soa_probe_stop(probe);
+	soa_probe_join(probe);
+	soa_probe_destroy(probe);
+	close(fd);
+
+	knot_dname_free(plog.zone, NULL);
+
+	return 0;
+}
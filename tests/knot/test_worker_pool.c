@@ -22,6 +22,7 @@
 #include <signal.h>
 #include <time.h>
 
+#include "knot/server/dthreads.h"
 #include "knot/worker/pool.h"
 #include "knot/worker/queue.h"
 
@@ -61,6 +62,50 @@ static void task_counting(worker_task_t *task)
 	pthread_mutex_unlock(&log->mx);
 }
 
+/*!
+ * Task recording the execution order.
+ */
+typedef struct order_log {
+	pthread_mutex_t mx;
+	worker_task_t *order[TASKS_BATCH + 1];
+	unsigned count;
+} order_log_t;
+
+static void task_ordered(worker_task_t *task)
+{
+	order_log_t *log = task->ctx;
+
+	pthread_mutex_lock(&log->mx);
+	log->order[log->count++] = task;
+	pthread_mutex_unlock(&log->mx);
+}
+
+/*!
+ * Task tracking the maximal number of concurrently running tasks.
+ */
+typedef struct concurrency_log {
+	pthread_mutex_t mx;
+	unsigned running;
+	unsigned max;
+} concurrency_log_t;
+
+static void task_concurrent(worker_task_t *task)
+{
+	concurrency_log_t *log = task->ctx;
+
+	pthread_mutex_lock(&log->mx);
+	log->running += 1;
+	log->max = (log->running > log->max) ? log->running : log->max;
+	pthread_mutex_unlock(&log->mx);
+
+	struct timespec delay = { 0, 5000000 };
+	nanosleep(&delay, NULL);
+
+	pthread_mutex_lock(&log->mx);
+	log->running -= 1;
+	pthread_mutex_unlock(&log->mx);
+}
+
 static void interrupt_handle(int s)
 {
 }
@@ -148,5 +193,78 @@ int main(void)
 
 	pthread_mutex_destroy(&log.mx);
 
+	// priority tasks run first
+
+	pool = worker_pool_create(1);
+	ok(pool != NULL, "create single-thread pool");
+	if (!pool) {
+		return 1;
+	}
+
+	order_log_t order = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+	};
+	worker_task_t ordered[TASKS_BATCH];
+	for (int i = 0; i < TASKS_BATCH; i++) {
+		ordered[i] = (worker_task_t){ .run = task_ordered, .ctx = &order };
+		worker_pool_assign(pool, &ordered[i]);
+	}
+	worker_task_t prio = { .run = task_ordered, .ctx = &order, .flags = WORKER_TASK_PRIO };
+	worker_pool_assign(pool, &prio);
+
+	worker_pool_start(pool);
+	worker_pool_wait(pool);
+	ok(order.count == TASKS_BATCH + 1 && order.order[0] == &prio,
+	   "priority task executed first");
+	bool fifo = true;
+	for (int i = 0; i < TASKS_BATCH && order.count == TASKS_BATCH + 1; i++) {
+		fifo &= (order.order[i + 1] == &ordered[i]);
+	}
+	ok(fifo, "ordinary tasks executed in order");
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+	pthread_mutex_destroy(&order.mx);
+
+	// CPU-heavy tasks are limited to the number of CPUs
+
+	pool = worker_pool_create(THREADS);
+	ok(pool != NULL, "create worker pool");
+	if (!pool) {
+		return 1;
+	}
+
+	concurrency_log_t cpu_log = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+	};
+	concurrency_log_t io_log = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+	};
+	worker_task_t cpu_task = { .run = task_concurrent, .ctx = &cpu_log, .flags = WORKER_TASK_CPU };
+	worker_task_t io_task = { .run = task_concurrent, .ctx = &io_log };
+	for (int i = 0; i < TASKS_BATCH; i++) {
+		worker_pool_assign(pool, &cpu_task);
+		worker_pool_assign(pool, &io_task);
+	}
+
+	worker_pool_start(pool);
+	worker_pool_wait(pool);
+
+	int running, queued;
+	worker_pool_status(pool, &running, &queued);
+	ok(running == 0 && queued == 0, "status after wait");
+
+	int cpus = dt_online_cpus();
+	unsigned cpu_limit = (cpus > 0 && cpus < THREADS) ? cpus : THREADS;
+	ok(cpu_log.max >= 1 && cpu_log.max <= cpu_limit,
+	   "concurrent CPU-heavy tasks limited (%u/%u)", cpu_log.max, cpu_limit);
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+	pthread_mutex_destroy(&cpu_log.mx);
+	pthread_mutex_destroy(&io_log.mx);
+
 	return 0;
 }
@@ -14,6 +14,7 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
 #include <tap/basic.h>
 
 #include "knot/worker/queue.h"
@@ -53,5 +54,28 @@ int main(void)
 	worker_queue_deinit(&queue);
 	ok(1, "queue deinit");
 
+	// growing and wrapping around
+
+	worker_task_t tasks[100] = { 0 };
+	worker_queue_init(&queue);
+	bool order = true;
+	for (int i = 0; i < 10; i++) {
+		worker_queue_enqueue(&queue, &tasks[i]);
+	}
+	for (int i = 0; i < 5; i++) {
+		order &= (worker_queue_dequeue(&queue) == &tasks[i]);
+	}
+	for (int i = 10; i < 100; i++) {
+		worker_queue_enqueue(&queue, &tasks[i]);
+	}
+	ok(worker_queue_length(&queue) == 95, "length after growing");
+	ok(worker_queue_dequeue_last(&queue) == &tasks[99], "dequeue last");
+	for (int i = 5; i < 99; i++) {
+		order &= (worker_queue_dequeue(&queue) == &tasks[i]);
+	}
+	ok(order, "order after growing");
+	ok(worker_queue_dequeue_last(&queue) == NULL, "dequeue last from empty");
+	worker_queue_deinit(&queue);
+
 	return 0;
 }
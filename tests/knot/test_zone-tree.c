@@ -18,9 +18,11 @@
 #include <tap/basic.h>
 
 #include "libknot/errcode.h"
+#include "knot/zone/adjust.h"
 #include "knot/zone/zone-tree.h"
 
 #define NCOUNT 4
+#define BCOUNT 256
 static knot_dname_t* NAME[NCOUNT];
 static zone_node_t NODEE[NCOUNT];
 static knot_dname_t* ORDER[NCOUNT];
@@ -68,6 +70,54 @@ static int ztree_iter_data(zone_node_t *node, void *data)
 	return result;
 }
 
+static bool ztree_prevs_ok(zone_tree_t *t)
+{
+	zone_tree_it_t it = { 0 };
+	if (zone_tree_it_begin(t, &it) != KNOT_EOK) {
+		return false;
+	}
+	zone_node_t *first = zone_tree_it_val(&it), *prev = NULL;
+	bool ok = true;
+	while (!zone_tree_it_finished(&it)) {
+		zone_node_t *node = zone_tree_it_val(&it);
+		ok &= (prev == NULL || node->prev == prev);
+		prev = node;
+		zone_tree_it_next(&it);
+	}
+	zone_tree_it_free(&it);
+	return ok && first->prev == prev;
+}
+
+/*! Checks that each node points to the closest preceding node with data. */
+static bool ztree_prevs_skip_ok(zone_tree_t *t)
+{
+	size_t count = zone_tree_count(t), i = 0;
+	zone_node_t **nodes = malloc(count * sizeof(*nodes));
+	zone_tree_it_t it = { 0 };
+	if (nodes == NULL || zone_tree_it_begin(t, &it) != KNOT_EOK) {
+		free(nodes);
+		return false;
+	}
+	while (!zone_tree_it_finished(&it)) {
+		nodes[i++] = zone_tree_it_val(&it);
+		zone_tree_it_next(&it);
+	}
+	zone_tree_it_free(&it);
+
+	bool ok = true;
+	for (i = 0; i < count; i++) {
+		for (size_t back = 1; back <= count; back++) {
+			zone_node_t *prev = nodes[(i + count - back) % count];
+			if (prev->rrset_count > 0 && !(prev->flags & NODE_FLAGS_NONAUTH)) {
+				ok &= (nodes[i]->prev == prev);
+				break;
+			}
+		}
+	}
+	free(nodes);
+	return ok;
+}
+
 static int ztree_node_counter(zone_node_t *node, void *data)
 {
 	(void)node;
@@ -129,7 +179,112 @@ int main(int argc, char *argv[])
 	ret = zone_tree_sub_apply(t, (const knot_dname_t *)"\x02""ac", true, ztree_node_counter, &counter);
 	ok(ret == KNOT_EOK && counter == 1, "ztree: subtree iteration excluding root");
 
+	/* 7. cyclic iteration */
+	zone_tree_it_t it = { 0 };
+	tmp_dn = knot_dname_from_str_alloc("a.");
+	ret = zone_tree_it_leq_begin(t, tmp_dn, &it);
+	ok(ret == 0 && zone_tree_it_val(&it) == NODEE + 0, "ztree: cyclic iteration start");
+	zone_tree_it_next_loop(&it);
+	zone_tree_it_next_loop(&it);
+	zone_tree_it_next_loop(&it);
+	ok(zone_tree_it_val(&it) == NODEE + 3, "ztree: cyclic iteration forward");
+	zone_tree_it_next_loop(&it);
+	ok(zone_tree_it_val(&it) == NODEE + 0, "ztree: cyclic iteration over the end");
+	zone_tree_it_prev_loop(&it);
+	ok(zone_tree_it_val(&it) == NODEE + 3, "ztree: cyclic iteration over the begin");
+	zone_tree_it_free(&it);
+	ret = zone_tree_it_leq_begin(t, NAME[1], &it);
+	ok(ret > 0 && zone_tree_it_val(&it) == NODEE + 1, "ztree: cyclic iteration exact start");
+	zone_tree_it_free(&it);
+	knot_dname_free(tmp_dn, NULL);
+
+	/* 8. incremental prev pointers */
+	zone_tree_t *changed = zone_tree_create(false);
+	ret = zone_adjust_prevs_incremental(t, t, NULL);
+	ok(ret == KNOT_EOK && ztree_prevs_ok(t), "ztree: prevs of all nodes");
+
+	zone_tree_remove_node(t, NAME[1]);
+	NODEE[1].flags |= NODE_FLAGS_DELETED;
+	node = NODEE + 1;
+	zone_tree_insert(changed, &node);
+	ret = zone_adjust_prevs_incremental(t, changed, NULL);
+	ok(ret == KNOT_EOK && ztree_prevs_ok(t), "ztree: prevs after removal");
+
+	NODEE[1].flags &= ~NODE_FLAGS_DELETED;
+	zone_tree_insert(t, &node);
+	zone_tree_remove_node(t, NAME[0]);
+	NODEE[0].flags |= NODE_FLAGS_DELETED;
+	node = NODEE + 0;
+	zone_tree_insert(changed, &node);
+	ret = zone_adjust_prevs_incremental(t, changed, NULL);
+	ok(ret == KNOT_EOK && ztree_prevs_ok(t), "ztree: prevs after insertion and removal");
+
+	NODEE[2].rrset_count = 0;
+	node = NODEE + 2;
+	zone_tree_insert(changed, &node);
+	ret = zone_adjust_prevs_incremental(t, changed, NULL);
+	ok(ret == KNOT_EOK && NODEE[1].prev == NODEE + 3 && NODEE[2].prev == NODEE + 3,
+	   "ztree: prevs skip empty node");
+	zone_tree_free(&changed);
+
 	zone_tree_free(&t);
+
+	/* 9. incremental prev pointers of a bigger tree */
+	zone_node_t *big = calloc(BCOUNT, sizeof(*big));
+	const zone_node_t *big_prevs[BCOUNT];
+	t = zone_tree_create(false);
+	for (i = 0; i < BCOUNT; i++) {
+		char owner[16];
+		(void)snprintf(owner, sizeof(owner), "n%u.test.", i);
+		big[i].owner = knot_dname_from_str_alloc(owner);
+		big[i].rrset_count = 1;
+		node = big + i;
+		zone_tree_insert(t, &node);
+	}
+	ret = zone_adjust_prevs_incremental(t, t, NULL);
+	ok(ret == KNOT_EOK && ztree_prevs_ok(t), "ztree: prevs of a bigger tree");
+
+	passed = 1;
+	for (unsigned round = 2; round < 8 && passed; round++) {
+		changed = zone_tree_create(false);
+		zone_tree_t *changed_prevs = zone_tree_create(false);
+		for (i = 0; i < BCOUNT; i++) {
+			node = big + i;
+			big_prevs[i] = node->prev;
+			if (i % round == 0) {
+				if (node->flags & NODE_FLAGS_DELETED) {
+					node->flags &= ~NODE_FLAGS_DELETED;
+					zone_tree_insert(t, &node);
+				} else {
+					zone_tree_remove_node(t, node->owner);
+					node->flags |= NODE_FLAGS_DELETED;
+				}
+				zone_tree_insert(changed, &node);
+			} else if (i % 11 == round) {
+				node->flags ^= NODE_FLAGS_NONAUTH;
+				zone_tree_insert(changed, &node);
+			}
+		}
+		ret = zone_adjust_prevs_incremental(t, changed, changed_prevs);
+		passed = (ret == KNOT_EOK && ztree_prevs_skip_ok(t));
+		for (i = 0; i < BCOUNT; i++) {
+			node = big + i;
+			if (!(node->flags & NODE_FLAGS_DELETED) && node->prev != big_prevs[i] &&
+			    zone_tree_get(changed_prevs, node->owner) != node) {
+				passed = 0;
+			}
+		}
+		zone_tree_free(&changed_prevs);
+		zone_tree_free(&changed);
+	}
+	ok(passed, "ztree: prevs after repeated changes of a bigger tree");
+
+	zone_tree_free(&t);
+	for (i = 0; i < BCOUNT; i++) {
+		knot_dname_free(big[i].owner, NULL);
+	}
+	free(big);
+
 	ztree_free_data();
 	return 0;
 }
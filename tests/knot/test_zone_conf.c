@@ -0,0 +1,107 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <tap/basic.h>
+
+#include "test_conf.h"
+#include "knot/zone/zone-conf.h"
+#include "libknot/libknot.h"
+
+static void test_values(const char *zone_str, bool provide_ixfr, bool signing,
+                        unsigned serial_policy, size_t max_usage, int64_t sync,
+                        const char *acl)
+{
+	knot_dname_t *zone = knot_dname_from_str_alloc(zone_str);
+	zone_conf_t *zconf = zone_conf_new(conf(), zone);
+	ok(zconf != NULL, "%s: resolve", zone_str);
+	if (zconf == NULL) {
+		knot_dname_free(zone, NULL);
+		return;
+	}
+
+	ok(zconf->provide_ixfr == provide_ixfr &&
+	   zone_conf_provide_ixfr(conf(), NULL, zone) == provide_ixfr,
+	   "%s: provide-ixfr", zone_str);
+	ok(zconf->dnssec_signing == signing &&
+	   zone_conf_dnssec_signing(conf(), NULL, zone) == signing,
+	   "%s: dnssec-signing", zone_str);
+	ok(zconf->serial_policy == serial_policy &&
+	   zone_conf_serial_policy(conf(), NULL, zone) == serial_policy,
+	   "%s: serial-policy", zone_str);
+	ok(zconf->journal_max_usage == max_usage &&
+	   zone_conf_journal_max_usage(conf(), NULL, zone) == max_usage,
+	   "%s: journal-max-usage", zone_str);
+	zone_conf_t *none = NULL;
+	ok(zconf->zonefile_sync == sync &&
+	   zone_conf_zonefile_sync(conf(), &zconf, zone) == sync &&
+	   zone_conf_zonefile_sync(conf(), &none, zone) == sync,
+	   "%s: zonefile-sync", zone_str);
+	ok(zconf->acl.count == 1 && strcmp(zconf->acl.ids[0], acl) == 0 &&
+	   zconf->notify.count == 0, "%s: ACL identifiers", zone_str);
+
+	zone_conf_free(zconf);
+	knot_dname_free(zone, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	const char *conf_str =
+		"remote:\n"
+		"  - id: r1\n"
+		"    address: 127.0.0.1\n"
+		"acl:\n"
+		"  - id: a1\n"
+		"    action: transfer\n"
+		"  - id: a2\n"
+		"    action: notify\n"
+		"template:\n"
+		"  - id: default\n"
+		"    acl: a1\n"
+		"    journal-max-usage: 1M\n"
+		"  - id: signed\n"
+		"    dnssec-signing: on\n"
+		"    serial-policy: unixtime\n"
+		"    acl: a2\n"
+		"    master: r1\n"
+		"zone:\n"
+		"  - domain: example.com.\n"
+		"  - domain: example.net.\n"
+		"    template: signed\n"
+		"    provide-ixfr: off\n"
+		"    zonefile-sync: -1\n";
+
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "prepare configuration");
+
+	test_values("example.com.", true, false, SERIAL_POLICY_INCREMENT,
+	            1024 * 1024, 0, "a1");
+	test_values("example.net.", false, true, SERIAL_POLICY_UNIXTIME,
+	            100 * 1024 * 1024, -1, "a2");
+
+	knot_dname_t *zone = knot_dname_from_str_alloc("example.net.");
+	zone_conf_t *zconf = zone_conf_new(conf(), zone);
+	ok(zconf != NULL && zconf->master.count == 1 &&
+	   strcmp(zconf->master.ids[0], "r1") == 0, "example.net.: master identifiers");
+	zone_conf_free(zconf);
+	knot_dname_free(zone, NULL);
+
+	test_conf_free();
+
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "libknot/libknot.h"
+#include "knot/zone/snapshot.h"
+#include "knot/zone/zonefile.h"
+
+static const char *zone_str =
+"$ORIGIN test.\n"
+"@ 600 SOA ns admin 1 3600 900 86400 300\n"
+"@ NS ns\n"
+"ns A 192.0.2.1\n"
+"ns AAAA 2001:db8::1\n"
+"a.b.c TXT \"empty non-terminals\"\n"
+"*.w 300 MX 10 mail\n"
+"sub NS ns.sub\n"
+"ns.sub A 192.0.2.2\n"
+"x\\000y TXT \"binary label\"\n"
+"MH1LFFUP5S3D0VT1D0UQJJO9EKOVCIIQ NSEC3 1 0 0 - N2CBIKF6BTD4SCUBNAQG7ANFUUH8NNT4 A NS SOA\n"
+"N2CBIKF6BTD4SCUBNAQG7ANFUUH8NNT4 NSEC3 1 0 0 - MH1LFFUP5S3D0VT1D0UQJJO9EKOVCIIQ A AAAA\n";
+
+static zone_contents_t *load_zone(const char *path)
+{
+	knot_dname_t *origin = knot_dname_from_str_alloc("test.");
+
+	zloader_t zl;
+	int ret = zonefile_open(&zl, path, origin, SEMCHECK_MANDATORY_SOFT, 0);
+	knot_dname_free(origin, NULL);
+	if (ret != KNOT_EOK) {
+		return NULL;
+	}
+
+	sem_handler_t handler = {
+		.cb = err_handler_logger
+	};
+	zl.err_handler = &handler;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+static bool node_equal(const zone_node_t *n1, const zone_node_t *n2)
+{
+	if (n1 == NULL || n2 == NULL || n1->rrset_count != n2->rrset_count ||
+	    n1->children != n2->children || n1->flags != n2->flags ||
+	    (n1->parent == NULL) != (n2->parent == NULL) ||
+	    (n1->parent != NULL && !knot_dname_is_equal(n1->parent->owner,
+	                                                n2->parent->owner))) {
+		return false;
+	}
+
+	for (uint16_t i = 0; i < n1->rrset_count; i++) {
+		knot_rrset_t rr1 = node_rrset_at(n1, i);
+		knot_rrset_t rr2 = node_rrset(n2, rr1.type);
+		if (!knot_rrset_equal(&rr1, &rr2, true) || rr1.ttl != rr2.ttl) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool tree_equal(zone_tree_t *t1, zone_tree_t *t2)
+{
+	if (zone_tree_count(t1) != zone_tree_count(t2)) {
+		return false;
+	}
+
+	zone_tree_it_t it = { 0 };
+	bool equal = (zone_tree_it_begin(t1, &it) == KNOT_EOK);
+	while (equal && !zone_tree_it_finished(&it)) {
+		zone_node_t *n1 = zone_tree_it_val(&it);
+		equal = node_equal(n1, zone_tree_get(t2, n1->owner));
+		zone_tree_it_next(&it);
+	}
+	zone_tree_it_free(&it);
+
+	return equal;
+}
+
+static bool truncate_file(const char *path, off_t size)
+{
+	return truncate(path, size) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *temp_dir = test_mkdtemp();
+	ok(temp_dir != NULL, "make temporary directory");
+
+	char zone_path[1024];
+	(void)snprintf(zone_path, sizeof(zone_path), "%s/test.zone", temp_dir);
+
+	FILE *f = fopen(zone_path, "w");
+	ok(f != NULL && fputs(zone_str, f) >= 0, "write zone file");
+	if (f != NULL) {
+		fclose(f);
+	}
+
+	char *snap_path = zone_snapshot_path(zone_path);
+	ok(snap_path != NULL &&
+	   strcmp(snap_path + strlen(snap_path) - strlen(".zone.snap"), ".zone.snap") == 0,
+	   "snapshot path");
+
+	struct stat st;
+	ok(stat(zone_path, &st) == 0, "zone file status");
+
+	knot_dname_t *origin = knot_dname_from_str_alloc("test.");
+	zone_contents_t *text = load_zone(zone_path);
+	ok(text != NULL, "load zone file");
+
+	uint64_t params = zone_snapshot_params(SEMCHECK_MANDATORY_SOFT, false, true);
+
+	zone_contents_t *snap = NULL;
+	int ret = zone_snapshot_load(snap_path, origin, &st, params, &snap);
+	is_int(KNOT_ENOENT, ret, "load missing snapshot");
+
+	ret = zone_snapshot_write(snap_path, text, &st, params);
+	is_int(KNOT_EOK, ret, "write snapshot");
+	ok(zone_snapshot_detect(snap_path), "detect snapshot");
+	ok(!zone_snapshot_detect(zone_path), "detect zone file");
+
+	ret = zone_snapshot_load(snap_path, origin, &st, params, &snap);
+	is_int(KNOT_EOK, ret, "load snapshot");
+	if (ret == KNOT_EOK) {
+		ok(tree_equal(text->nodes, snap->nodes), "normal tree equal");
+		ok(tree_equal(text->nsec3_nodes, snap->nsec3_nodes), "NSEC3 tree equal");
+		ok(text->size == snap->size && text->max_ttl == snap->max_ttl,
+		   "zone size and max TTL equal");
+		zone_contents_deep_free(snap);
+		snap = NULL;
+	}
+
+	struct stat other = st;
+	other.st_mtim.tv_sec++;
+	ret = zone_snapshot_load(snap_path, origin, &other, params, &snap);
+	is_int(KNOT_ENOENT, ret, "load stale snapshot");
+
+	/* The zone file rewritten with the modification time preserved. */
+	other = st;
+	other.st_size++;
+	ret = zone_snapshot_load(snap_path, origin, &other, params, &snap);
+	is_int(KNOT_ENOENT, ret, "load snapshot of a resized zone file");
+	other = st;
+	other.st_ino++;
+	other.st_ctim.tv_sec++;
+	ret = zone_snapshot_load(snap_path, origin, &other, params, &snap);
+	is_int(KNOT_ENOENT, ret, "load snapshot of a replaced zone file");
+
+	/* The zone file loaded differently. */
+	uint64_t other_params = zone_snapshot_params(SEMCHECK_DNSSEC_ON, false, true);
+	ret = zone_snapshot_load(snap_path, origin, &st, other_params, &snap);
+	is_int(KNOT_ENOENT, ret, "load snapshot with other semantic checks");
+	other_params = zone_snapshot_params(SEMCHECK_MANDATORY_SOFT, false, false);
+	ret = zone_snapshot_load(snap_path, origin, &st, other_params, &snap);
+	is_int(KNOT_ENOENT, ret, "load snapshot of a bootstrapped zone");
+	ret = zone_snapshot_load(snap_path, origin, NULL, other_params, &snap);
+	is_int(KNOT_EOK, ret, "load snapshot without a zone file");
+	zone_contents_deep_free(snap);
+	snap = NULL;
+
+	knot_dname_t *wrong = knot_dname_from_str_alloc("other.");
+	ret = zone_snapshot_load(snap_path, wrong, NULL, params, &snap);
+	is_int(KNOT_EOUTOFZONE, ret, "load snapshot of another zone");
+	knot_dname_free(wrong, NULL);
+
+	ok(truncate_file(snap_path, 200), "truncate snapshot");
+	ret = zone_snapshot_load(snap_path, origin, &st, params, &snap);
+	is_int(KNOT_EMALF, ret, "load truncated snapshot");
+	ok(snap == NULL, "no contents from truncated snapshot");
+
+	zone_contents_deep_free(text);
+	knot_dname_free(origin, NULL);
+	free(snap_path);
+
+	test_rm_rf(temp_dir);
+	free(temp_dir);
+
+	return 0;
+}
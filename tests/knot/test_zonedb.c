@@ -95,6 +95,28 @@ int main(int argc, char *argv[])
 	}
 	ok(nr_passed == ZONE_COUNT, "zonedb: find zones for subnames");
 
+	/* Labels with zero bytes don't match a zone by the lookup format prefix. */
+	const char *zero_pairs[][2] = {
+		{ "c\\000x.a.com.", "a.com." },
+		{ "x.b\\000.a.com.", "a.com." },
+	};
+	nr_passed = 0;
+	for (unsigned i = 0; i < sizeof(zero_pairs) / sizeof(zero_pairs[0]); ++i) {
+		dname = knot_dname_from_str_alloc(zero_pairs[i][0]);
+		knot_dname_t *exp = (zero_pairs[i][1] != NULL) ?
+		                    knot_dname_from_str_alloc(zero_pairs[i][1]) : NULL;
+		zone_t *zone = knot_zonedb_find_suffix(db, dname);
+		if ((zone == NULL && exp == NULL) ||
+		    (zone != NULL && exp != NULL && knot_dname_is_equal(zone->name, exp))) {
+			++nr_passed;
+		} else {
+			diag("knot_zonedb_find_suffix(%s) failed", zero_pairs[i][0]);
+		}
+		knot_dname_free(dname, NULL);
+		knot_dname_free(exp, NULL);
+	}
+	ok(nr_passed == 2, "zonedb: find zones for subnames with zero bytes");
+
 	/* Remove all zones. */
 	nr_passed = 0;
 	for (unsigned i = 0; i < ZONE_COUNT; ++i) {
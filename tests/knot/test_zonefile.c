@@ -0,0 +1,190 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "libknot/libknot.h"
+#include "knot/zone/zonefile.h"
+
+#define RECORDS		100000
+#define THREADS		4
+
+static const char *include_str = "inc A 192.0.2.53\n";
+
+/*!
+ * Big enough zone to be split into chunks. Owners repeat throughout the file
+ * and the records contain tricky syntax near possible chunk boundaries.
+ */
+static bool write_zone(const char *path, const char *include, unsigned error_at)
+{
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		return false;
+	}
+
+	fprintf(f, "$ORIGIN test.\n"
+	           "@ 600 SOA ns admin 1 3600 900 86400 300\n"
+	           "@ NS ns\n"
+	           "ns A 192.0.2.1\n");
+
+	for (unsigned i = 0; i < RECORDS; i++) {
+		if (i % 1000 == 0) {
+			unsigned section = (i / 1000) % 7;
+			fprintf(f, "$ORIGIN s%u.test.\n$TTL %u\n", section, 100 + section);
+		}
+		if (i == RECORDS / 2 && include != NULL) {
+			fprintf(f, "$INCLUDE %s ; included\n", include);
+		}
+		if (i == error_at) {
+			fprintf(f, "bad%u A 192.0.2.256\n", i);
+		}
+
+		switch (i % 5) {
+		case 0:
+			fprintf(f, "r%u TXT \"a;b (c\" ; comment (\n", i % 300);
+			break;
+		case 1:
+			fprintf(f, "m%u IN TXT ( \"line;%u\"\n"
+			           "\t\"line)%u\" ) ; \"comment\n", i % 400, i, i);
+			break;
+		case 2:
+			fprintf(f, "*.w%u A 192.0.2.%u\n", i % 50, i % 250);
+			break;
+		case 3:
+			fprintf(f, "c%u.test. 3600 A 192.0.2.%u\n"
+			           "\t3600 AAAA 2001:db8::%x\n", i % 1000, i % 250, i & 0xffff);
+			break;
+		default:
+			fprintf(f, "x\\(%u\\; TXT \\\"%u\n", i % 100, i);
+			break;
+		}
+	}
+
+	fclose(f);
+	return true;
+}
+
+static zone_contents_t *load_zone(const char *path, unsigned threads)
+{
+	knot_dname_t *origin = knot_dname_from_str_alloc("test.");
+
+	zloader_t zl;
+	int ret = zonefile_open(&zl, path, origin, SEMCHECK_MANDATORY_SOFT, 0);
+	knot_dname_free(origin, NULL);
+	if (ret != KNOT_EOK) {
+		return NULL;
+	}
+
+	sem_handler_t handler = {
+		.cb = err_handler_logger
+	};
+	zl.err_handler = &handler;
+	zl.threads = threads;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+static bool node_equal(const zone_node_t *n1, const zone_node_t *n2)
+{
+	if (n1 == NULL || n2 == NULL || n1->rrset_count != n2->rrset_count ||
+	    n1->children != n2->children || n1->flags != n2->flags ||
+	    (n1->parent == NULL) != (n2->parent == NULL) ||
+	    (n1->parent != NULL && !knot_dname_is_equal(n1->parent->owner,
+	                                                n2->parent->owner))) {
+		return false;
+	}
+
+	for (uint16_t i = 0; i < n1->rrset_count; i++) {
+		knot_rrset_t rr1 = node_rrset_at(n1, i);
+		knot_rrset_t rr2 = node_rrset(n2, rr1.type);
+		if (!knot_rrset_equal(&rr1, &rr2, true)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool tree_equal(zone_tree_t *t1, zone_tree_t *t2)
+{
+	if (zone_tree_count(t1) != zone_tree_count(t2)) {
+		return false;
+	}
+
+	zone_tree_it_t it = { 0 };
+	bool equal = (zone_tree_it_begin(t1, &it) == KNOT_EOK);
+	while (equal && !zone_tree_it_finished(&it)) {
+		zone_node_t *n1 = zone_tree_it_val(&it);
+		equal = node_equal(n1, zone_tree_get(t2, n1->owner));
+		zone_tree_it_next(&it);
+	}
+	zone_tree_it_free(&it);
+
+	return equal;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *temp_dir = test_mkdtemp();
+	ok(temp_dir != NULL, "make temporary directory");
+
+	char zone_path[1024], include_path[1024];
+	(void)snprintf(zone_path, sizeof(zone_path), "%s/test.zone", temp_dir);
+	(void)snprintf(include_path, sizeof(include_path), "%s/include.zone", temp_dir);
+
+	FILE *f = fopen(include_path, "w");
+	ok(f != NULL && fputs(include_str, f) >= 0, "write included file");
+	if (f != NULL) {
+		fclose(f);
+	}
+
+	ok(write_zone(zone_path, "include.zone", UINT32_MAX), "write zone file");
+
+	zone_contents_t *seq = load_zone(zone_path, 1);
+	ok(seq != NULL, "sequential load");
+	zone_contents_t *par = load_zone(zone_path, THREADS);
+	ok(par != NULL, "parallel load");
+
+	if (seq != NULL && par != NULL) {
+		ok(tree_equal(seq->nodes, par->nodes) &&
+		   zone_tree_count(par->nsec3_nodes) == 0,
+		   "parallel load equals sequential load");
+
+		knot_dname_t *inc = knot_dname_from_str_alloc("inc.s1.test.");
+		ok(node_rrtype_exists(zone_contents_find_node(par, inc), KNOT_RRTYPE_A),
+		   "included record in parallel load");
+		knot_dname_free(inc, NULL);
+	}
+	zone_contents_deep_free(seq);
+	zone_contents_deep_free(par);
+
+	ok(write_zone(zone_path, NULL, RECORDS - 10), "write zone file with error");
+	ok(load_zone(zone_path, THREADS) == NULL, "parallel load with error in last chunk");
+
+	test_rm_rf(temp_dir);
+	free(temp_dir);
+
+	return 0;
+}
@@ -115,6 +115,12 @@ static void ctl_server(const char *socket, size_t argc, knot_ctl_data_t *argv)
 	ret = knot_ctl_accept(ctl);
 	is_int(KNOT_EOK, ret, "Accept a connection");
 
+	// Process the connection in a separate context.
+	knot_ctl_t *listener = ctl;
+	ctl = knot_ctl_detach(listener);
+	ok(ctl != NULL, "Take over the connection");
+	ok(knot_ctl_detach(listener) == NULL, "No connection to take over");
+
 	diag("BEGIN: Server <- Client");
 
 	size_t count = 0;
@@ -168,9 +174,10 @@ static void ctl_server(const char *socket, size_t argc, knot_ctl_data_t *argv)
 
 	diag("END: Server -> Client");
 
-	knot_ctl_close(ctl);
-	knot_ctl_unbind(ctl);
 	knot_ctl_free(ctl);
+
+	knot_ctl_unbind(listener);
+	knot_ctl_free(listener);
 }
 
 static void test_client_server_client(void)
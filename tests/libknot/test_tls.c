@@ -0,0 +1,382 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tap/basic.h"
+#include "tap/files.h"
+#include "libknot/packet/wire.h"
+#include "libknot/quic/quic.h"
+#include "libknot/quic/tls.c"
+
+#define TIMEOUT 2000
+
+static const uint8_t query[] = "\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+                               "\x00\x00\x06\x00\x01";
+static const uint8_t answer[] = "\x12\x34\x81\x80\x00\x01\x00\x00\x00\x00\x00\x00"
+                                "\x00\x00\x06\x00\x01";
+
+static gnutls_certificate_credentials_t client_cred;
+
+static void set_nonblock(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	(void)fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static gnutls_session_t client_new(int fd)
+{
+	gnutls_session_t session;
+	if (gnutls_init(&session, GNUTLS_CLIENT | GNUTLS_NONBLOCK) != GNUTLS_E_SUCCESS) {
+		return NULL;
+	}
+	if (gnutls_set_default_priority(session) != GNUTLS_E_SUCCESS ||
+	    gnutls_credentials_set(session, GNUTLS_CRD_CERTIFICATE,
+	                           client_cred) != GNUTLS_E_SUCCESS ||
+	    gnutls_alpn_set_protocols(session, &dot_alpn, 1, 0) != GNUTLS_E_SUCCESS) {
+		gnutls_deinit(session);
+		return NULL;
+	}
+	gnutls_transport_set_int(session, fd);
+
+	return session;
+}
+
+static void client_wait(gnutls_session_t session)
+{
+	struct pollfd pfd = {
+		.fd = gnutls_transport_get_int(session),
+		.events = gnutls_record_get_direction(session) ? POLLOUT : POLLIN
+	};
+	(void)poll(&pfd, 1, TIMEOUT);
+}
+
+/*! \brief Interleave client and server handshake steps in one thread. */
+static int handshake(knot_tls_conn_t *conn, gnutls_session_t client)
+{
+	bool client_done = false;
+	for (int i = 0; i < 100; i++) {
+		if (!client_done) {
+			int ret = gnutls_handshake(client);
+			if (ret == GNUTLS_E_SUCCESS) {
+				client_done = true;
+			} else if (gnutls_error_is_fatal(ret) != 0) {
+				return KNOT_ECONN;
+			}
+		}
+
+		int ret = knot_tls_handshake(conn, TIMEOUT);
+		if (ret == KNOT_EOK && client_done) {
+			return KNOT_EOK;
+		} else if (ret != KNOT_EOK && ret != KNOT_EAGAIN) {
+			return ret;
+		}
+
+		/* Data in flight on TCP. */
+		struct pollfd pfd[] = {
+			{ .fd = conn->fd, .events = POLLIN },
+			{ .fd = gnutls_transport_get_int(client), .events = POLLIN }
+		};
+		(void)poll(pfd, 2, 10);
+	}
+
+	return KNOT_ETIMEOUT;
+}
+
+static bool client_send(gnutls_session_t client, const uint8_t *data, size_t len)
+{
+	size_t done = 0;
+	while (done < len) {
+		ssize_t ret = gnutls_record_send(client, data + done, len - done);
+		if (ret > 0) {
+			done += ret;
+		} else if (ret == GNUTLS_E_AGAIN) {
+			client_wait(client);
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool client_send_dns(gnutls_session_t client, const uint8_t *msg, size_t len)
+{
+	uint8_t buf[2 + len];
+	knot_wire_write_u16(buf, len);
+	memcpy(buf + 2, msg, len);
+
+	return client_send(client, buf, sizeof(buf));
+}
+
+static bool client_recv_dns(gnutls_session_t client, const uint8_t *msg, size_t len)
+{
+	uint8_t buf[2 + len];
+	size_t done = 0;
+	while (done < sizeof(buf)) {
+		ssize_t ret = gnutls_record_recv(client, buf + done, sizeof(buf) - done);
+		if (ret > 0) {
+			done += ret;
+		} else if (ret == GNUTLS_E_AGAIN) {
+			client_wait(client);
+		} else {
+			return false;
+		}
+	}
+
+	return knot_wire_read_u16(buf) == len && memcmp(buf + 2, msg, len) == 0;
+}
+
+/*! \brief Query from the client, answer from the server. */
+static void exchange(knot_tls_conn_t *conn, gnutls_session_t client, const char *msg)
+{
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+
+	ok(client_send_dns(client, query, sizeof(query)), "%s: client send", msg);
+	ssize_t ret = knot_tls_recv_dns(conn, buf, sizeof(buf), TIMEOUT);
+	ok(ret == sizeof(query) && memcmp(buf, query, sizeof(query)) == 0,
+	   "%s: server receive", msg);
+
+	ret = knot_tls_send_dns(conn, answer, sizeof(answer), TIMEOUT);
+	is_int(sizeof(answer), ret, "%s: server send", msg);
+	ok(client_recv_dns(client, answer, sizeof(answer)), "%s: client receive", msg);
+}
+
+static void test_socketpair(struct knot_quic_creds *creds)
+{
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		skip_block(20, "socketpair");
+		return;
+	}
+	set_nonblock(fds[0]);
+	set_nonblock(fds[1]);
+
+	knot_tls_conn_t *conn = knot_tls_conn_new(creds, fds[0]);
+	gnutls_session_t client = client_new(fds[1]);
+	ok(conn != NULL && client != NULL, "socketpair: create connection");
+
+	/* Handshake. */
+	int ret = knot_tls_handshake(conn, TIMEOUT);
+	is_int(KNOT_EAGAIN, ret, "handshake: no blocking without client data");
+	ret = handshake(conn, client);
+	is_int(KNOT_EOK, ret, "handshake: finished");
+	ok(conn->handshake_done, "handshake: done flag");
+	gnutls_datum_t alpn;
+	ok(gnutls_alpn_get_selected_protocol(client, &alpn) == GNUTLS_E_SUCCESS &&
+	   alpn.size == 3 && memcmp(alpn.data, "dot", 3) == 0, "handshake: ALPN");
+	is_int(KNOT_EOK, knot_tls_handshake(conn, TIMEOUT), "handshake: repeated");
+
+	/* No kernel TLS on a UNIX socket, GnuTLS keeps the records. */
+	ret = knot_tls_ktls_enable(conn);
+	ok(ret == KNOT_ENOTSUP && !conn->ktls_rx && !conn->ktls_tx,
+	   "socketpair: kTLS not used");
+
+	/* Send and receive. */
+	exchange(conn, client, "socketpair");
+
+	/* Two queries in one record, the second one isn't signalled by the socket. */
+	uint8_t two[2 * (2 + sizeof(query))];
+	knot_wire_write_u16(two, sizeof(query));
+	memcpy(two + 2, query, sizeof(query));
+	memcpy(two + 2 + sizeof(query), two, 2 + sizeof(query));
+	ok(client_send(client, two, sizeof(two)), "pending: client send");
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+	ret = knot_tls_recv_dns(conn, buf, sizeof(buf), TIMEOUT);
+	ok(ret == sizeof(query) && knot_tls_pending(conn), "pending: first query");
+	ret = knot_tls_recv_dns(conn, buf, sizeof(buf), TIMEOUT);
+	ok(ret == sizeof(query) && !knot_tls_pending(conn), "pending: second query");
+
+	/* Key update requested by the client. */
+	ret = gnutls_session_key_update(client, GNUTLS_KU_PEER);
+	is_int(GNUTLS_E_SUCCESS, ret, "key update: client");
+	exchange(conn, client, "key update");
+
+	/* Closed by the client. */
+	ret = gnutls_bye(client, GNUTLS_SHUT_WR);
+	ret = knot_tls_recv_dns(conn, buf, sizeof(buf), TIMEOUT);
+	is_int(KNOT_ECONN, ret, "close: server receive");
+
+	gnutls_deinit(client);
+	knot_tls_conn_del(conn);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void test_timeout(struct knot_quic_creds *creds)
+{
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		skip_block(2, "socketpair");
+		return;
+	}
+	set_nonblock(fds[0]);
+	set_nonblock(fds[1]);
+
+	knot_tls_conn_t *conn = knot_tls_conn_new(creds, fds[0]);
+	gnutls_session_t client = client_new(fds[1]);
+
+	int ret = knot_tls_handshake(conn, 10);
+	is_int(KNOT_EAGAIN, ret, "timeout: handshake started");
+
+	usleep(20000);
+	(void)gnutls_handshake(client);
+	ret = knot_tls_handshake(conn, 10);
+	is_int(KNOT_ETIMEOUT, ret, "timeout: whole handshake bounded");
+
+	gnutls_deinit(client);
+	knot_tls_conn_del(conn);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+#ifdef ENABLE_KTLS
+/*! \brief Compare the key update derivation with GnuTLS. */
+static void test_key_derivation(struct knot_quic_creds *creds)
+{
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		skip_block(2, "socketpair");
+		return;
+	}
+	set_nonblock(fds[0]);
+	set_nonblock(fds[1]);
+
+	knot_tls_conn_t *conn = knot_tls_conn_new(creds, fds[0]);
+	gnutls_session_t client = client_new(fds[1]);
+	(void)handshake(conn, client);
+
+	tls_conn_t *ctx = (tls_conn_t *)conn;
+	ok(ctx->secret_len > 0, "key derivation: traffic secrets kept");
+
+	/* GnuTLS updates its sending keys the same way as for the kernel. */
+	uint8_t secret[TLS_SECRET_MAX], key[32], iv[TLS13_IV_SIZE];
+	memcpy(secret, ctx->tx_secret, ctx->secret_len);
+	gnutls_mac_algorithm_t mac = (gnutls_mac_algorithm_t)gnutls_prf_hash_get(conn->session);
+	size_t key_len = gnutls_cipher_get_key_size(gnutls_cipher_get(conn->session));
+	int ret = tls13_expand_label(mac, secret, ctx->secret_len, "traffic upd",
+	                             secret, ctx->secret_len);
+	ret += tls13_expand_label(mac, secret, ctx->secret_len, "key", key, key_len);
+	ret += tls13_expand_label(mac, secret, ctx->secret_len, "iv", iv, sizeof(iv));
+
+	gnutls_datum_t mac_key, gnutls_iv, gnutls_key;
+	uint8_t seq[8];
+	ret += gnutls_session_key_update(conn->session, 0);
+	ret += gnutls_record_get_state(conn->session, 0, &mac_key, &gnutls_iv,
+	                               &gnutls_key, seq);
+	ok(ret == 0 && gnutls_key.size == key_len && gnutls_iv.size == sizeof(iv) &&
+	   memcmp(gnutls_key.data, key, key_len) == 0 &&
+	   memcmp(gnutls_iv.data, iv, sizeof(iv)) == 0,
+	   "key derivation: equal to GnuTLS");
+
+	gnutls_deinit(client);
+	knot_tls_conn_del(conn);
+	close(fds[0]);
+	close(fds[1]);
+}
+#endif
+
+static void test_ktls(struct knot_quic_creds *creds)
+{
+	struct sockaddr_in addr = { .sin_family = AF_INET };
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addr_len = sizeof(addr);
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+	int server_fd = -1;
+	if (listener < 0 || client_fd < 0 ||
+	    bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(listener, 1) != 0 ||
+	    getsockname(listener, (struct sockaddr *)&addr, &addr_len) != 0 ||
+	    connect(client_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    (server_fd = accept(listener, NULL, NULL)) < 0) {
+		skip_block(12, "TCP loopback");
+		goto finish;
+	}
+	set_nonblock(server_fd);
+	set_nonblock(client_fd);
+	int one = 1;
+	(void)setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	(void)setsockopt(server_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	knot_tls_conn_t *conn = knot_tls_conn_new(creds, server_fd);
+	gnutls_session_t client = client_new(client_fd);
+	int ret = handshake(conn, client);
+	is_int(KNOT_EOK, ret, "TCP: handshake");
+
+	if (knot_tls_ktls_enable(conn) != KNOT_EOK) {
+		skip_block(11, "kernel TLS not available");
+	} else {
+		ok(conn->ktls_rx && conn->ktls_tx, "kTLS: enabled");
+		exchange(conn, client, "kTLS");
+
+		/* Key update handled by the kernel, answered by our key update. */
+		ret = gnutls_session_key_update(client, GNUTLS_KU_PEER);
+		is_int(GNUTLS_E_SUCCESS, ret, "kTLS key update: client");
+		exchange(conn, client, "kTLS key update");
+
+		/* close_notify alert ends the connection without an I/O error. */
+		(void)gnutls_bye(client, GNUTLS_SHUT_WR);
+		uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+		ret = knot_tls_recv_dns(conn, buf, sizeof(buf), TIMEOUT);
+		is_int(KNOT_ECONN, ret, "kTLS close: server receive");
+	}
+
+	gnutls_deinit(client);
+	knot_tls_conn_del(conn);
+finish:
+	if (server_fd >= 0) {
+		close(server_fd);
+	}
+	close(client_fd);
+	close(listener);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *tmp_dir = test_mkdtemp();
+	ok(tmp_dir != NULL, "create temporary directory");
+	char key_file[256];
+	(void)snprintf(key_file, sizeof(key_file), "%s/key.pem", tmp_dir);
+
+	struct knot_quic_creds *creds = knot_quic_init_creds(true, NULL, key_file, NULL, 0);
+	ok(creds != NULL, "create server credentials");
+	ok(gnutls_certificate_allocate_credentials(&client_cred) == GNUTLS_E_SUCCESS,
+	   "create client credentials");
+
+	test_socketpair(creds);
+	test_timeout(creds);
+#ifdef ENABLE_KTLS
+	test_key_derivation(creds);
+#endif
+	test_ktls(creds);
+
+	gnutls_certificate_free_credentials(client_cred);
+	knot_quic_free_creds(creds);
+	test_rm_rf(tmp_dir);
+	free(tmp_dir);
+
+	return 0;
+}
@@ -590,6 +590,60 @@ void test_obufs(void)
 	free(data);
 }
 
+void test_syn_cookies(void)
+{
+	knot_xdp_msg_t msg;
+	knot_tcp_relay_t rl = { 0 };
+	test_table->syn_cookies = true;
+
+	prepare_msg(&msg, KNOT_XDP_MSG_SYN, 3, 2);
+	msg.mss = 1460;
+	msg.win_scale = 7;
+	int ret = knot_tcp_recv(&rl, &msg, 1, test_table, test_syn_table, XDP_TCP_IGNORE_NONE);
+	is_int(KNOT_EOK, ret, "SYN cookie: relay OK");
+	is_int(XDP_TCP_SYN, rl.action, "SYN cookie: relay action");
+	ok(rl.conn == NULL, "SYN cookie: no connection");
+	is_int(0, test_table->usage, "SYN cookie: no connection in normal table");
+	is_int(0, test_syn_table->usage, "SYN cookie: no connection in SYN table");
+	ret = knot_tcp_send(test_sock, &rl, 1, 1);
+	is_int(KNOT_EOK, ret, "SYN cookie: send OK");
+	is_int(msg.seqno + 1, sent_ackno, "SYN cookie: ackno");
+	is_int(rl.auto_seqno, sent_seqno, "SYN cookie: seqno is the cookie");
+	check_sent(0, 0, 1, 0);
+
+	// Forged ACK.
+	prepare_msg(&msg, KNOT_XDP_MSG_ACK, 3, 2);
+	prepare_seqack(&msg, 0, 2);
+	ret = knot_tcp_recv(&rl, &msg, 1, test_table, test_syn_table, XDP_TCP_IGNORE_NONE);
+	is_int(KNOT_EOK, ret, "SYN cookie: forged ACK relay OK");
+	ok(knot_tcp_relay_empty(&rl), "SYN cookie: forged ACK ignored");
+	is_int(0, test_table->usage, "SYN cookie: forged ACK no connection");
+
+	// Valid ACK carrying a query.
+	const char query[] = "\x00\x03xyz";
+	prepare_seqack(&msg, 0, 1);
+	prepare_data(&msg, query, sizeof(query) - 1);
+	ret = knot_tcp_recv(&rl, &msg, 1, test_table, test_syn_table, XDP_TCP_IGNORE_NONE);
+	is_int(KNOT_EOK, ret, "SYN cookie: ACK relay OK");
+	is_int(XDP_TCP_ESTABLISH, rl.action, "SYN cookie: established");
+	is_int(1, test_table->usage, "SYN cookie: one connection in normal table");
+	knot_tcp_conn_t *conn = tcp_table_find(test_table, &msg);
+	ok(conn != NULL && conn == rl.conn, "SYN cookie: relay points to connection");
+	assert(conn);
+	is_int(XDP_TCP_NORMAL, conn->state, "SYN cookie: connection state");
+	is_int(1460, conn->mss, "SYN cookie: MSS");
+	is_int(7, conn->window_scale, "SYN cookie: window scale");
+	is_int(1, rl.inbufs_count, "SYN cookie: query received");
+	is_int(KNOT_XDP_MSG_ACK, rl.auto_answer, "SYN cookie: data ACKed");
+	ret = knot_tcp_send(test_sock, &rl, 1, 1);
+	is_int(KNOT_EOK, ret, "SYN cookie: send OK");
+	check_sent(1, 0, 0, 0);
+
+	knot_tcp_cleanup(test_table, &rl, 1);
+	test_table->syn_cookies = false;
+	clean_table();
+}
+
 static void init_mock(knot_xdp_socket_t **socket, void *send_mock)
 {
 	*socket = calloc(1, sizeof(**socket));
@@ -614,6 +668,7 @@ int main(int argc, char *argv[])
 	test_syn_ack();
 	test_data_fragments();
 	test_close();
+	test_syn_cookies();
 
 	test_ibufs_size();
 
@@ -0,0 +1,181 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libdnssec/crypto.h"
+#include "libknot/libknot.h"
+#include "contrib/sockaddr.h"
+#include "contrib/time.h"
+#include "knot/modules/rrl/functions.c"
+#include "bench_rrl_mutex.h"
+
+#define BENCH_TBL_SIZE		393241
+#define BENCH_RATE		200
+#define BENCH_SOURCES		1024	/* Distinct /24 sources in the flood. */
+#define BENCH_MAX_THREADS	64
+
+typedef enum {
+	MODE_LOCKFREE,
+	MODE_MUTEX,
+} bench_mode_t;
+
+typedef struct {
+	bench_mode_t mode;
+	void *rrl;
+	rrl_req_t *req;
+	const knot_dname_t *zone;
+	pthread_barrier_t *barrier;
+	volatile bool *stop;
+	unsigned id;
+	uint64_t queries;
+} bench_thread_t;
+
+static void *bench_thread(void *arg)
+{
+	bench_thread_t *ctx = arg;
+
+	struct sockaddr_storage addr;
+	sockaddr_set(&addr, AF_INET, "10.0.0.0", 0);
+	struct sockaddr_in *addr4 = (struct sockaddr_in *)&addr;
+
+	unsigned src = ctx->id * 7919;
+	uint64_t queries = 0;
+
+	pthread_barrier_wait(ctx->barrier);
+
+	while (!*ctx->stop) {
+		src = (src + 1) % BENCH_SOURCES;
+		addr4->sin_addr.s_addr = htonl(0x0a000000 + (src << 8));
+		if (ctx->mode == MODE_LOCKFREE) {
+			(void)rrl_query(ctx->rrl, &addr, ctx->req, ctx->zone, NULL);
+		} else {
+			(void)rrl_mutex_query(ctx->rrl, &addr, ctx->req, ctx->zone);
+		}
+		queries++;
+	}
+
+	ctx->queries = queries;
+
+	return NULL;
+}
+
+static double bench_run(bench_mode_t mode, unsigned threads, unsigned msecs,
+                        rrl_req_t *req, const knot_dname_t *zone)
+{
+	void *rrl;
+	if (mode == MODE_LOCKFREE) {
+		rrl = rrl_create(BENCH_TBL_SIZE, BENCH_RATE);
+	} else {
+		rrl = rrl_mutex_create(BENCH_TBL_SIZE, BENCH_RATE);
+	}
+	if (rrl == NULL) {
+		return 0.0;
+	}
+
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, threads + 1);
+	volatile bool stop = false;
+
+	pthread_t thr[BENCH_MAX_THREADS];
+	bench_thread_t ctx[BENCH_MAX_THREADS];
+	for (unsigned i = 0; i < threads; i++) {
+		ctx[i] = (bench_thread_t) {
+			.mode = mode,
+			.rrl = rrl,
+			.req = req,
+			.zone = zone,
+			.barrier = &barrier,
+			.stop = &stop,
+			.id = i,
+		};
+		pthread_create(&thr[i], NULL, bench_thread, &ctx[i]);
+	}
+
+	pthread_barrier_wait(&barrier);
+	struct timespec begin = time_now();
+	struct timespec sleep = { msecs / 1000, (msecs % 1000) * 1000000 };
+	nanosleep(&sleep, NULL);
+	stop = true;
+
+	uint64_t queries = 0;
+	for (unsigned i = 0; i < threads; i++) {
+		pthread_join(thr[i], NULL);
+		queries += ctx[i].queries;
+	}
+	struct timespec end = time_now();
+	double elapsed = time_diff_ms(&begin, &end);
+
+	pthread_barrier_destroy(&barrier);
+	if (mode == MODE_LOCKFREE) {
+		rrl_destroy(rrl);
+	} else {
+		rrl_mutex_destroy(rrl);
+	}
+
+	return queries / elapsed / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned msecs = 1000;
+	if (argc > 1) {
+		msecs = atoi(argv[1]);
+	}
+	if (argc > 2 || msecs == 0) {
+		printf("RRL table microbenchmark.\n"
+		       "Usage: bench_rrl [msecs_per_run]\n");
+		return EXIT_FAILURE;
+	}
+
+	dnssec_crypto_init();
+
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MIN_PKTSIZE, NULL);
+	knot_dname_t *qname = knot_dname_from_str_alloc("flood.rrl.");
+	knot_dname_t *zone = knot_dname_from_str_alloc("rrl.");
+	if (query == NULL || qname == NULL || zone == NULL ||
+	    knot_pkt_put_question(query, qname, KNOT_CLASS_IN, KNOT_RRTYPE_A) != KNOT_EOK) {
+		printf("Failed to prepare the query\n");
+		return EXIT_FAILURE;
+	}
+
+	uint8_t response[KNOT_WIRE_MIN_PKTSIZE];
+	memcpy(response, query->wire, query->size);
+	knot_wire_set_qr(response);
+	knot_wire_set_ancount(response, 1);
+
+	rrl_req_t req = {
+		.wire = response,
+		.len = query->size,
+		.query = query,
+	};
+
+	printf("%8s %16s %16s\n", "threads", "lock-free Mqps", "mutex Mqps");
+	for (unsigned threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+		double lockfree = bench_run(MODE_LOCKFREE, threads, msecs, &req, zone);
+		double mutex = bench_run(MODE_MUTEX, threads, msecs, &req, zone);
+		printf("%8u %16.2f %16.2f\n", threads, lockfree, mutex);
+	}
+
+	knot_dname_free(zone, NULL);
+	knot_dname_free(qname, NULL);
+	knot_pkt_free(query);
+	dnssec_crypto_cleanup();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief The former mutex-protected hopscotch RRL table, kept as a baseline
+ *        for bench_rrl. Buckets are classified the same way as in the module,
+ *        state changes aren't logged.
+ */
+
+#pragma once
+
+#include "knot/modules/rrl/functions.h"
+
+typedef struct rrl_mutex_table rrl_mutex_table_t;
+
+rrl_mutex_table_t *rrl_mutex_create(size_t size, uint32_t rate);
+
+int rrl_mutex_query(rrl_mutex_table_t *rrl, const struct sockaddr_storage *remote,
+                    rrl_req_t *req, const knot_dname_t *zone);
+
+void rrl_mutex_destroy(rrl_mutex_table_t *rrl);
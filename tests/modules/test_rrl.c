@@ -14,6 +14,7 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
 #include <tap/basic.h>
 
 #include "libdnssec/crypto.h"
@@ -54,21 +55,19 @@ static void* rrl_runnable(void *arg)
 	struct runnable_data *d = (struct runnable_data *)arg;
 	struct sockaddr_storage addr;
 	memcpy(&addr, d->addr, sizeof(struct sockaddr_storage));
-	int lock = -1;
+	uint8_t buf[RRL_CLSBLK_MAXLEN];
 	uint32_t now = time(NULL);
 	struct bucketmap *m = malloc(RRL_INSERTS * sizeof(struct bucketmap));
 	for (unsigned i = 0; i < RRL_INSERTS; ++i) {
 		m[i].i = dnssec_random_uint32_t();
 		((struct sockaddr_in *) &addr)->sin_addr.s_addr = m[i].i;
-		rrl_item_t *b = rrl_hash(d->rrl, &addr, d->rq, d->zone, now, &lock);
-		rrl_unlock(d->rrl, lock);
-		m[i].x = b->netblk;
+		int len = rrl_classify(buf, sizeof(buf), &addr, d->rq, d->zone);
+		m[i].x = SipHash24(&d->rrl->key, buf, len);
+		(void)rrl_query(d->rrl, &addr, d->rq, d->zone, NULL);
 	}
 	for (unsigned i = 0; i < RRL_INSERTS; ++i) {
-		((struct sockaddr_in *) &addr)->sin_addr.s_addr = m[i].i;
-		rrl_item_t *b = rrl_hash(d->rrl, &addr, d->rq, d->zone, now, &lock);
-		rrl_unlock(d->rrl, lock);
-		if (b->netblk != m[i].x) {
+		rrl_item_t *b = rrl_bucket(d->rrl, m[i].x, now);
+		if (b->tag != hash_tag(m[i].x)) {
 			d->passed = 0;
 		}
 	}
@@ -153,12 +152,43 @@ int main(int argc, char *argv[])
 	rrl_classify(buf, sizeof(buf), &addr6, &rq, qname);
 	is_int(0, memcmp(buf, expectedv6, sizeof(expectedv6)), "rrl: IPv6 hash input buffer");
 
+	/* 4. Full burst at the maximum rate. */
+	ok(rrl_create(RRL_SIZE, RRL_RATE_MAX + 1) == NULL, "rrl: rate over maximum rejected");
+	rrl_table_t *rrl_max = rrl_create(RRL_SIZE, RRL_RATE_MAX);
+	struct sockaddr_storage addr_max;
+	sockaddr_set(&addr_max, AF_INET, "5.6.7.8", 0);
+	unsigned passed = 0;
+	while (rrl_query(rrl_max, &addr_max, &rq, zone, NULL) == KNOT_EOK &&
+	       passed <= RRL_CAPACITY * RRL_RATE_MAX) {
+		passed++;
+	}
+	ok(passed >= RRL_CAPACITY * RRL_RATE_MAX, "rrl: full burst at maximum rate");
+	rrl_destroy(rrl_max);
+
+	/* 5. Bucket timestamp doesn't alias after a long idle period. */
+	const uint16_t check = hash_check(0xbeef);
+	const uint32_t then = 0xfffffff0;
+	rrl_bucket_t limited = {
+		.check = check,
+		.flags = RRL_BF_ELIMIT,
+		.ntok = 0,
+		.time = then
+	};
+	uint8_t log;
+	bucket_visit(rrl, bucket_pack(&limited), check, then, &log, &ret);
+	is_int(KNOT_ELIMIT, ret, "rrl: bucket limited");
+	bucket_visit(rrl, bucket_pack(&limited), check, then + 65536, &log, &ret);
+	is_int(KNOT_EOK, ret, "rrl: bucket refilled after timestamp wrap");
+	uint64_t state = bucket_visit(rrl, bucket_pack(&limited), check, then - 1, &log, &ret);
+	ok(ret == KNOT_ELIMIT && bucket_unpack(state).time == then,
+	   "rrl: bucket not refilled by an earlier visit");
+
 #ifdef ENABLE_TIMED_TESTS
-	/* 5. limited request */
+	/* 6. limited request */
 	ret = rrl_query(rrl, &addr, &rq, zone, NULL);
 	is_int(KNOT_ELIMIT, ret, "rrl: throttled IPv4 request");
 
-	/* 6. limited IPv6 request */
+	/* 7. limited IPv6 request */
 	ret = rrl_query(rrl, &addr6, &rq, zone, NULL);
 	is_int(KNOT_ELIMIT, ret, "rrl: throttled IPv6 request");
 